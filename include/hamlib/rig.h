@@ -330,6 +330,7 @@ typedef enum rig_port_e {
     RIG_PORT_CM108,         /*!< CM108 GPIO */
     RIG_PORT_GPIO,          /*!< GPIO */
     RIG_PORT_GPION,         /*!< GPIO inverted */
+    RIG_PORT_REPLAY,        /*!< Playback of a capture file, see replay_file */
 } rig_port_t;
 
 
@@ -1877,6 +1878,46 @@ struct rig_spectrum_line
     unsigned char *spectrum_data; /*!< 8-bit spectrum data covering bandwidth of either the span_freq in center mode or from low edge to high edge in fixed mode. A higher value represents higher signal strength. */
 };
 
+/**
+ * \brief State of a VFO as one command of the rig reports it
+ *
+ * Several rigs answer freq, mode, PTT, split, RIT and XIT with a single
+ * command, like the IF of Kenwood and Yaesu.  The caller of
+ * rig_get_status_bulk() sets vfo, the backend fills in what its command
+ * tells and sets the matching RIG_STATUS_* bits in valid.  It may change
+ * vfo to the VFO the answer is about, e.g. RIG_VFO_CURR to RIG_VFO_A.
+ */
+struct rig_status_bulk
+{
+    vfo_t vfo;          /*!< VFO asked for */
+    unsigned int valid; /*!< RIG_STATUS_* bits of the fields filled in */
+    freq_t freq;        /*!< Frequency in Hz */
+    rmode_t mode;       /*!< Mode */
+    pbwidth_t width;    /*!< Passband width in Hz */
+    ptt_t ptt;          /*!< PTT of the rig */
+    split_t split;      /*!< Split */
+    vfo_t tx_vfo;       /*!< TX VFO, with RIG_STATUS_SPLIT */
+    shortfreq_t rit;    /*!< RIT offset in Hz, 0 when RIT is off */
+    shortfreq_t xit;    /*!< XIT offset in Hz, 0 when XIT is off */
+};
+
+#define RIG_STATUS_FREQ     (1 << 0)
+#define RIG_STATUS_MODE     (1 << 1)
+#define RIG_STATUS_WIDTH    (1 << 2)
+#define RIG_STATUS_PTT      (1 << 3)
+#define RIG_STATUS_SPLIT    (1 << 4)
+#define RIG_STATUS_RIT      (1 << 5)
+#define RIG_STATUS_XIT      (1 << 6)
+
+/**
+ * \brief Bits of rig_caps.cache_flags
+ *
+ * RIG_CACHE_FLAG_NO_FASTPATH: rig_get_freq() and rig_get_mode() of the
+ * current VFO do more than look at the cache for this rig, so rigctld
+ * must not answer get_freq and get_mode from the cache by itself.
+ */
+#define RIG_CACHE_FLAG_NO_FASTPATH (1 << 0)
+
 /**
  * Config item for deferred processing
  *  (Funky names to avoid clash with perl keywords. Sheesh.)
@@ -2225,6 +2266,8 @@ struct rig_caps {
     int (*get_lock_mode)(RIG *rig, int *mode);
     short timeout_retry;    /*!< number of retries to make in case of read timeout errors, some serial interfaces may require this, 0 to use default value, -1 to disable */
     short morse_qsize;  /*!< max length of morse message rig can accept in one command */
+    int (*get_status_bulk)(RIG *rig, struct rig_status_bulk *status, int n); /*!< State of n VFOs with as few commands as the rig allows, see rig_get_status_bulk() */
+    unsigned int cache_flags;   /*!< RIG_CACHE_FLAG_* bits */
 //    int (*bandwidth2rig)(RIG  *rig, enum bandwidth_t bandwidth);
 //    enum bandwidth_t (*rig2bandwidth)(RIG  *rig, int rigbandwidth);
 };
@@ -2453,7 +2496,11 @@ typedef enum {
     HAMLIB_CACHE_MODE,
     HAMLIB_CACHE_PTT,
     HAMLIB_CACHE_SPLIT,
-    HAMLIB_CACHE_WIDTH
+    HAMLIB_CACHE_WIDTH,
+    HAMLIB_CACHE_LEVEL, // levels other than meters, 0 by default
+    HAMLIB_CACHE_METER, // RIG_LEVEL_READONLY_LIST, 0 by default
+    HAMLIB_CACHE_FUNC,  // 0 by default
+    HAMLIB_CACHE_PARM   // 0 by default
 } hamlib_cache_t;
 
 typedef enum {
@@ -2754,6 +2801,11 @@ rig_get_vfo_info HAMLIB_PARAMS((RIG *rig,
 extern HAMLIB_EXPORT(int)
 rig_get_vfo_list HAMLIB_PARAMS((RIG *rig, char *buf, int buflen));
 
+extern HAMLIB_EXPORT(int)
+rig_get_status_bulk HAMLIB_PARAMS((RIG *rig,
+                           struct rig_status_bulk *status,
+                           int n));
+
 extern HAMLIB_EXPORT(int)
 netrigctl_get_vfo_mode HAMLIB_PARAMS((RIG *rig));
 
@@ -246,6 +246,11 @@ struct rig_state {
     int freq_skip; /*!< allow frequency skip for gpredict RX/TX freq set */
     client_t client;        /*!< Client application of the library. */
     pthread_mutex_t api_mutex;      /*!< Lock for any API entry. */
+    int event_queue_size;   /*!< Events waiting for the callback dispatch thread, 0 calls callbacks inline */
+    int event_overflow;     /*!< What a full event queue does with a new event, see event.h */
+    void *event_dispatch_priv_data; /*!< Pointer to rig_event_dispatch_priv_data. */
+    int poll_refresh;       /*!< Poll routine refreshes the cache itself, see rig_poll_routine() */
+    int poll_budget;        /*!< Percent of the serial port bytes/s the refreshes may use */
 // New rig_state items go before this line ============================================
 };
 
@@ -1823,7 +1823,7 @@ static int flrig_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode, pbwidth_t *width)
         {
             rig_debug(RIG_DEBUG_WARN, "%s: empty value, returning cached bandwidth\n",
                       __func__);
-            *width = CACHE(rig)->widthMainA;
+            *width = CACHE(rig)->slot[CACHE_SLOT_MAIN_A].width;
             RETURNFUNC(RIG_OK);
         }
 
@@ -1850,7 +1850,7 @@ static int flrig_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode, pbwidth_t *width)
             {
                 rig_debug(RIG_DEBUG_WARN, "%s: empty value, returning cached bandwidth\n",
                           __func__);
-                *width = CACHE(rig)->widthMainA;
+                *width = CACHE(rig)->slot[CACHE_SLOT_MAIN_A].width;
                 RETURNFUNC(RIG_OK);
             }
 
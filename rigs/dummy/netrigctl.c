@@ -24,6 +24,11 @@
 #include <stdlib.h>
 #include <string.h>  /* String function definitions */
 #include <unistd.h>  /* UNIX standard function definitions */
+#include <errno.h>
+
+#ifdef HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
 
 #include "hamlib/rig.h"
 #include "iofunc.h"
@@ -37,12 +42,89 @@
 
 #define CHKSCN1ARG(a) if ((a) != 1) return -RIG_EPROTO; else do {} while(0)
 
+#define NETRIGCTL_PIPELINE_MAX 16   /* set replies owed before one is waited for */
+
+/* backend conf */
+#define TOK_NET_PIPELINE    TOKEN_BACKEND(1)
+#define TOK_NET_MIRROR_MS   TOKEN_BACKEND(2)
+#define TOK_NET_STATE_CACHE TOKEN_BACKEND(3)
+
+/*
+ * Values rigctld pushed for its current VFO, see \subscribe.  Each item
+ * is good for mirror_ms after it came in or was set by us.
+ */
+enum netrigctl_mirror_item_e
+{
+    NETRIGCTL_MIRROR_FREQ,
+    NETRIGCTL_MIRROR_MODE,
+    NETRIGCTL_MIRROR_PTT,
+    NETRIGCTL_MIRROR_VFO,
+    NETRIGCTL_MIRROR_ITEMS
+};
+
+struct netrigctl_mirror
+{
+    int on;                     /* rigctld took the subscription */
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    ptt_t ptt;
+    vfo_t vfo;
+    int valid[NETRIGCTL_MIRROR_ITEMS];
+    struct timespec time[NETRIGCTL_MIRROR_ITEMS];
+};
+
+/*
+ * The \dump_state text of this open.  It is replayed from a file saved
+ * by an earlier open when rigctld reports the same hash, else recorded
+ * as it comes in to be saved.
+ */
+struct netrigctl_dump
+{
+    char *text;
+    size_t len;
+    size_t size;
+    size_t pos;                 /* next line to replay */
+    int replay;
+    int record;
+    int model;                  /* what \dump_state_hash said */
+    size_t hash_len;
+    uint32_t hash;
+};
+
 struct netrigctl_priv_data
 {
     vfo_t vfo_curr;
     int rigctld_vfo_mode;
     vfo_t rx_vfo;
     vfo_t tx_vfo;
+    int pipeline;               /* do not wait for the reply of sets */
+    int pending;                /* replies of pipelined sets not read yet */
+    int stale;                  /* a read failed, the stream may be out of step */
+    int mirror_ms;              /* 0 no mirror */
+    struct netrigctl_mirror mirror;
+    char state_cache[HAMLIB_FILPATHLEN];    /* "" do not save \dump_state */
+    struct netrigctl_dump dump;
+};
+
+static const struct confparams netrigctl_cfg_params[] =
+{
+    {
+        TOK_NET_PIPELINE, "pipeline", "Pipeline sets",
+        "Send set_freq, set_mode, set_level, set_func, set_rit and set_xit without waiting for their reply, failures are only logged",
+        "0", RIG_CONF_CHECKBUTTON
+    },
+    {
+        TOK_NET_MIRROR_MS, "mirror_ms", "Mirror max age",
+        "Subscribe to rigctld changes and answer get_freq, get_mode and get_ptt from values at most this many ms old, 0 disables",
+        "0", RIG_CONF_NUMERIC, { .n = { 0, 3600000, 1 } }
+    },
+    {
+        TOK_NET_STATE_CACHE, "state_cache", "State cache directory",
+        "Directory to save the rigctld \\dump_state in, reopening skips its transfer while rigctld reports the same hash",
+        "", RIG_CONF_STRING
+    },
+    { RIG_CONF_END, NULL, }
 };
 
 int netrigctl_get_vfo_mode(RIG *rig)
@@ -52,6 +134,185 @@ int netrigctl_get_vfo_mode(RIG *rig)
     return priv->rigctld_vfo_mode;
 }
 
+static void netrigctl_mirror_set(RIG *rig, int item)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+    priv->mirror.valid[item] = 1;
+    elapsed_ms(&priv->mirror.time[item], HAMLIB_ELAPSED_SET);
+}
+
+static void netrigctl_mirror_drop(RIG *rig)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+    memset(priv->mirror.valid, 0, sizeof(priv->mirror.valid));
+}
+
+/* 1 when item came in or was set less than mirror_ms ago */
+static int netrigctl_mirror_fresh(RIG *rig, int item)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+    return priv->mirror.on && priv->mirror.valid[item]
+           && elapsed_ms(&priv->mirror.time[item], HAMLIB_ELAPSED_GET) < priv->mirror_ms;
+}
+
+/* take in a pushed "EVENT item value" line, 0 if buf is something else */
+static int netrigctl_event(RIG *rig, const char *buf)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+    struct netrigctl_mirror *m = &priv->mirror;
+    char item[16], value[32];
+    long width;
+    int ptt;
+
+    if (strncmp(buf, "EVENT ", 6) != 0) { return 0; }
+
+    if (sscanf(buf + 6, "%15s %31s", item, value) != 2) { return 1; }
+
+    // sent before the pipelined sets took effect
+    if (priv->pending > 0 && strcmp(item, "ptt") != 0) { return 1; }
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: %s %s\n", __func__, item, value);
+
+    if (strcmp(item, "freq") == 0 && num_sscanf(value, "%"SCNfreq, &m->freq) == 1)
+    {
+        netrigctl_mirror_set(rig, NETRIGCTL_MIRROR_FREQ);
+    }
+    else if (strcmp(item, "mode") == 0
+             && sscanf(buf + 6, "%*s %*s %ld", &width) == 1)
+    {
+        m->mode = rig_parse_mode(value);
+        m->width = width;
+        netrigctl_mirror_set(rig, NETRIGCTL_MIRROR_MODE);
+    }
+    else if (strcmp(item, "ptt") == 0 && sscanf(value, "%d", &ptt) == 1)
+    {
+        m->ptt = ptt;
+        netrigctl_mirror_set(rig, NETRIGCTL_MIRROR_PTT);
+    }
+    else if (strcmp(item, "vfo") == 0)
+    {
+        m->vfo = rig_parse_vfo(value);
+        netrigctl_mirror_set(rig, NETRIGCTL_MIRROR_VFO);
+    }
+
+    return 1;
+}
+
+/* one line, a failed read leaves the stream out of step */
+static int netrigctl_read_raw(RIG *rig, char *buf)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+    int ret = read_string(RIGPORT(rig), (unsigned char *) buf, BUF_MAX, "\n", 1, 0,
+                          1);
+
+    if (ret < 0) { priv->stale = 1; }
+
+    return ret;
+}
+
+/* the next line that is not a pushed event */
+static int netrigctl_read_line(RIG *rig, char *buf)
+{
+    int ret;
+
+    do
+    {
+        ret = netrigctl_read_raw(rig, buf);
+    }
+    while (ret >= 0 && netrigctl_event(rig, buf));
+
+    return ret;
+}
+
+/* a reply line of a pipelined set came in */
+static void netrigctl_pipelined_reply(RIG *rig, const char *buf)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+    priv->pending--;
+
+    if (strncmp(buf, NETRIGCTL_RET, strlen(NETRIGCTL_RET)) != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: unexpected reply '%s'\n", __func__, buf);
+        priv->stale = 1;
+    }
+    else if (atoi(buf + strlen(NETRIGCTL_RET)) != RIG_OK)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: pipelined set failed: %s", __func__, buf);
+        // what we assumed it set is not so
+        netrigctl_mirror_drop(rig);
+    }
+}
+
+/* 1 when a line can be read right away */
+static int netrigctl_data_waiting(hamlib_port_t *rp)
+{
+    fd_set set;
+    struct timeval tv = { 0, 0 };
+
+    if (port_rx_pending(rp) > 0) { return 1; }
+
+    FD_ZERO(&set);
+    FD_SET(rp->fd, &set);
+
+    return select(rp->fd + 1, &set, NULL, NULL, &tv) > 0;
+}
+
+/*
+ * Take in whatever already arrived without waiting: pushed events, replies
+ * of pipelined sets, and leftovers of a command that timed out, which go.
+ */
+static void netrigctl_poll(RIG *rig)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+    hamlib_port_t *rp = RIGPORT(rig);
+    char buf[BUF_MAX];
+
+    if (priv->stale)
+    {
+        rig_flush(rp);
+        priv->pending = 0;
+        priv->stale = 0;
+        netrigctl_mirror_drop(rig);
+    }
+
+    while (netrigctl_data_waiting(rp))
+    {
+        if (netrigctl_read_raw(rig, buf) < 0 || netrigctl_event(rig, buf)) { continue; }
+
+        if (priv->pending > 0)
+        {
+            netrigctl_pipelined_reply(rig, buf);
+            continue;
+        }
+
+        rig_debug(RIG_DEBUG_WARN, "%s: dropping '%s'\n", __func__, buf);
+    }
+}
+
+/* wait for the replies of all pipelined sets */
+static int netrigctl_drain(RIG *rig)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+    char buf[BUF_MAX];
+
+    netrigctl_poll(rig);
+
+    while (priv->pending > 0)
+    {
+        int ret = netrigctl_read_line(rig, buf);
+
+        if (ret < 0) { return ret; }
+
+        netrigctl_pipelined_reply(rig, buf);
+    }
+
+    return RIG_OK;
+}
+
 /*
  * Helper function with protocol return code parsing
  */
@@ -62,8 +323,13 @@ static int netrigctl_transaction(RIG *rig, char *cmd, int len, char *buf)
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s: called len=%d\n", __func__, len);
 
-    /* flush anything in the read buffer before command is sent */
-    rig_flush(rp);
+    /* replies still owed go before this one */
+    ret = netrigctl_drain(rig);
+
+    if (ret != RIG_OK)
+    {
+        return ret;
+    }
 
     ret = write_block(rp, (unsigned char *) cmd, len);
 
@@ -72,7 +338,7 @@ static int netrigctl_transaction(RIG *rig, char *cmd, int len, char *buf)
         return ret;
     }
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_read_line(rig, buf);
 
     if (ret < 0)
     {
@@ -87,6 +353,40 @@ static int netrigctl_transaction(RIG *rig, char *cmd, int len, char *buf)
     return ret;
 }
 
+/*
+ * A set that only answers "RPRT x".  With pipelining its reply is read
+ * later, so a burst of sets costs no round trip each.
+ */
+static int netrigctl_transaction_set(RIG *rig, char *cmd, int len, char *buf)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+    int ret;
+
+    if (!priv->pipeline)
+    {
+        ret = netrigctl_transaction(rig, cmd, len, buf);
+
+        return ret > 0 ? -RIG_EPROTO : ret;
+    }
+
+    netrigctl_poll(rig);
+
+    if (priv->pending >= NETRIGCTL_PIPELINE_MAX)
+    {
+        ret = netrigctl_read_line(rig, buf);
+
+        if (ret < 0) { return ret; }
+
+        netrigctl_pipelined_reply(rig, buf);
+    }
+
+    ret = write_block(RIGPORT(rig), (unsigned char *) cmd, len);
+
+    if (ret == RIG_OK) { priv->pending++; }
+
+    return ret;
+}
+
 /* this will fill vfostr with the vfo value if the vfo mode is enabled
  * otherwise string will be null terminated
  * this allows us to use the string in snprintf in either mode
@@ -154,6 +454,20 @@ static int netrigctl_vfostr(RIG *rig, char *vfostr, int len, vfo_t vfo)
     return RIG_OK;
 }
 
+/*
+ * 1 when the mirror holds the VFO of vfostr.  Without a VFO argument
+ * rigctld answers for its current VFO, which is the one it pushes.
+ */
+static int netrigctl_mirror_vfo(RIG *rig, const char *vfostr)
+{
+    const struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+    if (vfostr[0] == '\0') { return 1; }
+
+    return priv->mirror.valid[NETRIGCTL_MIRROR_VFO]
+           && priv->mirror.vfo == rig_parse_vfo(vfostr + 1);
+}
+
 static int netrigctl_init(RIG *rig)
 {
     // cppcheck says leak here but it's freed in cleanup
@@ -189,7 +503,11 @@ static int netrigctl_init(RIG *rig)
 
 static int netrigctl_cleanup(RIG *rig)
 {
-    if (STATE(rig)->priv) { free(STATE(rig)->priv); }
+    if (STATE(rig)->priv)
+    {
+        free(((struct netrigctl_priv_data *)STATE(rig)->priv)->dump.text);
+        free(STATE(rig)->priv);
+    }
 
     STATE(rig)->priv = NULL;
     return RIG_OK;
@@ -244,11 +562,230 @@ int parse_array_double(const char *s, const char *delim, double *array,
 
 
 
-static int netrigctl_open(RIG *rig)
+static void netrigctl_dump_path(RIG *rig, char *path, int len)
+{
+    const struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+    SNPRINTF(path, len, "%s/netrigctl-%d-%08x.state", priv->state_cache,
+             priv->dump.model, priv->dump.hash);
+}
+
+/* 1 when text is what \dump_state_hash announced */
+static int netrigctl_dump_good(const struct netrigctl_dump *dump)
+{
+    return dump->len == dump->hash_len
+           && CRC32_function((const uint8_t *) dump->text, dump->len) == dump->hash;
+}
+
+static int netrigctl_dump_append(struct netrigctl_dump *dump, const char *line,
+                                 size_t n)
+{
+    if (dump->len + n > dump->size)
+    {
+        size_t size = dump->size ? dump->size * 2 : 8192;
+        char *text;
+
+        while (size < dump->len + n) { size *= 2; }
+
+        text = realloc(dump->text, size);
+
+        if (text == NULL) { return -RIG_ENOMEM; }
+
+        dump->text = text;
+        dump->size = size;
+    }
+
+    memcpy(dump->text + dump->len, line, n);
+    dump->len += n;
+
+    return RIG_OK;
+}
+
+/* replay the saved copy if there is one and it matches the hash */
+static int netrigctl_dump_load(RIG *rig)
+{
+    struct netrigctl_dump *dump = &((struct netrigctl_priv_data *)
+                                    STATE(rig)->priv)->dump;
+    char path[HAMLIB_FILPATHLEN + 32];
+    FILE *fp;
+
+    netrigctl_dump_path(rig, path, sizeof(path));
+
+    fp = fopen(path, "rb");
+
+    if (fp == NULL) { return 0; }
+
+    dump->text = malloc(dump->hash_len + 1);
+
+    if (dump->text)
+    {
+        dump->size = dump->hash_len + 1;
+        dump->len = fread(dump->text, 1, dump->size, fp);
+    }
+
+    fclose(fp);
+
+    if (dump->text == NULL || !netrigctl_dump_good(dump))
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: ignoring bad %s\n", __func__, path);
+        dump->len = 0;
+        return 0;
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: state from %s\n", __func__, path);
+    dump->replay = 1;
+
+    return 1;
+}
+
+/* keep what came in for the next open */
+static void netrigctl_dump_save(RIG *rig)
+{
+    const struct netrigctl_dump *dump = &((struct netrigctl_priv_data *)
+                                          STATE(rig)->priv)->dump;
+    char path[HAMLIB_FILPATHLEN + 32], tmp[HAMLIB_FILPATHLEN + 40];
+    FILE *fp;
+    int ok;
+
+    if (!dump->record) { return; }
+
+    if (!netrigctl_dump_good(dump))
+    {
+        // rigctld changed something between the hash and the dump
+        rig_debug(RIG_DEBUG_WARN, "%s: state does not match its hash\n", __func__);
+        return;
+    }
+
+    netrigctl_dump_path(rig, path, sizeof(path));
+    SNPRINTF(tmp, sizeof(tmp), "%s.tmp", path);
+
+    fp = fopen(tmp, "wb");
+
+    if (fp == NULL)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: cannot write %s: %s\n", __func__, tmp,
+                  strerror(errno));
+        return;
+    }
+
+    ok = fwrite(dump->text, 1, dump->len, fp) == dump->len;
+    ok = fclose(fp) == 0 && ok;
+
+    // a reader never sees half a file
+    if (!ok || rename(tmp, path) != 0)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: cannot save %s\n", __func__, path);
+        remove(tmp);
+        return;
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: state saved to %s\n", __func__, path);
+}
+
+static void netrigctl_dump_free(RIG *rig)
+{
+    struct netrigctl_dump *dump = &((struct netrigctl_priv_data *)
+                                    STATE(rig)->priv)->dump;
+
+    free(dump->text);
+    memset(dump, 0, sizeof(*dump));
+}
+
+/* next line of the \dump_state text, read_string() style */
+static int netrigctl_dump_line(RIG *rig, char *buf)
+{
+    struct netrigctl_dump *dump = &((struct netrigctl_priv_data *)
+                                    STATE(rig)->priv)->dump;
+    int ret;
+
+    if (dump->replay)
+    {
+        const char *line = dump->text + dump->pos;
+        const char *eol = memchr(line, '\n', dump->len - dump->pos);
+        size_t n = eol ? eol - line + 1 : dump->len - dump->pos;
+
+        if (n == 0) { return -RIG_EPROTO; }
+
+        dump->pos += n;
+
+        if (n > BUF_MAX - 1) { n = BUF_MAX - 1; }
+
+        memcpy(buf, line, n);
+        buf[n] = '\0';
+
+        return n;
+    }
+
+    ret = netrigctl_read_line(rig, buf);
+
+    if (ret > 0 && dump->record
+            && netrigctl_dump_append(dump, buf, ret) != RIG_OK)
+    {
+        dump->record = 0;
+    }
+
+    return ret;
+}
+
+/*
+ * First line of the \dump_state text.  With a state_cache, ask for the
+ * hash first, and skip the transfer if a saved copy has the same.
+ */
+static int netrigctl_dump_begin(RIG *rig, char *buf)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+    struct netrigctl_dump *dump = &priv->dump;
+    char cmd[CMD_MAX];
+    int ret;
+
+    netrigctl_dump_free(rig);
+
+    if (priv->state_cache[0])
+    {
+        /*
+         * An older rigctld says nothing to a command it does not know, so
+         * \\chk_vfo follows to have a reply either way without a timeout.
+         */
+        SNPRINTF(cmd, sizeof(cmd), "\\dump_state_hash\n\\chk_vfo\n");
+        ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+
+        if (ret > 0 && sscanf(buf, "%*d %d %zu %x", &dump->model, &dump->hash_len,
+                              &dump->hash) == 3)
+        {
+            char chk[BUF_MAX];
+
+            ret = netrigctl_read_line(rig, chk);
+
+            if (ret < 0) { return ret; }
+
+            if (netrigctl_dump_load(rig)) { return netrigctl_dump_line(rig, buf); }
+
+            dump->record = 1;
+        }
+        else
+        {
+            rig_debug(RIG_DEBUG_VERBOSE, "%s: rigctld has no \\dump_state_hash\n",
+                      __func__);
+        }
+    }
+
+    SNPRINTF(cmd, sizeof(cmd), "\\dump_state\n");
+    ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+
+    if (ret > 0 && dump->record
+            && netrigctl_dump_append(dump, buf, ret) != RIG_OK)
+    {
+        dump->record = 0;
+    }
+
+    return ret;
+}
+
+/* \chk_vfo and \dump_state */
+static int netrigctl_open_state(RIG *rig)
 {
     int ret, i;
     struct rig_state *rs = STATE(rig);
-    hamlib_port_t *rp = RIGPORT(rig);
     int prot_ver;
     char cmd[CMD_MAX];
     char buf[BUF_MAX];
@@ -287,9 +824,7 @@ static int netrigctl_open(RIG *rig)
     rig_debug(RIG_DEBUG_VERBOSE, "%s: vfo_mode=%d\n", __func__,
               priv->rigctld_vfo_mode);
 
-    SNPRINTF(cmd, sizeof(cmd), "\\dump_state\n");
-
-    ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+    ret = netrigctl_dump_begin(rig, buf);
 
     if (ret <= 0)
     {
@@ -304,14 +839,14 @@ static int netrigctl_open(RIG *rig)
         RETURNFUNC(-RIG_EPROTO);
     }
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
         RETURNFUNC((ret < 0) ? ret : -RIG_EPROTO);
     }
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -322,7 +857,7 @@ static int netrigctl_open(RIG *rig)
 
     for (i = 0; i < HAMLIB_FRQRANGESIZ; i++)
     {
-        ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+        ret = netrigctl_dump_line(rig, buf);
 
         if (ret <= 0)
         {
@@ -352,7 +887,7 @@ static int netrigctl_open(RIG *rig)
 
     for (i = 0; i < HAMLIB_FRQRANGESIZ; i++)
     {
-        ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+        ret = netrigctl_dump_line(rig, buf);
 
         if (ret <= 0)
         {
@@ -394,7 +929,7 @@ static int netrigctl_open(RIG *rig)
 
     for (i = 0; i < HAMLIB_TSLSTSIZ; i++)
     {
-        ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+        ret = netrigctl_dump_line(rig, buf);
 
         if (ret <= 0)
         {
@@ -418,7 +953,7 @@ static int netrigctl_open(RIG *rig)
 
     for (i = 0; i < HAMLIB_FLTLSTSIZ; i++)
     {
-        ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+        ret = netrigctl_dump_line(rig, buf);
 
         if (ret <= 0)
         {
@@ -445,7 +980,7 @@ static int netrigctl_open(RIG *rig)
     chan_t chan_list[HAMLIB_CHANLSTSIZ]; /*!< Channel list, zero ended */
 #endif
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -454,7 +989,7 @@ static int netrigctl_open(RIG *rig)
 
     rig->caps->max_rit = rs->max_rit = atol(buf);
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -463,7 +998,7 @@ static int netrigctl_open(RIG *rig)
 
     rig->caps->max_xit = rs->max_xit = atol(buf);
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -472,7 +1007,7 @@ static int netrigctl_open(RIG *rig)
 
     rig->caps->max_ifshift = rs->max_ifshift = atol(buf);
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -481,7 +1016,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->announces = atoi(buf);
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -508,7 +1043,7 @@ static int netrigctl_open(RIG *rig)
 
     rig->caps->preamp[ret] = rs->preamp[ret] = RIG_DBLST_END;
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -535,7 +1070,7 @@ static int netrigctl_open(RIG *rig)
 
     rig->caps->attenuator[ret] = rs->attenuator[ret] = RIG_DBLST_END;
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -544,7 +1079,7 @@ static int netrigctl_open(RIG *rig)
 
     rig->caps->has_get_func = rs->has_get_func = strtoll(buf, NULL, 0);
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -553,7 +1088,7 @@ static int netrigctl_open(RIG *rig)
 
     rig->caps->has_set_func = rs->has_set_func = strtoll(buf, NULL, 0);
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -575,7 +1110,7 @@ static int netrigctl_open(RIG *rig)
 
 #endif
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -584,7 +1119,7 @@ static int netrigctl_open(RIG *rig)
 
     rig->caps->has_set_level = rs->has_set_level = strtoll(buf, NULL, 0);
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -593,7 +1128,7 @@ static int netrigctl_open(RIG *rig)
 
     rs->has_get_parm = strtoll(buf, NULL, 0);
 
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_dump_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -632,7 +1167,7 @@ static int netrigctl_open(RIG *rig)
     {
         char setting[32], value[1024];
         hamlib_port_t *pttp = PTTPORT(rig);
-        ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+        ret = netrigctl_dump_line(rig, buf);
         strtok(buf, "\r\n"); // chop the EOL
 
         rig_debug(RIG_DEBUG_VERBOSE, "## %s\n", buf);
@@ -709,17 +1244,10 @@ static int netrigctl_open(RIG *rig)
 
                 if (!has) { rig->caps->get_freq = NULL; }
             }
-            else if (strcmp(setting, "has_set_conf") == 0)
-            {
-                int has = strtol(value, NULL, 0);
-
-                if (!has) { rig->caps->set_conf = NULL; }
-            }
-            else if (strcmp(setting, "has_get_conf") == 0)
+            else if (strcmp(setting, "has_set_conf") == 0
+                     || strcmp(setting, "has_get_conf") == 0)
             {
-                int has = strtol(value, NULL, 0);
-
-                if (!has) { rig->caps->get_conf = NULL; }
+                // our conf is local, pipeline and mirror_ms
             }
             else if (strcmp(setting, "has_get_ant") == 0)
             {
@@ -922,6 +1450,106 @@ static int netrigctl_open(RIG *rig)
     RETURNFUNC(RIG_OK);
 }
 
+/*
+ * Ask rigctld to push freq, mode, ptt and vfo changes for the mirror.  An
+ * older rigctld does not know \subscribe, then every get asks.
+ */
+static void netrigctl_subscribe(RIG *rig)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+    char cmd[] = "\\subscribe freq,mode,ptt,vfo\n";
+    char buf[BUF_MAX];
+    int ret;
+
+    ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+
+    if (ret != RIG_OK)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: rigctld did not take the subscription: %d\n",
+                  __func__, ret);
+        return;
+    }
+
+    priv->mirror.on = 1;
+}
+
+static int netrigctl_open(RIG *rig)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+    int ret;
+
+    priv->pending = 0;
+    priv->stale = 0;
+    memset(&priv->mirror, 0, sizeof(priv->mirror));
+
+    ret = netrigctl_open_state(rig);
+
+    if (ret == RIG_OK) { netrigctl_dump_save(rig); }
+
+    netrigctl_dump_free(rig);
+
+    if (ret == RIG_OK && priv->mirror_ms > 0)
+    {
+        netrigctl_subscribe(rig);
+    }
+
+    return ret;
+}
+
+static int netrigctl_set_conf(RIG *rig, hamlib_token_t token, const char *val)
+{
+    struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+    ENTERFUNC;
+
+    switch (token)
+    {
+    case TOK_NET_PIPELINE:
+        priv->pipeline = atoi(val) != 0;
+        break;
+
+    case TOK_NET_MIRROR_MS:
+        priv->mirror_ms = atoi(val);
+        break;
+
+    case TOK_NET_STATE_CACHE:
+        SNPRINTF(priv->state_cache, sizeof(priv->state_cache), "%s", val);
+        break;
+
+    default:
+        RETURNFUNC(-RIG_EINVAL);
+    }
+
+    RETURNFUNC(RIG_OK);
+}
+
+static int netrigctl_get_conf(RIG *rig, hamlib_token_t token, char *val)
+{
+    const struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+    ENTERFUNC;
+
+    switch (token)
+    {
+    case TOK_NET_PIPELINE:
+        SNPRINTF(val, 128, "%d", priv->pipeline);
+        break;
+
+    case TOK_NET_MIRROR_MS:
+        SNPRINTF(val, 128, "%d", priv->mirror_ms);
+        break;
+
+    case TOK_NET_STATE_CACHE:
+        SNPRINTF(val, 128, "%s", priv->state_cache);
+        break;
+
+    default:
+        RETURNFUNC(-RIG_EINVAL);
+    }
+
+    RETURNFUNC(RIG_OK);
+}
+
 static int netrigctl_close(RIG *rig)
 {
     const struct rig_state *rs = STATE(rig);
@@ -968,17 +1596,18 @@ static int netrigctl_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
     SNPRINTF(cmd, sizeof(cmd), "F %"FREQFMT"\n", freq);
 #endif
 
-    ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+    ret = netrigctl_transaction_set(rig, cmd, strlen(cmd), buf);
     rig_debug(RIG_DEBUG_TRACE, "%s: cmd=%s\n", __func__, strtok(cmd, "\r\n"));
 
-    if (ret > 0)
+    if (ret == RIG_OK && netrigctl_mirror_vfo(rig, vfostr))
     {
-        return -RIG_EPROTO;
-    }
-    else
-    {
-        return ret;
+        struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+        priv->mirror.freq = freq;
+        netrigctl_mirror_set(rig, NETRIGCTL_MIRROR_FREQ);
     }
+
+    return ret;
 }
 
 static int netrigctl_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
@@ -998,6 +1627,15 @@ static int netrigctl_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
 
     if (ret != RIG_OK) { return ret; }
 
+    netrigctl_poll(rig);
+
+    if (netrigctl_mirror_fresh(rig, NETRIGCTL_MIRROR_FREQ)
+            && netrigctl_mirror_vfo(rig, vfostr))
+    {
+        *freq = ((struct netrigctl_priv_data *)STATE(rig)->priv)->mirror.freq;
+        return RIG_OK;
+    }
+
     SNPRINTF(cmd, sizeof(cmd), "f%s\n", vfostr);
 
     ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
@@ -1013,7 +1651,7 @@ static int netrigctl_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
     CHKSCN1ARG(num_sscanf(buf, "%"SCNfreq, freq));
 
 #if 0 // implement set_freq VFO later if it can be detected
-    ret = read_string(RIGPORT(rig), buf, BUF_MAX, "\n", 1, 0, 1);
+    ret = netrigctl_read_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -1044,16 +1682,26 @@ static int netrigctl_set_mode(RIG *rig, vfo_t vfo, rmode_t mode,
     SNPRINTF(cmd, sizeof(cmd), "M%s %s %li\n",
              vfostr, rig_strrmode(mode), width);
 
-    ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+    ret = netrigctl_transaction_set(rig, cmd, strlen(cmd), buf);
 
-    if (ret > 0)
-    {
-        return -RIG_EPROTO;
-    }
-    else
+    if (ret == RIG_OK && netrigctl_mirror_vfo(rig, vfostr))
     {
-        return ret;
+        struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+        // the rig picks the width for RIG_PASSBAND_NORMAL and NOCHANGE
+        if (width > 0)
+        {
+            priv->mirror.mode = mode;
+            priv->mirror.width = width;
+            netrigctl_mirror_set(rig, NETRIGCTL_MIRROR_MODE);
+        }
+        else
+        {
+            priv->mirror.valid[NETRIGCTL_MIRROR_MODE] = 0;
+        }
     }
+
+    return ret;
 }
 
 
@@ -1071,6 +1719,18 @@ static int netrigctl_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode,
 
     if (ret != RIG_OK) { return ret; }
 
+    netrigctl_poll(rig);
+
+    if (netrigctl_mirror_fresh(rig, NETRIGCTL_MIRROR_MODE)
+            && netrigctl_mirror_vfo(rig, vfostr))
+    {
+        const struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+        *mode = priv->mirror.mode;
+        *width = priv->mirror.width;
+        return RIG_OK;
+    }
+
     SNPRINTF(cmd, sizeof(cmd), "m%s\n", vfostr);
 
     ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
@@ -1084,8 +1744,7 @@ static int netrigctl_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode,
 
     *mode = rig_parse_mode(buf);
 
-    ret = read_string(RIGPORT(rig), (unsigned char *) buf, BUF_MAX, "\n", 1,
-                      0, 1);
+    ret = netrigctl_read_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -1120,6 +1779,16 @@ static int netrigctl_set_vfo(RIG *rig, vfo_t vfo)
 
     priv->vfo_curr = vfo; // remember our vfo
     STATE(rig)->current_vfo = vfo;
+
+    if (ret == RIG_OK && priv->mirror.on)
+    {
+        // rigctld pushes the new VFO's values after this
+        priv->mirror.vfo = vfo;
+        netrigctl_mirror_set(rig, NETRIGCTL_MIRROR_VFO);
+        priv->mirror.valid[NETRIGCTL_MIRROR_FREQ] = 0;
+        priv->mirror.valid[NETRIGCTL_MIRROR_MODE] = 0;
+    }
+
     return ret;
 }
 
@@ -1189,10 +1858,16 @@ static int netrigctl_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
     {
         return -RIG_EPROTO;
     }
-    else
+
+    if (ret == RIG_OK)
     {
-        return ret;
+        struct netrigctl_priv_data *priv = STATE(rig)->priv;
+
+        priv->mirror.ptt = ptt;
+        netrigctl_mirror_set(rig, NETRIGCTL_MIRROR_PTT);
     }
+
+    return ret;
 }
 
 
@@ -1209,6 +1884,14 @@ static int netrigctl_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
     if (ret != RIG_OK) { return ret; }
 
+    netrigctl_poll(rig);
+
+    if (netrigctl_mirror_fresh(rig, NETRIGCTL_MIRROR_PTT))
+    {
+        *ptt = ((struct netrigctl_priv_data *)STATE(rig)->priv)->mirror.ptt;
+        return RIG_OK;
+    }
+
     SNPRINTF(cmd, sizeof(cmd), "t%s\n", vfostr);
 
     ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
@@ -1701,8 +2384,7 @@ static int netrigctl_get_split_mode(RIG *rig, vfo_t vfo, rmode_t *tx_mode,
 
     *tx_mode = rig_parse_mode(buf);
 
-    ret = read_string(RIGPORT(rig), (unsigned char *) buf, BUF_MAX, "\n", 1,
-                      0, 1);
+    ret = netrigctl_read_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -1769,8 +2451,7 @@ static int netrigctl_get_split_vfo(RIG *rig, vfo_t vfo, split_t *split,
 
     *split = atoi(buf);
 
-    ret = read_string(RIGPORT(rig), (unsigned char *) buf, BUF_MAX, "\n", 1,
-                      0, 1);
+    ret = netrigctl_read_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -1800,7 +2481,7 @@ static int netrigctl_set_rit(RIG *rig, vfo_t vfo, shortfreq_t rit)
 
     SNPRINTF(cmd, sizeof(cmd), "J%s %ld\n", vfostr, rit);
 
-    ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+    ret = netrigctl_transaction_set(rig, cmd, strlen(cmd), buf);
 
     if (ret > 0)
     {
@@ -1856,7 +2537,7 @@ static int netrigctl_set_xit(RIG *rig, vfo_t vfo, shortfreq_t xit)
 
     SNPRINTF(cmd, sizeof(cmd), "Z%s %ld\n", vfostr, xit);
 
-    ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+    ret = netrigctl_transaction_set(rig, cmd, strlen(cmd), buf);
 
     if (ret > 0)
     {
@@ -1968,7 +2649,7 @@ static int netrigctl_set_func(RIG *rig, vfo_t vfo, setting_t func, int status)
 
     SNPRINTF(cmd, sizeof(cmd), "U%s %s %i\n", vfostr, rig_strfunc(func), status);
 
-    ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+    ret = netrigctl_transaction_set(rig, cmd, strlen(cmd), buf);
 
     if (ret > 0)
     {
@@ -2038,7 +2719,7 @@ static int netrigctl_set_level(RIG *rig, vfo_t vfo, setting_t level,
     SNPRINTF(cmd, sizeof(cmd), "L%s %s %s\n", vfostr, rig_strlevel(level),
              lstr);
 
-    ret = netrigctl_transaction(rig, cmd, strlen(cmd), buf);
+    ret = netrigctl_transaction_set(rig, cmd, strlen(cmd), buf);
 
     if (ret > 0)
     {
@@ -2316,8 +2997,7 @@ static int netrigctl_get_ant(RIG *rig, vfo_t vfo, ant_t ant, value_t *option,
                   ret);
     }
 
-    ret = read_string(RIGPORT(rig), (unsigned char *) buf, BUF_MAX, "\n", 1,
-                      0, 1);
+    ret = netrigctl_read_line(rig, buf);
 
     if (ret <= 0)
     {
@@ -2792,7 +3472,6 @@ int netrigctl_get_lock_mode(RIG *rig, int *lock)
     char cmdbuf[256];
     char buf[BUF_MAX];
     int ret;
-    hamlib_port_t *rp = RIGPORT(rig);
 
     SNPRINTF(cmdbuf, sizeof(cmdbuf), "\\get_lock_mode\n");
     ret = netrigctl_transaction(rig, cmdbuf, strlen(cmdbuf), buf);
@@ -2803,7 +3482,14 @@ int netrigctl_get_lock_mode(RIG *rig, int *lock)
     }
 
     sscanf(buf, "%d", lock);
-    ret = read_string(rp, (unsigned char *) buf, BUF_MAX, "\n", 1, 0, 1);
+    // the RPRT line, events pushed before it are taken on the way
+    ret = netrigctl_read_line(rig, buf);
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+
     return (RIG_OK);
 }
 
@@ -2824,7 +3510,7 @@ struct rig_caps netrigctl_caps =
     RIG_MODEL(RIG_MODEL_NETRIGCTL),
     .model_name =     "NET rigctl",
     .mfg_name =       "Hamlib",
-    .version =        "20250211.0",
+    .version =        "20251018.0",
     .copyright =      "LGPL",
     .status =         RIG_STATUS_STABLE,
     .rig_type =       RIG_TYPE_OTHER,
@@ -2859,10 +3545,14 @@ struct rig_caps netrigctl_caps =
     .max_ifshift = 0,
     .priv =  NULL,
 
+    .cfgparams =    netrigctl_cfg_params,
+
     .rig_init =     netrigctl_init,
     .rig_cleanup =  netrigctl_cleanup,
     .rig_open =     netrigctl_open,
     .rig_close =    netrigctl_close,
+    .set_conf =     netrigctl_set_conf,
+    .get_conf =     netrigctl_get_conf,
 
     .set_freq =     netrigctl_set_freq,
     .get_freq =     netrigctl_get_freq,
@@ -32,12 +32,12 @@
 
 // Common error handling macros for cached values
 #define RETURN_CACHED_FREQ(rig, vfo, freq) do { \
-    *(freq) = (vfo == RIG_VFO_A) ? CACHE(rig)->freqMainA : CACHE(rig)->freqMainB; \
+    *(freq) = CACHE(rig)->slot[(vfo) == RIG_VFO_A ? CACHE_SLOT_MAIN_A : CACHE_SLOT_MAIN_B].freq; \
     return RIG_OK; \
 } while(0)
 
 #define RETURN_CACHED_MODE(rig, vfo, mode, width, cachep, p) do { \
-    *(mode) = (vfo == RIG_VFO_A) ? (cachep)->modeMainA : (cachep)->modeMainB; \
+    *(mode) = (cachep)->slot[(vfo) == RIG_VFO_A ? CACHE_SLOT_MAIN_A : CACHE_SLOT_MAIN_B].mode; \
     *(width) = (p)->filterBW; \
     return RIG_OK; \
 } while(0)
@@ -401,12 +401,12 @@ static int q900_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
                          (reply[freq_b_offset+2] << 8) | 
                          reply[freq_b_offset+3];
         // Update cache
-        CACHE(rig)->freqMainA = (freq_t)freq_a;
-        CACHE(rig)->freqMainB = (freq_t)freq_b;
+        rig_set_cache_freq(rig, RIG_VFO_A, (freq_t)freq_a);
+        rig_set_cache_freq(rig, RIG_VFO_B, (freq_t)freq_b);
         // Return requested VFO frequency
-        *freq = (vfo == RIG_VFO_A) ? CACHE(rig)->freqMainA : CACHE(rig)->freqMainB;
-        rig_debug(RIG_DEBUG_VERBOSE, "%s: Successfully got VFOA=%.0f Hz, VFOB=%.0f Hz\n",
-                 __func__, CACHE(rig)->freqMainA, CACHE(rig)->freqMainB);
+        *freq = (vfo == RIG_VFO_A) ? (freq_t)freq_a : (freq_t)freq_b;
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: Successfully got VFOA=%u Hz, VFOB=%u Hz\n",
+                 __func__, (unsigned int)freq_a, (unsigned int)freq_b);
     }
     return RIG_OK;
 }
@@ -428,10 +428,12 @@ static int q900_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
             RETURN_CACHED_MODE(rig, vfo, mode, width, cachep, p);
         }
         // Update cache
-        cachep->modeMainA = guohe2rmode(reply[7], q900_modes);
-        cachep->modeMainB = guohe2rmode(reply[8], q900_modes);
+        rmode_t mode_a = guohe2rmode(reply[7], q900_modes);
+        rmode_t mode_b = guohe2rmode(reply[8], q900_modes);
+        rig_set_cache_mode(rig, RIG_VFO_A, mode_a, 0);
+        rig_set_cache_mode(rig, RIG_VFO_B, mode_b, 0);
         // Return requested mode
-        *mode = (vfo == RIG_VFO_A) ? cachep->modeMainA : cachep->modeMainB;
+        *mode = (vfo == RIG_VFO_A) ? mode_a : mode_b;
         *width = p->filterBW;
     }
     return RIG_OK;
@@ -486,8 +488,8 @@ static int q900_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             RETURN_CACHED_PTT(rig, ptt, cachep);
         }
         // Get PTT status
-        cachep->ptt = reply[6];
-        *ptt = cachep->ptt;
+        *ptt = reply[6];
+        rig_set_cache_ptt(rig, *ptt);
     }
     return RIG_OK;
 }
@@ -560,13 +562,13 @@ static int q900_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
     if (vfo == RIG_VFO_B)
     {
-        to_be(&cmd[6], CACHE(rig)->freqMainA, 4);
+        to_be(&cmd[6], CACHE(rig)->slot[CACHE_SLOT_MAIN_A].freq, 4);
         to_be(&cmd[10], freq, 4);
     }
     else
     {
         to_be(&cmd[6], freq, 4);
-        to_be(&cmd[10], CACHE(rig)->freqMainB, 4);
+        to_be(&cmd[10], CACHE(rig)->slot[CACHE_SLOT_MAIN_B].freq, 4);
     }
  
      unsigned int crc = CRC16Check(&cmd[4], 10);
@@ -580,26 +582,12 @@ static int q900_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
      if (ret < 0) {
          rig_debug(RIG_DEBUG_ERR, "%s: Failed to read response, using cached values\n", __func__);
          // Update cache with requested frequency even if response failed
-         if (vfo == RIG_VFO_B)
-         {
-             CACHE(rig)->freqMainB = freq;
-         }
-         else
-         {
-             CACHE(rig)->freqMainA = freq;
-         }
+         rig_set_cache_freq(rig, vfo == RIG_VFO_B ? RIG_VFO_B : RIG_VFO_A, freq);
          return RIG_OK;
      }
      
      // Update cache with requested frequency
-     if (vfo == RIG_VFO_B)
-     {
-         CACHE(rig)->freqMainB = freq;
-     }
-     else
-     {
-         CACHE(rig)->freqMainA = freq;
-     }
+     rig_set_cache_freq(rig, vfo == RIG_VFO_B ? RIG_VFO_B : RIG_VFO_A, freq);
 
      return RIG_OK;
  }
@@ -629,13 +617,13 @@ static int q900_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
      if (vfo == RIG_VFO_B)
      {
-         cmd[6] = rmode2guohe(CACHE(rig)->modeMainA, q900_modes);
+         cmd[6] = rmode2guohe(CACHE(rig)->slot[CACHE_SLOT_MAIN_A].mode, q900_modes);
          cmd[7] = i;
      }
      else
      {
          cmd[6] = i;
-         cmd[7] = rmode2guohe(CACHE(rig)->modeMainB, q900_modes);
+         cmd[7] = rmode2guohe(CACHE(rig)->slot[CACHE_SLOT_MAIN_B].mode, q900_modes);
      }
 
      int crc = CRC16Check(&cmd[4], 4);
@@ -647,14 +635,7 @@ static int q900_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
      // Use common response reading function
      if (read_rig_response(rig, reply, sizeof(reply), __func__) < 0) {
          // Update cache with requested mode even if response failed
-         if (vfo == RIG_VFO_B)
-         {
-             CACHE(rig)->modeMainB = mode;
-         }
-         else
-         {
-             CACHE(rig)->modeMainA = mode;
-         }
+         rig_set_cache_mode(rig, vfo == RIG_VFO_B ? RIG_VFO_B : RIG_VFO_A, mode, 0);
          return RIG_OK;
      }
      
@@ -662,14 +643,7 @@ static int q900_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
      if (reply[4] < 3) { // Need at least 3 bytes to access reply[6] and reply[7]
          rig_debug(RIG_DEBUG_ERR, "%s: Response too short for mode data, using cached values\n", __func__);
          // Update cache with requested mode even if validation failed
-         if (vfo == RIG_VFO_B)
-         {
-             CACHE(rig)->modeMainB = mode;
-         }
-         else
-         {
-             CACHE(rig)->modeMainA = mode;
-         }
+         rig_set_cache_mode(rig, vfo == RIG_VFO_B ? RIG_VFO_B : RIG_VFO_A, mode, 0);
          return RIG_OK;
      }
      
@@ -677,34 +651,20 @@ static int q900_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
      if (reply[6] >= GUOHE_MODE_TABLE_MAX) {
          rig_debug(RIG_DEBUG_ERR, "%s: Invalid mode A index %d, using cached values\n", __func__, reply[6]);
          // Update cache with requested mode even if validation failed
-         if (vfo == RIG_VFO_B)
-         {
-             CACHE(rig)->modeMainB = mode;
-         }
-         else
-         {
-             CACHE(rig)->modeMainA = mode;
-         }
+         rig_set_cache_mode(rig, vfo == RIG_VFO_B ? RIG_VFO_B : RIG_VFO_A, mode, 0);
          return RIG_OK;
      }
      
      if (reply[7] >= GUOHE_MODE_TABLE_MAX) {
          rig_debug(RIG_DEBUG_ERR, "%s: Invalid mode B index %d, using cached values\n", __func__, reply[7]);
          // Update cache with requested mode even if validation failed
-         if (vfo == RIG_VFO_B)
-         {
-             CACHE(rig)->modeMainB = mode;
-         }
-         else
-         {
-             CACHE(rig)->modeMainA = mode;
-         }
+         rig_set_cache_mode(rig, vfo == RIG_VFO_B ? RIG_VFO_B : RIG_VFO_A, mode, 0);
          return RIG_OK;
      }
      
      // Update cache with response data
-     CACHE(rig)->modeMainA = guohe2rmode(reply[6], q900_modes);
-     CACHE(rig)->modeMainB = guohe2rmode(reply[7], q900_modes);
+     rig_set_cache_mode(rig, RIG_VFO_A, guohe2rmode(reply[6], q900_modes), 0);
+     rig_set_cache_mode(rig, RIG_VFO_B, guohe2rmode(reply[7], q900_modes), 0);
 
      return RIG_OK;
  }
@@ -727,7 +687,7 @@ static int q900_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
     q900_send(rig, cmd, sizeof(cmd), reply, sizeof(reply));
 
     // Update cache
-    CACHE(rig)->ptt = ptt;
+    rig_set_cache_ptt(rig, ptt);
 
     return RIG_OK;
 }
@@ -780,7 +740,9 @@ static int q900_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
          break;
      }
  
+     rig_cache_write_begin(CACHE(rig));
      CACHE(rig)->split = split;
+     rig_cache_write_end(CACHE(rig));
  
      return RIG_OK;
  
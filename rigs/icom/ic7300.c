@@ -1349,6 +1349,7 @@ struct rig_caps ic9700_caps =
     .stop_voice_mem = icom_stop_voice_mem,
     .set_clock = ic9700_set_clock,
     .get_clock = ic9700_get_clock,
+    .cache_flags = RIG_CACHE_FLAG_NO_FASTPATH,
     .hamlib_check_rig_caps = HAMLIB_CHECK_RIG_CAPS
 };
 
@@ -356,5 +356,6 @@ struct rig_caps ic910_caps =
     .set_rptr_offs =  icom_set_rptr_offs,
     .get_rptr_offs =  icom_get_rptr_offs,
 
+    .cache_flags = RIG_CACHE_FLAG_NO_FASTPATH,
     .hamlib_check_rig_caps = HAMLIB_CHECK_RIG_CAPS
 };
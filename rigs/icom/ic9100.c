@@ -293,5 +293,6 @@ struct rig_caps ic9100_caps =
     .set_split_mode = icom_set_split_mode,
     .get_split_mode = icom_get_split_mode,
 
+    .cache_flags = RIG_CACHE_FLAG_NO_FASTPATH,
     .hamlib_check_rig_caps = HAMLIB_CHECK_RIG_CAPS
 };
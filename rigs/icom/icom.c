@@ -3214,7 +3214,10 @@ int icom_set_vfo(RIG *rig, vfo_t vfo)
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: VFO changing from %s to %s\n", __func__,
                   rig_strvfo(rs->current_vfo), rig_strvfo(vfo));
-        cachep->freqCurr = 0; // reset current frequency so set_freq works 1st time
+        // reset current frequency so set_freq works 1st time
+        rig_cache_write_begin(cachep);
+        cachep->slot[CACHE_SLOT_CURR].freq = 0;
+        rig_cache_write_end(cachep);
     }
 
     rig_debug(RIG_DEBUG_TRACE, "%s: line#%d\n", __func__, __LINE__);
@@ -4643,7 +4646,7 @@ int icom_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
                       val->f);
         }
 
-        if (RIG_IS_IC9700 && CACHE(rig)->freqMainA >= 1e9)
+        if (RIG_IS_IC9700 && CACHE(rig)->slot[CACHE_SLOT_MAIN_A].freq >= 1e9)
         {
             val->f /= 10;   // power scale is different for 10GHz
         }
@@ -5801,12 +5804,16 @@ int icom_get_split_vfos(RIG *rig, vfo_t *rx_vfo, vfo_t *tx_vfo)
         {
             *rx_vfo = RIG_VFO_MAIN;
             *tx_vfo = RIG_VFO_SUB;
+            rig_cache_write_begin(cachep);
             cachep->satmode = 1;
+            rig_cache_write_end(cachep);
         }
         else if (cachep->split == RIG_SPLIT_OFF)
         {
             *rx_vfo = *tx_vfo = rs->current_vfo;
+            rig_cache_write_begin(cachep);
             cachep->satmode = 0;
+            rig_cache_write_end(cachep);
         }
         else
         {
@@ -6908,7 +6915,9 @@ int icom_get_split_vfo(RIG *rig, vfo_t rx_vfo, split_t *split, vfo_t *tx_vfo)
     }
 
     // Update cache early for icom_get_split_vfos()
+    rig_cache_write_begin(CACHE(rig));
     CACHE(rig)->split = *split;
+    rig_cache_write_end(CACHE(rig));
 
     icom_get_split_vfos(rig, &rs->rx_vfo, &rs->tx_vfo);
 
@@ -7340,7 +7349,9 @@ int icom_set_func(RIG *rig, vfo_t vfo, setting_t func, int status)
                       __func__, __LINE__, satmode);
         }
 
+        rig_cache_write_begin(CACHE(rig));
         CACHE(rig)->satmode = satmode;
+        rig_cache_write_end(CACHE(rig));
         icom_satmode_fix(rig, satmode);
 
         // Turning satmode ON/OFF can change the TX/RX VFOs
@@ -7606,7 +7617,9 @@ int icom_get_func(RIG *rig, vfo_t vfo, setting_t func, int *status)
                       __func__, __LINE__, satmode);
         }
 
+        rig_cache_write_begin(CACHE(rig));
         CACHE(rig)->satmode = satmode;
+        rig_cache_write_end(CACHE(rig));
         icom_satmode_fix(rig, satmode);
     }
     else
@@ -286,7 +286,7 @@ static int id5100_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
 {
     rig_debug(RIG_DEBUG_VERBOSE, "%s(%d): Sub/A vfo=%s\n", __func__, __LINE__,
               rig_strvfo(vfo));
-        *freq = CACHE(rig)->freqSubA;
+        *freq = CACHE(rig)->slot[CACHE_SLOT_SUB_A].freq;
         int cache_ms_freq, cache_ms_mode, cache_ms_width;
         pbwidth_t width;
         freq_t tfreq;
@@ -660,5 +660,6 @@ struct rig_caps id5100_caps =
     .get_ctcss_sql =  icom_get_ctcss_sql,
     .set_dcs_sql =  icom_set_dcs_sql,
     .get_dcs_sql =  icom_get_dcs_sql,
+    .cache_flags = RIG_CACHE_FLAG_NO_FASTPATH,
     .hamlib_check_rig_caps = HAMLIB_CHECK_RIG_CAPS
 };
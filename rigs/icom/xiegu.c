@@ -1190,7 +1190,9 @@ static int x108g_set_split_vfo(RIG *rig, vfo_t vfo, split_t split, vfo_t tx_vfo)
         return -RIG_ERJCTED;
     }
 
+    rig_cache_write_begin(cachep);
     cachep->split = split;
+    rig_cache_write_end(cachep);
     return RIG_OK;
 }
 
@@ -340,7 +340,7 @@ static int jst145_get_vfo(RIG *rig, vfo_t *vfo)
 
     jst145_get_ptt(rig, RIG_VFO_A,
                    &ptt); // set priv->ptt to current transmit status
-    CACHE(rig)->ptt = ptt;
+    rig_set_cache_ptt(rig, ptt);
 
 ptt_retry:
 
@@ -610,7 +610,8 @@ static int jst145_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
     if (pttstatus[1] == '1') { *ptt = RIG_PTT_ON; }
     else { *ptt = RIG_PTT_OFF; }
 
-    priv->ptt = CACHE(rig)->ptt = *ptt;
+    priv->ptt = *ptt;
+    rig_set_cache_ptt(rig, *ptt);
 
     return RIG_OK;
 }
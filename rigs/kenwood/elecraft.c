@@ -376,10 +376,7 @@ int elecraft_open(RIG *rig)
         /* get current AI state so it can be restored */
         priv->trn_state = -1;
         kenwood_get_trn(rig, &priv->trn_state);  /* ignore errors */
-        /* Currently we cannot cope with AI mode so turn it off in
-             case last client left it on */
-        kenwood_set_trn(rig,
-                        RIG_TRN_OFF); /* ignore status in case it's not supported */
+        kenwood_open_trn(rig); /* ignore status in case it's not supported */
     }
 
     // For rigs like K3X vfo emulation need to set VFO_A to start
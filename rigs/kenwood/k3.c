@@ -239,6 +239,11 @@ struct rig_caps k3_caps =
     .vfo_ops =      K3_VFO_OP,
     .targetable_vfo =   RIG_TARGETABLE_FREQ | RIG_TARGETABLE_MODE,
     .transceive =       RIG_TRN_RIG,
+    .async_data_supported = 1,
+    .read_frame_direct = kenwood_read_frame_direct,
+    .is_async_frame = kenwood_is_async_frame,
+    .process_async_frame = kenwood_process_async_frame,
+    .get_status_bulk = kenwood_get_status_bulk,
     .bank_qty =     0,
     .chan_desc_sz =     0,
 
@@ -401,6 +406,11 @@ struct rig_caps k3s_caps =
     .vfo_ops =      K3_VFO_OP,
     .targetable_vfo =   RIG_TARGETABLE_FREQ | RIG_TARGETABLE_MODE,
     .transceive =       RIG_TRN_RIG,
+    .async_data_supported = 1,
+    .read_frame_direct = kenwood_read_frame_direct,
+    .is_async_frame = kenwood_is_async_frame,
+    .process_async_frame = kenwood_process_async_frame,
+    .get_status_bulk = kenwood_get_status_bulk,
     .bank_qty =     0,
     .chan_desc_sz =     0,
 
@@ -573,6 +583,11 @@ struct rig_caps k4_caps =
     .vfo_ops =      K3_VFO_OP,
     .targetable_vfo =   RIG_TARGETABLE_FREQ | RIG_TARGETABLE_MODE,
     .transceive =       RIG_TRN_RIG,
+    .async_data_supported = 1,
+    .read_frame_direct = kenwood_read_frame_direct,
+    .is_async_frame = kenwood_is_async_frame,
+    .process_async_frame = kenwood_process_async_frame,
+    .get_status_bulk = kenwood_get_status_bulk,
     .agc_level_count = 3,
     .agc_levels = { RIG_AGC_OFF, RIG_AGC_SLOW, RIG_AGC_FAST },
     .bank_qty =     0,
@@ -734,6 +749,11 @@ struct rig_caps kx3_caps =
     .vfo_ops =      K3_VFO_OP,
     .targetable_vfo =   RIG_TARGETABLE_FREQ | RIG_TARGETABLE_MODE,
     .transceive =       RIG_TRN_RIG,
+    .async_data_supported = 1,
+    .read_frame_direct = kenwood_read_frame_direct,
+    .is_async_frame = kenwood_is_async_frame,
+    .process_async_frame = kenwood_process_async_frame,
+    .get_status_bulk = kenwood_get_status_bulk,
     .bank_qty =     0,
     .chan_desc_sz =     0,
 
@@ -893,6 +913,11 @@ struct rig_caps kx2_caps =
     .vfo_ops =      K3_VFO_OP,
     .targetable_vfo =   RIG_TARGETABLE_FREQ | RIG_TARGETABLE_MODE,
     .transceive =       RIG_TRN_RIG,
+    .async_data_supported = 1,
+    .read_frame_direct = kenwood_read_frame_direct,
+    .is_async_frame = kenwood_is_async_frame,
+    .process_async_frame = kenwood_process_async_frame,
+    .get_status_bulk = kenwood_get_status_bulk,
     .bank_qty =     0,
     .chan_desc_sz =     0,
 
@@ -34,6 +34,7 @@
 #include "register.h"
 #include "cal.h"
 #include "cache.h"
+#include "event.h"
 #include "misc.h"
 
 #include "kenwood.h"
@@ -348,6 +349,10 @@ int kenwood_transaction(RIG *rig, const char *cmdstr, char *data,
     cmdtrm_str[0] = caps->cmdtrm;
     cmdtrm_str[1] = '\0';
 
+    /* with AI on, tell the async data handler which reply is ours */
+    kenwood_set_async_wait(rig, !cmdstr ? "*"
+                           : datasize ? cmdstr : priv->verify_cmd);
+
 transaction_write:
 
     if (cmdstr)
@@ -419,7 +424,11 @@ transaction_write:
     }
 
     // Malachite SDR cannot send ID after FA
-    if (!datasize && priv->no_id) { RETURNFUNC2(RIG_OK); }
+    if (!datasize && priv->no_id)
+    {
+        kenwood_set_async_wait(rig, "");
+        RETURNFUNC2(RIG_OK);
+    }
 
     if (!datasize && strncmp(cmdstr, "KY", 2) != 0)
     {
@@ -575,6 +584,7 @@ transaction_read:
             {
                 rig_debug(RIG_DEBUG_ERR, "%s: Command rejected by the rig (get): '%s'\n",
                           __func__, cmdstr);
+                kenwood_set_async_wait(rig, "");
                 RETURNFUNC2(-RIG_ERJCTED);
             }
 
@@ -718,6 +728,7 @@ transaction_quit:
         strncpy(priv->last_if_response, buffer, caps->if_len);
     }
 
+    kenwood_set_async_wait(rig, "");
     rs->transaction_active = 0;
     RETURNFUNC2(retval);
 }
@@ -852,6 +863,7 @@ int kenwood_init(RIG *rig)
     priv = STATE(rig)->priv;
 
     memset(priv, 0x00, sizeof(struct kenwood_priv_data));
+    pthread_mutex_init(&priv->async_lock, NULL);
 
     if (RIG_IS_XG3)
     {
@@ -910,8 +922,12 @@ int kenwood_init(RIG *rig)
 
 int kenwood_cleanup(RIG *rig)
 {
+    struct kenwood_priv_data *priv = STATE(rig)->priv;
+
     ENTERFUNC;
 
+    if (priv) { pthread_mutex_destroy(&priv->async_lock); }
+
     free(STATE(rig)->priv);
     STATE(rig)->priv = NULL;
 
@@ -1122,12 +1138,10 @@ int kenwood_open(RIG *rig)
                 kenwood_get_trn(rig, &priv->trn_state);  /* ignore errors */
             }
 
-            /* Currently we cannot cope with AI mode so turn it off in
-               case last client left it on */
-            if (priv->trn_state != RIG_TRN_OFF)
+            if (priv->trn_state != RIG_TRN_OFF || RIGPORT(rig)->asyncio)
             {
-                kenwood_set_trn(rig, RIG_TRN_OFF); /* ignore status in case
-                                                      it's not supported */
+                kenwood_open_trn(rig); /* ignore status in case
+                                          it's not supported */
             }
 
             if (!RIG_IS_THD74 && !RIG_IS_THD7A && !RIG_IS_TMD700)
@@ -1639,9 +1653,12 @@ int kenwood_set_split_vfo(RIG *rig, vfo_t vfo, split_t split, vfo_t txvfo)
     tsplit = RIG_SPLIT_OFF; // default in case rig does not set split status
     retval = rig_get_split_vfo(rig, vfo, &tsplit, &tx_vfo);
 
-    priv->split = CACHE(rig)->split = split;
+    priv->split = split;
+    rig_cache_write_begin(CACHE(rig));
+    CACHE(rig)->split = split;
     CACHE(rig)->split_vfo = txvfo;
     elapsed_ms(&CACHE(rig)->time_split, HAMLIB_ELAPSED_SET);
+    rig_cache_write_end(CACHE(rig));
 
     // and it should be OK to do a SPLIT_OFF at any time so we won's skip that
     if (retval == RIG_OK && split == RIG_SPLIT_ON && tsplit == RIG_SPLIT_ON)
@@ -1661,7 +1678,7 @@ int kenwood_set_split_vfo(RIG *rig, vfo_t vfo, split_t split, vfo_t txvfo)
             || rig->caps->rig_model == RIG_MODEL_KX2
             || rig->caps->rig_model == RIG_MODEL_KX3)
     {
-        rig_set_freq(rig, RIG_VFO_B, CACHE(rig)->freqMainA);
+        rig_set_freq(rig, RIG_VFO_B, CACHE(rig)->slot[CACHE_SLOT_MAIN_A].freq);
     }
 
     if (retval != RIG_OK)
@@ -1670,8 +1687,11 @@ int kenwood_set_split_vfo(RIG *rig, vfo_t vfo, split_t split, vfo_t txvfo)
     }
 
     /* Remember whether split is on, for kenwood_set_vfo */
-    priv->split = CACHE(rig)->split = split;
+    priv->split = split;
+    rig_cache_write_begin(CACHE(rig));
+    CACHE(rig)->split = split;
     elapsed_ms(&CACHE(rig)->time_split, HAMLIB_ELAPSED_SET);
+    rig_cache_write_end(CACHE(rig));
 
     RETURNFUNC2(RIG_OK);
 }
@@ -1829,6 +1849,136 @@ int kenwood_get_split_vfo_if(RIG *rig, vfo_t rxvfo, split_t *split,
 }
 
 
+/*
+ * The VFOs of an IF answer or report: the one it shows, the receive VFO
+ * and the transmit VFO.  IF shows the TX VFO while transmitting split,
+ * except on Elecraft.
+ */
+static int kenwood_if_vfos(RIG *rig, const char *info, vfo_t *if_vfo,
+                           vfo_t *rx_vfo, vfo_t *tx_vfo)
+{
+    int transmitting = info[28] == '1';
+    int split = info[32] == '1';
+
+    switch (info[30])
+    {
+    case '0': *if_vfo = RIG_VFO_A; break;
+
+    case '1': *if_vfo = RIG_VFO_B; break;
+
+    case '2': *if_vfo = RIG_VFO_MEM; break;
+
+    default:
+        rig_debug(RIG_DEBUG_ERR, "%s: unsupported VFO %c\n", __func__, info[30]);
+        return -RIG_EPROTO;
+    }
+
+    *rx_vfo = *if_vfo;
+
+    if (transmitting && split && *if_vfo != RIG_VFO_MEM && !RIG_IS_K2
+            && !RIG_IS_K3)
+    {
+        *rx_vfo = *if_vfo == RIG_VFO_A ? RIG_VFO_B : RIG_VFO_A;
+    }
+
+    *tx_vfo = *rx_vfo;
+
+    if (split && *rx_vfo != RIG_VFO_MEM)
+    {
+        *tx_vfo = *rx_vfo == RIG_VFO_A ? RIG_VFO_B : RIG_VFO_A;
+    }
+
+    return RIG_OK;
+}
+
+
+/*
+ * kenwood_get_status_bulk
+ *   Freq, PTT, split, RIT and XIT of the receive VFO from one IF, and its
+ *   mode on rigs that read the mode from IF anyway.  IF tells nothing about
+ *   the other VFO, nor the receive freq while transmitting split.
+ */
+int kenwood_get_status_bulk(RIG *rig, struct rig_status_bulk *status, int n)
+{
+    struct rig_state *rs = STATE(rig);
+    struct kenwood_priv_data *priv = rs->priv;
+    struct kenwood_priv_caps *caps = kenwood_caps(rig);
+    struct rig_status_bulk *st = NULL;
+    vfo_t if_vfo, rx_vfo, tx_vfo;
+    int transmitting, split, i, retval;
+    shortfreq_t offset;
+    char buf[12];
+
+    ENTERFUNC;
+
+    retval = kenwood_get_if(rig);
+
+    if (retval != RIG_OK)
+    {
+        RETURNFUNC(retval);
+    }
+
+    retval = kenwood_if_vfos(rig, priv->info, &if_vfo, &rx_vfo, &tx_vfo);
+
+    if (retval != RIG_OK)
+    {
+        RETURNFUNC(retval);
+    }
+
+    transmitting = priv->info[28] == '1';
+    split = priv->info[32] == '1';
+
+    for (i = 0; i < n && st == NULL; i++)
+    {
+        if (status[i].vfo == RIG_VFO_CURR || status[i].vfo == rx_vfo)
+        {
+            st = &status[i];
+        }
+    }
+
+    if (st == NULL)
+    {
+        RETURNFUNC(RIG_OK);
+    }
+
+    st->vfo = rx_vfo;
+    st->valid = RIG_STATUS_PTT | RIG_STATUS_SPLIT | RIG_STATUS_RIT
+                | RIG_STATUS_XIT;
+
+    if (!(transmitting && split))
+    {
+        memcpy(buf, &priv->info[2], 11);
+        buf[11] = '\0';
+
+        if (sscanf(buf, "%"SCNfreq, &st->freq) == 1)
+        {
+            st->valid |= RIG_STATUS_FREQ;
+        }
+    }
+
+    if (rig->caps->get_mode == kenwood_get_mode_if)
+    {
+        st->mode = kenwood2rmode(priv->info[29] - '0', caps->mode_table);
+        st->valid |= RIG_STATUS_MODE;
+    }
+
+    st->ptt = transmitting ? RIG_PTT_ON : RIG_PTT_OFF;
+    st->split = split ? RIG_SPLIT_ON : RIG_SPLIT_OFF;
+    st->tx_vfo = tx_vfo;
+
+    /* RIT and XIT share the offset field */
+    memcpy(buf, &priv->info[17], 6);
+    buf[6] = '\0';
+    offset = atoi(buf);
+    st->rit = priv->info[23] == '1' ? offset : 0;
+    st->xit = priv->info[24] == '1' ? offset : 0;
+
+    priv->split = st->split;
+
+    RETURNFUNC(RIG_OK);
+}
+
+
 /*
  * kenwood_get_vfo_if using byte 31 of the IF information field
  *
@@ -5314,6 +5464,264 @@ int kenwood_get_trn(RIG *rig, int *trn)
     RETURNFUNC(RIG_OK);
 }
 
+/*
+ * kenwood_open_trn
+ * Turn AI off in case the last client left it on, or to AI2 when the
+ * async data handler is there to take the rig's reports.
+ */
+int kenwood_open_trn(RIG *rig)
+{
+    ENTERFUNC;
+
+    if (!RIGPORT(rig)->asyncio)
+    {
+        RETURNFUNC(kenwood_set_trn(rig, RIG_TRN_OFF));
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: async data on, AI2\n", __func__);
+
+    RETURNFUNC(kenwood_transaction(rig, "AI2", NULL, 0));
+}
+
+int kenwood_read_frame_direct(RIG *rig, size_t buffer_length,
+                              const unsigned char *buffer)
+{
+    const char stopset[] = { kenwood_caps(rig)->cmdtrm, '\0' };
+
+    return read_string_direct(RIGPORT(rig), (unsigned char *) buffer,
+                              buffer_length - 1, stopset, 1, 0, 1);
+}
+
+/*
+ * Tell the async data handler which reply the running transaction waits
+ * for: the command up to its terminator, "*" for any frame, "" for none.
+ */
+void kenwood_set_async_wait(RIG *rig, const char *reply)
+{
+    struct kenwood_priv_data *priv = STATE(rig)->priv;
+    size_t len = strcspn(reply, ";\r");
+
+    if (len >= sizeof(priv->async_wait)) { len = sizeof(priv->async_wait) - 1; }
+
+    pthread_mutex_lock(&priv->async_lock);
+    memcpy(priv->async_wait, reply, len);
+    priv->async_wait[len] = '\0';
+    pthread_mutex_unlock(&priv->async_lock);
+}
+
+/*
+ * With AI on, a report looks just like a reply, so a frame is the reply
+ * of the running transaction when it starts with the whole command that
+ * waits for it, "ZZFA" but not "ZZFB".  Error replies like "?;" always
+ * belong to the transaction.
+ */
+int kenwood_is_async_frame(RIG *rig, size_t frame_length,
+                           const unsigned char *frame)
+{
+    struct kenwood_priv_data *priv = STATE(rig)->priv;
+    char wait[sizeof(priv->async_wait)];
+    size_t len;
+
+    if (frame_length <= 2) { return 0; }
+
+    pthread_mutex_lock(&priv->async_lock);
+    memcpy(wait, priv->async_wait, sizeof(wait));
+    pthread_mutex_unlock(&priv->async_lock);
+
+    if (wait[0] == '*') { return 0; }
+
+    len = strlen(wait);
+
+    return len == 0 || frame_length < len || memcmp(frame, wait, len) != 0;
+}
+
+/* the data mode variant of mode for rigs that report DA separately */
+static rmode_t kenwood_async_datamode(RIG *rig, vfo_t vfo, rmode_t mode)
+{
+    const struct kenwood_priv_data *priv = STATE(rig)->priv;
+    int datamode = vfo == RIG_VFO_B ? priv->datamodeB : priv->datamodeA;
+
+    if (!datamode) { return mode; }
+
+    switch (mode)
+    {
+    case RIG_MODE_USB: return RIG_MODE_PKTUSB;
+
+    case RIG_MODE_LSB: return RIG_MODE_PKTLSB;
+
+    case RIG_MODE_FM: return RIG_MODE_PKTFM;
+
+    case RIG_MODE_AM: return RIG_MODE_PKTAM;
+
+    default: return mode;
+    }
+}
+
+/* the AI report of a mode digit */
+static void kenwood_async_mode(RIG *rig, vfo_t vfo, char c)
+{
+    const struct kenwood_priv_data *priv = STATE(rig)->priv;
+    rmode_t mode;
+    int kmode = c <= '9' ? c - '0' : c - 'A' + 10;
+
+    mode = kenwood2rmode(kmode, kenwood_caps(rig)->mode_table);
+
+    if (priv->is_emulation || RIG_IS_HPSDR)
+    {
+        if (RIG_MODE_RTTY == mode) { mode = RIG_MODE_PKTLSB; }
+
+        if (RIG_MODE_RTTYR == mode) { mode = RIG_MODE_PKTUSB; }
+    }
+
+    mode = kenwood_async_datamode(rig, vfo, mode);
+
+    rig_fire_mode_event(rig, vfo, mode, RIG_PASSBAND_NOCHANGE);
+}
+
+/* reports of settings the cache may hold, they are forgotten on sight */
+static const struct
+{
+    char cmd[3];
+    int kind;
+    setting_t setting;
+} kenwood_async_settings[] =
+{
+    { "AG", CACHE_KIND_LEVEL, RIG_LEVEL_AF },
+    { "RG", CACHE_KIND_LEVEL, RIG_LEVEL_RF },
+    { "SQ", CACHE_KIND_LEVEL, RIG_LEVEL_SQL },
+    { "PC", CACHE_KIND_LEVEL, RIG_LEVEL_RFPOWER },
+    { "MG", CACHE_KIND_LEVEL, RIG_LEVEL_MICGAIN },
+    { "KS", CACHE_KIND_LEVEL, RIG_LEVEL_KEYSPD },
+    { "GT", CACHE_KIND_LEVEL, RIG_LEVEL_AGC },
+    { "RA", CACHE_KIND_LEVEL, RIG_LEVEL_ATT },
+    { "PA", CACHE_KIND_LEVEL, RIG_LEVEL_PREAMP },
+    { "NB", CACHE_KIND_FUNC, RIG_FUNC_NB },
+    { "NR", CACHE_KIND_FUNC, RIG_FUNC_NR },
+};
+
+/*
+ * Reports the rig sends on its own with AI2: FA/FB frequency, MD mode,
+ * DA data mode, FR receive VFO, TX/RX and IF.  Reports of the settings
+ * above drop them from the cache, everything else is left for the cache
+ * timeout.
+ */
+int kenwood_process_async_frame(RIG *rig, size_t frame_length,
+                                const unsigned char *frame)
+{
+    struct kenwood_priv_data *priv = STATE(rig)->priv;
+    const struct kenwood_priv_caps *caps = kenwood_caps(rig);
+    const char *buf = (const char *) frame;
+    vfo_t vfo = STATE(rig)->current_vfo;
+    freq_t freq;
+
+    ENTERFUNC;
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: %.*s\n", __func__, (int) frame_length, buf);
+
+    if (vfo != RIG_VFO_B) { vfo = RIG_VFO_A; }
+
+    if ((buf[0] == 'F' && (buf[1] == 'A' || buf[1] == 'B'))
+            && sscanf(buf + 2, "%11lf", &freq) == 1)
+    {
+        rig_fire_freq_event(rig, buf[1] == 'A' ? RIG_VFO_A : RIG_VFO_B, freq);
+    }
+    else if (strncmp(buf, "MD", 2) == 0 && frame_length == 4)
+    {
+        kenwood_async_mode(rig, vfo, buf[2]);
+    }
+    else if (strncmp(buf, "DA", 2) == 0 && frame_length == 4)
+    {
+        freq_t f;
+        rmode_t mode;
+        pbwidth_t width;
+        int ms_f, ms_m, ms_w;
+
+        if (vfo == RIG_VFO_B) { priv->datamodeB = buf[2] == '1'; }
+        else { priv->datamodeA = buf[2] == '1'; }
+
+        // redo the cached mode with the new data mode
+        rig_get_cache(rig, vfo, &f, &ms_f, &mode, &ms_m, &width, &ms_w);
+
+        switch (mode)
+        {
+        case RIG_MODE_PKTUSB: mode = RIG_MODE_USB; break;
+
+        case RIG_MODE_PKTLSB: mode = RIG_MODE_LSB; break;
+
+        case RIG_MODE_PKTFM: mode = RIG_MODE_FM; break;
+
+        case RIG_MODE_PKTAM: mode = RIG_MODE_AM; break;
+
+        default: break;
+        }
+
+        if (mode != RIG_MODE_NONE)
+        {
+            rig_fire_mode_event(rig, vfo, kenwood_async_datamode(rig, vfo, mode),
+                                RIG_PASSBAND_NOCHANGE);
+        }
+    }
+    else if (strncmp(buf, "FR", 2) == 0 && frame_length == 4)
+    {
+        if (buf[2] == '0' || buf[2] == '1')
+        {
+            rig_fire_vfo_event(rig, buf[2] == '0' ? RIG_VFO_A : RIG_VFO_B);
+        }
+    }
+    else if (strncmp(buf, "TX", 2) == 0)
+    {
+        rig_fire_ptt_event(rig, RIG_VFO_CURR, RIG_PTT_ON);
+    }
+    else if (strncmp(buf, "RX", 2) == 0)
+    {
+        rig_fire_ptt_event(rig, RIG_VFO_CURR, RIG_PTT_OFF);
+    }
+    else if (strncmp(buf, "IF", 2) == 0 && caps->if_len > 32
+             && (int) frame_length == caps->if_len + 1)
+    {
+        /* same layout kenwood_get_status_bulk() reads */
+        vfo_t if_vfo, rx_vfo, tx_vfo;
+
+        if (kenwood_if_vfos(rig, buf, &if_vfo, &rx_vfo, &tx_vfo) == RIG_OK)
+        {
+            // freq and mode are of the VFO shown, the TX one in split TX
+            if (sscanf(buf + 2, "%11lf", &freq) == 1)
+            {
+                rig_fire_freq_event(rig, if_vfo, freq);
+            }
+
+            if (rx_vfo != RIG_VFO_MEM)
+            {
+                rig_fire_vfo_event(rig, rx_vfo);
+            }
+
+            kenwood_async_mode(rig, if_vfo, buf[29]);
+            rig_fire_ptt_event(rig, RIG_VFO_CURR,
+                               buf[28] == '0' ? RIG_PTT_OFF : RIG_PTT_ON);
+        }
+    }
+    else
+    {
+        int i;
+
+        for (i = 0; i < (int)(sizeof(kenwood_async_settings)
+                              / sizeof(kenwood_async_settings[0])); i++)
+        {
+            if (strncmp(buf, kenwood_async_settings[i].cmd, 2) == 0)
+            {
+                rig_cache_invalidate_setting(rig, kenwood_async_settings[i].kind,
+                                             kenwood_async_settings[i].setting);
+                break;
+            }
+        }
+
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: ignoring %.*s\n", __func__,
+                  (int) frame_length, buf);
+    }
+
+    RETURNFUNC(RIG_OK);
+}
+
 /*
  * kenwood_set_powerstat
  */
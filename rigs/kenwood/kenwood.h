@@ -25,10 +25,11 @@
 #define _KENWOOD_H 1
 
 #include <string.h>
+#include <pthread.h>
 #include "token.h"
 #include "idx_builtin.h"
 
-#define BACKEND_VER "20250515"
+#define BACKEND_VER "20251018"
 
 #define EOM_KEN ';'
 #define EOM_TH '\r'
@@ -185,6 +186,8 @@ struct kenwood_priv_data
     int voice_bank; /* last voice bank send for use by stop_voice_mem */
     rmode_t last_mode_pc; // last mode memory for PC command
     int power_now,power_min,power_max;
+    char async_wait[16]; /* reply a transaction waits for, "*" any, "" none -- see kenwood_is_async_frame */
+    pthread_mutex_t async_lock; /* of async_wait, the async data handler reads it */
 };
 
 
@@ -264,6 +267,7 @@ int kenwood_scan(RIG *rig, vfo_t vfo, scan_t scan, int ch);
 const char *kenwood_get_info(RIG *rig);
 int kenwood_get_id(RIG *rig, char *buf);
 int kenwood_get_if(RIG *rig);
+int kenwood_get_status_bulk(RIG *rig, struct rig_status_bulk *status, int n);
 int kenwood_send_voice_mem(RIG *rig, vfo_t vfo, int bank);
 int kenwood_stop_voice_mem(RIG *rig, vfo_t vfo);
 int kenwood_get_clock(RIG *rig, int *year, int *month, int *day, int *hour, int *min, int *sec, double *msec, int *utc_offset);
@@ -271,6 +275,14 @@ int kenwood_set_clock(RIG *rig, int year, int month, int day, int hour, int min,
 
 int kenwood_set_trn(RIG *rig, int trn);
 int kenwood_get_trn(RIG *rig, int *trn);
+int kenwood_open_trn(RIG *rig);
+int kenwood_read_frame_direct(RIG *rig, size_t buffer_length,
+                              const unsigned char *buffer);
+void kenwood_set_async_wait(RIG *rig, const char *reply);
+int kenwood_is_async_frame(RIG *rig, size_t frame_length,
+                           const unsigned char *frame);
+int kenwood_process_async_frame(RIG *rig, size_t frame_length,
+                                const unsigned char *frame);
 
 /* only use if returned string has length 6, e.g. 'SQ011;' */
 int get_kenwood_level(RIG *rig, const char *cmd, float *fval, int *ival);
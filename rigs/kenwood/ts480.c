@@ -1347,6 +1347,11 @@ struct rig_caps ts480_caps =
     .max_ifshift = Hz(0),
     .targetable_vfo = RIG_TARGETABLE_FREQ,
     .transceive = RIG_TRN_RIG,
+    .async_data_supported = 1,
+    .read_frame_direct = kenwood_read_frame_direct,
+    .is_async_frame = kenwood_is_async_frame,
+    .process_async_frame = kenwood_process_async_frame,
+    .get_status_bulk = kenwood_get_status_bulk,
     .agc_level_count = 3,
     .agc_levels = { RIG_AGC_OFF, RIG_AGC_FAST, RIG_AGC_SLOW },
 
@@ -2402,11 +2407,11 @@ static int malachite_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
     ENTERFUNC;
 
     rig_debug(RIG_DEBUG_TRACE, "%s: freqMainA=%g, freq=%g\n", __func__,
-              cachep->freqMainA, freq);
+              cachep->slot[CACHE_SLOT_MAIN_A].freq, freq);
 
-    if ((cachep->freqMainA < 400000000 && freq >= 400000000)
-            || (cachep->freqMainA >= 400000000 && freq < 400000000)
-            || cachep->freqMainA == 0)
+    if ((cachep->slot[CACHE_SLOT_MAIN_A].freq < 400000000 && freq >= 400000000)
+            || (cachep->slot[CACHE_SLOT_MAIN_A].freq >= 400000000 && freq < 400000000)
+            || cachep->slot[CACHE_SLOT_MAIN_A].freq == 0)
     {
         // Malachite has a bug where it takes two freq set to make it work
         // under band changes -- so we just do this all the time
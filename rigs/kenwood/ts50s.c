@@ -187,6 +187,7 @@ struct rig_caps ts50s_caps =
     .get_xit =  kenwood_get_xit,
     .set_mode =  kenwood_set_mode,
     .get_mode =  kenwood_get_mode_if,
+    .get_status_bulk = kenwood_get_status_bulk,
     .set_vfo =  kenwood_set_vfo,
     .get_vfo =  kenwood_get_vfo_if,
     .set_split_vfo = kenwood_set_split,
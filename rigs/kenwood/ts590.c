@@ -241,7 +241,8 @@ static int ts590_set_mode(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
     if (!sf_fails)
     {
         SNPRINTF(cmd, sizeof(cmd), "SF%d%011.0f%c", vfo == RIG_VFO_A ? 0 : 1,
-                 vfo == RIG_VFO_A ? CACHE(rig)->freqMainA : CACHE(rig)->freqMainB,
+                 CACHE(rig)->slot[vfo == RIG_VFO_A ? CACHE_SLOT_MAIN_A
+                                  : CACHE_SLOT_MAIN_B].freq,
                  c);
         retval = kenwood_transaction(rig, cmd, NULL, 0);
     }
@@ -1742,6 +1743,11 @@ struct rig_caps ts590_caps =
 //    mode command is not vfo targetable
     .targetable_vfo = RIG_TARGETABLE_FREQ,
     .transceive = RIG_TRN_RIG,
+    .async_data_supported = 1,
+    .read_frame_direct = kenwood_read_frame_direct,
+    .is_async_frame = kenwood_is_async_frame,
+    .process_async_frame = kenwood_process_async_frame,
+    .get_status_bulk = kenwood_get_status_bulk,
     .agc_level_count = 6,
     .agc_levels = { RIG_AGC_OFF, RIG_AGC_SLOW, RIG_AGC_MEDIUM, RIG_AGC_FAST, RIG_AGC_SUPERFAST, RIG_AGC_ON },
 
@@ -2173,6 +2179,11 @@ struct rig_caps ts590sg_caps =
 //    mode command is not vfo targetable
     .targetable_vfo = RIG_TARGETABLE_FREQ,
     .transceive = RIG_TRN_RIG,
+    .async_data_supported = 1,
+    .read_frame_direct = kenwood_read_frame_direct,
+    .is_async_frame = kenwood_is_async_frame,
+    .process_async_frame = kenwood_process_async_frame,
+    .get_status_bulk = kenwood_get_status_bulk,
     .agc_level_count = 6,
     .agc_levels = { RIG_AGC_OFF, RIG_AGC_SLOW, RIG_AGC_MEDIUM, RIG_AGC_FAST, RIG_AGC_SUPERFAST, RIG_AGC_ON },
 
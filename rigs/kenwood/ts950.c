@@ -184,6 +184,7 @@ struct rig_caps ts950s_caps =
     .get_xit =  kenwood_get_xit,
     .set_mode =  kenwood_set_mode,
     .get_mode =  kenwood_get_mode_if,
+    .get_status_bulk = kenwood_get_status_bulk,
     .set_vfo =  kenwood_set_vfo,
     .get_vfo =  kenwood_get_vfo_if,
     .set_ctcss_tone =  kenwood_set_ctcss_tone,
@@ -330,6 +331,7 @@ struct rig_caps ts950sdx_caps =
     .get_xit =  kenwood_get_xit,
     .set_mode =  kenwood_set_mode,
     .get_mode =  kenwood_get_mode_if,
+    .get_status_bulk = kenwood_get_status_bulk,
     .set_vfo =  kenwood_set_vfo,
     .get_vfo =  kenwood_get_vfo_if,
     .set_ctcss_tone =  kenwood_set_ctcss_tone,
@@ -197,6 +197,7 @@ static int xg3_init(RIG *rig)
         return -RIG_ENOMEM;
     }
 
+    pthread_mutex_init(&priv->async_lock, NULL);
     STATE(rig)->priv = (void *)priv;
     RIGPORT(rig)->type.rig = RIG_PORT_SERIAL;
 // Tried set_trn to turn transceiver on/off but turning it on isn't enabled in hamlib for some reason
@@ -4123,11 +4123,11 @@ static int ft1000_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
 
     if (vfo == RIG_VFO_A)
     {
-        *freq = CACHE(rig)->freqMainA;
+        *freq = CACHE(rig)->slot[CACHE_SLOT_MAIN_A].freq;
     }
     else
     {
-        *freq = CACHE(rig)->freqMainB;
+        *freq = CACHE(rig)->slot[CACHE_SLOT_MAIN_B].freq;
     }
 
     return RIG_OK;
@@ -4137,11 +4137,11 @@ static int ft1000_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode, pbwidth_t *width)
 {
     if (vfo == RIG_VFO_A)
     {
-        *mode = CACHE(rig)->modeMainA;
+        *mode = CACHE(rig)->slot[CACHE_SLOT_MAIN_A].mode;
     }
     else
     {
-        *mode = CACHE(rig)->modeMainB;
+        *mode = CACHE(rig)->slot[CACHE_SLOT_MAIN_B].mode;
     }
 
     return RIG_OK;
@@ -857,12 +857,12 @@ static int ft1000mp_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
     {
     case RIG_VFO_A:
         cmd_index = FT1000MP_NATIVE_FREQA_SET;
-        CACHE(rig)->freqMainA = freq;
+        rig_set_cache_freq(rig, RIG_VFO_A, freq);
         break;
 
     case RIG_VFO_B:
         cmd_index = FT1000MP_NATIVE_FREQB_SET;
-        CACHE(rig)->freqMainB = freq;
+        rig_set_cache_freq(rig, RIG_VFO_B, freq);
         break;
 
     case RIG_VFO_MEM:
@@ -1848,8 +1848,8 @@ static int ft1000mp_set_split_freq_mode(RIG *rig, vfo_t vfo, freq_t freq,
 
     if (retval == RIG_OK)
     {
-        CACHE(rig)->freqMainB = freq;
-        CACHE(rig)->modeMainB = mode;
+        rig_set_cache_freq(rig, RIG_VFO_B, freq);
+        rig_set_cache_mode(rig, RIG_VFO_B, mode, 0);
     }
 
     RETURNFUNC(retval);
@@ -1873,8 +1873,8 @@ static int ft1000mp_get_split_freq_mode(RIG *rig, vfo_t vfo, freq_t *freq,
 
     if (retval == RIG_OK)
     {
-        CACHE(rig)->freqMainB = *freq;
-        CACHE(rig)->modeMainB = *mode;
+        rig_set_cache_freq(rig, RIG_VFO_B, *freq);
+        rig_set_cache_mode(rig, RIG_VFO_B, *mode, *width);
     }
 
     RETURNFUNC(retval);
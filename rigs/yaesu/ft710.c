@@ -175,6 +175,11 @@ struct rig_caps ft710_caps =
     .scan_ops =           RIG_SCAN_VFO,
     .targetable_vfo =     RIG_TARGETABLE_FREQ,
     .transceive =         RIG_TRN_OFF, /* May enable later as the FT-710 has an Auto Info command */
+    .async_data_supported = 1,
+    .read_frame_direct =  newcat_read_frame_direct,
+    .is_async_frame =     newcat_is_async_frame,
+    .process_async_frame = newcat_process_async_frame,
+    .get_status_bulk = newcat_get_status_bulk,
     .bank_qty =           0,
     .chan_desc_sz =       0,
     .rfpower_meter_cal =  FT710_RFPOWER_METER_CAL,
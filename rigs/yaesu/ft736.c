@@ -297,7 +297,7 @@ int ft736_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
 {
     rig_debug(RIG_DEBUG_VERBOSE, "%s: called\n", __func__);
 
-    if (vfo == RIG_VFO_A || vfo == RIG_VFO_MAIN) { *freq = CACHE(rig)->freqMainA; }
+    if (vfo == RIG_VFO_A || vfo == RIG_VFO_MAIN) { *freq = CACHE(rig)->slot[CACHE_SLOT_MAIN_A].freq; }
     else { rig_get_cache_freq(rig, vfo, freq, NULL); }
 
     return RIG_OK;
@@ -316,7 +316,7 @@ static int ft736_get_mode(RIG *rig, vfo_t vfo, rmode_t *mode, pbwidth_t *width)
 {
     rig_debug(RIG_DEBUG_VERBOSE, "%s: called\n", __func__);
 
-    *mode = CACHE(rig)->modeMainA;
+    *mode = CACHE(rig)->slot[CACHE_SLOT_MAIN_A].mode;
 
     switch (*mode)
     {
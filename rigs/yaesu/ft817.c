@@ -871,7 +871,7 @@ static int ft817_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
     // we can't query VFOB while in transmit and split mode
     if (cachep->ptt && vfo == RIG_VFO_B && cachep->split)
     {
-        *freq = cachep->freqMainB;
+        *freq = cachep->slot[CACHE_SLOT_MAIN_B].freq;
         return RIG_OK;
     }
 
@@ -2019,7 +2019,9 @@ static int ft817_set_split_vfo(RIG *rig, vfo_t vfo, split_t split, vfo_t tx_vfo)
         return n;
     }
 
+    rig_cache_write_begin(CACHE(rig));
     CACHE(rig)->split = split;
+    rig_cache_write_end(CACHE(rig));
 
     return RIG_OK;
 
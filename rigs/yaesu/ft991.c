@@ -231,6 +231,11 @@ struct rig_caps ft991_caps =
     .scan_ops =           RIG_SCAN_VFO,
     .targetable_vfo =     RIG_TARGETABLE_FREQ,
     .transceive =         RIG_TRN_OFF,        /* May enable later as the 950 has an Auto Info command */
+    .async_data_supported = 1,
+    .read_frame_direct =  newcat_read_frame_direct,
+    .is_async_frame =     newcat_is_async_frame,
+    .process_async_frame = newcat_process_async_frame,
+    .get_status_bulk = newcat_get_status_bulk,
     .bank_qty =           0,
     .chan_desc_sz =       0,
     .rfpower_meter_cal =  FT991_RFPOWER_METER_CAL,
@@ -467,7 +472,7 @@ ft991_set_split_freq(RIG *rig, vfo_t vfo, freq_t tx_freq)
         return (rval);
     }
 
-    if (CACHE(rig)->freqMainB == tx_freq)
+    if (CACHE(rig)->slot[CACHE_SLOT_MAIN_B].freq == tx_freq)
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: freq %.0f already set on VFOB\n", __func__,
                   tx_freq);
@@ -644,7 +649,7 @@ static int ft991_set_split_mode(RIG *rig, vfo_t vfo, rmode_t tx_mode,
         return -RIG_EINVAL;
     }
 
-    if (CACHE(rig)->modeMainB == tx_mode)
+    if (CACHE(rig)->slot[CACHE_SLOT_MAIN_B].mode == tx_mode)
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: mode %s already set on VFOB\n", __func__,
                   rig_strrmode(tx_mode));
@@ -235,6 +235,11 @@ struct rig_caps ftdx101d_caps =
     .scan_ops =           RIG_SCAN_VFO,
     .targetable_vfo =     RIG_TARGETABLE_FREQ | RIG_TARGETABLE_MODE | RIG_TARGETABLE_FUNC | RIG_TARGETABLE_LEVEL | RIG_TARGETABLE_COMMON | RIG_TARGETABLE_ANT | RIG_TARGETABLE_ROOFING | RIG_TARGETABLE_TONE,
     .transceive =         RIG_TRN_OFF, /* May enable later as the FTDX101 has an Auto Info command */
+    .async_data_supported = 1,
+    .read_frame_direct =  newcat_read_frame_direct,
+    .is_async_frame =     newcat_is_async_frame,
+    .process_async_frame = newcat_process_async_frame,
+    .get_status_bulk = newcat_get_status_bulk,
     .bank_qty =           0,
     .chan_desc_sz =       0,
     .rfpower_meter_cal =  FTDX101D_RFPOWER_METER_WATTS_CAL,
@@ -377,5 +382,6 @@ struct rig_caps ftdx101d_caps =
     .scan =               newcat_scan,
     .send_voice_mem =     newcat_send_voice_mem,
     .morse_qsize =        50,
+    .cache_flags = RIG_CACHE_FLAG_NO_FASTPATH,
     .hamlib_check_rig_caps = HAMLIB_CHECK_RIG_CAPS
 };
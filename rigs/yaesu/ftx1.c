@@ -473,7 +473,7 @@ ftx1_set_split_freq(RIG *rig, vfo_t vfo, freq_t tx_freq)
         return (rval);
     }
 
-    if (CACHE(rig)->freqMainB == tx_freq)
+    if (CACHE(rig)->slot[CACHE_SLOT_MAIN_B].freq == tx_freq)
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: freq %.0f already set on VFOB\n", __func__,
                   tx_freq);
@@ -650,7 +650,7 @@ static int ftx1_set_split_mode(RIG *rig, vfo_t vfo, rmode_t tx_mode,
         return -RIG_EINVAL;
     }
 
-    if (CACHE(rig)->modeMainB == tx_mode)
+    if (CACHE(rig)->slot[CACHE_SLOT_MAIN_B].mode == tx_mode)
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: mode %s already set on VFOB\n", __func__,
                   rig_strrmode(tx_mode));
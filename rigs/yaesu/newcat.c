@@ -37,6 +37,7 @@
 #include "misc.h"
 #include "cache.h"
 #include "cal.h"
+#include "event.h"
 #include "newcat.h"
 
 /* global variables */
@@ -501,6 +502,7 @@ int newcat_init(RIG *rig)
     priv->rig_id = NC_RIGID_NONE;
     priv->current_mem = NC_MEM_CHANNEL_NONE;
     priv->fast_set_commands = FALSE;
+    pthread_mutex_init(&priv->async_lock, NULL);
 
     /*
      * Determine the type of rig from the model number.  Note it is
@@ -546,6 +548,9 @@ int newcat_cleanup(RIG *rig)
 
     if (STATE(rig)->priv)
     {
+        struct newcat_priv_data *priv = STATE(rig)->priv;
+
+        pthread_mutex_destroy(&priv->async_lock);
         free(STATE(rig)->priv);
     }
 
@@ -601,9 +606,13 @@ int newcat_open(RIG *rig)
     rp->timeout = 100;
     newcat_get_trn(rig, &priv->trn_state);  /* ignore errors */
 
-    /* Currently we cannot cope with AI mode so turn it off in case
-       last client left it on */
-    if (priv->trn_state > 0)
+    /* With async data the AI reports feed the cache, otherwise turn AI
+       off in case last client left it on */
+    if (rp->asyncio)
+    {
+        newcat_set_trn(rig, RIG_TRN_RIG);
+    } /* ignore status in case it's not supported */
+    else if (priv->trn_state > 0)
     {
         newcat_set_trn(rig, RIG_TRN_OFF);
     } /* ignore status in case it's not supported */
@@ -954,7 +963,7 @@ int newcat_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
 
     ENTERFUNC;
 
-    if (newcat_60m_exception(rig, freq, cachep->modeMainA))
+    if (newcat_60m_exception(rig, freq, cachep->slot[CACHE_SLOT_MAIN_A].mode))
     {
         // we don't try to set freq on 60m for some rigs since we must be in memory mode
         // and we can't run split mode on 60M memory mode either
@@ -1522,7 +1531,7 @@ int newcat_set_mode(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
 
     ENTERFUNC;
 
-    if (newcat_60m_exception(rig, cachep->freqMainA, mode)) { RETURNFUNC(RIG_OK); } // we don't set mode in this case
+    if (newcat_60m_exception(rig, cachep->slot[CACHE_SLOT_MAIN_A].freq, mode)) { RETURNFUNC(RIG_OK); } // we don't set mode in this case
 
     if (!newcat_valid_command(rig, "MD"))
     {
@@ -1589,14 +1598,8 @@ int newcat_set_mode(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
         RETURNFUNC(err);
     }
 
-    if (vfo == RIG_VFO_A || vfo == RIG_VFO_MAIN)
-    {
-        cachep->modeMainA = mode;
-    }
-    else
-    {
-        cachep->modeMainB = mode;
-    }
+    rig_set_cache_mode(rig, (vfo == RIG_VFO_A || vfo == RIG_VFO_MAIN)
+                       ? RIG_VFO_A : RIG_VFO_B, mode, 0);
 
     if (RIG_PASSBAND_NOCHANGE == width) { RETURNFUNC(err); }
 
@@ -2730,14 +2733,8 @@ int newcat_set_split_mode(RIG *rig, vfo_t vfo, rmode_t tx_mode,
         RETURNFUNC(err);
     }
 
-    if (vfo == RIG_VFO_A || vfo == RIG_VFO_MAIN)
-    {
-        CACHE(rig)->modeMainA = tx_mode;
-    }
-    else
-    {
-        CACHE(rig)->modeMainB = tx_mode;
-    }
+    rig_set_cache_mode(rig, (vfo == RIG_VFO_A || vfo == RIG_VFO_MAIN)
+                       ? RIG_VFO_A : RIG_VFO_B, tx_mode, 0);
 
 
     RETURNFUNC(-RIG_ENAVAIL);
@@ -2779,8 +2776,8 @@ int newcat_set_split_vfo(RIG *rig, vfo_t vfo, split_t split, vfo_t tx_vfo)
         RETURNFUNC(err);
     }
 
-    if (newcat_60m_exception(rig, CACHE(rig)->freqMainA,
-                             CACHE(rig)->modeMainA))
+    if (newcat_60m_exception(rig, CACHE(rig)->slot[CACHE_SLOT_MAIN_A].freq,
+                             CACHE(rig)->slot[CACHE_SLOT_MAIN_A].mode))
     {
         rig_debug(RIG_DEBUG_VERBOSE,
                   "%s: force set_split off since we're on 60M exception\n", __func__);
@@ -3168,6 +3165,98 @@ int newcat_get_xit(RIG *rig, vfo_t vfo, shortfreq_t *xit)
 }
 
 
+/*
+ * Freq, mode, RIT and XIT of VFO A (Main) from one IF and of VFO B (Sub)
+ * from one OI.  Neither tells PTT or split.
+ */
+int newcat_get_status_bulk(RIG *rig, struct rig_status_bulk *status, int n)
+{
+    struct rig_state *rs = STATE(rig);
+    struct newcat_priv_data *priv = (struct newcat_priv_data *)rs->priv;
+    int i, err, width;
+    char digits[10];
+    const char *buf;
+
+    ENTERFUNC;
+
+    for (i = 0; i < n; i++)
+    {
+        struct rig_status_bulk *st = &status[i];
+        vfo_t vfo = st->vfo == RIG_VFO_CURR ? rs->current_vfo : st->vfo;
+        const char *cmd;
+        shortfreq_t clar;
+
+        // OI always returns VFOB and IF always VFOA
+        switch (vfo)
+        {
+        case RIG_VFO_A:
+        case RIG_VFO_MAIN: cmd = "IF"; break;
+
+        case RIG_VFO_B:
+        case RIG_VFO_SUB: cmd = "OI"; break;
+
+        default: continue;
+        }
+
+        if (!newcat_valid_command(rig, cmd))
+        {
+            continue;
+        }
+
+        SNPRINTF(priv->cmd_str, sizeof(priv->cmd_str), "%s%c", cmd, cat_term);
+
+        err = newcat_get_cmd(rig);
+
+        // leave it to the caller to read what some firmware rejects
+        if (err == -RIG_ERJCTED)
+        {
+            continue;
+        }
+
+        if (err != RIG_OK)
+        {
+            RETURNFUNC(err);
+        }
+
+        buf = priv->ret_data;
+
+        // same lengths newcat_async_info() knows
+        switch (strlen(buf))
+        {
+        case 27:
+        case 30: width = 8; break;
+
+        case 28:
+        case 41: width = 9; break;
+
+        default:
+            rig_debug(RIG_DEBUG_ERR, "%s: incorrect length of %s response, got %d\n",
+                      __func__, cmd, (int)strlen(buf));
+            RETURNFUNC(-RIG_EPROTO);
+        }
+
+        /* P1 memory channel, P2 frequency, P3 clarifier, P4 RX and P5 TX
+         * clarifier on, P6 mode */
+        SNPRINTF(digits, sizeof(digits), "%.*s", width, buf + 5);
+        st->freq = atof(digits);
+        SNPRINTF(digits, sizeof(digits), "%.5s", buf + 5 + width);
+        clar = atoi(digits);
+        st->rit = buf[5 + width + 5] == '1' ? clar : 0;
+        st->xit = buf[5 + width + 6] == '1' ? clar : 0;
+        st->mode = newcat_rmode(buf[5 + width + 7]);
+        st->vfo = vfo;
+        st->valid = RIG_STATUS_FREQ | RIG_STATUS_RIT | RIG_STATUS_XIT;
+
+        if (st->mode != RIG_MODE_NONE)
+        {
+            st->valid |= RIG_STATUS_MODE;
+        }
+    }
+
+    RETURNFUNC(RIG_OK);
+}
+
+
 int newcat_set_ts(RIG *rig, vfo_t vfo, shortfreq_t ts)
 {
     int err, i;
@@ -4328,9 +4417,9 @@ int newcat_set_level(RIG *rig, vfo_t vfo, setting_t level, value_t val)
 
         rmode_t exclude = RIG_MODE_CW | RIG_MODE_CWR | RIG_MODE_RTTY | RIG_MODE_RTTYR;
 
-        if ((STATE(rig)->tx_vfo == RIG_VFO_A && (cachep->modeMainA & exclude))
-                || (STATE(rig)->tx_vfo == RIG_VFO_B && (cachep->modeMainB & exclude))
-                || (STATE(rig)->tx_vfo == RIG_VFO_C && (cachep->modeMainC & exclude)))
+        if ((STATE(rig)->tx_vfo == RIG_VFO_A && (cachep->slot[CACHE_SLOT_MAIN_A].mode & exclude))
+                || (STATE(rig)->tx_vfo == RIG_VFO_B && (cachep->slot[CACHE_SLOT_MAIN_B].mode & exclude))
+                || (STATE(rig)->tx_vfo == RIG_VFO_C && (cachep->slot[CACHE_SLOT_MAIN_C].mode & exclude)))
         {
             rig_debug(RIG_DEBUG_VERBOSE, "%s: rig cannot set MG in CW/RTTY modes\n",
                       __func__);
@@ -4934,7 +5023,7 @@ int newcat_set_level(RIG *rig, vfo_t vfo, setting_t level, value_t val)
         if (is_ftdx101d || is_ftdx101mp)
         {
             rmode_t curmode = STATE(rig)->current_vfo == RIG_VFO_A ?
-                              cachep->modeMainA : cachep->modeMainB;
+                              cachep->slot[CACHE_SLOT_MAIN_A].mode : cachep->slot[CACHE_SLOT_MAIN_B].mode;
             float valf = val.f / level_info->step.f;
 
             switch (curmode)
@@ -5146,9 +5235,9 @@ int newcat_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
 
         rmode_t exclude = RIG_MODE_CW | RIG_MODE_CWR | RIG_MODE_RTTY | RIG_MODE_RTTYR;
 
-        if ((STATE(rig)->tx_vfo == RIG_VFO_A && (cachep->modeMainA & exclude))
-                || (STATE(rig)->tx_vfo == RIG_VFO_B && (cachep->modeMainB & exclude))
-                || (STATE(rig)->tx_vfo == RIG_VFO_C && (cachep->modeMainC & exclude)))
+        if ((STATE(rig)->tx_vfo == RIG_VFO_A && (cachep->slot[CACHE_SLOT_MAIN_A].mode & exclude))
+                || (STATE(rig)->tx_vfo == RIG_VFO_B && (cachep->slot[CACHE_SLOT_MAIN_B].mode & exclude))
+                || (STATE(rig)->tx_vfo == RIG_VFO_C && (cachep->slot[CACHE_SLOT_MAIN_C].mode & exclude)))
         {
             rig_debug(RIG_DEBUG_VERBOSE, "%s: rig cannot read MG in CW/RTTY modes\n",
                       __func__);
@@ -5531,7 +5620,7 @@ int newcat_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
         if (is_ftdx101d || is_ftdx101mp)
         {
             rmode_t curmode = STATE(rig)->current_vfo == RIG_VFO_A ?
-                              cachep->modeMainA : cachep->modeMainB;
+                              cachep->slot[CACHE_SLOT_MAIN_A].mode : cachep->slot[CACHE_SLOT_MAIN_B].mode;
 
             switch (curmode)
             {
@@ -5573,7 +5662,7 @@ int newcat_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
         if (is_ftdx101d || is_ftdx101mp)
         {
             rmode_t curmode = STATE(rig)->current_vfo == RIG_VFO_A ?
-                              cachep->modeMainA : cachep->modeMainB;
+                              cachep->slot[CACHE_SLOT_MAIN_A].mode : cachep->slot[CACHE_SLOT_MAIN_B].mode;
 
             switch (curmode)
             {
@@ -7757,6 +7846,186 @@ int newcat_get_trn(RIG *rig, int *trn)
 }
 
 
+int newcat_read_frame_direct(RIG *rig, size_t buffer_length,
+                             const unsigned char *buffer)
+{
+    return read_string_direct(RIGPORT(rig), (unsigned char *) buffer,
+                              buffer_length - 1, &cat_term, sizeof(cat_term), 0, 1);
+}
+
+
+/*
+ * Tell the async data handler which reply the running transaction waits
+ * for: the query up to its terminator, "" for none.
+ */
+void newcat_set_async_wait(RIG *rig, const char *reply)
+{
+    struct newcat_priv_data *priv = STATE(rig)->priv;
+    size_t len = strcspn(reply, ";");
+
+    if (len >= sizeof(priv->async_wait)) { len = sizeof(priv->async_wait) - 1; }
+
+    pthread_mutex_lock(&priv->async_lock);
+    memcpy(priv->async_wait, reply, len);
+    priv->async_wait[len] = '\0';
+    pthread_mutex_unlock(&priv->async_lock);
+}
+
+/*
+ * With AI on, a report looks just like a reply, so a frame is the reply
+ * of the running transaction when it starts with the whole query, "MD0"
+ * but not "MD1".  Error replies like "?;" always belong to the
+ * transaction.
+ */
+int newcat_is_async_frame(RIG *rig, size_t frame_length,
+                          const unsigned char *frame)
+{
+    struct newcat_priv_data *priv = STATE(rig)->priv;
+    size_t len;
+    int async;
+
+    if (frame_length <= 2) { return 0; }
+
+    pthread_mutex_lock(&priv->async_lock);
+    len = strlen(priv->async_wait);
+    async = len == 0 || frame_length < len
+            || memcmp(frame, priv->async_wait, len) != 0;
+
+    if (!async) { priv->async_wait[0] = '\0'; }   /* one reply per query */
+
+    pthread_mutex_unlock(&priv->async_lock);
+
+    return async;
+}
+
+
+/* freq, mode and vfo of an IF (VFO A) or OI (VFO B) report */
+static void newcat_async_info(RIG *rig, vfo_t vfo, const char *buf,
+                              size_t frame_length)
+{
+    char digits[10];
+    int width;
+    rmode_t mode;
+
+    // same lengths newcat_get_vfo_mode() knows
+    switch (frame_length)
+    {
+    case 27:
+    case 30: width = 8; break;
+
+    case 28:
+    case 41: width = 9; break;
+
+    default:
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: unknown length %d\n", __func__,
+                  (int) frame_length);
+        return;
+    }
+
+    /* P1 memory channel, P2 frequency, P3 clarifier, P4, P5, P6 mode */
+    SNPRINTF(digits, sizeof(digits), "%.*s", width, buf + 5);
+    rig_fire_freq_event(rig, vfo, atof(digits));
+
+    mode = newcat_rmode(buf[5 + width + 7]);
+
+    if (mode != RIG_MODE_NONE)
+    {
+        rig_fire_mode_event(rig, vfo, mode, RIG_PASSBAND_NOCHANGE);
+    }
+}
+
+
+/* reports of settings the cache may hold, they are forgotten on sight */
+static const struct
+{
+    char cmd[3];
+    int kind;
+    setting_t setting;
+} newcat_async_settings[] =
+{
+    { "AG", CACHE_KIND_LEVEL, RIG_LEVEL_AF },
+    { "RG", CACHE_KIND_LEVEL, RIG_LEVEL_RF },
+    { "SQ", CACHE_KIND_LEVEL, RIG_LEVEL_SQL },
+    { "PC", CACHE_KIND_LEVEL, RIG_LEVEL_RFPOWER },
+    { "MG", CACHE_KIND_LEVEL, RIG_LEVEL_MICGAIN },
+    { "KS", CACHE_KIND_LEVEL, RIG_LEVEL_KEYSPD },
+    { "GT", CACHE_KIND_LEVEL, RIG_LEVEL_AGC },
+    { "RA", CACHE_KIND_LEVEL, RIG_LEVEL_ATT },
+    { "PA", CACHE_KIND_LEVEL, RIG_LEVEL_PREAMP },
+    { "NB", CACHE_KIND_FUNC, RIG_FUNC_NB },
+    { "NR", CACHE_KIND_FUNC, RIG_FUNC_NR },
+};
+
+/*
+ * Turns the AI reports into events and cache updates.  FA, FB, MD, TX,
+ * IF and OI are understood, reports of the settings above drop them
+ * from the cache and other reports are ignored.
+ */
+int newcat_process_async_frame(RIG *rig, size_t frame_length,
+                               const unsigned char *frame)
+{
+    struct newcat_priv_data *priv = STATE(rig)->priv;
+    const char *buf = (const char *) frame;
+    freq_t freq;
+
+    ENTERFUNC;
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: %.*s\n", __func__, (int) frame_length, buf);
+
+    // the saved IF reply may be out of date now
+    priv->cache_start.tv_sec = 0;
+
+    if (buf[0] == 'F' && (buf[1] == 'A' || buf[1] == 'B')
+            && sscanf(buf + 2, "%"SCNfreq, &freq) == 1)
+    {
+        rig_fire_freq_event(rig, buf[1] == 'A' ? RIG_VFO_A : RIG_VFO_B, freq);
+    }
+    else if (strncmp(buf, "MD", 2) == 0 && frame_length == 5)
+    {
+        rmode_t mode = newcat_rmode(buf[3]);
+
+        if (mode != RIG_MODE_NONE)
+        {
+            rig_fire_mode_event(rig, buf[2] == '1' ? RIG_VFO_B : RIG_VFO_A, mode,
+                                RIG_PASSBAND_NOCHANGE);
+        }
+    }
+    else if (strncmp(buf, "TX", 2) == 0 && frame_length == 4)
+    {
+        rig_fire_ptt_event(rig, RIG_VFO_CURR,
+                           buf[2] == '0' ? RIG_PTT_OFF : RIG_PTT_ON);
+    }
+    else if (strncmp(buf, "IF", 2) == 0)
+    {
+        newcat_async_info(rig, RIG_VFO_A, buf, frame_length);
+    }
+    else if (strncmp(buf, "OI", 2) == 0)
+    {
+        newcat_async_info(rig, RIG_VFO_B, buf, frame_length);
+    }
+    else
+    {
+        int i;
+
+        for (i = 0; i < (int)(sizeof(newcat_async_settings)
+                              / sizeof(newcat_async_settings[0])); i++)
+        {
+            if (strncmp(buf, newcat_async_settings[i].cmd, 2) == 0)
+            {
+                rig_cache_invalidate_setting(rig, newcat_async_settings[i].kind,
+                                             newcat_async_settings[i].setting);
+                break;
+            }
+        }
+
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: ignoring %.*s\n", __func__,
+                  (int) frame_length, buf);
+    }
+
+    RETURNFUNC(RIG_OK);
+}
+
+
 int newcat_decode_event(RIG *rig)
 {
     ENTERFUNC;
@@ -11297,6 +11566,7 @@ int newcat_get_cmd(RIG *rig)
             /* send the command */
             rig_debug(RIG_DEBUG_TRACE, "cmd_str = %s\n", priv->cmd_str);
 
+            newcat_set_async_wait(rig, priv->cmd_str);
             rc = write_block(rp, (unsigned char *) priv->cmd_str,
                              strlen(priv->cmd_str));
 
@@ -11611,6 +11881,7 @@ repeat:
         // some rigs like FT-450/Signalink need a little time before we can ask for TX status again
         if (strncmp(valcmd, "TX", 2) == 0) { hl_usleep(50 * 1000); }
 
+        newcat_set_async_wait(rig, valcmd);
         rc = write_block(rp, (unsigned char *) cmd, strlen(cmd));
 
         if (rc != RIG_OK) { RETURNFUNC(-RIG_EIO); }
@@ -11755,6 +12026,8 @@ int newcat_set_cmd(RIG *rig)
         /* send the verification command */
         rig_debug(RIG_DEBUG_TRACE, "cmd_str = %s\n", verify_cmd);
 
+        newcat_set_async_wait(rig, verify_cmd);
+
         if (RIG_OK != (rc = write_block(rp, (unsigned char *) verify_cmd,
                                         strlen(verify_cmd))))
         {
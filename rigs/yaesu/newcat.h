@@ -33,6 +33,7 @@
 #ifndef _NEWCAT_H
 #define _NEWCAT_H 1
 
+#include <pthread.h>
 #include "tones.h"
 #include "token.h"
 
@@ -50,7 +51,7 @@
 typedef char ncboolean;
 
 /* shared function version */
-#define NEWCAT_VER "20241118"
+#define NEWCAT_VER "20251018"
 
 /* Hopefully large enough for future use, 128 chars plus '\0' */
 #define NEWCAT_DATA_LEN                 129
@@ -131,6 +132,8 @@ struct newcat_priv_data
     char front_rear_status; /* e.g. FTDX5000 EX103 status */
     int split_st_command_missing; /* is ST command gone?  assume not until proven otherwise */
     int band_index;
+    char async_wait[16]; /* reply a query waits for with AI on, "" none */
+    pthread_mutex_t async_lock; /* async_wait, shared with the async reader */
 };
 
 /*
@@ -207,6 +210,7 @@ const char *newcat_get_info(RIG * rig);
 int newcat_get_rit(RIG * rig, vfo_t vfo, shortfreq_t * rit);
 int newcat_set_rit(RIG * rig, vfo_t vfo, shortfreq_t rit);
 int newcat_get_xit(RIG * rig, vfo_t vfo, shortfreq_t * xit);
+int newcat_get_status_bulk(RIG * rig, struct rig_status_bulk * status, int n);
 int newcat_set_xit(RIG * rig, vfo_t vfo, shortfreq_t xit);
 int newcat_get_clarifier_frequency(RIG *rig, vfo_t vfo, shortfreq_t *freq);
 int newcat_set_clarifier_frequency(RIG *rig, vfo_t vfo, shortfreq_t freq);
@@ -228,6 +232,13 @@ int newcat_set_ts(RIG * rig, vfo_t vfo, shortfreq_t ts);
 int newcat_get_ts(RIG * rig, vfo_t vfo, shortfreq_t * ts);
 int newcat_set_trn(RIG * rig, int trn);
 int newcat_get_trn(RIG * rig, int *trn);
+int newcat_read_frame_direct(RIG *rig, size_t buffer_length,
+                             const unsigned char *buffer);
+void newcat_set_async_wait(RIG *rig, const char *reply);
+int newcat_is_async_frame(RIG *rig, size_t frame_length,
+                          const unsigned char *frame);
+int newcat_process_async_frame(RIG *rig, size_t frame_length,
+                               const unsigned char *frame);
 int newcat_set_channel(RIG * rig, vfo_t vfo, const channel_t * chan);
 int newcat_get_channel(RIG * rig, vfo_t vfo, channel_t * chan, int read_only);
 rmode_t newcat_rmode(char mode);
@@ -585,6 +585,8 @@ int HAMLIB_API amp_cleanup(AMP *amp)
         amp->caps->amp_cleanup(amp);
     }
 
+    port_io_state_release(AMPPORT(amp));
+
     free(amp);
 
     return RIG_OK;
@@ -21,22 +21,113 @@
  */
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <stdio.h>
+#include <string.h>
+
 #include "cache.h"
 #include "hamlib/rig_state.h"
 #include "misc.h"
 
 #define CHECK_RIG_ARG(r) (!(r) || !(r)->caps || !STATE(r)->comm_state)
 
+extern double monotonic_seconds();
+
 /**
  * \file cache.c
  * \addtogroup rig
  * @{
  */
 
+/* vfo_t aliases sharing a slot, see enum rig_cache_slot_e */
+static const struct
+{
+    vfo_t vfo;
+    int slot;
+} cache_vfo_slots[] =
+{
+    { RIG_VFO_CURR, CACHE_SLOT_CURR },
+    { RIG_VFO_OTHER, CACHE_SLOT_OTHER },
+    { RIG_VFO_A, CACHE_SLOT_MAIN_A },
+    { RIG_VFO_VFO, CACHE_SLOT_MAIN_A },
+    { RIG_VFO_MAIN, CACHE_SLOT_MAIN_A },
+    { RIG_VFO_MAIN_A, CACHE_SLOT_MAIN_A },
+    { RIG_VFO_B, CACHE_SLOT_MAIN_B },
+    { RIG_VFO_SUB, CACHE_SLOT_MAIN_B },
+    { RIG_VFO_MAIN_B, CACHE_SLOT_MAIN_B },
+    { RIG_VFO_C, CACHE_SLOT_MAIN_C },
+    { RIG_VFO_MAIN_C, CACHE_SLOT_MAIN_C },
+    { RIG_VFO_SUB_A, CACHE_SLOT_SUB_A },
+    { RIG_VFO_SUB_B, CACHE_SLOT_SUB_B },
+    { RIG_VFO_SUB_C, CACHE_SLOT_SUB_C },
+    { RIG_VFO_MEM, CACHE_SLOT_MEM },
+};
+
+/* age in ms of a slot time, stale for one never set */
+static int cache_age_ms(double stamp, double now)
+{
+    if (stamp <= 0 || now < stamp)
+    {
+        return 1000 * 1000;
+    }
+
+    return (int)((now - stamp) * 1000);
+}
+
+/* Called once the cache is allocated */
+void rig_cache_init(RIG *rig)
+{
+    struct rig_cache *cachep = CACHE(rig);
+    size_t i;
+
+    pthread_mutex_init(&cachep->write_lock, NULL);
+    pthread_cond_init(&cachep->changed, NULL);
+
+    memset(cachep->vfo_slot, -1, sizeof(cachep->vfo_slot));
+
+    for (i = 0; i < sizeof(cache_vfo_slots) / sizeof(cache_vfo_slots[0]); i++)
+    {
+        cachep->vfo_slot[hl_ctz(cache_vfo_slots[i].vfo)] =
+            cache_vfo_slots[i].slot;
+    }
+}
+
+/* Mark everything stale, the next get of anything goes to the rig */
+void rig_cache_reset(RIG *rig)
+{
+    struct rig_cache *cachep = CACHE(rig);
+    int i;
+
+    rig_cache_write_begin(cachep);
+
+    for (i = 0; i < CACHE_SLOTS; i++)
+    {
+        cachep->slot[i].time_freq = 0;
+        cachep->slot[i].time_mode = 0;
+    }
+
+    elapsed_ms(&cachep->time_vfo, HAMLIB_ELAPSED_INVALIDATE);
+    elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_INVALIDATE);
+    elapsed_ms(&cachep->time_split, HAMLIB_ELAPSED_INVALIDATE);
+
+    rig_cache_write_end(cachep);
+}
+
+static void cache_slot_set_mode(struct rig_cache_vfo *slot, rmode_t mode,
+                                pbwidth_t width, double now)
+{
+    slot->mode = mode;
+
+    if (width > 0) { slot->width = width; }
+
+    slot->time_mode = now;
+}
+
 int rig_set_cache_mode(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
 {
     struct rig_cache *cachep = CACHE(rig);
     struct rig_state *rs = STATE(rig);
+    double now;
+    int slot, i;
 
     ENTERFUNC;
 
@@ -65,103 +156,47 @@ int rig_set_cache_mode(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
 
     if (vfo == RIG_VFO_OTHER) { vfo = vfo_fixup(rig, vfo, cachep->split); }
 
+    now = monotonic_seconds();
+    slot = rig_cache_slot(cachep, vfo);
+
+    if (slot < 0 && vfo != RIG_VFO_ALL)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s(%d): unknown vfo=%s\n", __func__, __LINE__,
+                  rig_strvfo(vfo));
+        RETURNFUNC(-RIG_EINTERNAL);
+    }
+
+    rig_cache_write_begin(cachep);
+
     if (vfo == rs->current_vfo)
     {
-        cachep->modeCurr = mode;
+        cache_slot_set_mode(&cachep->slot[CACHE_SLOT_CURR], mode, width, now);
+    }
 
-        if (width > 0)
+    if (vfo == RIG_VFO_ALL) // we'll use ALL to reset all VFO caches
+    {
+        for (i = 0; i < CACHE_SLOTS; i++)
         {
-            cachep->widthCurr = width;
+            cachep->slot[i].time_mode = 0;
         }
-
-        elapsed_ms(&cachep->time_modeCurr, HAMLIB_ELAPSED_SET);
     }
-
-    switch (vfo)
+    else
     {
-    case RIG_VFO_ALL: // we'll use NONE to reset all VFO caches
-        elapsed_ms(&cachep->time_modeMainA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeMainB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeMainC, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeSubA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeSubB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeSubC, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthMainA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthMainB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthMainC, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthSubA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthSubB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthSubC, HAMLIB_ELAPSED_INVALIDATE);
-        break;
-
-    case RIG_VFO_A:
-    case RIG_VFO_VFO:
-    case RIG_VFO_MAIN:
-    case RIG_VFO_MAIN_A:
-        cachep->modeMainA = mode;
-
-        if (width > 0) { cachep->widthMainA = width; }
-
-        elapsed_ms(&cachep->time_modeMainA, HAMLIB_ELAPSED_SET);
-        elapsed_ms(&cachep->time_widthMainA, HAMLIB_ELAPSED_SET);
-        break;
-
-    case RIG_VFO_B:
-    case RIG_VFO_SUB:
-    case RIG_VFO_MAIN_B:
-        cachep->modeMainB = mode;
-
-        if (width > 0) { cachep->widthMainB = width; }
-
-        elapsed_ms(&cachep->time_modeMainB, HAMLIB_ELAPSED_SET);
-        elapsed_ms(&cachep->time_widthMainB, HAMLIB_ELAPSED_SET);
-        break;
-
-    case RIG_VFO_C:
-    case RIG_VFO_MAIN_C:
-        cachep->modeMainC = mode;
-
-        if (width > 0) { cachep->widthMainC = width; }
-
-        elapsed_ms(&cachep->time_modeMainC, HAMLIB_ELAPSED_SET);
-        elapsed_ms(&cachep->time_widthMainC, HAMLIB_ELAPSED_SET);
-        break;
-
-    case RIG_VFO_SUB_A:
-        cachep->modeSubA = mode;
-        elapsed_ms(&cachep->time_modeSubA, HAMLIB_ELAPSED_SET);
-        break;
-
-    case RIG_VFO_SUB_B:
-        cachep->modeSubB = mode;
-        elapsed_ms(&cachep->time_modeSubB, HAMLIB_ELAPSED_SET);
-        break;
-
-    case RIG_VFO_SUB_C:
-        cachep->modeSubC = mode;
-        elapsed_ms(&cachep->time_modeSubC, HAMLIB_ELAPSED_SET);
-        break;
-
-    case RIG_VFO_MEM:
-        cachep->modeMem = mode;
-        elapsed_ms(&cachep->time_modeMem, HAMLIB_ELAPSED_SET);
-        break;
-
-    default:
-        rig_debug(RIG_DEBUG_WARN, "%s(%d): unknown vfo=%s\n", __func__, __LINE__,
-                  rig_strvfo(vfo));
-        RETURNFUNC(-RIG_EINTERNAL);
+        cache_slot_set_mode(&cachep->slot[slot], mode, width, now);
     }
 
+    rig_cache_write_end(cachep);
+
     rig_cache_show(rig, __func__, __LINE__);
     RETURNFUNC(RIG_OK);
 }
 
 int rig_set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq)
 {
-    int flag = HAMLIB_ELAPSED_SET;
     struct rig_cache *cachep = CACHE(rig);
     struct rig_state *rs = STATE(rig);
+    double now;
+    int slot;
 
     if (rig_need_debug(RIG_DEBUG_CACHE))
     {
@@ -178,14 +213,14 @@ int rig_set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq)
         vfo = rs->current_vfo;
     }
 
-    // if freq == 0 then we are asking to invalidate the cache
-    if (freq == 0) { flag = HAMLIB_ELAPSED_INVALIDATE; }
-
     // pick a sane default
     if (vfo == RIG_VFO_NONE || vfo == RIG_VFO_CURR) { vfo = RIG_VFO_A; }
 
     if (vfo == RIG_VFO_SUB && cachep->satmode) { vfo = RIG_VFO_SUB_A; };
 
+    // same as rig_set_cache_mode(), so rig_get_cache() finds it again
+    if (vfo == RIG_VFO_OTHER) { vfo = vfo_fixup(rig, vfo, cachep->split); }
+
     if (rig_need_debug(RIG_DEBUG_CACHE))
     {
         rig_debug(RIG_DEBUG_CACHE, "%s(%d): set vfo=%s to freq=%.0f\n", __func__,
@@ -193,91 +228,36 @@ int rig_set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq)
                   rig_strvfo(vfo), freq);
     }
 
-    if (vfo == rs->current_vfo)
+    if (vfo == RIG_VFO_ALL) // we'll use ALL to reset all VFO caches
+    {
+        rig_cache_reset(rig);
+        return (RIG_OK);
+    }
+
+    // if freq == 0 then we are asking to invalidate the cache
+    now = freq == 0 ? 0 : monotonic_seconds();
+    slot = rig_cache_slot(cachep, vfo);
+
+    if (slot < 0)
     {
-        cachep->freqCurr = freq;
-        elapsed_ms(&cachep->time_freqCurr, flag);
-    }
-
-    switch (vfo)
-    {
-    case RIG_VFO_ALL: // we'll use NONE to reset all VFO caches
-        elapsed_ms(&cachep->time_freqMainA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_freqMainB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_freqMainC, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_freqSubA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_freqSubB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_freqSubC, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_freqMem, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_vfo, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeMainA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeMainB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeMainC, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeSubA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeSubB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_modeSubC, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthMainA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthMainB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthMainC, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthSubA, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthSubB, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_widthSubC, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_INVALIDATE);
-        elapsed_ms(&cachep->time_split, HAMLIB_ELAPSED_INVALIDATE);
-        break;
-
-    case RIG_VFO_A:
-    case RIG_VFO_VFO:
-    case RIG_VFO_MAIN:
-    case RIG_VFO_MAIN_A:
-        cachep->freqMainA = freq;
-        elapsed_ms(&cachep->time_freqMainA, flag);
-        break;
-
-    case RIG_VFO_B:
-    case RIG_VFO_MAIN_B:
-    case RIG_VFO_SUB:
-        cachep->freqMainB = freq;
-        elapsed_ms(&cachep->time_freqMainB, flag);
-        break;
-
-    case RIG_VFO_C:
-    case RIG_VFO_MAIN_C:
-        cachep->freqMainC = freq;
-        elapsed_ms(&cachep->time_freqMainC, flag);
-        break;
-
-    case RIG_VFO_SUB_A:
-        cachep->freqSubA = freq;
-        elapsed_ms(&cachep->time_freqSubA, flag);
-        break;
-
-    case RIG_VFO_SUB_B:
-        cachep->freqSubB = freq;
-        elapsed_ms(&cachep->time_freqSubB, flag);
-        break;
-
-    case RIG_VFO_SUB_C:
-        cachep->freqSubC = freq;
-        elapsed_ms(&cachep->time_freqSubC, flag);
-        break;
-
-    case RIG_VFO_MEM:
-        cachep->freqMem = freq;
-        elapsed_ms(&cachep->time_freqMem, flag);
-        break;
-
-    case RIG_VFO_OTHER:
-        rig_debug(RIG_DEBUG_VERBOSE, "%s(%d): ignoring VFO_OTHER\n", __func__,
-                  __LINE__);
-        break;
-
-    default:
         rig_debug(RIG_DEBUG_WARN, "%s(%d): unknown vfo?, vfo=%s\n", __func__, __LINE__,
                   rig_strvfo(vfo));
         return (-RIG_EINVAL);
     }
 
+    rig_cache_write_begin(cachep);
+
+    if (vfo == rs->current_vfo)
+    {
+        cachep->slot[CACHE_SLOT_CURR].freq = freq;
+        cachep->slot[CACHE_SLOT_CURR].time_freq = now;
+    }
+
+    cachep->slot[slot].freq = freq;
+    cachep->slot[slot].time_freq = now;
+
+    rig_cache_write_end(cachep);
+
     if (rig_need_debug(RIG_DEBUG_CACHE))
     {
         rig_cache_show(rig, __func__, __LINE__);
@@ -287,6 +267,211 @@ int rig_set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq)
     return (RIG_OK);
 }
 
+void rig_set_cache_vfo(RIG *rig, vfo_t vfo)
+{
+    struct rig_cache *cachep = CACHE(rig);
+
+    rig_cache_write_begin(cachep);
+    cachep->vfo = vfo;
+    elapsed_ms(&cachep->time_vfo, HAMLIB_ELAPSED_SET);
+    rig_cache_write_end(cachep);
+}
+
+void rig_set_cache_ptt(RIG *rig, ptt_t ptt)
+{
+    struct rig_cache *cachep = CACHE(rig);
+
+    rig_cache_write_begin(cachep);
+    cachep->ptt = ptt;
+    elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
+    rig_cache_write_end(cachep);
+}
+
+/* PTT of the rig itself, not of a serial line or a GPIO */
+static int cache_ptt_of_rig(RIG *rig)
+{
+    ptt_type_t type = PTTPORT(rig)->type.ptt;
+
+    return rig->caps->get_ptt
+           && (type == RIG_PTT_RIG || type == RIG_PTT_RIG_MICDATA);
+}
+
+/*
+ * Remember what a get_status_bulk reported.  A new mode without a width
+ * is left for rig_get_mode(), the cached width belongs to the old one.
+ */
+void rig_set_cache_status(RIG *rig, const struct rig_status_bulk *status)
+{
+    struct rig_cache *cachep = CACHE(rig);
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    int ms_freq, ms_mode, ms_width;
+
+    if (status->valid & ~HL_ATOMIC_LOAD_RELAXED(&cachep->status_fields))
+    {
+        rig_cache_write_begin(cachep);
+        HL_ATOMIC_STORE_RELAXED(&cachep->status_fields,
+                                cachep->status_fields | status->valid);
+        rig_cache_write_end(cachep);
+    }
+
+    if (status->valid & RIG_STATUS_FREQ)
+    {
+        rig_set_cache_freq(rig, status->vfo, status->freq);
+    }
+
+    if (status->valid & RIG_STATUS_MODE)
+    {
+        rig_get_cache(rig, status->vfo, &freq, &ms_freq, &mode, &ms_mode, &width,
+                      &ms_width);
+
+        if (status->valid & RIG_STATUS_WIDTH)
+        {
+            rig_set_cache_mode(rig, status->vfo, status->mode, status->width);
+        }
+        else if (status->mode == mode)
+        {
+            rig_set_cache_mode(rig, status->vfo, status->mode, 0);
+        }
+    }
+
+    if ((status->valid & RIG_STATUS_PTT) && cache_ptt_of_rig(rig))
+    {
+        rig_set_cache_ptt(rig, status->ptt);
+    }
+
+    if (status->valid & RIG_STATUS_SPLIT)
+    {
+        STATE(rig)->tx_vfo = status->tx_vfo;
+        rig_cache_write_begin(cachep);
+        cachep->split = status->split;
+        cachep->split_vfo = status->tx_vfo;
+        elapsed_ms(&cachep->time_split, HAMLIB_ELAPSED_SET);
+        rig_cache_write_end(cachep);
+    }
+}
+
+/*
+ * RIG_STATUS_* bits of what get_status_bulk can refresh, learned from the
+ * answers: newcat IF never tells PTT or split.  All of them until the
+ * first answer.
+ */
+unsigned int rig_cache_status_fields(RIG *rig)
+{
+    unsigned int fields = HL_ATOMIC_LOAD_RELAXED(&CACHE(rig)->status_fields);
+
+    return fields ? fields : ~0U;
+}
+
+/*
+ * How many of freq, mode, PTT and split of the current VFO are older than
+ * the cache timeout, the ones the rig cannot tell or get_status_bulk does
+ * not fill not counted
+ */
+int rig_cache_stale(RIG *rig)
+{
+    struct rig_cache *cachep = CACHE(rig);
+    const struct rig_caps *caps = rig->caps;
+    unsigned int fields = rig_cache_status_fields(rig);
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    int ms_freq, ms_mode, ms_width;
+    int stale = 0;
+
+    if (cachep->timeout_ms <= 0)
+    {
+        return 0;
+    }
+
+    if (rig_get_cache(rig, RIG_VFO_CURR, &freq, &ms_freq, &mode, &ms_mode, &width,
+                      &ms_width) != RIG_OK)
+    {
+        return 0;
+    }
+
+    stale += (fields & RIG_STATUS_FREQ) && caps->get_freq
+             && ms_freq >= cachep->timeout_ms;
+    stale += (fields & RIG_STATUS_MODE) && caps->get_mode
+             && ms_mode >= cachep->timeout_ms;
+    stale += (fields & RIG_STATUS_PTT) && cache_ptt_of_rig(rig)
+             && elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_GET) >= cachep->timeout_ms;
+    stale += (fields & RIG_STATUS_SPLIT) && caps->get_split_vfo
+             && elapsed_ms(&cachep->time_split, HAMLIB_ELAPSED_GET) >= cachep->timeout_ms;
+
+    return stale;
+}
+
+/*
+ * With two or more of them stale, read the state of the current VFO with
+ * one get_status_bulk, so the getters that follow answer from the cache.
+ * Nothing happens for a backend without get_status_bulk.
+ */
+void rig_cache_refresh_status(RIG *rig)
+{
+    struct rig_status_bulk status;
+
+    if (rig->caps->get_status_bulk == NULL || rig_cache_stale(rig) < 2)
+    {
+        return;
+    }
+
+    memset(&status, 0, sizeof(status));
+    status.vfo = RIG_VFO_CURR;
+    rig_get_status_bulk(rig, &status, 1);
+}
+
+/* even number that moves on with every update of the cache */
+unsigned int rig_cache_generation(RIG *rig)
+{
+    return rig_cache_read_begin(CACHE(rig));
+}
+
+/*
+ * Wait until the cache moves past *generation or timeout_ms passes, and
+ * bring *generation up to date.  Returns 1 when something changed.
+ * Spurious wakeups are not retried, callers look at the cache anyway.
+ */
+int rig_cache_wait(RIG *rig, unsigned int *generation, int timeout_ms)
+{
+    struct rig_cache *cachep = CACHE(rig);
+    struct timespec until;
+    int changed;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += timeout_ms / 1000;
+    until.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+
+    if (until.tv_nsec >= 1000000000L)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&cachep->write_lock);
+
+    if (cachep->seq == *generation && timeout_ms > 0)
+    {
+        pthread_cond_timedwait(&cachep->changed, &cachep->write_lock, &until);
+    }
+
+    changed = cachep->seq != *generation;
+    *generation = cachep->seq;
+    pthread_mutex_unlock(&cachep->write_lock);
+
+    return changed;
+}
+
+/* wake everybody in rig_cache_wait(), e.g. to have a watcher thread quit */
+void rig_cache_notify(RIG *rig)
+{
+    struct rig_cache *cachep = CACHE(rig);
+
+    rig_cache_write_begin(cachep);
+    rig_cache_write_end(cachep);
+}
+
 /**
  * \brief get cached values for a VFO
  * \param rig           The rig handle
@@ -313,6 +498,10 @@ int rig_get_cache(RIG *rig, vfo_t vfo, freq_t *freq, int *cache_ms_freq,
 {
     struct rig_cache *cachep;
     struct rig_state *rs;
+    struct rig_cache_vfo copy;
+    unsigned int seq;
+    double now;
+    int slot;
 
     if (CHECK_RIG_ARG(rig) || !freq || !cache_ms_freq ||
             !mode || !cache_ms_mode || !width || !cache_ms_width)
@@ -403,126 +592,30 @@ int rig_get_cache(RIG *rig, vfo_t vfo, freq_t *freq, int *cache_ms_freq,
     // If we're in satmode we map SUB to SUB_A
     if (vfo == RIG_VFO_SUB && cachep->satmode) { vfo = RIG_VFO_SUB_A; };
 
-    switch (vfo)
-    {
-    case RIG_VFO_CURR:
-        *freq = cachep->freqCurr;
-        *mode = cachep->modeCurr;
-        *width = cachep->widthCurr;
-        *cache_ms_freq = elapsed_ms(&cachep->time_freqCurr,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_mode = elapsed_ms(&cachep->time_modeCurr,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_width = elapsed_ms(&cachep->time_widthCurr,
-                                     HAMLIB_ELAPSED_GET);
-        break;
-
-    case RIG_VFO_OTHER:
-        *freq = cachep->freqOther;
-        *mode = cachep->modeOther;
-        *width = cachep->widthOther;
-        *cache_ms_freq = elapsed_ms(&cachep->time_freqOther,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_mode = elapsed_ms(&cachep->time_modeOther,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_width = elapsed_ms(&cachep->time_widthOther,
-                                     HAMLIB_ELAPSED_GET);
-        break;
-
-    case RIG_VFO_A:
-    case RIG_VFO_VFO:
-    case RIG_VFO_MAIN:
-    case RIG_VFO_MAIN_A:
-        *freq = cachep->freqMainA;
-        *mode = cachep->modeMainA;
-        *width = cachep->widthMainA;
-        *cache_ms_freq = elapsed_ms(&cachep->time_freqMainA,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_mode = elapsed_ms(&cachep->time_modeMainA,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_width = elapsed_ms(&cachep->time_widthMainA,
-                                     HAMLIB_ELAPSED_GET);
-        break;
-
-    case RIG_VFO_B:
-    case RIG_VFO_SUB:
-    case RIG_VFO_MAIN_B:
-        *freq = cachep->freqMainB;
-        *mode = cachep->modeMainB;
-        *width = cachep->widthMainB;
-        *cache_ms_freq = elapsed_ms(&cachep->time_freqMainB,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_mode = elapsed_ms(&cachep->time_modeMainB,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_width = elapsed_ms(&cachep->time_widthMainB,
-                                     HAMLIB_ELAPSED_GET);
-        break;
-
-    case RIG_VFO_SUB_A:
-        *freq = cachep->freqSubA;
-        *mode = cachep->modeSubA;
-        *width = cachep->widthSubA;
-        *cache_ms_freq = elapsed_ms(&cachep->time_freqSubA,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_mode = elapsed_ms(&cachep->time_modeSubA,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_width = elapsed_ms(&cachep->time_widthSubA,
-                                     HAMLIB_ELAPSED_GET);
-        break;
-
-    case RIG_VFO_SUB_B:
-        *freq = cachep->freqSubB;
-        *mode = cachep->modeSubB;
-        *width = cachep->widthSubB;
-        *cache_ms_freq = elapsed_ms(&cachep->time_freqSubB,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_mode = elapsed_ms(&cachep->time_modeSubB,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_width = elapsed_ms(&cachep->time_widthSubB,
-                                     HAMLIB_ELAPSED_GET);
-        break;
-
-    case RIG_VFO_C:
-        //case RIG_VFO_MAINC: // not used by any rig yet
-        *freq = cachep->freqMainC;
-        *mode = cachep->modeMainC;
-        *width = cachep->widthMainC;
-        *cache_ms_freq = elapsed_ms(&cachep->time_freqMainC,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_mode = elapsed_ms(&cachep->time_modeMainC,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_width = elapsed_ms(&cachep->time_widthMainC,
-                                     HAMLIB_ELAPSED_GET);
-        break;
-
-    case RIG_VFO_SUB_C:
-        *freq = cachep->freqSubC;
-        *mode = cachep->modeSubC;
-        *width = cachep->widthSubC;
-        *cache_ms_freq = elapsed_ms(&cachep->time_freqSubC,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_mode = elapsed_ms(&cachep->time_modeSubC,
-                                    HAMLIB_ELAPSED_GET);
-        *cache_ms_width = elapsed_ms(&cachep->time_widthSubC,
-                                     HAMLIB_ELAPSED_GET);
-        break;
-
-    case RIG_VFO_MEM:
-        *freq = cachep->freqMem;
-        *mode = cachep->modeMem;
-        *width = cachep->widthMem;
-        *cache_ms_freq = elapsed_ms(&cachep->time_freqMem, HAMLIB_ELAPSED_GET);
-        *cache_ms_mode = elapsed_ms(&cachep->time_modeMem, HAMLIB_ELAPSED_GET);
-        *cache_ms_width = elapsed_ms(&cachep->time_widthMem,
-                                     HAMLIB_ELAPSED_GET);
-        break;
-
-    default:
+    slot = rig_cache_slot(cachep, vfo);
+
+    if (slot < 0)
+    {
         rig_debug(RIG_DEBUG_WARN, "%s(%d): unknown vfo?, vfo=%s\n", __func__, __LINE__,
                   rig_strvfo(vfo));
         RETURNFUNC2(-RIG_EINVAL);
     }
 
+    do
+    {
+        seq = rig_cache_read_begin(cachep);
+        copy = cachep->slot[slot];
+    }
+    while (rig_cache_read_retry(cachep, seq));
+
+    now = monotonic_seconds();
+    *freq = copy.freq;
+    *mode = copy.mode;
+    *width = copy.width;
+    *cache_ms_freq = cache_age_ms(copy.time_freq, now);
+    *cache_ms_mode = cache_age_ms(copy.time_mode, now);
+    *cache_ms_width = *cache_ms_mode;
+
     rig_debug(RIG_DEBUG_CACHE, "%s(%d): vfo=%s, freq=%.0f, mode=%s, width=%d\n",
               __func__, __LINE__, rig_strvfo(vfo),
               (double)*freq, rig_strrmode(*mode), (int)*width);
@@ -569,49 +662,371 @@ int rig_get_cache_freq(RIG *rig, vfo_t vfo, freq_t *freq, int *cache_ms_freq_p)
     return retval;
 }
 
+/* setting cache kind for a selection, -1 for the VFO cache */
+static int cache_selection_kind(hamlib_cache_t selection)
+{
+    switch (selection)
+    {
+    case HAMLIB_CACHE_LEVEL: return CACHE_KIND_LEVEL;
+
+    case HAMLIB_CACHE_METER: return CACHE_KIND_METER;
+
+    case HAMLIB_CACHE_FUNC: return CACHE_KIND_FUNC;
+
+    case HAMLIB_CACHE_PARM: return CACHE_KIND_PARM;
+
+    default: return -1;
+    }
+}
+
 /* Get cache timeout period
  * Returns value in msec, -1 if error
  */
 int HAMLIB_API rig_get_cache_timeout_ms(RIG *rig, hamlib_cache_t selection)
 {
+    int kind = cache_selection_kind(selection);
+
     rig_debug(RIG_DEBUG_TRACE, "%s: called selection=%d\n", __func__, selection);
     if (!rig) {return -1;}
+    if (kind >= 0) { return CACHE(rig)->settings_timeout_ms[kind]; }
     return CACHE(rig)->timeout_ms;
 }
 
+/* Set cache timeout period
+ * HAMLIB_CACHE_LEVEL, _METER, _FUNC and _PARM set the timeout of that
+ * class of settings, any other selection the one of freq, mode, ptt...
+ */
 int HAMLIB_API rig_set_cache_timeout_ms(RIG *rig, hamlib_cache_t selection,
                                         int ms)
 {
+    int kind = cache_selection_kind(selection);
+
     rig_debug(RIG_DEBUG_TRACE, "%s: called selection=%d, ms=%d\n", __func__,
               selection, ms);
     if (!rig) {return -RIG_EINVAL;}
+    if (kind >= 0)
+    {
+        CACHE(rig)->settings_timeout_ms[kind] = ms;
+        if (ms == 0) { rig_cache_invalidate_setting(rig, kind, 0); }
+        return RIG_OK;
+    }
     CACHE(rig)->timeout_ms = ms;
     return RIG_OK;
 }
 
-void rig_cache_show(RIG *rig, const char *func, int line)
+static int cache_setting_kind(int kind, setting_t setting)
+{
+    if (kind == CACHE_KIND_LEVEL && (setting & RIG_LEVEL_READONLY_LIST))
+    {
+        return CACHE_KIND_METER;
+    }
+
+    return kind;
+}
+
+/* slot a setting is kept under, -1 if it can't be cached */
+static int cache_setting_slot(RIG *rig, int kind, vfo_t vfo)
+{
+    if (kind == CACHE_KIND_PARM)
+    {
+        return CACHE_SLOTS;
+    }
+
+    if (vfo == RIG_VFO_CURR || vfo == RIG_VFO_NONE)
+    {
+        vfo = STATE(rig)->current_vfo;
+    }
+
+    return rig_cache_slot(CACHE(rig), vfo);
+}
+
+static struct rig_cache_setting *cache_setting_find(struct rig_cache *cachep,
+        int kind, int slot, setting_t setting)
+{
+    int i;
+
+    for (i = 0; i < CACHE_SETTINGS; i++)
+    {
+        struct rig_cache_setting *e = &cachep->settings[i];
+
+        if (e->setting == setting && e->kind == kind && e->slot == slot)
+        {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief look up a level, func or parm in the cache
+ * \param rig     The rig handle
+ * \param kind    CACHE_KIND_LEVEL, CACHE_KIND_FUNC or CACHE_KIND_PARM
+ * \param vfo     The VFO, ignored for parms
+ * \param setting A single level, func or parm
+ * \param val     The cached value is stored here, val.i for funcs
+ *
+ * \return RIG_OK on a hit younger than the timeout of its class,
+ * -RIG_ENAVAIL otherwise
+ */
+int rig_get_cache_setting(RIG *rig, int kind, vfo_t vfo, setting_t setting,
+                          value_t *val)
 {
     struct rig_cache *cachep = CACHE(rig);
+    const struct rig_cache_setting *e;
+    int timeout_ms, slot, retval = -RIG_ENAVAIL;
+
+    kind = cache_setting_kind(kind, setting);
+    timeout_ms = cachep->settings_timeout_ms[kind];
+
+    if (timeout_ms == 0 || (slot = cache_setting_slot(rig, kind, vfo)) < 0)
+    {
+        return -RIG_ENAVAIL;
+    }
+
+    pthread_mutex_lock(&cachep->write_lock);
+
+    e = cache_setting_find(cachep, kind, slot, setting);
+
+    if (e && (timeout_ms == HAMLIB_CACHE_ALWAYS
+              || cache_age_ms(e->time, monotonic_seconds()) < timeout_ms))
+    {
+        *val = e->val;
+        cachep->settings_hits[kind]++;
+        retval = RIG_OK;
+    }
+    else
+    {
+        cachep->settings_misses[kind]++;
+    }
+
+    pthread_mutex_unlock(&cachep->write_lock);
+
+    return retval;
+}
+
+/**
+ * \brief last known value of a level, func or parm, however old
+ *
+ * Unlike rig_get_cache_setting() this neither looks at the timeout nor
+ * counts as a hit or a miss, for watchers that report changes.
+ *
+ * \return RIG_OK when the cache holds a value, -RIG_ENAVAIL otherwise
+ */
+int rig_cache_peek_setting(RIG *rig, int kind, vfo_t vfo, setting_t setting,
+                           value_t *val)
+{
+    struct rig_cache *cachep = CACHE(rig);
+    const struct rig_cache_setting *e;
+    int slot, retval = -RIG_ENAVAIL;
+
+    kind = cache_setting_kind(kind, setting);
+
+    if ((slot = cache_setting_slot(rig, kind, vfo)) < 0)
+    {
+        return -RIG_ENAVAIL;
+    }
+
+    pthread_mutex_lock(&cachep->write_lock);
+
+    e = cache_setting_find(cachep, kind, slot, setting);
+
+    if (e)
+    {
+        *val = e->val;
+        retval = RIG_OK;
+    }
+
+    pthread_mutex_unlock(&cachep->write_lock);
+
+    return retval;
+}
+
+/**
+ * \brief where the setting cache stands, to pass to rig_set_cache_setting()
+ *
+ * Taken before asking the rig, so a value read while a set of the same
+ * setting was going on is not kept.
+ */
+unsigned int rig_cache_settings_epoch(RIG *rig)
+{
+    struct rig_cache *cachep = CACHE(rig);
+    unsigned int epoch;
+
+    pthread_mutex_lock(&cachep->write_lock);
+    epoch = cachep->settings_epoch;
+    pthread_mutex_unlock(&cachep->write_lock);
+
+    return epoch;
+}
+
+/**
+ * \brief remember a level, func or parm the rig reported
+ * \param epoch rig_cache_settings_epoch() from before the rig was asked
+ *
+ * Nothing is kept for a class with a timeout of 0 or string parms, nor
+ * when settings were forgotten since epoch.  The oldest entry goes when
+ * the cache is full.
+ */
+void rig_set_cache_setting(RIG *rig, int kind, vfo_t vfo, setting_t setting,
+                           value_t val, unsigned int epoch)
+{
+    struct rig_cache *cachep = CACHE(rig);
+    struct rig_cache_setting *e;
+    int slot, i;
+
+    kind = cache_setting_kind(kind, setting);
+
+    if (cachep->settings_timeout_ms[kind] == 0
+            || (kind == CACHE_KIND_PARM && RIG_PARM_IS_STRING(setting))
+            || (slot = cache_setting_slot(rig, kind, vfo)) < 0)
+    {
+        return;
+    }
+
+    // an update like any other for rig_cache_wait()
+    rig_cache_write_begin(cachep);
+
+    if (cachep->settings_epoch != epoch)
+    {
+        // a set may have changed it after the rig was read
+        rig_cache_write_end(cachep);
+        return;
+    }
+
+    e = cache_setting_find(cachep, kind, slot, setting);
+
+    for (i = 0; e == NULL && i < CACHE_SETTINGS; i++)
+    {
+        if (cachep->settings[i].setting == 0) { e = &cachep->settings[i]; }
+    }
+
+    if (e == NULL)
+    {
+        e = &cachep->settings[0];
+
+        for (i = 1; i < CACHE_SETTINGS; i++)
+        {
+            if (cachep->settings[i].time < e->time) { e = &cachep->settings[i]; }
+        }
+    }
+
+    e->setting = setting;
+    e->kind = kind;
+    e->slot = slot;
+    e->val = val;
+    e->time = monotonic_seconds();
+
+    rig_cache_write_end(cachep);
+}
+
+/**
+ * \brief forget a level, func or parm on every VFO
+ * \param setting The setting, 0 forgets all of the kind
+ *
+ * Setters call this both before and after changing the setting, so a get
+ * that overlaps the set never keeps what it read.
+ */
+void rig_cache_invalidate_setting(RIG *rig, int kind, setting_t setting)
+{
+    struct rig_cache *cachep = CACHE(rig);
+    int i;
+
+    kind = cache_setting_kind(kind, setting);
+
+    pthread_mutex_lock(&cachep->write_lock);
+
+    for (i = 0; i < CACHE_SETTINGS; i++)
+    {
+        struct rig_cache_setting *e = &cachep->settings[i];
+
+        if (e->kind == kind && (setting == 0 || e->setting == setting))
+        {
+            e->setting = 0;
+        }
+    }
+
+    cachep->settings_epoch++;
+    pthread_mutex_unlock(&cachep->write_lock);
+}
+
+/*
+ * Hits and misses of the setting cache per class, then of the other values
+ *   "level hits=12 misses=3 meter hits=0 misses=40 func ... parm ...
+ *    freq hits=320 misses=41 mode ... vfo ... ptt ... split ..."
+ */
+int rig_cache_stats(RIG *rig, char *buf, size_t len)
+{
+    static const char *names[CACHE_KINDS] = { "level", "meter", "func", "parm" };
+    static const char *items[CACHE_ITEMS] = { "freq", "mode", "vfo", "ptt", "split" };
+    struct rig_cache *cachep = CACHE(rig);
+    int i, n = 0;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    buf[0] = '\0';
+
+    pthread_mutex_lock(&cachep->write_lock);
+
+    for (i = 0; i < CACHE_KINDS && n >= 0 && n < (int) len; i++)
+    {
+        n += snprintf(buf + n, len - n, "%s%s hits=%lu misses=%lu", i ? " " : "",
+                      names[i], cachep->settings_hits[i], cachep->settings_misses[i]);
+    }
+
+    pthread_mutex_unlock(&cachep->write_lock);
+
+    for (i = 0; i < CACHE_ITEMS && n >= 0 && n < (int) len; i++)
+    {
+        n += snprintf(buf + n, len - n, " %s hits=%lu misses=%lu", items[i],
+                      (unsigned long) HL_ATOMIC_LOAD_RELAXED(&cachep->item_hits[i]),
+                      (unsigned long) HL_ATOMIC_LOAD_RELAXED(&cachep->item_misses[i]));
+    }
+
+    return n;
+}
+
+void rig_cache_reset_stats(RIG *rig)
+{
+    struct rig_cache *cachep = CACHE(rig);
+
+    pthread_mutex_lock(&cachep->write_lock);
+    memset(cachep->settings_hits, 0, sizeof(cachep->settings_hits));
+    memset(cachep->settings_misses, 0, sizeof(cachep->settings_misses));
+    memset(cachep->item_hits, 0, sizeof(cachep->item_hits));
+    memset(cachep->item_misses, 0, sizeof(cachep->item_misses));
+    pthread_mutex_unlock(&cachep->write_lock);
+}
+
+static void cache_show_slot(const struct rig_cache *cachep, int i,
+                            const char *func, int line)
+{
+    static const char *names[CACHE_SLOTS] =
+    {
+        "Curr", "Other", "MainA", "MainB", "MainC", "SubA", "SubB", "SubC", "Mem"
+    };
+    const struct rig_cache_vfo *slot = &cachep->slot[i];
 
     rig_debug(RIG_DEBUG_CACHE,
-              "%s(%d): freqMainA=%.0f, modeMainA=%s, widthMainA=%d\n", func, line,
-              cachep->freqMainA, rig_strrmode(cachep->modeMainA),
-              (int)cachep->widthMainA);
-    rig_debug(RIG_DEBUG_CACHE,
-              "%s(%d): freqMainB=%.0f, modeMainB=%s, widthMainB=%d\n", func, line,
-              cachep->freqMainB, rig_strrmode(cachep->modeMainB),
-              (int)cachep->widthMainB);
+              "%s(%d): freq%s=%.0f, mode%s=%s, width%s=%d\n", func, line,
+              names[i], slot->freq, names[i], rig_strrmode(slot->mode),
+              names[i], (int)slot->width);
+}
+
+void rig_cache_show(RIG *rig, const char *func, int line)
+{
+    struct rig_cache *cachep = CACHE(rig);
+
+    cache_show_slot(cachep, CACHE_SLOT_MAIN_A, func, line);
+    cache_show_slot(cachep, CACHE_SLOT_MAIN_B, func, line);
 
     if (STATE(rig)->vfo_list & RIG_VFO_SUB_A)
     {
-        rig_debug(RIG_DEBUG_CACHE,
-                  "%s(%d): freqSubA=%.0f, modeSubA=%s, widthSubA=%d\n", func, line,
-                  cachep->freqSubA, rig_strrmode(cachep->modeSubA),
-                  (int)cachep->widthSubA);
-        rig_debug(RIG_DEBUG_CACHE,
-                  "%s(%d): freqSubB=%.0f, modeSubB=%s, widthSubB=%d\n", func, line,
-                  cachep->freqSubB, rig_strrmode(cachep->modeSubB),
-                  (int)cachep->widthSubB);
+        cache_show_slot(cachep, CACHE_SLOT_SUB_A, func, line);
+        cache_show_slot(cachep, CACHE_SLOT_SUB_B, func, line);
     }
 }
 
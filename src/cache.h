@@ -24,7 +24,10 @@
 #ifndef _CACHE_H
 #define _CACHE_H
 
+#include <pthread.h>
+
 #include "hamlib/rig.h"
+#include "hl_atomic.h"
 
 __BEGIN_DECLS
 
@@ -36,6 +39,78 @@ __BEGIN_DECLS
  *      - n3gb 2025-05-14
  */
 
+/* Slots of the per VFO cache, see rig_cache_slot()
+ * Main is the Main VFO and Sub is for the 2nd VFO
+ * Most rigs have MainA and MainB
+ * Dual VFO rigs can have SubA and SubB too
+ */
+enum rig_cache_slot_e
+{
+    CACHE_SLOT_CURR,    // VFO_CURR
+    CACHE_SLOT_OTHER,   // VFO_OTHER
+    CACHE_SLOT_MAIN_A,  // VFO_A, VFO_VFO, VFO_MAIN, and VFO_MAIN_A
+    CACHE_SLOT_MAIN_B,  // VFO_B, VFO_SUB, and VFO_MAIN_B
+    CACHE_SLOT_MAIN_C,  // VFO_C, VFO_MAIN_C
+    CACHE_SLOT_SUB_A,   // VFO_SUB_A -- only for rigs with dual Sub VFOs
+    CACHE_SLOT_SUB_B,   // VFO_SUB_B -- only for rigs with dual Sub VFOs
+    CACHE_SLOT_SUB_C,   // VFO_SUB_C -- only for rigs with 3 Sub VFOs
+    CACHE_SLOT_MEM,     // VFO_MEM -- last MEM channel
+    CACHE_SLOTS
+};
+
+/**
+ * \brief Cached state of one VFO
+ *
+ * Times are monotonic_seconds() of the last update, 0 when never set or
+ * invalidated.  Mode and width are always set together.
+ */
+struct rig_cache_vfo {
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;  // if non-zero then rig has separate width for this VFO
+    double time_freq;
+    double time_mode;
+};
+
+/* Classes of settings with their own cache timeout
+ * Callers pass CACHE_KIND_LEVEL for any level, meters are told apart here
+ */
+enum rig_cache_kind_e
+{
+    CACHE_KIND_LEVEL,   // levels that only change when set, AGC, PREAMP, RFPOWER...
+    CACHE_KIND_METER,   // RIG_LEVEL_READONLY_LIST, STRENGTH, SWR, ALC...
+    CACHE_KIND_FUNC,
+    CACHE_KIND_PARM,
+    CACHE_KINDS
+};
+
+#define CACHE_SETTINGS 64   // levels, funcs and parms remembered at once
+
+/* Values rig_get_*() answers from the cache, counted in rig_cache_stats() */
+enum rig_cache_item_e
+{
+    CACHE_ITEM_FREQ,
+    CACHE_ITEM_MODE,
+    CACHE_ITEM_VFO,
+    CACHE_ITEM_PTT,
+    CACHE_ITEM_SPLIT,
+    CACHE_ITEMS
+};
+
+/**
+ * \brief Cached value of a level, func or parm
+ *
+ * Entries are keyed by kind, setting and VFO slot, CACHE_SLOTS for parms.
+ * A setting of 0 marks a free entry.
+ */
+struct rig_cache_setting {
+    setting_t setting;
+    int kind;
+    int slot;
+    value_t val;
+    double time;
+};
+
 /**
  * \brief Rig cache data
  *
@@ -45,86 +120,131 @@ __BEGIN_DECLS
 struct rig_cache {
     int timeout_ms;  // the cache timeout for invalidating itself
     vfo_t vfo;
-    //freq_t freq; // to be deprecated in 4.1 when full Main/Sub/A/B caching is implemented in 4.1
     // other abstraction here is based on dual vfo rigs and mapped to all others
-    // So we have four possible states of rig
-    // MainA, MainB, SubA, SubB
-    // Main is the Main VFO and Sub is for the 2nd VFO
-    // Most rigs have MainA and MainB
-    // Dual VFO rigs can have SubA and SubB too
     // For dual VFO rigs simplex operations are all done on MainA/MainB -- ergo this abstraction
-    freq_t freqCurr; // Other VFO
-    freq_t freqOther; // Other VFO
-    freq_t freqMainA; // VFO_A, VFO_MAIN, and VFO_MAINA
-    freq_t freqMainB; // VFO_B, VFO_SUB, and VFO_MAINB
-    freq_t freqMainC; // VFO_C, VFO_MAINC
-    freq_t freqSubA;  // VFO_SUBA -- only for rigs with dual Sub VFOs
-    freq_t freqSubB;  // VFO_SUBB -- only for rigs with dual Sub VFOs
-    freq_t freqSubC;  // VFO_SUBC -- only for rigs with 3 Sub VFOs
-    freq_t freqMem;   // VFO_MEM -- last MEM channel
-    rmode_t modeCurr;
-    rmode_t modeOther;
-    rmode_t modeMainA;
-    rmode_t modeMainB;
-    rmode_t modeMainC;
-    rmode_t modeSubA;
-    rmode_t modeSubB;
-    rmode_t modeSubC;
-    rmode_t modeMem;
-    pbwidth_t widthCurr; // if non-zero then rig has separate width for MainA
-    pbwidth_t widthOther; // if non-zero then rig has separate width for MainA
-    pbwidth_t widthMainA; // if non-zero then rig has separate width for MainA
-    pbwidth_t widthMainB; // if non-zero then rig has separate width for MainB
-    pbwidth_t widthMainC; // if non-zero then rig has separate width for MainC
-    pbwidth_t widthSubA;  // if non-zero then rig has separate width for SubA
-    pbwidth_t widthSubB;  // if non-zero then rig has separate width for SubB
-    pbwidth_t widthSubC;  // if non-zero then rig has separate width for SubC
-    pbwidth_t widthMem;  // if non-zero then rig has separate width for Mem
+    struct rig_cache_vfo slot[CACHE_SLOTS];
+    signed char vfo_slot[32];  // slot of each single bit vfo_t, -1 if none
     ptt_t ptt;
     split_t split;
     vfo_t split_vfo;  // split caches two values
-    struct timespec time_freqCurr;
-    struct timespec time_freqOther;
-    struct timespec time_freqMainA;
-    struct timespec time_freqMainB;
-    struct timespec time_freqMainC;
-    struct timespec time_freqSubA;
-    struct timespec time_freqSubB;
-    struct timespec time_freqSubC;
-    struct timespec time_freqMem;
     struct timespec time_vfo;
-    struct timespec time_modeCurr;
-    struct timespec time_modeOther;
-    struct timespec time_modeMainA;
-    struct timespec time_modeMainB;
-    struct timespec time_modeMainC;
-    struct timespec time_modeSubA;
-    struct timespec time_modeSubB;
-    struct timespec time_modeSubC;
-    struct timespec time_modeMem;
-    struct timespec time_widthCurr;
-    struct timespec time_widthOther;
-    struct timespec time_widthMainA;
-    struct timespec time_widthMainB;
-    struct timespec time_widthMainC;
-    struct timespec time_widthSubA;
-    struct timespec time_widthSubB;
-    struct timespec time_widthSubC;
-    struct timespec time_widthMem;
     struct timespec time_ptt;
     struct timespec time_split;
     int satmode; // if rig is in satellite mode
+    struct rig_cache_setting settings[CACHE_SETTINGS];  // under write_lock
+    unsigned int settings_epoch;  // moves on when settings are forgotten, under write_lock
+    int settings_timeout_ms[CACHE_KINDS];  // 0 does not cache the kind
+    unsigned long settings_hits[CACHE_KINDS];
+    unsigned long settings_misses[CACHE_KINDS];
+    unsigned long item_hits[CACHE_ITEMS];  // see rig_cache_count()
+    unsigned long item_misses[CACHE_ITEMS];
+    unsigned int status_fields;  // RIG_STATUS_* get_status_bulk ever filled, under write_lock
+    unsigned int seq;  // odd while a writer is updating, see rig_cache_write_begin()
+    pthread_mutex_t write_lock;  // writers come one at a time
+    pthread_cond_t changed;  // broadcast on every update, see rig_cache_wait()
 };
 
 /* Access macros */
 #define CACHE(r) ((r)->cache_addr)
 //#define HAMLIB_CACHE(r) ((struct rig_cache *)rig_data_pointer(r, RIG_PTRX_CACHE))
 
+/* slot index for vfo, -1 for none or a vfo_t with several bits set */
+static inline int rig_cache_slot(const struct rig_cache *cachep, vfo_t vfo)
+{
+    if (vfo == 0 || (vfo & (vfo - 1)) != 0)
+    {
+        return -1;
+    }
+
+    return cachep->vfo_slot[hl_ctz(vfo)];
+}
+
+/*
+ * Sequence lock for the cache
+ *
+ * Readers never block on a writer, which may be the thread holding the rig
+ * for a serial transaction.  They copy what they need and start over when
+ * seq moved meanwhile, so freq, mode, width and their timestamps always come
+ * from one consistent update.
+ *
+ *    do
+ *    {
+ *        seq = rig_cache_read_begin(cachep);
+ *        ...copy fields...
+ *    }
+ *    while (rig_cache_read_retry(cachep, seq));
+ *
+ * Writers bracket their updates with rig_cache_write_begin()/_end() and must
+ * not do I/O or call elapsed_ms() GET in between.
+ *
+ * seq also serves as the generation of the cache: every finished update
+ * moves it by two and wakes the threads in rig_cache_wait().
+ */
+static inline void rig_cache_write_begin(struct rig_cache *cachep)
+{
+    pthread_mutex_lock(&cachep->write_lock);
+    HL_ATOMIC_STORE_RELAXED(&cachep->seq, cachep->seq + 1);
+    HL_FENCE_RELEASE();
+}
+
+static inline void rig_cache_write_end(struct rig_cache *cachep)
+{
+    HL_ATOMIC_STORE(&cachep->seq, cachep->seq + 1);
+    pthread_cond_broadcast(&cachep->changed);
+    pthread_mutex_unlock(&cachep->write_lock);
+}
+
+static inline unsigned int rig_cache_read_begin(const struct rig_cache *cachep)
+{
+    unsigned int seq;
+
+    while ((seq = HL_ATOMIC_LOAD(&cachep->seq)) & 1)
+    {
+        hl_yield();
+    }
+
+    return seq;
+}
+
+static inline int rig_cache_read_retry(const struct rig_cache *cachep,
+                                       unsigned int seq)
+{
+    HL_FENCE_ACQUIRE();
+    return HL_ATOMIC_LOAD_RELAXED(&cachep->seq) != seq;
+}
+
+/* Count a lookup of a CACHE_ITEM_*, callers hold no lock */
+static inline void rig_cache_count(struct rig_cache *cachep, int item, int hit)
+{
+    HL_ATOMIC_ADD(hit ? &cachep->item_hits[item] : &cachep->item_misses[item], 1);
+}
+
 /* Function templates
  * Does not include those marked as part of HAMLIB_API
  */
+void rig_cache_init(RIG *rig);
+void rig_cache_reset(RIG *rig);
 int rig_set_cache_mode(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width);
 int rig_set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq);
+void rig_set_cache_vfo(RIG *rig, vfo_t vfo);
+void rig_set_cache_ptt(RIG *rig, ptt_t ptt);
+void rig_set_cache_status(RIG *rig, const struct rig_status_bulk *status);
+unsigned int rig_cache_status_fields(RIG *rig);
+int rig_cache_stale(RIG *rig);
+void rig_cache_refresh_status(RIG *rig);
+unsigned int rig_cache_generation(RIG *rig);
+int rig_cache_wait(RIG *rig, unsigned int *generation, int timeout_ms);
+void rig_cache_notify(RIG *rig);
+int rig_get_cache_setting(RIG *rig, int kind, vfo_t vfo, setting_t setting,
+                          value_t *val);
+int rig_cache_peek_setting(RIG *rig, int kind, vfo_t vfo, setting_t setting,
+                           value_t *val);
+unsigned int rig_cache_settings_epoch(RIG *rig);
+void rig_set_cache_setting(RIG *rig, int kind, vfo_t vfo, setting_t setting,
+                           value_t val, unsigned int epoch);
+void rig_cache_invalidate_setting(RIG *rig, int kind, setting_t setting);
+int rig_cache_stats(RIG *rig, char *buf, size_t len);
+void rig_cache_reset_stats(RIG *rig);
 void rig_cache_show(RIG *rig, const char *func, int line);
 
 __END_DECLS
@@ -41,6 +41,9 @@
 #include "hamlib/port.h"
 #include "hamlib/rig_state.h"
 #include "token.h"
+#include "iofunc.h"
+#include "cache.h"
+#include "event.h"
 
 
 /*
@@ -58,11 +61,21 @@ static const struct confparams frontend_cfg_params[] =
         "Delay in ms between each byte sent out",
         "0", RIG_CONF_NUMERIC, { .n = { 0, 1000, 1 } }
     },
+    {
+        TOK_WRITE_QUEUE, "write_queue", "Write queue",
+        "True sends write_delay paced commands from a background thread so the caller does not wait",
+        "0", RIG_CONF_CHECKBUTTON, { 0 }
+    },
     {
         TOK_POST_WRITE_DELAY, "post_write_delay", "Post write delay",
         "Delay in ms between each command sent out",
         "0", RIG_CONF_NUMERIC, { .n = { 0, 1000, 1 } }
     },
+    {
+        TOK_POST_WRITE_DEFERRED, "post_write_deferred", "Deferred post write delay",
+        "True applies post_write_delay as a minimum gap before the next command instead of sleeping after each one",
+        "0", RIG_CONF_CHECKBUTTON, { 0 }
+    },
     {
         TOK_POST_PTT_DELAY, "post_ptt_delay", "Post ptt delay",
         "Delay in ms after PTT is asserted",
@@ -72,6 +85,21 @@ static const struct confparams frontend_cfg_params[] =
         TOK_TIMEOUT, "timeout", "Timeout", "Timeout in ms",
         "0", RIG_CONF_NUMERIC, { .n = { 0, 10000, 1 } }
     },
+    {
+        TOK_ADAPTIVE_TIMEOUT, "adaptive_timeout", "Adaptive timeout",
+        "N>0 waits N times the 99th percentile of the observed reply time of each command class, at most timeout; 0 always waits timeout",
+        "0", RIG_CONF_NUMERIC, { .n = { 0, 20, 1 } }
+    },
+    {
+        TOK_TIMEOUT_LEARNED, "timeout_learned", "Learned timeouts",
+        "Reply times in ms and timeouts per command class learned by adaptive_timeout, setting it forgets them",
+        "", RIG_CONF_STRING,
+    },
+    {
+        TOK_PORT_STATS, "port_stats", "Port statistics",
+        "Bytes sent and received, reply timeouts, retries and async frames, setting it zeroes them",
+        "", RIG_CONF_STRING,
+    },
     {
         TOK_RETRY, "retry", "Retry", "Max number of retry",
         "0", RIG_CONF_NUMERIC, { .n = { 0, 10, 1 } }
@@ -96,6 +124,21 @@ static const struct confparams frontend_cfg_params[] =
         "User-specified device ID for multicast state data and commands",
         "", RIG_CONF_STRING,
     },
+    {
+        TOK_CAPTURE_FILE, "capture_file", "Capture file",
+        "File to record all rig port traffic to, with timestamps, for later replay",
+        "", RIG_CONF_STRING,
+    },
+    {
+        TOK_REPLAY_FILE, "replay_file", "Replay file",
+        "Capture file to play back to the backend instead of opening rig_pathname",
+        "", RIG_CONF_STRING,
+    },
+    {
+        TOK_REPLAY_SPEED, "replay_speed", "Replay speed",
+        "Replay speed relative to the capture, 0 answers without any delay",
+        "1", RIG_CONF_NUMERIC, { .n = { 0, 1000, 0.1 } }
+    },
 
     {
         TOK_VFO_COMP, "vfo_comp", "VFO compensation",
@@ -107,6 +150,21 @@ static const struct confparams frontend_cfg_params[] =
         "Polling interval in ms for transceive emulation, defaults to 1000, value of 0 disables polling",
         "1000", RIG_CONF_NUMERIC, { .n = { 0, 1000000, 1 } }
     },
+    {
+        TOK_POLL_REFRESH, "poll_refresh", "Poll routine refreshes the cache",
+        "True makes the poll routine read freq, mode, ptt, split and the cached levels from the rig, each at its own rate",
+        "0", RIG_CONF_CHECKBUTTON, { 0 }
+    },
+    {
+        TOK_POLL_BUDGET, "poll_budget", "Poll bandwidth budget in percent",
+        "Percent of the bytes per second of a serial port the poll refreshes may use, slower rates are stretched to fit. Other ports have no budget",
+        "50", RIG_CONF_NUMERIC, { .n = { 1, 100, 1 } }
+    },
+    {
+        TOK_POLL_STATS, "poll_stats", "Poll statistics",
+        "Refreshes and bytes of the poll routine, its budget and demand in bytes/s and the stretch of its rates",
+        "", RIG_CONF_STRING,
+    },
     {
         TOK_PTT_TYPE, "ptt_type", "PTT type",
         "Push-To-Talk interface type override",
@@ -142,6 +200,46 @@ static const struct confparams frontend_cfg_params[] =
         "Cache timeout, value of 0 disables caching",
         "500", RIG_CONF_NUMERIC, { .n = {0, 5000, 1}}
     },
+    {
+        TOK_CACHE_TIMEOUT_LEVEL, "cache_timeout_level", "Level cache timeout in ms",
+        "Cache timeout of levels other than meters, value of 0 disables caching them",
+        "0", RIG_CONF_NUMERIC, { .n = {0, 60000, 1}}
+    },
+    {
+        TOK_CACHE_TIMEOUT_METER, "cache_timeout_meter", "Meter cache timeout in ms",
+        "Cache timeout of meter levels like STRENGTH and SWR, value of 0 disables caching them",
+        "0", RIG_CONF_NUMERIC, { .n = {0, 5000, 1}}
+    },
+    {
+        TOK_CACHE_TIMEOUT_FUNC, "cache_timeout_func", "Func cache timeout in ms",
+        "Cache timeout of funcs, value of 0 disables caching them",
+        "0", RIG_CONF_NUMERIC, { .n = {0, 60000, 1}}
+    },
+    {
+        TOK_CACHE_TIMEOUT_PARM, "cache_timeout_parm", "Parm cache timeout in ms",
+        "Cache timeout of parms, value of 0 disables caching them",
+        "0", RIG_CONF_NUMERIC, { .n = {0, 60000, 1}}
+    },
+    {
+        TOK_CACHE_STATS, "cache_stats", "Cache statistics",
+        "Hits and misses of the level, meter, func and parm caches and of freq, mode, vfo, ptt and split, setting it clears them",
+        "", RIG_CONF_STRING,
+    },
+    {
+        TOK_EVENT_QUEUE, "event_queue", "Event queue length",
+        "Events waiting for a thread that calls the event callbacks, value of 0 calls them from the thread that found the change",
+        "0", RIG_CONF_NUMERIC, { .n = {0, 4096, 1}}
+    },
+    {
+        TOK_EVENT_OVERFLOW, "event_overflow", "Event queue overflow",
+        "What a full event queue does with a new event: replace the queued one of the same kind and VFO, or drop the oldest",
+        "coalesce", RIG_CONF_COMBO, { .c = {{ "coalesce", "drop_oldest", NULL }} }
+    },
+    {
+        TOK_EVENT_STATS, "event_stats", "Event statistics",
+        "Queued, coalesced and dropped freq, mode, vfo, ptt and dcd events, setting it clears them",
+        "", RIG_CONF_STRING,
+    },
     {
         TOK_AUTO_POWER_ON, "auto_power_on", "Auto power on",
         "True enables compatible rigs to be powered up on open",
@@ -300,6 +398,14 @@ static int frontend_set_conf(RIG *rig, hamlib_token_t token, const char *val)
         rs->rigport_deprecated.write_delay = val_i;
         break;
 
+    case TOK_WRITE_QUEUE:
+        if (1 != sscanf(val, "%ld", &val_i))
+        {
+            return -RIG_EINVAL; //value format error
+        }
+
+        return port_set_write_queue(rp, val_i ? 1 : 0);
+
     case TOK_POST_WRITE_DELAY:
         if (1 != sscanf(val, "%ld", &val_i))
         {
@@ -310,6 +416,14 @@ static int frontend_set_conf(RIG *rig, hamlib_token_t token, const char *val)
         rs->rigport_deprecated.post_write_delay = val_i;
         break;
 
+    case TOK_POST_WRITE_DEFERRED:
+        if (1 != sscanf(val, "%ld", &val_i))
+        {
+            return -RIG_EINVAL; //value format error
+        }
+
+        return port_set_post_write_deferred(rp, val_i ? 1 : 0);
+
     case TOK_POST_PTT_DELAY:
         if (1 != sscanf(val, "%ld", &val_i))
         {
@@ -691,6 +805,29 @@ static int frontend_set_conf(RIG *rig, hamlib_token_t token, const char *val)
         strncpy(rs->device_id, val, HAMLIB_RIGNAMSIZ - 1);
         break;
 
+    case TOK_ADAPTIVE_TIMEOUT:
+        if (1 != sscanf(val, "%ld", &val_i))
+        {
+            return -RIG_EINVAL; //value format error
+        }
+
+        return port_set_adaptive_timeout(rp, val_i);
+
+    case TOK_TIMEOUT_LEARNED:
+        return port_reset_timeout_learned(rp);
+
+    case TOK_PORT_STATS:
+        return port_reset_stats(rp);
+
+    case TOK_CAPTURE_FILE:
+        return port_set_capture_file(rp, val);
+
+    case TOK_REPLAY_FILE:
+        return port_set_replay_file(rp, val);
+
+    case TOK_REPLAY_SPEED:
+        return port_set_replay_speed(rp, atof(val));
+
 
     case TOK_VFO_COMP:
         rs->vfo_comp = atof(val);
@@ -707,6 +844,28 @@ static int frontend_set_conf(RIG *rig, hamlib_token_t token, const char *val)
         rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_ALL, atol(val));
         break;
 
+    case TOK_POLL_REFRESH:
+        if (1 != sscanf(val, "%ld", &val_i))
+        {
+            return -RIG_EINVAL;
+        }
+
+        rs->poll_refresh = val_i ? 1 : 0;
+        break;
+
+    case TOK_POLL_BUDGET:
+        if (1 != sscanf(val, "%ld", &val_i) || val_i < 1 || val_i > 100)
+        {
+            return -RIG_EINVAL;
+        }
+
+        rs->poll_budget = val_i;
+        break;
+
+    case TOK_POLL_STATS:
+        rig_poll_reset_stats(rig);
+        break;
+
     case TOK_LO_FREQ:
         rs->lo_freq = atof(val);
         break;
@@ -715,6 +874,55 @@ static int frontend_set_conf(RIG *rig, hamlib_token_t token, const char *val)
         rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_ALL, atol(val));
         break;
 
+    case TOK_CACHE_TIMEOUT_LEVEL:
+        rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_LEVEL, atol(val));
+        break;
+
+    case TOK_CACHE_TIMEOUT_METER:
+        rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_METER, atol(val));
+        break;
+
+    case TOK_CACHE_TIMEOUT_FUNC:
+        rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_FUNC, atol(val));
+        break;
+
+    case TOK_CACHE_TIMEOUT_PARM:
+        rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_PARM, atol(val));
+        break;
+
+    case TOK_CACHE_STATS:
+        rig_cache_reset_stats(rig);
+        break;
+
+    case TOK_EVENT_QUEUE:
+        if (1 != sscanf(val, "%ld", &val_i) || val_i < 0)
+        {
+            return -RIG_EINVAL;
+        }
+
+        rs->event_queue_size = val_i;
+        break;
+
+    case TOK_EVENT_OVERFLOW:
+        if (!strcmp(val, "coalesce"))
+        {
+            rs->event_overflow = RIG_EVENT_OVERFLOW_COALESCE;
+        }
+        else if (!strcmp(val, "drop_oldest"))
+        {
+            rs->event_overflow = RIG_EVENT_OVERFLOW_DROP_OLDEST;
+        }
+        else
+        {
+            return -RIG_EINVAL;
+        }
+
+        break;
+
+    case TOK_EVENT_STATS:
+        rig_event_reset_stats(rig);
+        break;
+
     case TOK_AUTO_POWER_ON:
         if (1 != sscanf(val, "%ld", &val_i))
         {
@@ -910,10 +1118,18 @@ static int frontend_get_conf2(RIG *rig, hamlib_token_t token, char *val,
         SNPRINTF(val, val_len, "%d", rp->write_delay);
         break;
 
+    case TOK_WRITE_QUEUE:
+        SNPRINTF(val, val_len, "%d", port_get_write_queue(rp));
+        break;
+
     case TOK_POST_WRITE_DELAY:
         SNPRINTF(val, val_len, "%d", rp->post_write_delay);
         break;
 
+    case TOK_POST_WRITE_DEFERRED:
+        SNPRINTF(val, val_len, "%d", port_get_post_write_deferred(rp));
+        break;
+
     case TOK_POST_PTT_DELAY:
         SNPRINTF(val, val_len, "%d", rs->post_ptt_delay);
         break;
@@ -1106,6 +1322,30 @@ static int frontend_get_conf2(RIG *rig, hamlib_token_t token, char *val,
         SNPRINTF(val, val_len, "%s", rs->device_id);
         break;
 
+    case TOK_ADAPTIVE_TIMEOUT:
+        SNPRINTF(val, val_len, "%d", port_get_adaptive_timeout(rp));
+        break;
+
+    case TOK_TIMEOUT_LEARNED:
+        port_get_timeout_learned(rp, val, val_len);
+        break;
+
+    case TOK_PORT_STATS:
+        port_get_stats(rp, val, val_len);
+        break;
+
+    case TOK_CAPTURE_FILE:
+        SNPRINTF(val, val_len, "%s", port_get_capture_file(rp));
+        break;
+
+    case TOK_REPLAY_FILE:
+        SNPRINTF(val, val_len, "%s", port_get_replay_file(rp));
+        break;
+
+    case TOK_REPLAY_SPEED:
+        SNPRINTF(val, val_len, "%g", port_get_replay_speed(rp));
+        break;
+
     case TOK_VFO_COMP:
         SNPRINTF(val, val_len, "%f", rs->vfo_comp);
         break;
@@ -1114,6 +1354,18 @@ static int frontend_get_conf2(RIG *rig, hamlib_token_t token, char *val,
         SNPRINTF(val, val_len, "%d", rs->poll_interval);
         break;
 
+    case TOK_POLL_REFRESH:
+        SNPRINTF(val, val_len, "%d", rs->poll_refresh);
+        break;
+
+    case TOK_POLL_BUDGET:
+        SNPRINTF(val, val_len, "%d", rs->poll_budget);
+        break;
+
+    case TOK_POLL_STATS:
+        rig_poll_stats(rig, val, val_len);
+        break;
+
     case TOK_PTT_TYPE:
         switch (pttp->type.ptt)
         {
@@ -1232,6 +1484,40 @@ static int frontend_get_conf2(RIG *rig, hamlib_token_t token, char *val,
         SNPRINTF(val, val_len, "%d", rig_get_cache_timeout_ms(rig, HAMLIB_CACHE_ALL));
         break;
 
+    case TOK_CACHE_TIMEOUT_LEVEL:
+        SNPRINTF(val, val_len, "%d", rig_get_cache_timeout_ms(rig, HAMLIB_CACHE_LEVEL));
+        break;
+
+    case TOK_CACHE_TIMEOUT_METER:
+        SNPRINTF(val, val_len, "%d", rig_get_cache_timeout_ms(rig, HAMLIB_CACHE_METER));
+        break;
+
+    case TOK_CACHE_TIMEOUT_FUNC:
+        SNPRINTF(val, val_len, "%d", rig_get_cache_timeout_ms(rig, HAMLIB_CACHE_FUNC));
+        break;
+
+    case TOK_CACHE_TIMEOUT_PARM:
+        SNPRINTF(val, val_len, "%d", rig_get_cache_timeout_ms(rig, HAMLIB_CACHE_PARM));
+        break;
+
+    case TOK_CACHE_STATS:
+        rig_cache_stats(rig, val, val_len);
+        break;
+
+    case TOK_EVENT_QUEUE:
+        SNPRINTF(val, val_len, "%d", rs->event_queue_size);
+        break;
+
+    case TOK_EVENT_OVERFLOW:
+        SNPRINTF(val, val_len, "%s",
+                 rs->event_overflow == RIG_EVENT_OVERFLOW_DROP_OLDEST ? "drop_oldest" :
+                 "coalesce");
+        break;
+
+    case TOK_EVENT_STATS:
+        rig_event_stats(rig, val, val_len);
+        break;
+
     case TOK_AUTO_POWER_ON:
         SNPRINTF(val, val_len, "%d", rs->auto_power_on);
         break;
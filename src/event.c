@@ -47,6 +47,9 @@
 #include "misc.h"
 #include "cache.h"
 #include "network.h"
+#include "iofunc.h"
+
+extern double monotonic_seconds();
 
 #define CHECK_RIG_ARG(r) (!(r) || !(r)->caps || !STATE(r)->comm_state)
 
@@ -55,194 +58,625 @@ typedef struct rig_poll_routine_args_s
     RIG *rig;
 } rig_poll_routine_args;
 
+/*
+ * With poll_refresh the poll routine reads the rig itself, so apps can
+ * answer from the cache.  Every item has a rate of its own, in reads per
+ * poll_interval: the PTT and the freq of the current VFO every interval,
+ * the meters twice as often but only while transmitting, the mode every
+ * other interval, the other VFO and split every fourth and the levels
+ * that only change when set every 30th.  Items come in order of priority.
+ *
+ * What a read costs is learned from the port counters.  When the reads
+ * would need more than poll_budget percent of the bytes a serial port
+ * carries, all rates are stretched alike until they fit.  Network and
+ * USB ports have no known rate and so no budget.
+ *
+ * The reads take the rig lock between API calls, an app that needs the
+ * rig for longer, like rigctl and rigctld for a command, holds rig_lock().
+ */
+enum rig_poll_what_e
+{
+    RIG_POLL_PTT,
+    RIG_POLL_FREQ,
+    RIG_POLL_MODE,
+    RIG_POLL_SPLIT,
+    RIG_POLL_LEVEL
+};
+
+#define RIG_POLL_ITEMS 16
+#define RIG_POLL_COST 32.0  // bytes of a read not measured yet
+
+struct rig_poll_item
+{
+    int what;
+    vfo_t vfo;
+    setting_t level;
+    double rate;        // reads per poll_interval
+    int tx_only;        // meters, only read while the PTT is on
+    double cost;        // bytes of a read, moving average, 0 until measured
+    double due;         // monotonic_seconds() of the next read
+};
+
 typedef struct rig_poll_routine_priv_data_s
 {
     pthread_t thread_id;
     rig_poll_routine_args args;
+    struct rig_poll_item items[RIG_POLL_ITEMS];
+    int n_items;
+    pthread_mutex_t api_lock;   // with api_free, wakes rig_poll_lock()
+    pthread_cond_t api_free;
+    pthread_mutex_t stats_lock;
+    unsigned long reads;
+    unsigned long bytes;
+    double budget;      // bytes/s, 0 for no limit
+    double demand;      // bytes/s the rates ask for
+    double stretch;
+    int no_bulk;        // get_status_bulk turned out not to work
+    int no_bulk_other;  // nor for the other VFO
 } rig_poll_routine_priv_data;
 
-void *rig_poll_routine(void *arg)
+static void rig_poll_add(rig_poll_routine_priv_data *priv, int what, vfo_t vfo,
+                         setting_t level, double rate, int tx_only)
 {
-    rig_poll_routine_args *args = (rig_poll_routine_args *)arg;
-    RIG *rig = args->rig;
-    struct rig_state *rs = STATE(rig);
-    struct rig_cache *cachep = CACHE(rig);
-    int update_occurred;
+    struct rig_poll_item *item;
 
-    vfo_t vfo = RIG_VFO_NONE, tx_vfo = RIG_VFO_NONE;
-    freq_t freq_main_a = 0, freq_main_b = 0, freq_main_c = 0, freq_sub_a = 0,
-           freq_sub_b = 0, freq_sub_c = 0;
-    rmode_t mode_main_a = 0, mode_main_b = 0, mode_main_c = 0, mode_sub_a = 0,
-            mode_sub_b = 0, mode_sub_c = 0;
-    pbwidth_t width_main_a = 0, width_main_b = 0, width_main_c = 0, width_sub_a = 0,
-              width_sub_b = 0, width_sub_c = 0;
-    ptt_t ptt = RIG_PTT_OFF;
-    split_t split = RIG_SPLIT_OFF;
+    if (priv->n_items >= RIG_POLL_ITEMS)
+    {
+        return;
+    }
 
-    rig_debug(RIG_DEBUG_VERBOSE, "%s(%d): Starting rig poll routine thread\n",
-              __FILE__, __LINE__);
+    item = &priv->items[priv->n_items++];
+    memset(item, 0, sizeof(*item));
+    item->what = what;
+    item->vfo = vfo;
+    item->level = level;
+    item->rate = rate;
+    item->tx_only = tx_only;
+}
 
-    // Rig cache time should be equal to rig poll interval (should be set automatically by rigctld at least)
-    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_ALL, rs->poll_interval);
+/* what the rig can tell, levels only when their class is cached */
+static void rig_poll_items(RIG *rig, rig_poll_routine_priv_data *priv)
+{
+    static const setting_t meters[] =
+    {
+        RIG_LEVEL_RFPOWER_METER, RIG_LEVEL_SWR, RIG_LEVEL_ALC
+    };
+    static const setting_t levels[] =
+    {
+        RIG_LEVEL_RFPOWER, RIG_LEVEL_AF, RIG_LEVEL_RF, RIG_LEVEL_SQL,
+        RIG_LEVEL_PREAMP, RIG_LEVEL_ATT, RIG_LEVEL_AGC
+    };
+    const struct rig_caps *caps = rig->caps;
+    const struct rig_cache *cachep = CACHE(rig);
+    int i;
 
-    // Attempt to detect changes with the interval below (in milliseconds)
-    int change_detection_interval = 50;
-    int interval_count = 0;
+    priv->n_items = 0;
 
-    update_occurred = 0;
+    if (caps->get_ptt)
+    {
+        rig_poll_add(priv, RIG_POLL_PTT, RIG_VFO_CURR, 0, 1, 0);
+    }
 
-    network_publish_rig_poll_data(rig);
+    if (caps->get_freq)
+    {
+        rig_poll_add(priv, RIG_POLL_FREQ, RIG_VFO_CURR, 0, 1, 0);
+    }
 
-    while (rs->poll_routine_thread_run)
+    for (i = 0; i < (int)(sizeof(meters) / sizeof(meters[0])); i++)
     {
-        if (rs->current_vfo != vfo)
+        if (cachep->settings_timeout_ms[CACHE_KIND_METER] > 0
+                && rig_has_get_level(rig, meters[i]))
         {
-            vfo = rs->current_vfo;
-            update_occurred = 1;
+            rig_poll_add(priv, RIG_POLL_LEVEL, RIG_VFO_CURR, meters[i], 2, 1);
         }
+    }
 
-        if (rs->tx_vfo != tx_vfo)
-        {
-            tx_vfo = rs->tx_vfo;
-            update_occurred = 1;
-        }
+    if (caps->get_mode)
+    {
+        rig_poll_add(priv, RIG_POLL_MODE, RIG_VFO_CURR, 0, 0.5, 0);
+    }
 
-        if (cachep->freqMainA != freq_main_a)
-        {
-            freq_main_a = cachep->freqMainA;
-            update_occurred = 1;
-        }
+    if (caps->get_freq && (caps->targetable_vfo & RIG_TARGETABLE_FREQ))
+    {
+        rig_poll_add(priv, RIG_POLL_FREQ, RIG_VFO_OTHER, 0, 0.25, 0);
+    }
 
-        if (cachep->freqMainB != freq_main_b)
-        {
-            freq_main_b = cachep->freqMainB;
-            update_occurred = 1;
-        }
+    if (caps->get_split_vfo)
+    {
+        rig_poll_add(priv, RIG_POLL_SPLIT, RIG_VFO_CURR, 0, 0.25, 0);
+    }
 
-        if (cachep->freqMainC != freq_main_c)
+    for (i = 0; i < (int)(sizeof(levels) / sizeof(levels[0])); i++)
+    {
+        if (cachep->settings_timeout_ms[CACHE_KIND_LEVEL] > 0
+                && rig_has_get_level(rig, levels[i]))
         {
-            freq_main_b = cachep->freqMainC;
-            update_occurred = 1;
+            rig_poll_add(priv, RIG_POLL_LEVEL, RIG_VFO_CURR, levels[i], 1.0 / 30, 0);
         }
+    }
+}
 
-        if (cachep->freqSubA != freq_sub_a)
-        {
-            freq_sub_a = cachep->freqSubA;
-            update_occurred = 1;
-        }
+/* poll_budget percent of a serial port, with a start and a stop bit a byte */
+static double rig_poll_budget(RIG *rig)
+{
+    const hamlib_port_t *rp = RIGPORT(rig);
 
-        if (cachep->freqSubB != freq_sub_b)
-        {
-            freq_sub_b = cachep->freqSubB;
-            update_occurred = 1;
-        }
+    if (rp->type.rig != RIG_PORT_SERIAL || rp->parm.serial.rate <= 0)
+    {
+        return 0;
+    }
 
-        if (cachep->freqSubC != freq_sub_c)
-        {
-            freq_sub_c = cachep->freqSubC;
-            update_occurred = 1;
-        }
+    return rp->parm.serial.rate / 10.0 * STATE(rig)->poll_budget / 100.0;
+}
 
-        if (cachep->ptt != ptt)
-        {
-            ptt = cachep->ptt;
-            update_occurred = 1;
-        }
+/* how much longer the periods must be for the reads to fit the budget */
+static double rig_poll_stretch(rig_poll_routine_priv_data *priv, int ptt_on,
+                               double interval)
+{
+    double demand = 0, stretch = 1;
+    int i;
 
-        if (cachep->split != split)
-        {
-            split = cachep->split;
-            update_occurred = 1;
-        }
+    for (i = 0; i < priv->n_items; i++)
+    {
+        const struct rig_poll_item *item = &priv->items[i];
+
+        if (item->tx_only && !ptt_on) { continue; }
+
+        demand += (item->cost > 0 ? item->cost : RIG_POLL_COST) * item->rate
+                  / interval;
+    }
+
+    if (priv->budget > 0 && demand > priv->budget)
+    {
+        stretch = demand / priv->budget;
+    }
+
+    pthread_mutex_lock(&priv->stats_lock);
+    priv->demand = demand;
+    priv->stretch = stretch;
+    pthread_mutex_unlock(&priv->stats_lock);
+
+    return stretch;
+}
+
+/* age in seconds of what the cache holds for a freq or mode item */
+static double rig_poll_age(RIG *rig, const struct rig_poll_item *item)
+{
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    int ms_freq, ms_mode, ms_width;
+
+    if (item->what != RIG_POLL_FREQ && item->what != RIG_POLL_MODE)
+    {
+        return 1e9;
+    }
+
+    if (rig_get_cache(rig, item->vfo, &freq, &ms_freq, &mode, &ms_mode, &width,
+                      &ms_width) != RIG_OK)
+    {
+        return 1e9;
+    }
+
+    if (item->what == RIG_POLL_FREQ)
+    {
+        return freq != 0 ? ms_freq / 1000.0 : 1e9;
+    }
+
+    return mode != RIG_MODE_NONE ? ms_mode / 1000.0 : 1e9;
+}
+
+/* bytes of one more read of an item, as a moving average */
+static void rig_poll_cost(struct rig_poll_item *item, unsigned long bytes)
+{
+    if (bytes > 0)
+    {
+        item->cost = item->cost > 0 ? 0.75 * item->cost + 0.25 * bytes : bytes;
+    }
+}
 
-        if (cachep->modeMainA != mode_main_a)
+static void rig_poll_count(rig_poll_routine_priv_data *priv,
+                           unsigned long bytes)
+{
+    pthread_mutex_lock(&priv->stats_lock);
+    priv->reads++;
+    priv->bytes += bytes;
+    pthread_mutex_unlock(&priv->stats_lock);
+}
+
+/*
+ * Take the rig between two API calls of the apps.  A rig held by an app
+ * is waited for until rig_lock() releases it, or until the poll routine
+ * is stopped, since the app may be closing the rig and joining this
+ * thread.  Returns 0 when the poll routine is stopping.
+ */
+static int rig_poll_lock(RIG *rig)
+{
+    struct rig_state *rs = STATE(rig);
+    rig_poll_routine_priv_data *priv = rs->poll_routine_priv_data;
+    int locked = 1;
+
+    pthread_mutex_lock(&priv->api_lock);
+
+    while (pthread_mutex_trylock(&rs->api_mutex) != 0)
+    {
+        if (!rs->poll_routine_thread_run) { locked = 0; break; }
+
+        pthread_cond_wait(&priv->api_free, &priv->api_lock);
+    }
+
+    pthread_mutex_unlock(&priv->api_lock);
+
+    return locked;
+}
+
+/* the rig was released or the poll routine is stopping, see rig_poll_lock() */
+void rig_poll_wake(RIG *rig)
+{
+    rig_poll_routine_priv_data *priv = STATE(rig)->poll_routine_priv_data;
+
+    if (priv == NULL) { return; }
+
+    pthread_mutex_lock(&priv->api_lock);
+    pthread_cond_broadcast(&priv->api_free);
+    pthread_mutex_unlock(&priv->api_lock);
+}
+
+/*
+ * One read of an item through the frontend, which puts the answer in the
+ * cache.  The cache timeout is poll_interval and no item is read more
+ * often than that, so the getters do go to the rig, except for levels.
+ */
+static int rig_poll_read(RIG *rig, rig_poll_routine_priv_data *priv,
+                         struct rig_poll_item *item)
+{
+    hamlib_port_t *rp = RIGPORT(rig);
+    unsigned long before, bytes;
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    ptt_t ptt;
+    split_t split;
+    vfo_t tx_vfo;
+    value_t val;
+    int retval;
+
+    if (!rig_poll_lock(rig))
+    {
+        return -RIG_EINTERNAL;
+    }
+
+    before = port_get_traffic(rp);
+
+    switch (item->what)
+    {
+    case RIG_POLL_PTT:
+        retval = rig_get_ptt(rig, item->vfo, &ptt);
+        break;
+
+    case RIG_POLL_FREQ:
+        retval = rig_get_freq(rig, item->vfo, &freq);
+        break;
+
+    case RIG_POLL_MODE:
+        retval = rig_get_mode(rig, item->vfo, &mode, &width);
+        break;
+
+    case RIG_POLL_SPLIT:
+        retval = rig_get_split_vfo(rig, item->vfo, &split, &tx_vfo);
+        break;
+
+    default:
+        // the level cache may be kept longer than the rate of the item
+        rig_cache_invalidate_setting(rig, CACHE_KIND_LEVEL, item->level);
+        retval = rig_get_level(rig, item->vfo, item->level, &val);
+        break;
+    }
+
+    bytes = port_get_traffic(rp) - before;
+
+    pthread_mutex_unlock(&STATE(rig)->api_mutex);
+
+    if (retval == RIG_OK) { rig_poll_cost(item, bytes); }
+
+    rig_poll_count(priv, bytes);
+
+    return retval;
+}
+
+/* the RIG_STATUS_* bit of the item in a get_status_bulk answer */
+static unsigned int rig_poll_field(const struct rig_poll_item *item)
+{
+    switch (item->what)
+    {
+    case RIG_POLL_PTT: return RIG_STATUS_PTT;
+
+    case RIG_POLL_FREQ: return RIG_STATUS_FREQ;
+
+    case RIG_POLL_MODE: return RIG_STATUS_MODE;
+
+    case RIG_POLL_SPLIT: return RIG_STATUS_SPLIT;
+
+    default: return 0;
+    }
+}
+
+/*
+ * When several freq, mode, PTT and split items are due and the backend
+ * has get_status_bulk, one read of it stands in for all of them.  The
+ * items it did not answer are read one by one as usual, and the ones it
+ * never fills do not count.  unit is the period of an item with a rate
+ * of 1.
+ */
+static void rig_poll_bulk(RIG *rig, rig_poll_routine_priv_data *priv,
+                          double unit, double now)
+{
+    hamlib_port_t *rp = RIGPORT(rig);
+    struct rig_status_bulk status[2];
+    struct rig_poll_item *due[RIG_POLL_ITEMS];
+    unsigned long before, bytes;
+    unsigned int fields = rig_cache_status_fields(rig);
+    int n_due = 0, n = 1, covered = 0, i, retval;
+
+    if (rig->caps->get_status_bulk == NULL || priv->no_bulk)
+    {
+        return;
+    }
+
+    for (i = 0; i < priv->n_items; i++)
+    {
+        struct rig_poll_item *item = &priv->items[i];
+
+        if (item->rate <= 0 || item->what == RIG_POLL_LEVEL || item->due > now
+                || rig_poll_age(rig, item) < unit / item->rate
+                || !(fields & rig_poll_field(item)))
         {
-            mode_main_a = cachep->modeMainA;
-            update_occurred = 1;
+            continue;
         }
 
-        if (cachep->modeMainB != mode_main_b)
+        if (item->vfo == RIG_VFO_OTHER)
         {
-            mode_main_b = cachep->modeMainB;
-            update_occurred = 1;
+            if (priv->no_bulk_other) { continue; }
+
+            n = 2;
         }
 
-        if (cachep->modeMainC != mode_main_c)
+        due[n_due++] = item;
+    }
+
+    if (n_due < 2 || !rig_poll_lock(rig))
+    {
+        return;
+    }
+
+    memset(status, 0, sizeof(status));
+    status[0].vfo = RIG_VFO_CURR;
+    status[1].vfo = RIG_VFO_OTHER;
+
+    before = port_get_traffic(rp);
+    retval = rig_get_status_bulk(rig, status, n);
+    bytes = port_get_traffic(rp) - before;
+
+    pthread_mutex_unlock(&STATE(rig)->api_mutex);
+
+    rig_poll_count(priv, bytes);
+
+    if (retval != RIG_OK)
+    {
+        if (retval == -RIG_ENIMPL || retval == -RIG_ENAVAIL) { priv->no_bulk = 1; }
+
+        return;
+    }
+
+    if (n == 2 && status[1].valid == 0) { priv->no_bulk_other = 1; }
+
+    now = monotonic_seconds();
+
+    for (i = 0; i < n_due; i++)
+    {
+        struct rig_poll_item *item = due[i];
+        const struct rig_status_bulk *st = &status[item->vfo == RIG_VFO_OTHER];
+        int done;
+
+        switch (item->what)
         {
-            mode_main_c = cachep->modeMainC;
-            update_occurred = 1;
+        case RIG_POLL_PTT: done = st->valid & RIG_STATUS_PTT; break;
+
+        case RIG_POLL_SPLIT: done = st->valid & RIG_STATUS_SPLIT; break;
+
+        // freq and mode are done when they made it into the cache
+        default: done = rig_poll_age(rig, item) < unit / item->rate; break;
         }
 
-        if (cachep->modeSubA != mode_sub_a)
+        if (done)
         {
-            mode_sub_a = cachep->modeSubA;
-            update_occurred = 1;
+            item->due = now + unit / item->rate;
+            due[covered++] = item;
         }
+    }
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: one read for %d of %d items, %lu bytes\n",
+              __func__, covered, n_due, bytes);
 
-        if (cachep->modeSubB != mode_sub_b)
+    // the items share the bytes of the read
+    for (i = 0; i < covered; i++)
+    {
+        rig_poll_cost(due[i], bytes / covered);
+    }
+}
+
+/*
+ * Read the items that are due, in order of priority, and return when the
+ * next one is.  A freq or mode an app just read is not read again.
+ */
+static double rig_poll_refresh(RIG *rig, rig_poll_routine_priv_data *priv)
+{
+    struct rig_state *rs = STATE(rig);
+    double interval = rs->poll_interval / 1000.0;
+    int ptt_on = CACHE(rig)->ptt != RIG_PTT_OFF;
+    double stretch = rig_poll_stretch(priv, ptt_on, interval);
+    double now = monotonic_seconds(), next;
+    int i;
+
+    rig_poll_bulk(rig, priv, interval * stretch, now);
+
+    now = monotonic_seconds();
+    next = now + interval;
+
+    for (i = 0; i < priv->n_items && rs->poll_routine_thread_run; i++)
+    {
+        struct rig_poll_item *item = &priv->items[i];
+        double period = interval * stretch / item->rate;
+        double age;
+        int retval;
+
+        if (item->rate <= 0 || (item->tx_only && !ptt_on)) { continue; }
+
+        if (item->due <= now)
         {
-            mode_sub_b = cachep->modeSubB;
-            update_occurred = 1;
+            age = rig_poll_age(rig, item);
+
+            if (age < period)
+            {
+                item->due = now + period - age;
+            }
+            else
+            {
+                retval = rig_poll_read(rig, priv, item);
+                now = monotonic_seconds();
+                item->due = now + period;
+
+                if (retval == -RIG_ENIMPL || retval == -RIG_ENAVAIL)
+                {
+                    rig_debug(RIG_DEBUG_VERBOSE, "%s: no more reads of item %d: %s\n",
+                              __func__, i, rigerror(retval));
+                    item->rate = 0;
+                    continue;
+                }
+
+                // an item the rig does not answer must not eat the budget
+                if (retval != RIG_OK) { item->due = now + 8 * period; }
+            }
         }
 
-        if (cachep->modeSubC != mode_sub_c)
+        if (item->due < next) { next = item->due; }
+    }
+
+    return next;
+}
+
+void *rig_poll_routine(void *arg)
+{
+    rig_poll_routine_args *args = (rig_poll_routine_args *)arg;
+    RIG *rig = args->rig;
+    struct rig_state *rs = STATE(rig);
+    struct rig_cache *cachep = CACHE(rig);
+    int update_occurred;
+
+    vfo_t vfo = RIG_VFO_NONE, tx_vfo = RIG_VFO_NONE;
+    struct rig_cache_vfo slots[CACHE_SLOTS], seen[CACHE_SLOTS];
+    unsigned int seq, generation;
+    int i;
+    ptt_t ptt = RIG_PTT_OFF, cur_ptt;
+    split_t split = RIG_SPLIT_OFF, cur_split;
+    double next_publish;
+
+    rig_poll_routine_priv_data *priv = rs->poll_routine_priv_data;
+    double next_refresh = 0;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s(%d): Starting rig poll routine thread\n",
+              __FILE__, __LINE__);
+
+    // Rig cache time should be equal to rig poll interval (should be set automatically by rigctld at least)
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_ALL, rs->poll_interval);
+
+    if (rs->poll_refresh)
+    {
+        rig_poll_items(rig, priv);
+        // leave the app a moment to finish setting up after rig_open()
+        next_refresh = monotonic_seconds() + rs->poll_interval / 1000.0;
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: refreshing %d items, budget %.0f bytes/s\n",
+                  __func__, priv->n_items, priv->budget);
+    }
+
+    // Publish at least this often (in milliseconds) even when nothing changes
+    int publish_interval = rs->poll_interval > 0 ? rs->poll_interval : 1000;
+
+    update_occurred = 0;
+    memset(seen, 0, sizeof(seen));
+
+    generation = rig_cache_generation(rig);
+    network_publish_rig_poll_data(rig);
+    next_publish = monotonic_seconds() + publish_interval / 1000.0;
+
+    while (rs->poll_routine_thread_run)
+    {
+        if (priv->n_items > 0 && monotonic_seconds() >= next_refresh)
         {
-            mode_sub_c = cachep->modeSubC;
-            update_occurred = 1;
+            next_refresh = rig_poll_refresh(rig, priv);
         }
 
-        if (cachep->widthMainA != width_main_a)
+        if (rs->current_vfo != vfo)
         {
-            width_main_a = cachep->widthMainA;
+            vfo = rs->current_vfo;
             update_occurred = 1;
         }
 
-        if (cachep->widthMainB != width_main_b)
+        if (rs->tx_vfo != tx_vfo)
         {
-            width_main_b = cachep->widthMainB;
+            tx_vfo = rs->tx_vfo;
             update_occurred = 1;
         }
 
-        if (cachep->widthMainC != width_main_c)
+        do
         {
-            width_main_c = cachep->widthMainC;
-            update_occurred = 1;
+            seq = rig_cache_read_begin(cachep);
+            memcpy(slots, cachep->slot, sizeof(slots));
+            cur_ptt = cachep->ptt;
+            cur_split = cachep->split;
         }
+        while (rig_cache_read_retry(cachep, seq));
 
-        if (cachep->widthSubA != width_sub_a)
+        // Writers also refresh unchanged values, only publish real changes
+        for (i = CACHE_SLOT_MAIN_A; i <= CACHE_SLOT_SUB_C; i++)
         {
-            width_sub_a = cachep->widthSubA;
-            update_occurred = 1;
+            if (slots[i].freq != seen[i].freq || slots[i].mode != seen[i].mode
+                    || slots[i].width != seen[i].width)
+            {
+                seen[i] = slots[i];
+                update_occurred = 1;
+            }
         }
 
-        if (cachep->widthSubB != width_sub_b)
+        if (cur_ptt != ptt)
         {
-            width_sub_b = cachep->widthSubB;
+            ptt = cur_ptt;
             update_occurred = 1;
         }
 
-        if (cachep->widthSubC != width_sub_c)
+        if (cur_split != split)
         {
-            width_sub_c = cachep->widthSubC;
+            split = cur_split;
             update_occurred = 1;
         }
 
-        if (update_occurred)
+        double now = monotonic_seconds();
+
+        // Publish updates every poll_interval if no changes have been detected
+        if (update_occurred || now >= next_publish)
         {
             network_publish_rig_poll_data(rig);
             update_occurred = 0;
-            interval_count = 0;
+            next_publish = now + publish_interval / 1000.0;
         }
 
-        hl_usleep(change_detection_interval * 1000);
-        interval_count++;
+        // Sleep until the cache changes or the next publish or read is due
+        double wake = next_publish;
 
-        // Publish updates every poll_interval if no changes have been detected
-        if (interval_count >= (rs->poll_interval / change_detection_interval))
-        {
-            interval_count = 0;
-            network_publish_rig_poll_data(rig);
-        }
+        if (priv->n_items > 0 && next_refresh < wake) { wake = next_refresh; }
+
+        rig_cache_wait(rig, &generation,
+                       (int)((wake - monotonic_seconds()) * 1000) + 1);
     }
 
     network_publish_rig_poll_data(rig);
@@ -293,6 +727,11 @@ int rig_poll_routine_start(RIG *rig)
 
     poll_routine_priv = (rig_poll_routine_priv_data *) rs->poll_routine_priv_data;
     poll_routine_priv->args.rig = rig;
+    pthread_mutex_init(&poll_routine_priv->api_lock, NULL);
+    pthread_cond_init(&poll_routine_priv->api_free, NULL);
+    pthread_mutex_init(&poll_routine_priv->stats_lock, NULL);
+    poll_routine_priv->budget = rig_poll_budget(rig);
+    poll_routine_priv->stretch = 1;
     int err = pthread_create(&poll_routine_priv->thread_id, NULL,
                              rig_poll_routine, &poll_routine_priv->args);
 
@@ -334,6 +773,8 @@ int rig_poll_routine_stop(RIG *rig)
     }
 
     rs->poll_routine_thread_run = 0;
+    rig_cache_notify(rig);
+    rig_poll_wake(rig);
 
     poll_routine_priv = (rig_poll_routine_priv_data *) rs->poll_routine_priv_data;
 
@@ -353,12 +794,383 @@ int rig_poll_routine_stop(RIG *rig)
 
     network_publish_rig_poll_data(rig);
 
+    pthread_mutex_destroy(&poll_routine_priv->api_lock);
+    pthread_cond_destroy(&poll_routine_priv->api_free);
+    pthread_mutex_destroy(&poll_routine_priv->stats_lock);
     free(rs->poll_routine_priv_data);
     rs->poll_routine_priv_data = NULL;
 
     RETURNFUNC(RIG_OK);
 }
 
+/*
+ * Reads and bytes of the poll refreshes, the budget and what the rates
+ * ask for in bytes/s and how much they were stretched to fit
+ *   "reads=120 bytes=2400 budget=240 demand=320 stretch=1.33"
+ */
+int rig_poll_stats(RIG *rig, char *buf, size_t len)
+{
+    rig_poll_routine_priv_data *priv = STATE(rig)->poll_routine_priv_data;
+    int n;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    if (priv == NULL)
+    {
+        return snprintf(buf, len, "reads=0 bytes=0 budget=0 demand=0 stretch=1.00");
+    }
+
+    pthread_mutex_lock(&priv->stats_lock);
+    n = snprintf(buf, len, "reads=%lu bytes=%lu budget=%.0f demand=%.0f stretch=%.2f",
+                 priv->reads, priv->bytes, priv->budget, priv->demand, priv->stretch);
+    pthread_mutex_unlock(&priv->stats_lock);
+
+    return n;
+}
+
+void rig_poll_reset_stats(RIG *rig)
+{
+    rig_poll_routine_priv_data *priv = STATE(rig)->poll_routine_priv_data;
+
+    if (priv == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&priv->stats_lock);
+    priv->reads = 0;
+    priv->bytes = 0;
+    pthread_mutex_unlock(&priv->stats_lock);
+}
+
+/*
+ * The callbacks of freq, mode, vfo, ptt and dcd events are called by a
+ * dispatch thread, so a slow callback cannot hold up the thread that
+ * found the change, often the async data handler reading the rig.  The
+ * queue takes a short lock only to copy an event in or out; when it is
+ * full the new event either replaces the queued one of the same kind and
+ * VFO or pushes out the oldest, see event_overflow.
+ */
+enum rig_event_type_e
+{
+    RIG_EVENT_FREQ,
+    RIG_EVENT_MODE,
+    RIG_EVENT_VFO,
+    RIG_EVENT_PTT,
+    RIG_EVENT_DCD,
+    RIG_EVENT_TYPES
+};
+
+struct rig_event
+{
+    int type;
+    vfo_t vfo;
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    ptt_t ptt;
+    dcd_t dcd;
+};
+
+typedef struct rig_event_dispatch_priv_data_s
+{
+    pthread_t thread_id;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int run;
+    RIG *rig;
+    struct rig_event *queue;
+    int size;
+    int head;                   /* oldest queued event */
+    int count;
+    unsigned long queued[RIG_EVENT_TYPES];
+    unsigned long coalesced[RIG_EVENT_TYPES];
+    unsigned long dropped[RIG_EVENT_TYPES];
+} rig_event_dispatch_priv_data;
+
+/* the callbacks and their args, set while the dispatch thread runs */
+static pthread_mutex_t rig_callbacks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void rig_event_deliver(RIG *rig, const struct rig_event *ev)
+{
+    struct rig_callbacks callbacks;
+    const struct rig_callbacks *cb = &callbacks;
+
+    // a callback and its arg come from the same rig_set_*_callback()
+    pthread_mutex_lock(&rig_callbacks_lock);
+    callbacks = rig->callbacks;
+    pthread_mutex_unlock(&rig_callbacks_lock);
+
+    switch (ev->type)
+    {
+    case RIG_EVENT_FREQ:
+        if (cb->freq_event) { cb->freq_event(rig, ev->vfo, ev->freq, cb->freq_arg); }
+
+        break;
+
+    case RIG_EVENT_MODE:
+        if (cb->mode_event)
+        {
+            cb->mode_event(rig, ev->vfo, ev->mode, ev->width, cb->mode_arg);
+        }
+
+        break;
+
+    case RIG_EVENT_VFO:
+        if (cb->vfo_event) { cb->vfo_event(rig, ev->vfo, cb->vfo_arg); }
+
+        break;
+
+    case RIG_EVENT_PTT:
+        if (cb->ptt_event) { cb->ptt_event(rig, ev->vfo, ev->ptt, cb->ptt_arg); }
+
+        break;
+
+    case RIG_EVENT_DCD:
+        if (cb->dcd_event) { cb->dcd_event(rig, ev->vfo, ev->dcd, cb->dcd_arg); }
+
+        break;
+    }
+}
+
+static void *rig_event_dispatch(void *arg)
+{
+    rig_event_dispatch_priv_data *priv = arg;
+    struct rig_event ev;
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s(%d): Starting event dispatch thread\n",
+              __FILE__, __LINE__);
+
+    pthread_mutex_lock(&priv->lock);
+
+    // what is queued at stop is still delivered
+    while (priv->run || priv->count > 0)
+    {
+        if (priv->count == 0)
+        {
+            pthread_cond_wait(&priv->cond, &priv->lock);
+            continue;
+        }
+
+        ev = priv->queue[priv->head];
+        priv->head = (priv->head + 1) % priv->size;
+        priv->count--;
+
+        pthread_mutex_unlock(&priv->lock);
+        rig_event_deliver(priv->rig, &ev);
+        pthread_mutex_lock(&priv->lock);
+    }
+
+    pthread_mutex_unlock(&priv->lock);
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s(%d): Stopping event dispatch thread\n",
+              __FILE__, __LINE__);
+
+    return NULL;
+}
+
+/* Queue ev for the dispatch thread, or deliver it here without one */
+static void rig_event_post(RIG *rig, const struct rig_event *ev)
+{
+    rig_event_dispatch_priv_data *priv = STATE(rig)->event_dispatch_priv_data;
+    int i, slot = -1;
+
+    if (priv == NULL)
+    {
+        rig_event_deliver(rig, ev);
+        return;
+    }
+
+    pthread_mutex_lock(&priv->lock);
+
+    priv->queued[ev->type]++;
+
+    if (priv->count == priv->size)
+    {
+        if (STATE(rig)->event_overflow == RIG_EVENT_OVERFLOW_COALESCE)
+        {
+            // the newest queued event of the same kind and VFO
+            for (i = priv->count - 1; i >= 0 && slot < 0; i--)
+            {
+                int j = (priv->head + i) % priv->size;
+
+                if (priv->queue[j].type == ev->type && priv->queue[j].vfo == ev->vfo)
+                {
+                    slot = j;
+                }
+            }
+        }
+
+        if (slot >= 0)
+        {
+            priv->coalesced[ev->type]++;
+        }
+        else
+        {
+            priv->dropped[priv->queue[priv->head].type]++;
+            priv->head = (priv->head + 1) % priv->size;
+            priv->count--;
+        }
+    }
+
+    if (slot < 0)
+    {
+        slot = (priv->head + priv->count) % priv->size;
+        priv->count++;
+    }
+
+    priv->queue[slot] = *ev;
+
+    pthread_cond_signal(&priv->cond);
+    pthread_mutex_unlock(&priv->lock);
+}
+
+/**
+ * \brief Start the event dispatch thread
+ *
+ * Start the thread calling the event callbacks, unless event_queue is 0
+ *
+ * \return RIG_OK or < 0 if error
+ */
+int rig_event_dispatch_start(RIG *rig)
+{
+    struct rig_state *rs = STATE(rig);
+    rig_event_dispatch_priv_data *priv;
+
+    ENTERFUNC;
+
+    if (rs->event_queue_size < 1 || rs->event_dispatch_priv_data != NULL)
+    {
+        RETURNFUNC(RIG_OK);
+    }
+
+    priv = calloc(1, sizeof(rig_event_dispatch_priv_data));
+
+    if (priv == NULL || (priv->queue = calloc(rs->event_queue_size,
+                                       sizeof(struct rig_event))) == NULL)
+    {
+        free(priv);
+        RETURNFUNC(-RIG_ENOMEM);
+    }
+
+    priv->rig = rig;
+    priv->size = rs->event_queue_size;
+    priv->run = 1;
+    pthread_mutex_init(&priv->lock, NULL);
+    pthread_cond_init(&priv->cond, NULL);
+
+    int err = pthread_create(&priv->thread_id, NULL, rig_event_dispatch, priv);
+
+    if (err)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s(%d) pthread_create error: %s\n", __FILE__,
+                  __LINE__, strerror(err));
+        pthread_mutex_destroy(&priv->lock);
+        pthread_cond_destroy(&priv->cond);
+        free(priv->queue);
+        free(priv);
+        RETURNFUNC(-RIG_EINTERNAL);
+    }
+
+    rs->event_dispatch_priv_data = priv;
+
+    RETURNFUNC(RIG_OK);
+}
+
+/**
+ * \brief Stop the event dispatch thread
+ *
+ * Stop the event dispatch thread after it delivered the queued events
+ *
+ * \return RIG_OK or < 0 if error
+ */
+int rig_event_dispatch_stop(RIG *rig)
+{
+    struct rig_state *rs = STATE(rig);
+    rig_event_dispatch_priv_data *priv = rs->event_dispatch_priv_data;
+
+    ENTERFUNC;
+
+    if (priv == NULL)
+    {
+        RETURNFUNC(RIG_OK);
+    }
+
+    pthread_mutex_lock(&priv->lock);
+    priv->run = 0;
+    pthread_cond_signal(&priv->cond);
+    pthread_mutex_unlock(&priv->lock);
+
+    int err = pthread_join(priv->thread_id, NULL);
+
+    if (err)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s(%d): pthread_join error %s\n", __FILE__, __LINE__,
+                  strerror(err));
+        // just ignore it
+    }
+
+    rs->event_dispatch_priv_data = NULL;
+
+    pthread_mutex_destroy(&priv->lock);
+    pthread_cond_destroy(&priv->cond);
+    free(priv->queue);
+    free(priv);
+
+    RETURNFUNC(RIG_OK);
+}
+
+/*
+ * Events queued for the callbacks, replaced in a full queue and dropped
+ * from it, per kind
+ *   "freq queued=310 coalesced=2 dropped=0 mode ... vfo ... ptt ... dcd ..."
+ */
+int rig_event_stats(RIG *rig, char *buf, size_t len)
+{
+    static const char *names[RIG_EVENT_TYPES] = { "freq", "mode", "vfo", "ptt", "dcd" };
+    rig_event_dispatch_priv_data *priv = STATE(rig)->event_dispatch_priv_data;
+    int i, n = 0;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    buf[0] = '\0';
+
+    if (priv) { pthread_mutex_lock(&priv->lock); }
+
+    for (i = 0; i < RIG_EVENT_TYPES && n >= 0 && n < (int) len; i++)
+    {
+        n += snprintf(buf + n, len - n, "%s%s queued=%lu coalesced=%lu dropped=%lu",
+                      i ? " " : "", names[i], priv ? priv->queued[i] : 0,
+                      priv ? priv->coalesced[i] : 0, priv ? priv->dropped[i] : 0);
+    }
+
+    if (priv) { pthread_mutex_unlock(&priv->lock); }
+
+    return n;
+}
+
+void rig_event_reset_stats(RIG *rig)
+{
+    rig_event_dispatch_priv_data *priv = STATE(rig)->event_dispatch_priv_data;
+
+    if (priv == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&priv->lock);
+    memset(priv->queued, 0, sizeof(priv->queued));
+    memset(priv->coalesced, 0, sizeof(priv->coalesced));
+    memset(priv->dropped, 0, sizeof(priv->dropped));
+    pthread_mutex_unlock(&priv->lock);
+}
+
 /**
  * \brief set the callback for freq events
  * \param rig   The rig handle
@@ -380,8 +1192,10 @@ int HAMLIB_API rig_set_freq_callback(RIG *rig, freq_cb_t cb, rig_ptr_t arg)
         RETURNFUNC(-RIG_EINVAL);
     }
 
+    pthread_mutex_lock(&rig_callbacks_lock);
     rig->callbacks.freq_event = cb;
     rig->callbacks.freq_arg = arg;
+    pthread_mutex_unlock(&rig_callbacks_lock);
 
     RETURNFUNC(RIG_OK);
 }
@@ -408,8 +1222,10 @@ int HAMLIB_API rig_set_mode_callback(RIG *rig, mode_cb_t cb, rig_ptr_t arg)
         RETURNFUNC(-RIG_EINVAL);
     }
 
+    pthread_mutex_lock(&rig_callbacks_lock);
     rig->callbacks.mode_event = cb;
     rig->callbacks.mode_arg = arg;
+    pthread_mutex_unlock(&rig_callbacks_lock);
 
     RETURNFUNC(RIG_OK);
 }
@@ -436,8 +1252,10 @@ int HAMLIB_API rig_set_vfo_callback(RIG *rig, vfo_cb_t cb, rig_ptr_t arg)
         RETURNFUNC(-RIG_EINVAL);
     }
 
+    pthread_mutex_lock(&rig_callbacks_lock);
     rig->callbacks.vfo_event = cb;
     rig->callbacks.vfo_arg = arg;
+    pthread_mutex_unlock(&rig_callbacks_lock);
 
     RETURNFUNC(RIG_OK);
 }
@@ -464,8 +1282,10 @@ int HAMLIB_API rig_set_ptt_callback(RIG *rig, ptt_cb_t cb, rig_ptr_t arg)
         RETURNFUNC(-RIG_EINVAL);
     }
 
+    pthread_mutex_lock(&rig_callbacks_lock);
     rig->callbacks.ptt_event = cb;
     rig->callbacks.ptt_arg = arg;
+    pthread_mutex_unlock(&rig_callbacks_lock);
 
     RETURNFUNC(RIG_OK);
 }
@@ -492,8 +1312,10 @@ int HAMLIB_API rig_set_dcd_callback(RIG *rig, dcd_cb_t cb, rig_ptr_t arg)
         RETURNFUNC(-RIG_EINVAL);
     }
 
+    pthread_mutex_lock(&rig_callbacks_lock);
     rig->callbacks.dcd_event = cb;
     rig->callbacks.dcd_arg = arg;
+    pthread_mutex_unlock(&rig_callbacks_lock);
 
     RETURNFUNC(RIG_OK);
 }
@@ -636,7 +1458,9 @@ int rig_fire_freq_event(RIG *rig, vfo_t vfo, freq_t freq)
 
         if (rig->callbacks.freq_event)
         {
-            rig->callbacks.freq_event(rig, vfo, freq, rig->callbacks.freq_arg);
+            struct rig_event ev = { .type = RIG_EVENT_FREQ, .vfo = vfo, .freq = freq };
+
+            rig_event_post(rig, &ev);
         }
     }
 
@@ -663,7 +1487,9 @@ int rig_fire_mode_event(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
 
     if (rig->callbacks.mode_event)
     {
-        rig->callbacks.mode_event(rig, vfo, mode, width, rig->callbacks.mode_arg);
+        struct rig_event ev = { .type = RIG_EVENT_MODE, .vfo = vfo, .mode = mode, .width = width };
+
+        rig_event_post(rig, &ev);
     }
 
     RETURNFUNC(0);
@@ -672,19 +1498,19 @@ int rig_fire_mode_event(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width)
 
 int rig_fire_vfo_event(RIG *rig, vfo_t vfo)
 {
-    struct rig_cache *cachep = CACHE(rig);
     ENTERFUNC;
 
     rig_debug(RIG_DEBUG_TRACE, "Event: vfo changed to %s\n", rig_strvfo(vfo));
 
-    cachep->vfo = vfo;
-    elapsed_ms(&cachep->time_vfo, HAMLIB_ELAPSED_SET);
+    rig_set_cache_vfo(rig, vfo);
 
     network_publish_rig_transceive_data(rig);
 
     if (rig->callbacks.vfo_event)
     {
-        rig->callbacks.vfo_event(rig, vfo, rig->callbacks.vfo_arg);
+        struct rig_event ev = { .type = RIG_EVENT_VFO, .vfo = vfo };
+
+        rig_event_post(rig, &ev);
     }
 
     RETURNFUNC(0);
@@ -693,20 +1519,20 @@ int rig_fire_vfo_event(RIG *rig, vfo_t vfo)
 
 int rig_fire_ptt_event(RIG *rig, vfo_t vfo, ptt_t ptt)
 {
-    struct rig_cache *cachep = CACHE(rig);
     ENTERFUNC;
 
     rig_debug(RIG_DEBUG_TRACE, "Event: PTT changed to %i on %s\n", ptt,
               rig_strvfo(vfo));
 
-    cachep->ptt = ptt;
-    elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
+    rig_set_cache_ptt(rig, ptt);
 
     network_publish_rig_transceive_data(rig);
 
     if (rig->callbacks.ptt_event)
     {
-        rig->callbacks.ptt_event(rig, vfo, ptt, rig->callbacks.ptt_arg);
+        struct rig_event ev = { .type = RIG_EVENT_PTT, .vfo = vfo, .ptt = ptt };
+
+        rig_event_post(rig, &ev);
     }
 
     RETURNFUNC(0);
@@ -724,7 +1550,9 @@ int rig_fire_dcd_event(RIG *rig, vfo_t vfo, dcd_t dcd)
 
     if (rig->callbacks.dcd_event)
     {
-        rig->callbacks.dcd_event(rig, vfo, dcd, rig->callbacks.dcd_arg);
+        struct rig_event ev = { .type = RIG_EVENT_DCD, .vfo = vfo, .dcd = dcd };
+
+        rig_event_post(rig, &ev);
     }
 
     RETURNFUNC(0);
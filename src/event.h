@@ -24,8 +24,23 @@
 
 #include "hamlib/rig.h"
 
+/* what a full event queue does with a new event, see event_overflow */
+enum rig_event_overflow_e
+{
+    RIG_EVENT_OVERFLOW_COALESCE,    /* replace the queued one of the same kind and VFO */
+    RIG_EVENT_OVERFLOW_DROP_OLDEST
+};
+
 int rig_poll_routine_start(RIG *rig);
 int rig_poll_routine_stop(RIG *rig);
+int rig_poll_stats(RIG *rig, char *buf, size_t len);
+void rig_poll_reset_stats(RIG *rig);
+void rig_poll_wake(RIG *rig);
+
+int rig_event_dispatch_start(RIG *rig);
+int rig_event_dispatch_stop(RIG *rig);
+int rig_event_stats(RIG *rig, char *buf, size_t len);
+void rig_event_reset_stats(RIG *rig);
 
 int rig_fire_freq_event(RIG *rig, vfo_t vfo, freq_t freq);
 int rig_fire_mode_event(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width);
@@ -0,0 +1,88 @@
+/*
+ *  Hamlib Interface - atomic operations
+ *  Copyright (c) 2025 by the Hamlib group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#ifndef _HL_ATOMIC_H
+#define _HL_ATOMIC_H
+
+/*
+ * The few atomics, the bit scan and the yield the lock free parts of
+ * Hamlib need, for GCC and Clang as well as MSVC.  They work on int,
+ * unsigned int and unsigned long objects.
+ *
+ * HL_ATOMIC_LOAD() acquires and HL_ATOMIC_STORE() releases, the _RELAXED
+ * ones only promise the access is not torn.  HL_ATOMIC_ADD() returns the
+ * new value.
+ */
+
+#if defined(_MSC_VER) && !defined(__clang__) && !defined(__GNUC__)
+
+#include <windows.h>
+#include <intrin.h>
+
+/* long is 32 bits on Windows, as are int and unsigned long */
+#define HL_ATOMIC_LOAD(p) \
+    InterlockedCompareExchange((volatile long *)(p), 0, 0)
+#define HL_ATOMIC_LOAD_RELAXED(p) HL_ATOMIC_LOAD(p)
+#define HL_ATOMIC_STORE(p, v) \
+    ((void) InterlockedExchange((volatile long *)(p), (long)(v)))
+#define HL_ATOMIC_STORE_RELAXED(p, v) HL_ATOMIC_STORE(p, v)
+#define HL_ATOMIC_ADD(p, v) \
+    (InterlockedExchangeAdd((volatile long *)(p), (long)(v)) + (long)(v))
+#define HL_FENCE_ACQUIRE() MemoryBarrier()
+#define HL_FENCE_RELEASE() MemoryBarrier()
+
+/* index of the lowest bit set, x must not be 0 */
+static __inline int hl_ctz(unsigned long x)
+{
+    unsigned long i;
+
+    _BitScanForward(&i, x);
+
+    return (int) i;
+}
+
+#define hl_yield() SwitchToThread()
+
+#elif defined(__GNUC__) || defined(__clang__)
+
+#include <sched.h>
+
+#define HL_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define HL_ATOMIC_LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define HL_ATOMIC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define HL_ATOMIC_STORE_RELAXED(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define HL_ATOMIC_ADD(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#define HL_FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define HL_FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+
+/* index of the lowest bit set, x must not be 0 */
+#define hl_ctz(x) __builtin_ctz(x)
+
+#define hl_yield() sched_yield()
+
+#else
+
+#error "hl_atomic.h: no atomic operations known for this compiler"
+
+#endif
+
+#endif /* _HL_ATOMIC_H */
@@ -34,12 +34,20 @@
 #include "hamlib/rig.h"
 #include "hamlib/config.h"
 
+#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>  /* String function definitions */
 #include <unistd.h>  /* UNIX standard function definitions */
 #include <fcntl.h>   /* File control definitions */
 #include <errno.h>   /* Error number definitions */
 #include <sys/time.h>
 #include <sys/types.h>
+#if defined(HAVE_POLL_H)
+#include <poll.h>
+#endif
+#if defined(HAVE_SYS_EVENTFD_H)
+#include <sys/eventfd.h>
+#endif
 
 #include "hamlib/port.h"
 #include "iofunc.h"
@@ -51,8 +59,23 @@
 #include "network.h"
 #include "cm108.h"
 #include "asyncpipe.h"
+#include "mutex.h"
+#include "wirecap.h"
+#include "rtt.h"
+#include "hl_atomic.h"
+
+extern double monotonic_seconds();
+
+/* Receive buffer per port and direction, larger than any single reply
+ * chunk we expect a rig or a rigctld socket to hand us in one read */
+#define PORT_RXBUF_SIZE 4096
 
-#define HAMLIB_TRACE2 rig_debug(RIG_DEBUG_TRACE,"%s trace(%d)\n",  __FILE__, __LINE__)
+struct port_rxbuf
+{
+    size_t start;       /* first byte not yet handed to a reader */
+    size_t end;         /* one past the last byte received */
+    unsigned char data[PORT_RXBUF_SIZE];
+};
 
 #if defined(WIN32) && defined(HAVE_WINDOWS_H)
 #include <windows.h>
@@ -109,6 +132,25 @@ static int create_sync_data_pipe(hamlib_port_t *p)
 
 #else
 
+/*
+ * On POSIX the frames the async data handler hands to a waiting
+ * transaction go through an in-memory channel in the port I/O state.
+ * fd_sync_read/fd_sync_write are only used to wake a reader blocked in
+ * poll(): an eventfd where available, else a pipe.  The error pipe of
+ * older versions is folded into the channel, so fd_sync_error_read and
+ * fd_sync_error_write stay -1.
+ */
+struct port_sync_chan
+{
+    pthread_mutex_t lock;
+    int waiting;                /* a reader sleeps on fd_sync_read */
+    int error_pending;          /* error from the async data handler */
+    signed char error;
+    struct port_rxbuf buf;
+};
+
+static struct port_sync_chan *port_sync_chan_get(const hamlib_port_t *p);
+
 static void init_sync_data_pipe(hamlib_port_t *p)
 {
     p->fd_sync_write = -1;
@@ -119,536 +161,1666 @@ static void init_sync_data_pipe(hamlib_port_t *p)
 
 static void close_sync_data_pipe(hamlib_port_t *p)
 {
-    if (p->fd_sync_read != -1)
-    {
-        close(p->fd_sync_read);
-        p->fd_sync_read = -1;
-    }
-
-    if (p->fd_sync_write != -1)
+    if (p->fd_sync_write != -1 && p->fd_sync_write != p->fd_sync_read)
     {
         close(p->fd_sync_write);
-        p->fd_sync_write = -1;
     }
 
-
-    if (p->fd_sync_error_read != -1)
+    if (p->fd_sync_read != -1)
     {
-        close(p->fd_sync_error_read);
-        p->fd_sync_error_read = -1;
+        close(p->fd_sync_read);
     }
 
-    if (p->fd_sync_error_write != -1)
-    {
-        close(p->fd_sync_error_write);
-        p->fd_sync_error_write = -1;
-    }
+    p->fd_sync_read = -1;
+    p->fd_sync_write = -1;
 }
 
 static int create_sync_data_pipe(hamlib_port_t *p)
 {
-    int status;
     int sync_pipe_fds[2];
-    int flags;
-
-    status = pipe(sync_pipe_fds);
-    flags = fcntl(sync_pipe_fds[0], F_GETFL);
-    flags |= O_NONBLOCK;
+    struct port_sync_chan *c = port_sync_chan_get(p);
 
-    if (fcntl(sync_pipe_fds[0], F_SETFL, flags))
+    if (c == NULL)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s: error setting O_NONBLOCK on sync_read=%s\n",
-                  __func__, strerror(errno));
+        return (-RIG_ENOMEM);
     }
 
-    flags = fcntl(sync_pipe_fds[1], F_GETFL);
-    flags |= O_NONBLOCK;
+    c->buf.start = c->buf.end = 0;
+    c->error_pending = 0;
+    c->waiting = 0;
+
+#if defined(HAVE_SYS_EVENTFD_H)
+    sync_pipe_fds[0] = sync_pipe_fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
-    if (fcntl(sync_pipe_fds[1], F_SETFL, flags))
+    if (sync_pipe_fds[0] < 0)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s: error setting O_NONBLOCK on sync_write=%s\n",
+        rig_debug(RIG_DEBUG_ERR, "%s: synchronous data eventfd failed, err=%s\n",
                   __func__, strerror(errno));
+        return (-RIG_EINTERNAL);
     }
 
-    if (status != 0)
+#else
+
+    if (pipe(sync_pipe_fds) != 0)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s: synchronous data pipe open status=%d, err=%s\n",
-                  __func__,
-                  status, strerror(errno));
-        close_sync_data_pipe(p);
+        rig_debug(RIG_DEBUG_ERR, "%s: synchronous data pipe open failed, err=%s\n",
+                  __func__, strerror(errno));
         return (-RIG_EINTERNAL);
     }
 
+    fcntl(sync_pipe_fds[0], F_SETFL, fcntl(sync_pipe_fds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(sync_pipe_fds[1], F_SETFL, fcntl(sync_pipe_fds[1], F_GETFL) | O_NONBLOCK);
+#endif
+
     p->fd_sync_read = sync_pipe_fds[0];
     p->fd_sync_write = sync_pipe_fds[1];
 
-    status = pipe(sync_pipe_fds);
-    flags = fcntl(sync_pipe_fds[0], F_GETFL);
-    flags |= O_NONBLOCK;
+    rig_debug(RIG_DEBUG_VERBOSE,
+              "%s: created data channel for synchronous transactions\n", __func__);
+
+    return (RIG_OK);
+}
+
+#endif
+
+struct port_txq;
+static void port_txq_stop(struct port_txq *q);
+static void port_txq_free(struct port_txq *q);
+static void port_tx_wait_idle(hamlib_port_t *p);
+struct port_io_state;
+static void port_capture_stop(struct port_io_state *s);
+
+/* traffic counters of a port, see port_get_stats() */
+struct port_io_stats
+{
+    unsigned long tx_bytes;
+    unsigned long rx_bytes;
+    unsigned long timeouts;     /* replies that did not come in time */
+    unsigned long retries;      /* writes repeating the one that timed out */
+    unsigned long async_frames; /* frames handed to process_async_frame */
+    unsigned long last_tx;      /* hash of the last write */
+    int timed_out;              /* nothing written since the last timeout */
+};
+
+/*
+ * Per-port I/O state.
+ *
+ * hamlib_port_t cannot grow until 5.0 (it is embedded in rig_state), so
+ * anything the I/O layer needs to remember between calls lives here,
+ * looked up by port address.  Entries are created on first use, reset
+ * when the port is opened or closed, and freed by port_io_state_release()
+ * when the owning RIG/AMP/ROT is cleaned up.
+ */
+struct port_io_state
+{
+    const hamlib_port_t *port;
+    int fd;                     /* fd the buffered data belongs to */
+    struct port_rxbuf rx[2];    /* [0] sync data pipe, [1] direct from device */
+    int post_write_deferred;    /* post_write_delay is a gap before the next write */
+    double next_write;          /* monotonic time the next write may start */
+    int write_queue;            /* paced writes go through txq */
+    struct port_txq *txq;       /* transmit queue, allocated on first use */
+    struct port_sync_chan *sync;    /* async handler to reader channel, POSIX */
+    char *capture_path;         /* capture_file, opened with the port */
+    struct wirecap *capture;
+    char *replay_path;          /* replay_file, for RIG_PORT_REPLAY */
+    struct wirereplay *replay;
+    double replay_speed;
+    int adaptive_timeout;       /* safety factor on the reply time p99, 0 off */
+    struct rtt_stats *rtt;      /* reply times, allocated with the above */
+    struct port_io_stats stats;
+    struct port_io_state *next;
+};
+
+static struct port_io_state *port_io_state_head = NULL;
+MUTEX(port_io_state_mutex);
+
+/* ports with a capture file open, so the others skip the state lookup,
+ * read without port_io_state_mutex */
+static int port_capture_count = 0;
+/* same for ports with adaptive_timeout */
+static int port_rtt_count = 0;
+
+static void port_io_state_clear(struct port_io_state *s, int fd)
+{
+    s->fd = fd;
+    s->rx[0].start = s->rx[0].end = 0;
+    s->rx[1].start = s->rx[1].end = 0;
+    s->next_write = 0;
+}
+
+/* Look up without creating, for the reset/release paths */
+static struct port_io_state *port_io_state_find(const hamlib_port_t *p)
+{
+    struct port_io_state *s;
+
+    MUTEX_LOCK(port_io_state_mutex);
 
-    if (fcntl(sync_pipe_fds[0], F_SETFL, flags))
+    for (s = port_io_state_head; s != NULL; s = s->next)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s: error setting O_NONBLOCK on error_read=%s\n",
-                  __func__, strerror(errno));
+        if (s->port == p) { break; }
     }
 
-    flags = fcntl(sync_pipe_fds[1], F_GETFL);
-    flags |= O_NONBLOCK;
+    MUTEX_UNLOCK(port_io_state_mutex);
+
+    return s;
+}
+
+static struct port_io_state *port_io_state_get(const hamlib_port_t *p)
+{
+    struct port_io_state *s;
+
+    MUTEX_LOCK(port_io_state_mutex);
 
-    if (fcntl(sync_pipe_fds[1], F_SETFL, flags))
+    for (s = port_io_state_head; s != NULL; s = s->next)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s: error setting O_NONBLOCK on error_write=%s\n",
-                  __func__, strerror(errno));
+        if (s->port == p) { break; }
     }
 
-    if (status != 0)
+    if (s == NULL)
     {
-        rig_debug(RIG_DEBUG_ERR,
-                  "%s: synchronous data error code pipe open status=%d, err=%s\n", __func__,
-                  status, strerror(errno));
-        close_sync_data_pipe(p);
-        return (-RIG_EINTERNAL);
-    }
+        s = calloc(1, sizeof(struct port_io_state));
 
-    p->fd_sync_error_read = sync_pipe_fds[0];
-    p->fd_sync_error_write = sync_pipe_fds[1];
+        if (s != NULL)
+        {
+            s->port = p;
+            s->fd = p->fd;
+            s->replay_speed = 1;
+            s->next = port_io_state_head;
+            port_io_state_head = s;
+        }
+    }
+    else if (s->fd != p->fd)
+    {
+        /* port reopened behind our back, stale data is useless */
+        port_io_state_clear(s, p->fd);
+    }
 
-    rig_debug(RIG_DEBUG_VERBOSE,
-              "%s: created data pipe for synchronous transactions\n", __func__);
+    MUTEX_UNLOCK(port_io_state_mutex);
 
-    return (RIG_OK);
+    return s;
 }
 
-#endif
-
 /**
- * \brief Open a hamlib_port based on its rig port type
+ * \brief Reset the internal I/O state of a port
  * \param p rig port descriptor
- * \return status
+ *
+ * Drops any received bytes not yet handed out by read_string()/read_block()
+ * and any pending post write delay.  A running transmit queue is drained
+ * and its writer thread stopped, so this must be called while the fd is
+ * still open.  Settings made with the port_set_*() functions are kept.
  */
-int HAMLIB_API port_open(hamlib_port_t *p)
+void HAMLIB_API port_io_state_reset(const hamlib_port_t *p)
 {
-    int status;
-    int want_state_delay = 0;
+    struct port_io_state *s = port_io_state_find(p);
 
-    p->fd = -1;
-    init_sync_data_pipe(p);
-
-    if (p->asyncio)
+    if (s && s->txq)
     {
-        status = create_sync_data_pipe(p);
+        port_txq_stop(s->txq);
+    }
 
-        if (status < 0)
+    MUTEX_LOCK(port_io_state_mutex);
+
+    for (s = port_io_state_head; s != NULL; s = s->next)
+    {
+        if (s->port == p)
         {
-            return (status);
+            port_io_state_clear(s, -1);
+            break;
         }
     }
 
-    switch (p->type.rig)
-    {
-    case RIG_PORT_SERIAL:
-        status = serial_open(p);
+    MUTEX_UNLOCK(port_io_state_mutex);
+}
 
-        if (status < 0)
-        {
-#if defined(WIN32)
-//            rig_debug(RIG_DEBUG_ERR, "%s: serial_open(%s) status=%d, err=%s\n", __func__,
-//                      p->pathname, status, rigerror(status));
-#else
-            rig_debug(RIG_DEBUG_ERR, "%s: serial_open(%s) status=%d, err=%s\n", __func__,
-                      p->pathname, status, strerror(errno));
-#endif
-            close_sync_data_pipe(p);
-            return (status);
-        }
+/**
+ * \brief Release the internal I/O state of a port
+ * \param p rig port descriptor
+ *
+ * To be called before the memory holding \a p is freed.
+ * Safe to call more than once.
+ */
+void HAMLIB_API port_io_state_release(const hamlib_port_t *p)
+{
+    struct port_io_state *s, **prev;
 
-        if (p->parm.serial.rts_state != RIG_SIGNAL_UNSET
-                && p->parm.serial.handshake != RIG_HANDSHAKE_HARDWARE)
-        {
-            status = ser_set_rts(p,
-                                 p->parm.serial.rts_state == RIG_SIGNAL_ON);
-            want_state_delay = 1;
-        }
+    MUTEX_LOCK(port_io_state_mutex);
 
-        if (status != 0)
+    for (prev = &port_io_state_head; (s = *prev) != NULL; prev = &s->next)
+    {
+        if (s->port == p)
         {
-            close_sync_data_pipe(p);
-            return (status);
+            *prev = s->next;
+            break;
         }
+    }
 
-        if (p->parm.serial.dtr_state != RIG_SIGNAL_UNSET)
-        {
-            status = ser_set_dtr(p,
-                                 p->parm.serial.dtr_state == RIG_SIGNAL_ON);
-            want_state_delay = 1;
-        }
+    MUTEX_UNLOCK(port_io_state_mutex);
 
-        if (status != 0)
+    if (s != NULL)
+    {
+        if (s->txq)
         {
-            rig_debug(RIG_DEBUG_ERR, "%s: set_dtr status=%d\n", __func__, status);
-            close_sync_data_pipe(p);
-            return (status);
+            port_txq_stop(s->txq);
+            port_txq_free(s->txq);
         }
 
-        /*
-         * Wait whatever electrolytics in the circuit come up to voltage.
-         * Is 100ms enough? Too much?
-         */
-        if (want_state_delay)
+#if !(defined(WIN32) && defined(HAVE_WINDOWS_H))
+
+        if (s->sync)
         {
-            hl_usleep(100 * 1000);
+            pthread_mutex_destroy(&s->sync->lock);
+            free(s->sync);
         }
 
-        break;
+#endif
 
-    case RIG_PORT_PARALLEL:
-        status = par_open(p);
+        port_capture_stop(s);
+        wirereplay_close(s->replay);
 
-        if (status < 0)
+        if (s->adaptive_timeout > 0)
         {
-            close_sync_data_pipe(p);
-            return (status);
+            MUTEX_LOCK(port_io_state_mutex);
+            HL_ATOMIC_ADD(&port_rtt_count, -1);
+            MUTEX_UNLOCK(port_io_state_mutex);
         }
 
-        break;
+        rtt_stats_free(s->rtt);
+        free(s->capture_path);
+        free(s->replay_path);
+        free(s);
+    }
+}
 
-    case RIG_PORT_CM108:
-        status = cm108_open(p);
+/**
+ * \brief Select how post_write_delay is applied
+ * \param p rig port descriptor
+ * \param deferred 0 to sleep post_write_delay after every write, 1 to
+ * only keep the next write from starting before post_write_delay has passed
+ * \return RIG_OK or < 0
+ *
+ * In deferred mode write_block() returns as soon as the data is sent and
+ * the caller may go on reading the reply.  Whatever time is left of the
+ * delay when the next write comes along is slept then, so the spacing of
+ * commands on the wire is unchanged.
+ */
+int HAMLIB_API port_set_post_write_deferred(hamlib_port_t *p, int deferred)
+{
+    struct port_io_state *s = port_io_state_get(p);
 
-        if (status < 0)
-        {
-            close_sync_data_pipe(p);
-            return (status);
-        }
+    if (s == NULL)
+    {
+        return -RIG_ENOMEM;
+    }
 
-        break;
+    s->post_write_deferred = deferred ? 1 : 0;
+    s->next_write = 0;
 
-    case RIG_PORT_DEVICE:
-        status = open(p->pathname, O_RDWR, 0);
+    return RIG_OK;
+}
 
-        if (status < 0)
-        {
-            close_sync_data_pipe(p);
-            return (-RIG_EIO);
-        }
+/**
+ * \brief Tell if post_write_delay is deferred to the next write
+ * \param p rig port descriptor
+ * \return 1 if deferred, 0 otherwise
+ */
+int HAMLIB_API port_get_post_write_deferred(hamlib_port_t *p)
+{
+    const struct port_io_state *s = port_io_state_get(p);
 
-        p->fd = status;
-        break;
+    return s ? s->post_write_deferred : 0;
+}
 
-#if defined(HAVE_LIBUSB)
+static int port_set_path(char **dst, const char *path)
+{
+    char *copy = NULL;
 
-    case RIG_PORT_USB:
-        status = usb_port_open(p);
+    if (path != NULL && path[0] != '\0')
+    {
+        copy = strdup(path);
 
-        if (status < 0)
+        if (copy == NULL)
         {
-            close_sync_data_pipe(p);
-            return (status);
+            return -RIG_ENOMEM;
         }
+    }
 
-        break;
-#endif
+    free(*dst);
+    *dst = copy;
 
-    case RIG_PORT_NONE:
-    case RIG_PORT_RPC:
-        break;  /* ez :) */
+    return RIG_OK;
+}
 
-    case RIG_PORT_NETWORK:
-    case RIG_PORT_UDP_NETWORK:
-        /* FIXME: hardcoded network port */
-        status = network_open(p, 4532);
+static void port_capture_start(hamlib_port_t *p, struct port_io_state *s)
+{
+    if (s->capture_path == NULL || s->capture != NULL)
+    {
+        return;
+    }
 
-        if (status < 0)
-        {
-            close_sync_data_pipe(p);
-            return (status);
-        }
+    s->capture = wirecap_open(s->capture_path);
 
-        break;
+    if (s->capture == NULL)
+    {
+        /* not worth failing the open over */
+        rig_debug(RIG_DEBUG_ERR, "%s: capture to %s disabled\n", __func__,
+                  s->capture_path);
+        return;
+    }
 
-    default:
-        close_sync_data_pipe(p);
-        return (-RIG_EINVAL);
+    MUTEX_LOCK(port_io_state_mutex);
+    HL_ATOMIC_ADD(&port_capture_count, 1);
+    MUTEX_UNLOCK(port_io_state_mutex);
+}
+
+static void port_capture_stop(struct port_io_state *s)
+{
+    if (s->capture == NULL)
+    {
+        return;
     }
 
-    return (RIG_OK);
+    wirecap_close(s->capture);
+    s->capture = NULL;
+
+    MUTEX_LOCK(port_io_state_mutex);
+    HL_ATOMIC_ADD(&port_capture_count, -1);
+    MUTEX_UNLOCK(port_io_state_mutex);
 }
 
+static void port_capture(const hamlib_port_t *p, int dir,
+                         const unsigned char *data, size_t len)
+{
+    const struct port_io_state *s;
+
+    if (HL_ATOMIC_LOAD_RELAXED(&port_capture_count) == 0 || len == 0)
+    {
+        return;
+    }
+
+    s = port_io_state_find(p);
+
+    if (s && s->capture)
+    {
+        wirecap_record(s->capture, dir, data, len);
+    }
+}
 
 /**
- * \brief Close a hamlib_port
+ * \brief Record the traffic of a port to a capture file
  * \param p rig port descriptor
- * \param port_type equivalent rig port type
- * \return status
+ * \param path file to create, NULL or "" to stop capturing
+ * \return RIG_OK or < 0
+ *
+ * Every write_block() and every read from the device is written to the
+ * file with its direction and a monotonic timestamp.  The file is created
+ * when the port is opened, or right away if it is open already, and can
+ * be fed back to a backend later through a RIG_PORT_REPLAY port.
  */
-int HAMLIB_API port_close(hamlib_port_t *p, rig_port_t port_type)
+int HAMLIB_API port_set_capture_file(hamlib_port_t *p, const char *path)
 {
-    int ret = RIG_OK;
+    struct port_io_state *s = port_io_state_get(p);
+    int ret;
 
-    if (p->fd != -1)
+    if (s == NULL)
     {
-        switch (port_type)
-        {
-        case RIG_PORT_SERIAL:
-            ret = ser_close(p);
-            break;
+        return -RIG_ENOMEM;
+    }
 
-#if defined(HAVE_LIBUSB)
+    port_capture_stop(s);
+    ret = port_set_path(&s->capture_path, path);
 
-        case RIG_PORT_USB:
-            ret = usb_port_close(p);
-            break;
-#endif
+    if (ret == RIG_OK && p->fd >= 0)
+    {
+        port_capture_start(p, s);
+    }
 
-        case RIG_PORT_NETWORK:
-        case RIG_PORT_UDP_NETWORK:
-            ret = network_close(p);
-            break;
+    return ret;
+}
 
-        default:
-            rig_debug(RIG_DEBUG_ERR, "%s(): Unknown port type %d\n",
-                      __func__, port_type);
-            HL_FALLTHROUGH
+/**
+ * \brief Get the capture file of a port
+ * \param p rig port descriptor
+ * \return the path, "" if the port is not captured
+ */
+const char *HAMLIB_API port_get_capture_file(hamlib_port_t *p)
+{
+    const struct port_io_state *s = port_io_state_get(p);
 
-        case RIG_PORT_DEVICE:
-            ret = close(p->fd);
-        }
+    return s && s->capture_path ? s->capture_path : "";
+}
 
-        p->fd = -1;
+/**
+ * \brief Play back a capture file instead of talking to a device
+ * \param p rig port descriptor
+ * \param path capture made with port_set_capture_file()
+ * \return RIG_OK or < 0
+ *
+ * Turns \a p into a RIG_PORT_REPLAY port.  Once opened, writes are
+ * matched against the TX records of the capture and reads return its RX
+ * records, timed relative to the write before them as set by
+ * port_set_replay_speed().  A write that differs from the capture is
+ * logged and replay goes on, so a backend change can be benchmarked
+ * against the traffic of the old code.
+ */
+int HAMLIB_API port_set_replay_file(hamlib_port_t *p, const char *path)
+{
+    struct port_io_state *s = port_io_state_get(p);
+    int ret;
+
+    if (s == NULL)
+    {
+        return -RIG_ENOMEM;
     }
 
-    close_sync_data_pipe(p);
+    ret = port_set_path(&s->replay_path, path);
 
-    return (ret);
-}
+    if (ret == RIG_OK && s->replay_path != NULL)
+    {
+        p->type.rig = RIG_PORT_REPLAY;
+    }
 
+    return ret;
+}
 
-#if defined(WIN32) && !defined(HAVE_TERMIOS_H)
-#  include "win32termios.h"
+/**
+ * \brief Get the replay file of a port
+ * \param p rig port descriptor
+ * \return the path, "" if none
+ */
+const char *HAMLIB_API port_get_replay_file(hamlib_port_t *p)
+{
+    const struct port_io_state *s = port_io_state_get(p);
 
-extern int is_uh_radio_fd(int fd);
+    return s && s->replay_path ? s->replay_path : "";
+}
 
-static int port_read_sync_data_error_code(hamlib_port_t *p)
+/**
+ * \brief Set the playback speed of a RIG_PORT_REPLAY port
+ * \param p rig port descriptor
+ * \param speed 1 to answer as fast as the rig did, 2 twice as fast, ...
+ * 0 to answer at once and not wait out timeouts either
+ * \return RIG_OK or < 0
+ *
+ * Takes effect the next time the port is opened.
+ */
+int HAMLIB_API port_set_replay_speed(hamlib_port_t *p, double speed)
 {
-    ssize_t total_bytes_read = 0;
-    signed char data;
-    int result;
+    struct port_io_state *s = port_io_state_get(p);
 
-    do
+    if (s == NULL)
     {
-        // Wait for data using a zero-length read
-        result = async_pipe_read(p->sync_data_error_pipe, &data, 0, p->timeout);
-
-        if (result < 0)
-        {
-            if (result == -RIG_ETIMEOUT)
-            {
-                if (total_bytes_read > 0)
-                {
-                    return data;
-                }
-            }
-
-            return result;
-        }
+        return -RIG_ENOMEM;
+    }
 
-        result = async_pipe_read(p->sync_data_error_pipe, &data, 1, p->timeout);
+    if (speed < 0)
+    {
+        return -RIG_EINVAL;
+    }
 
-        if (result < 0)
-        {
-            if (result == -RIG_ETIMEOUT)
-            {
-                if (total_bytes_read > 0)
-                {
-                    return data;
-                }
-            }
+    s->replay_speed = speed;
 
-            return result;
-        }
+    return RIG_OK;
+}
 
-        total_bytes_read += result;
-    }
-    while (result > 0);
+/**
+ * \brief Get the playback speed of a RIG_PORT_REPLAY port
+ * \param p rig port descriptor
+ * \return speed factor
+ */
+double HAMLIB_API port_get_replay_speed(hamlib_port_t *p)
+{
+    const struct port_io_state *s = port_io_state_get(p);
 
-    return data;
+    return s ? s->replay_speed : 1;
 }
 
-static int port_read_sync_data(hamlib_port_t *p, void *buf, size_t count)
+/**
+ * \brief Let the reply timeout follow the observed reply times
+ * \param p rig port descriptor
+ * \param factor 0 to always wait p->timeout, else wait factor times the
+ * 99th percentile of the time the rig took to answer the same kind of
+ * command, never longer than p->timeout
+ * \return RIG_OK or < 0
+ *
+ * The time from the end of each write to the end of the reply frame, an
+ * echo of the command not counting, is kept per command class, the leading letters of a text command or the first
+ * bytes of a binary one.  A class waits the full p->timeout until it has
+ * enough replies of its own, or while more than one in eight of its
+ * replies times out, so a lost reply on a quick rig costs a few
+ * milliseconds without starving the slow commands.  Retry counts are
+ * left alone; each retry simply waits the shorter time.
+ */
+int HAMLIB_API port_set_adaptive_timeout(hamlib_port_t *p, int factor)
 {
-    // Wait for data in both the response data pipe and the error code pipe to detect errors occurred during read
-    LARGE_INTEGER timeout;
-    HANDLE hLocal = CreateWaitableTimer(NULL, FALSE, NULL);
-    HANDLE event_handles[3] =
+    struct port_io_state *s = port_io_state_get(p);
+
+    if (s == NULL)
     {
-        p->sync_data_pipe->read_overlapped.hEvent,
-        p->sync_data_error_pipe->read_overlapped.hEvent,
-        hLocal
-    };
-    HANDLE read_handle = p->sync_data_pipe->read;
-    LPOVERLAPPED overlapped = &p->sync_data_pipe->read_overlapped;
-    DWORD wait_result;
-    int result;
-    ssize_t bytes_read;
+        return -RIG_ENOMEM;
+    }
 
-    result = ReadFile(p->sync_data_pipe->read, buf, count, NULL, overlapped);
+    if (factor < 0)
+    {
+        return -RIG_EINVAL;
+    }
 
-    if (!result)
+    if (factor > 0 && s->rtt == NULL)
     {
-        result = GetLastError();
+        s->rtt = rtt_stats_new();
 
-        switch (result)
+        if (s->rtt == NULL)
         {
-        case ERROR_SUCCESS:
-            // No error?
-            break;
-
-        case ERROR_IO_PENDING:
-            timeout.QuadPart = (p->timeout * -1000000LL);
-
-            if ((result = SetWaitableTimer(hLocal, &timeout, 0, NULL, NULL, 0)) == 0)
-            {
-                rig_debug(RIG_DEBUG_ERR, "%s: SetWaitableTimer error: %d\n", __func__, result);
-                wait_result = WaitForMultipleObjects(3, event_handles, FALSE, INFINITE);
-            }
-            else
-            {
-                wait_result = WaitForMultipleObjects(3, event_handles, FALSE, p->timeout);
-            }
+            return -RIG_ENOMEM;
+        }
+    }
 
+    MUTEX_LOCK(port_io_state_mutex);
+    HL_ATOMIC_ADD(&port_rtt_count, (factor > 0) - (s->adaptive_timeout > 0));
+    s->adaptive_timeout = factor;
+    MUTEX_UNLOCK(port_io_state_mutex);
 
-            switch (wait_result)
-            {
-            case WAIT_OBJECT_0 + 0:
-                break;
+    return RIG_OK;
+}
 
-            case WAIT_OBJECT_0 + 1:
-                return port_read_sync_data_error_code(p);
+/**
+ * \brief Get the adaptive timeout factor of a port
+ * \param p rig port descriptor
+ * \return factor, 0 if off
+ */
+int HAMLIB_API port_get_adaptive_timeout(hamlib_port_t *p)
+{
+    const struct port_io_state *s = port_io_state_get(p);
 
-            case WAIT_OBJECT_0 + 2:
-                if (count == 0)
-                {
-                    CancelIo(read_handle);
-                    return -RIG_ETIMEOUT;
-                }
-                else
-                {
-                    // Should not happen
-                    return -RIG_EINTERNAL;
-                }
+    return s ? s->adaptive_timeout : 0;
+}
 
-            default:
-                result = GetLastError();
-                rig_debug(RIG_DEBUG_ERR, "%s(): WaitForMultipleObjects() error: %d\n", __func__,
-                          result);
-                return -RIG_EINTERNAL;
-            }
+/**
+ * \brief Describe the reply times learned on a port
+ * \param p rig port descriptor
+ * \param buf where to put the text
+ * \param len size of buf
+ * \return length of the text
+ *
+ * One entry for the whole port, then one per command class with the
+ * count of recent replies and timeouts, p50 and p99 of the reply time
+ * and the timeout the class uses now, all times in ms:
+ * "* n=812 to=3 p50=1.41 p99=5.66 FA n=301 to=0 p50=1.41 p99=2.83 timeout=10".
+ * Empty while adaptive_timeout has never been on.
+ */
+int HAMLIB_API port_get_timeout_learned(hamlib_port_t *p, char *buf, int len)
+{
+    const struct port_io_state *s = port_io_state_get(p);
 
-            break;
+    if (s == NULL || s->rtt == NULL)
+    {
+        if (len > 0) { buf[0] = '\0'; }
 
-        default:
-            rig_debug(RIG_DEBUG_ERR, "%s(): ReadFile() error: %d\n", __func__, result);
-            return -RIG_EIO;
-        }
+        return 0;
     }
 
-    result = GetOverlappedResult(read_handle, overlapped, (LPDWORD) &bytes_read,
-                                 FALSE);
+    return rtt_format(s->rtt, buf, len, p->timeout, s->adaptive_timeout);
+}
 
-    if (!result)
+/**
+ * \brief Forget the reply times learned on a port
+ * \param p rig port descriptor
+ * \return RIG_OK
+ */
+int HAMLIB_API port_reset_timeout_learned(hamlib_port_t *p)
+{
+    const struct port_io_state *s = port_io_state_get(p);
+
+    if (s && s->rtt)
     {
-        result = GetLastError();
+        rtt_stats_reset(s->rtt);
+    }
 
-        switch (result)
-        {
-        case ERROR_SUCCESS:
-            // No error?
-            bytes_read = 0;
-            break;
+    return RIG_OK;
+}
 
-        case ERROR_IO_PENDING:
-            // Shouldn't happen?
-            bytes_read = 0;
-            return -RIG_ETIMEOUT;
+/*
+ * The port state when this wait is for the reply to a transaction and
+ * the port has adaptive_timeout on.  With asyncio the async data handler
+ * reads the device and the transaction waits on the sync data channel.
+ */
+static struct port_io_state *port_rtt_state(const hamlib_port_t *p,
+        int direct)
+{
+    struct port_io_state *s;
 
-        default:
-            rig_debug(RIG_DEBUG_ERR, "%s(): GetOverlappedResult() error: %d\n", __func__,
-                      result);
-            return -RIG_EIO;
-        }
+    if (HL_ATOMIC_LOAD_RELAXED(&port_rtt_count) == 0
+            || (direct != 0) == (p->asyncio != 0))
+    {
+        return NULL;
     }
 
-    return bytes_read;
+    s = port_io_state_find(p);
+
+    return s && s->adaptive_timeout > 0 ? s : NULL;
 }
 
-static int port_wait_for_data_sync_pipe(hamlib_port_t *p)
+static void port_rtt_sent(const hamlib_port_t *p, const unsigned char *data,
+                          size_t len)
 {
-    unsigned char data;
-    int result;
-
-    // Use a zero-length read to wait for data in pipe
-    result = port_read_sync_data(p, &data, 0);
+    const struct port_io_state *s;
 
-    if (result > 0)
+    if (HL_ATOMIC_LOAD_RELAXED(&port_rtt_count) == 0)
     {
-        return RIG_OK;
+        return;
     }
 
-    return result;
+    s = port_io_state_find(p);
+
+    if (s && s->adaptive_timeout > 0)
+    {
+        rtt_sent(s->rtt, data, len);
+    }
 }
 
-static ssize_t port_read_sync_data_pipe(hamlib_port_t *p, void *buf,
-                                        size_t count)
+/* a transaction read a whole frame */
+static void port_rtt_received(const hamlib_port_t *p,
+                              const unsigned char *frame, size_t len, int direct)
 {
-    return port_read_sync_data(p, buf, count);
+    const struct port_io_state *s = port_rtt_state(p, direct);
+
+    if (s)
+    {
+        rtt_received(s->rtt, frame, len);
+    }
 }
 
-/* On MinGW32/MSVC/.. the appropriate accessor must be used
- * depending on the port type, sigh.
+/**
+ * \brief Get the traffic counters of a port
+ * \param p rig port descriptor
+ * \param buf where to put the text
+ * \param len size of buf
+ * \return length of the text
+ *
+ * Bytes written to and read from the device, replies that timed out, the
+ * writes that repeated the command of such a reply, and the async frames
+ * processed, counted since the port was first used:
+ * "tx_bytes=1022 rx_bytes=4090 timeouts=2 retries=1 async_frames=0".
  */
-static ssize_t port_read_generic(hamlib_port_t *p, void *buf, size_t count,
-                                 int direct)
+int HAMLIB_API port_get_stats(hamlib_port_t *p, char *buf, int len)
 {
-    int fd = p->fd;
-    int i;
-    ssize_t bytes_read;
+    const struct port_io_state *s = port_io_state_get(p);
+    struct port_io_stats st;
 
-    if (!direct)
+    if (len <= 0)
     {
-        return port_read_sync_data_pipe(p, buf, count);
+        return 0;
     }
 
-    /*
-     * Since WIN32 does its special serial read, we have
-     * to catch the microHam case to do just "read".
-     * Note that we always have RIG_PORT_SERIAL in the
-     * microHam case.
-     */
-    if (is_uh_radio_fd(fd))
+    if (s == NULL)
     {
-        return read(fd, buf, count);
+        buf[0] = '\0';
+        return 0;
     }
 
-    if (p->type.rig == RIG_PORT_SERIAL)
-    {
-        bytes_read = win32_serial_read(fd, buf, (int) count);
+    st = s->stats;
 
-        if (p->parm.serial.data_bits == 7)
-        {
-            unsigned char *pbuf = buf;
+    return snprintf(buf, len,
+                    "tx_bytes=%lu rx_bytes=%lu timeouts=%lu retries=%lu async_frames=%lu",
+                    st.tx_bytes, st.rx_bytes, st.timeouts, st.retries, st.async_frames);
+}
+
+/**
+ * \brief Zero the traffic counters of a port
+ * \param p rig port descriptor
+ * \return RIG_OK
+ */
+int HAMLIB_API port_reset_stats(hamlib_port_t *p)
+{
+    struct port_io_state *s = port_io_state_get(p);
+
+    if (s)
+    {
+        memset(&s->stats, 0, sizeof(s->stats));
+    }
+
+    return RIG_OK;
+}
+
+/**
+ * \brief Bytes written to and read from a port
+ * \param p rig port descriptor
+ * \return tx_bytes + rx_bytes of port_get_stats()
+ *
+ * What a transaction cost is the difference of this before and after it.
+ */
+unsigned long HAMLIB_API port_get_traffic(hamlib_port_t *p)
+{
+    const struct port_io_state *s = port_io_state_get(p);
+
+    return s ? s->stats.tx_bytes + s->stats.rx_bytes : 0;
+}
+
+/**
+ * \brief Count an async frame processed on a port
+ * \param p rig port descriptor
+ */
+void HAMLIB_API port_count_async_frame(const hamlib_port_t *p)
+{
+    struct port_io_state *s = port_io_state_find(p);
+
+    if (s)
+    {
+        s->stats.async_frames++;
+    }
+}
+
+static void port_stats_sent(const hamlib_port_t *p, const unsigned char *data,
+                            size_t len)
+{
+    struct port_io_state *s = port_io_state_find(p);
+    unsigned long hash = 5381;
+    size_t i;
+
+    if (s == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        hash = hash * 33 ^ data[i];
+    }
+
+    if (s->stats.timed_out && hash == s->stats.last_tx)
+    {
+        s->stats.retries++;
+    }
+
+    s->stats.timed_out = 0;
+    s->stats.last_tx = hash;
+    s->stats.tx_bytes += len;
+}
+
+static void port_stats_received(const hamlib_port_t *p, size_t len)
+{
+    struct port_io_state *s = port_io_state_find(p);
+
+    if (s)
+    {
+        s->stats.rx_bytes += len;
+    }
+}
+
+/* a reply timed out, the idle waits of an async data handler do not count */
+static void port_stats_timed_out(const hamlib_port_t *p, int direct)
+{
+    struct port_io_state *s;
+
+    if ((direct != 0) == (p->asyncio != 0))
+    {
+        return;
+    }
+
+    s = port_io_state_find(p);
+
+    if (s)
+    {
+        s->stats.timeouts++;
+        s->stats.timed_out = 1;
+    }
+}
+
+static struct wirereplay *port_replay_get(const hamlib_port_t *p)
+{
+    const struct port_io_state *s = port_io_state_find(p);
+
+    return s ? s->replay : NULL;
+}
+
+static int port_replay_open(hamlib_port_t *p)
+{
+    struct port_io_state *s = port_io_state_get(p);
+
+    if (s == NULL || s->replay_path == NULL)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: no replay_file set\n", __func__);
+        return -RIG_ECONF;
+    }
+
+    s->replay = wirereplay_open(s->replay_path, s->replay_speed);
+
+    if (s->replay == NULL)
+    {
+        return -RIG_EIO;
+    }
+
+    /* a real fd keeps the fd checks all over the I/O layer happy */
+    p->fd = open(s->replay_path, O_RDONLY);
+
+    if (p->fd < 0)
+    {
+        wirereplay_close(s->replay);
+        s->replay = NULL;
+        return -RIG_EIO;
+    }
+
+    s->fd = p->fd;
+
+    return RIG_OK;
+}
+
+static int port_replay_close(hamlib_port_t *p)
+{
+    struct port_io_state *s = port_io_state_find(p);
+
+    if (s)
+    {
+        wirereplay_close(s->replay);
+        s->replay = NULL;
+    }
+
+    return close(p->fd);
+}
+
+static struct port_rxbuf *port_rxbuf_get(hamlib_port_t *p, int direct)
+{
+    struct port_io_state *s = port_io_state_get(p);
+
+    return s ? &s->rx[direct ? 1 : 0] : NULL;
+}
+
+#if !(defined(WIN32) && defined(HAVE_WINDOWS_H))
+/* created with the sync data fds, kept until the state is released */
+static struct port_sync_chan *port_sync_chan_get(const hamlib_port_t *p)
+{
+    struct port_io_state *s = port_io_state_get(p);
+
+    if (s == NULL)
+    {
+        return NULL;
+    }
+
+    if (s->sync == NULL)
+    {
+        struct port_sync_chan *c = calloc(1, sizeof(struct port_sync_chan));
+
+        if (c == NULL)
+        {
+            return NULL;
+        }
+
+        pthread_mutex_init(&c->lock, NULL);
+        s->sync = c;
+    }
+
+    return s->sync;
+}
+#endif
+
+/**
+ * \brief Number of received bytes buffered but not yet read
+ * \param p rig port descriptor
+ * \return byte count
+ */
+int HAMLIB_API port_rx_pending(hamlib_port_t *p)
+{
+    const struct port_rxbuf *rx = port_rxbuf_get(p, !p->asyncio);
+
+    return rx ? (int)(rx->end - rx->start) : 0;
+}
+
+/**
+ * \brief Discard received bytes buffered but not yet read
+ * \param p rig port descriptor
+ * \param direct 1 for the device buffer, 0 for the sync data pipe buffer
+ * \return number of bytes discarded
+ */
+int HAMLIB_API port_rx_discard(hamlib_port_t *p, int direct)
+{
+    struct port_rxbuf *rx = port_rxbuf_get(p, direct);
+    int n;
+
+    if (rx == NULL)
+    {
+        return 0;
+    }
+
+    n = (int)(rx->end - rx->start);
+
+    if (n > 0)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: discarding %d buffered bytes, direct=%d\n",
+                  __func__, n, direct);
+        dump_hex(rx->data + rx->start, n);
+    }
+
+    rx->start = rx->end = 0;
+
+    return n;
+}
+
+/**
+ * \brief Open a hamlib_port based on its rig port type
+ * \param p rig port descriptor
+ * \return status
+ */
+int HAMLIB_API port_open(hamlib_port_t *p)
+{
+    int status;
+    int want_state_delay = 0;
+
+    p->fd = -1;
+    port_io_state_reset(p);
+    init_sync_data_pipe(p);
+
+    if (p->asyncio)
+    {
+        status = create_sync_data_pipe(p);
+
+        if (status < 0)
+        {
+            return (status);
+        }
+    }
+
+    switch (p->type.rig)
+    {
+    case RIG_PORT_SERIAL:
+        status = serial_open(p);
+
+        if (status < 0)
+        {
+#if defined(WIN32)
+//            rig_debug(RIG_DEBUG_ERR, "%s: serial_open(%s) status=%d, err=%s\n", __func__,
+//                      p->pathname, status, rigerror(status));
+#else
+            rig_debug(RIG_DEBUG_ERR, "%s: serial_open(%s) status=%d, err=%s\n", __func__,
+                      p->pathname, status, strerror(errno));
+#endif
+            close_sync_data_pipe(p);
+            return (status);
+        }
+
+        if (p->parm.serial.rts_state != RIG_SIGNAL_UNSET
+                && p->parm.serial.handshake != RIG_HANDSHAKE_HARDWARE)
+        {
+            status = ser_set_rts(p,
+                                 p->parm.serial.rts_state == RIG_SIGNAL_ON);
+            want_state_delay = 1;
+        }
+
+        if (status != 0)
+        {
+            close_sync_data_pipe(p);
+            return (status);
+        }
+
+        if (p->parm.serial.dtr_state != RIG_SIGNAL_UNSET)
+        {
+            status = ser_set_dtr(p,
+                                 p->parm.serial.dtr_state == RIG_SIGNAL_ON);
+            want_state_delay = 1;
+        }
+
+        if (status != 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: set_dtr status=%d\n", __func__, status);
+            close_sync_data_pipe(p);
+            return (status);
+        }
+
+        /*
+         * Wait whatever electrolytics in the circuit come up to voltage.
+         * Is 100ms enough? Too much?
+         */
+        if (want_state_delay)
+        {
+            hl_usleep(100 * 1000);
+        }
+
+        break;
+
+    case RIG_PORT_PARALLEL:
+        status = par_open(p);
+
+        if (status < 0)
+        {
+            close_sync_data_pipe(p);
+            return (status);
+        }
+
+        break;
+
+    case RIG_PORT_CM108:
+        status = cm108_open(p);
+
+        if (status < 0)
+        {
+            close_sync_data_pipe(p);
+            return (status);
+        }
+
+        break;
+
+    case RIG_PORT_DEVICE:
+        status = open(p->pathname, O_RDWR, 0);
+
+        if (status < 0)
+        {
+            close_sync_data_pipe(p);
+            return (-RIG_EIO);
+        }
+
+        p->fd = status;
+        break;
+
+#if defined(HAVE_LIBUSB)
+
+    case RIG_PORT_USB:
+        status = usb_port_open(p);
+
+        if (status < 0)
+        {
+            close_sync_data_pipe(p);
+            return (status);
+        }
+
+        break;
+#endif
+
+    case RIG_PORT_NONE:
+    case RIG_PORT_RPC:
+        break;  /* ez :) */
+
+    case RIG_PORT_NETWORK:
+    case RIG_PORT_UDP_NETWORK:
+        /* FIXME: hardcoded network port */
+        status = network_open(p, 4532);
+
+        if (status < 0)
+        {
+            close_sync_data_pipe(p);
+            return (status);
+        }
+
+        break;
+
+    case RIG_PORT_REPLAY:
+        status = port_replay_open(p);
+
+        if (status < 0)
+        {
+            close_sync_data_pipe(p);
+            return (status);
+        }
+
+        break;
+
+    default:
+        close_sync_data_pipe(p);
+        return (-RIG_EINVAL);
+    }
+
+    if (p->fd >= 0)
+    {
+        struct port_io_state *s = port_io_state_find(p);
+
+        if (s)
+        {
+            port_capture_start(p, s);
+        }
+    }
+
+    return (RIG_OK);
+}
+
+
+/**
+ * \brief Close a hamlib_port
+ * \param p rig port descriptor
+ * \param port_type equivalent rig port type
+ * \return status
+ */
+int HAMLIB_API port_close(hamlib_port_t *p, rig_port_t port_type)
+{
+    int ret = RIG_OK;
+
+    if (p->fd != -1)
+    {
+        /* let queued writes out while the fd is still good */
+        port_io_state_reset(p);
+
+        switch (port_type)
+        {
+        case RIG_PORT_SERIAL:
+            ret = ser_close(p);
+            break;
+
+#if defined(HAVE_LIBUSB)
+
+        case RIG_PORT_USB:
+            ret = usb_port_close(p);
+            break;
+#endif
+
+        case RIG_PORT_NETWORK:
+        case RIG_PORT_UDP_NETWORK:
+            ret = network_close(p);
+            break;
+
+        case RIG_PORT_REPLAY:
+            ret = port_replay_close(p);
+            break;
+
+        default:
+            rig_debug(RIG_DEBUG_ERR, "%s(): Unknown port type %d\n",
+                      __func__, port_type);
+            HL_FALLTHROUGH
+
+        case RIG_PORT_DEVICE:
+            ret = close(p->fd);
+        }
+
+        p->fd = -1;
+    }
+
+    close_sync_data_pipe(p);
+    port_io_state_reset(p);
+
+    {
+        struct port_io_state *s = port_io_state_find(p);
+
+        if (s)
+        {
+            port_capture_stop(s);
+        }
+    }
+
+    return (ret);
+}
+
+
+#if defined(WIN32) && !defined(HAVE_TERMIOS_H)
+#  include "win32termios.h"
+
+extern int is_uh_radio_fd(int fd);
+
+static int port_read_sync_data_error_code(hamlib_port_t *p)
+{
+    ssize_t total_bytes_read = 0;
+    signed char data;
+    int result;
+
+    do
+    {
+        // Wait for data using a zero-length read
+        result = async_pipe_read(p->sync_data_error_pipe, &data, 0, p->timeout);
+
+        if (result < 0)
+        {
+            if (result == -RIG_ETIMEOUT)
+            {
+                if (total_bytes_read > 0)
+                {
+                    return data;
+                }
+            }
+
+            return result;
+        }
+
+        result = async_pipe_read(p->sync_data_error_pipe, &data, 1, p->timeout);
+
+        if (result < 0)
+        {
+            if (result == -RIG_ETIMEOUT)
+            {
+                if (total_bytes_read > 0)
+                {
+                    return data;
+                }
+            }
+
+            return result;
+        }
+
+        total_bytes_read += result;
+    }
+    while (result > 0);
+
+    return data;
+}
+
+static int port_read_sync_data(hamlib_port_t *p, void *buf, size_t count)
+{
+    // Wait for data in both the response data pipe and the error code pipe to detect errors occurred during read
+    LARGE_INTEGER timeout;
+    HANDLE hLocal = CreateWaitableTimer(NULL, FALSE, NULL);
+    HANDLE event_handles[3] =
+    {
+        p->sync_data_pipe->read_overlapped.hEvent,
+        p->sync_data_error_pipe->read_overlapped.hEvent,
+        hLocal
+    };
+    HANDLE read_handle = p->sync_data_pipe->read;
+    LPOVERLAPPED overlapped = &p->sync_data_pipe->read_overlapped;
+    DWORD wait_result;
+    int result;
+    ssize_t bytes_read;
+
+    result = ReadFile(p->sync_data_pipe->read, buf, count, NULL, overlapped);
+
+    if (!result)
+    {
+        result = GetLastError();
+
+        switch (result)
+        {
+        case ERROR_SUCCESS:
+            // No error?
+            break;
+
+        case ERROR_IO_PENDING:
+            timeout.QuadPart = (p->timeout * -1000000LL);
+
+            if ((result = SetWaitableTimer(hLocal, &timeout, 0, NULL, NULL, 0)) == 0)
+            {
+                rig_debug(RIG_DEBUG_ERR, "%s: SetWaitableTimer error: %d\n", __func__, result);
+                wait_result = WaitForMultipleObjects(3, event_handles, FALSE, INFINITE);
+            }
+            else
+            {
+                wait_result = WaitForMultipleObjects(3, event_handles, FALSE, p->timeout);
+            }
+
+
+            switch (wait_result)
+            {
+            case WAIT_OBJECT_0 + 0:
+                break;
+
+            case WAIT_OBJECT_0 + 1:
+                return port_read_sync_data_error_code(p);
+
+            case WAIT_OBJECT_0 + 2:
+                if (count == 0)
+                {
+                    CancelIo(read_handle);
+                    return -RIG_ETIMEOUT;
+                }
+                else
+                {
+                    // Should not happen
+                    return -RIG_EINTERNAL;
+                }
+
+            default:
+                result = GetLastError();
+                rig_debug(RIG_DEBUG_ERR, "%s(): WaitForMultipleObjects() error: %d\n", __func__,
+                          result);
+                return -RIG_EINTERNAL;
+            }
+
+            break;
+
+        default:
+            rig_debug(RIG_DEBUG_ERR, "%s(): ReadFile() error: %d\n", __func__, result);
+            return -RIG_EIO;
+        }
+    }
+
+    result = GetOverlappedResult(read_handle, overlapped, (LPDWORD) &bytes_read,
+                                 FALSE);
+
+    if (!result)
+    {
+        result = GetLastError();
+
+        switch (result)
+        {
+        case ERROR_SUCCESS:
+            // No error?
+            bytes_read = 0;
+            break;
+
+        case ERROR_IO_PENDING:
+            // Shouldn't happen?
+            bytes_read = 0;
+            return -RIG_ETIMEOUT;
+
+        default:
+            rig_debug(RIG_DEBUG_ERR, "%s(): GetOverlappedResult() error: %d\n", __func__,
+                      result);
+            return -RIG_EIO;
+        }
+    }
+
+    return bytes_read;
+}
+
+static int port_wait_for_data_sync_pipe(hamlib_port_t *p)
+{
+    unsigned char data;
+    int result;
+
+    // Use a zero-length read to wait for data in pipe
+    result = port_read_sync_data(p, &data, 0);
+
+    if (result > 0)
+    {
+        return RIG_OK;
+    }
+
+    return result;
+}
+
+static ssize_t port_read_sync_data_pipe(hamlib_port_t *p, void *buf,
+                                        size_t count)
+{
+    return port_read_sync_data(p, buf, count);
+}
+
+/* On MinGW32/MSVC/.. the appropriate accessor must be used
+ * depending on the port type, sigh.
+ */
+static ssize_t port_read_generic(hamlib_port_t *p, void *buf, size_t count,
+                                 int direct)
+{
+    int fd = p->fd;
+    int i;
+    ssize_t bytes_read;
+
+    if (!direct)
+    {
+        return port_read_sync_data_pipe(p, buf, count);
+    }
+
+    /*
+     * Since WIN32 does its special serial read, we have
+     * to catch the microHam case to do just "read".
+     * Note that we always have RIG_PORT_SERIAL in the
+     * microHam case.
+     */
+    if (is_uh_radio_fd(fd))
+    {
+        return read(fd, buf, count);
+    }
+
+    if (p->type.rig == RIG_PORT_SERIAL)
+    {
+        bytes_read = win32_serial_read(fd, buf, (int) count);
+
+        if (p->parm.serial.data_bits == 7)
+        {
+            unsigned char *pbuf = buf;
+
+            /* clear MSB */
+            for (i = 0; i < bytes_read; i++)
+            {
+                pbuf[i] &= ~0x80;
+            }
+        }
+
+        return bytes_read;
+    }
+    else if (p->type.rig == RIG_PORT_NETWORK || p->type.rig == RIG_PORT_UDP_NETWORK)
+    {
+        return recv(fd, buf, count, 0);
+    }
+    else
+    {
+        return read(fd, buf, count);
+    }
+}
+
+static ssize_t port_write(hamlib_port_t *p, const void *buf, size_t count)
+{
+    /*
+     * Since WIN32 does its special serial write, we have
+     * to catch the microHam case to do just "write".
+     * Note that we always have RIG_PORT_SERIAL in the
+     * microHam case.
+     */
+    if (is_uh_radio_fd(p->fd))
+    {
+        return write(p->fd, buf, count);
+    }
+
+    if (p->type.rig == RIG_PORT_SERIAL)
+    {
+        return win32_serial_write(p->fd, buf, (int) count);
+    }
+    else if (p->type.rig == RIG_PORT_NETWORK
+             || p->type.rig == RIG_PORT_UDP_NETWORK)
+    {
+        return send(p->fd, buf, count, 0);
+    }
+    else
+    {
+        return write(p->fd, buf, count);
+    }
+}
+
+static int port_select(hamlib_port_t *p,
+                       int n,
+                       fd_set *readfds,
+                       fd_set *writefds,
+                       fd_set *exceptfds,
+                       struct timeval *timeout,
+                       int direct)
+{
+#if 1
+
+    /* select does not work very well with writefds/exceptfds
+     * So let's pretend there's none of them
+     */
+    if (exceptfds)
+    {
+        FD_ZERO(exceptfds);
+    }
+
+    if (writefds)
+    {
+        FD_ZERO(writefds);
+    }
+
+    writefds = NULL;
+    exceptfds = NULL;
+#endif
 
-            /* clear MSB */
-            for (i = 0; i < bytes_read; i++)
-            {
-                pbuf[i] &= ~0x80;
-            }
+    /*
+     * Since WIN32 does its special serial select, we have
+     * to catch the microHam case to do just "select".
+     * Note that we always have RIG_PORT_SERIAL in the
+     * microHam case.
+     */
+    if (direct && is_uh_radio_fd(p->fd))
+    {
+        return select(n, readfds, writefds, exceptfds, timeout);
+    }
+
+    if (direct && p->type.rig == RIG_PORT_SERIAL)
+    {
+        return win32_serial_select(n, readfds, writefds, exceptfds, timeout);
+    }
+    else
+    {
+        return select(n, readfds, writefds, exceptfds, timeout);
+    }
+}
+
+static int port_wait_for_data_direct(hamlib_port_t *p, int timeout)
+{
+    fd_set rfds, efds;
+    int fd = p->fd;
+    struct timeval tv, tv_timeout;
+    int result;
+
+    tv_timeout.tv_sec = timeout / 1000;
+    tv_timeout.tv_usec = (timeout % 1000) * 1000;
+    //rig_debug(RIG_DEBUG_CACHE, "%s(%d): timeout=%ld,%ld\n", __func__, __LINE__, tv_timeout.tv_sec, tv_timeout.tv_usec);
+
+    tv = tv_timeout;    /* select may have updated it */
+
+    FD_ZERO(&rfds);
+    FD_SET(fd, &rfds);
+    efds = rfds;
+
+    result = port_select(p, fd + 1, &rfds, NULL, &efds, &tv, 1);
+    //rig_debug(RIG_DEBUG_CACHE, "%s(%d): timeout=%ld,%ld\n", __func__, __LINE__, tv_timeout.tv_sec, tv_timeout.tv_usec);
+
+    if (result == 0)
+    {
+        return -RIG_ETIMEOUT;
+    }
+    else if (result < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR,
+                  "%s(): select() error: %s\n",
+                  __func__,
+                  strerror(errno));
+        return -RIG_EIO;
+    }
+
+    if (FD_ISSET(fd, &efds))
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s(): fd error\n", __func__);
+        return -RIG_EIO;
+    }
+
+    return RIG_OK;
+}
+
+static int port_wait_for_data(hamlib_port_t *p, int direct)
+{
+    struct port_io_state *s;
+    int timeout = p->timeout;
+    int result;
+
+    if (!direct)
+    {
+        result = port_wait_for_data_sync_pipe(p);
+
+        if (result == -RIG_ETIMEOUT)
+        {
+            port_stats_timed_out(p, direct);
         }
 
-        return bytes_read;
+        return result;
     }
-    else if (p->type.rig == RIG_PORT_NETWORK || p->type.rig == RIG_PORT_UDP_NETWORK)
+
+    port_tx_wait_idle(p);
+
+    s = port_rtt_state(p, direct);
+
+    if (s)
     {
-        return recv(fd, buf, count, 0);
+        timeout = rtt_timeout(s->rtt, p->timeout, s->adaptive_timeout);
+    }
+
+    if (p->type.rig == RIG_PORT_REPLAY)
+    {
+        result = wirereplay_wait(port_replay_get(p), timeout);
+    }
+    else
+    {
+        result = port_wait_for_data_direct(p, timeout);
+    }
+
+    if (result == -RIG_ETIMEOUT)
+    {
+        port_stats_timed_out(p, direct);
+
+        if (s)
+        {
+            rtt_timed_out(s->rtt);
+        }
+    }
+
+    return result;
+}
+
+int HAMLIB_API write_block_sync(hamlib_port_t *p, const unsigned char *txbuffer,
+                                size_t count)
+{
+    return async_pipe_write(p->sync_data_pipe, txbuffer, count, p->timeout);
+}
+
+int HAMLIB_API write_block_sync_error(hamlib_port_t *p,
+                                      const unsigned char *txbuffer, size_t count)
+{
+    return async_pipe_write(p->sync_data_error_pipe, txbuffer, count, p->timeout);
+}
+
+int HAMLIB_API port_flush_sync_pipes(hamlib_port_t *p)
+{
+    // TODO: To be implemented for Windows
+    port_rx_discard(p, 0);
+    return RIG_OK;
+}
+
+#else
+
+/* POSIX */
+
+/* take what the async data handler left in the channel, EAGAIN if none */
+static ssize_t port_read_sync_chan(hamlib_port_t *p, void *buf, size_t count)
+{
+    struct port_sync_chan *c = port_sync_chan_get(p);
+    size_t n;
+
+    if (c == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    pthread_mutex_lock(&c->lock);
+
+    n = c->buf.end - c->buf.start;
+
+    if (n > count) { n = count; }
+
+    memcpy(buf, c->buf.data + c->buf.start, n);
+    c->buf.start += n;
+
+    if (c->buf.start == c->buf.end)
+    {
+        c->buf.start = c->buf.end = 0;
+    }
+
+    pthread_mutex_unlock(&c->lock);
+
+    if (n == 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    return (ssize_t) n;
+}
+
+static ssize_t port_read_generic(hamlib_port_t *p, void *buf, size_t count,
+                                 int direct)
+{
+    int fd = p->fd;
+
+    if (!direct)
+    {
+        return port_read_sync_chan(p, buf, count);
+    }
+
+    if (p->type.rig == RIG_PORT_SERIAL && p->parm.serial.data_bits == 7)
+    {
+        unsigned char *pbuf = buf;
+
+        ssize_t ret = read(fd, buf, count);
+
+        /* clear MSB */
+        ssize_t i;
+
+        for (i = 0; i < ret; i++)
+        {
+            pbuf[i] &= ~0x80;
+        }
+
+        return ret;
     }
     else
     {
@@ -656,382 +1828,830 @@ static ssize_t port_read_generic(hamlib_port_t *p, void *buf, size_t count,
     }
 }
 
-static ssize_t port_write(hamlib_port_t *p, const void *buf, size_t count)
+//! @cond Doxygen_Suppress
+#define port_write(p,b,c) write((p)->fd,(b),(c))
+//! @endcond
+
+/*
+ * Wait up to timeout ms for fd to become readable.  Returns 1 when it is
+ * (or has an error or hangup for read() to report), 0 on timeout, <0 on
+ * error.  poll() has no FD_SETSIZE limit, but is broken for character
+ * devices on macOS, so select() is kept there.
+ */
+static int port_poll_fd(int fd, int timeout)
 {
-    /*
-     * Since WIN32 does its special serial write, we have
-     * to catch the microHam case to do just "write".
-     * Note that we always have RIG_PORT_SERIAL in the
-     * microHam case.
-     */
-    if (is_uh_radio_fd(p->fd))
+#if defined(HAVE_POLL_H) && !defined(__APPLE__)
+    struct pollfd pfd;
+    int result;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    do
+    {
+        pfd.revents = 0;
+        result = poll(&pfd, 1, timeout);
+    }
+    while (result < 0 && errno == EINTR);
+
+    if (result > 0 && (pfd.revents & POLLNVAL))
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    return result;
+#else
+    fd_set rfds;
+    struct timeval tv;
+    int result;
+
+    if (fd >= FD_SETSIZE)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    do
+    {
+        tv.tv_sec = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        result = select(fd + 1, &rfds, NULL, NULL, &tv);
+    }
+    while (result < 0 && errno == EINTR);
+
+    return result;
+#endif
+}
+
+static void port_sync_wake(int fd)
+{
+#if defined(HAVE_SYS_EVENTFD_H)
+    uint64_t one = 1;
+#else
+    unsigned char one = 1;
+#endif
+
+    if (write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: wakeup failed: %s\n", __func__, strerror(errno));
+    }
+}
+
+static void port_sync_wake_clear(int fd)
+{
+    unsigned char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0) {}
+}
+
+static int port_wait_for_data_sync_chan(hamlib_port_t *p, int timeout_ms)
+{
+    struct port_sync_chan *c = port_sync_chan_get(p);
+    double deadline = monotonic_seconds() + timeout_ms / 1000.0;
+
+    if (c == NULL)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    for (;;)
+    {
+        int result, timeout;
+
+        pthread_mutex_lock(&c->lock);
+
+        c->waiting = 0;
+
+        if (c->error_pending)
+        {
+            result = c->error;
+            c->error_pending = 0;
+            pthread_mutex_unlock(&c->lock);
+            rig_debug(RIG_DEBUG_VERBOSE, "%s(): returning error code %d\n", __func__,
+                      result);
+            return result;
+        }
+
+        if (c->buf.end > c->buf.start)
+        {
+            pthread_mutex_unlock(&c->lock);
+            return RIG_OK;
+        }
+
+        timeout = (int)((deadline - monotonic_seconds()) * 1000 + 0.5);
+
+        if (timeout <= 0)
+        {
+            pthread_mutex_unlock(&c->lock);
+            return -RIG_ETIMEOUT;
+        }
+
+        /* from here on write_block_sync() knows to wake us */
+        c->waiting = 1;
+        pthread_mutex_unlock(&c->lock);
+
+        result = port_poll_fd(p->fd_sync_read, timeout);
+
+        if (result < 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s(): poll() error: %s\n", __func__,
+                      strerror(errno));
+            pthread_mutex_lock(&c->lock);
+            c->waiting = 0;
+            pthread_mutex_unlock(&c->lock);
+            return -RIG_EIO;
+        }
+
+        if (result > 0)
+        {
+            port_sync_wake_clear(p->fd_sync_read);
+        }
+    }
+}
+
+static int port_wait_for_data(hamlib_port_t *p, int direct)
+{
+    struct port_io_state *s = port_rtt_state(p, direct);
+    int timeout = p->timeout;
+    int result;
+
+    /* the rig cannot answer before our command is out */
+    port_tx_wait_idle(p);
+
+    if (s)
     {
-        return write(p->fd, buf, count);
+        timeout = rtt_timeout(s->rtt, p->timeout, s->adaptive_timeout);
     }
 
-    if (p->type.rig == RIG_PORT_SERIAL)
+    if (!direct)
     {
-        return win32_serial_write(p->fd, buf, (int) count);
+        result = port_wait_for_data_sync_chan(p, timeout);
     }
-    else if (p->type.rig == RIG_PORT_NETWORK
-             || p->type.rig == RIG_PORT_UDP_NETWORK)
+    else if (p->type.rig == RIG_PORT_REPLAY)
     {
-        return send(p->fd, buf, count, 0);
+        result = wirereplay_wait(port_replay_get(p), timeout);
     }
     else
     {
-        return write(p->fd, buf, count);
+        result = port_poll_fd(p->fd, timeout);
+
+        if (result == 0)
+        {
+            result = -RIG_ETIMEOUT;
+        }
+        else if (result < 0)
+        {
+            rig_debug(RIG_DEBUG_ERR,
+                      "%s(): poll() error, direct=%d: %s\n",
+                      __func__,
+                      direct,
+                      strerror(errno));
+            result = -RIG_EIO;
+        }
+        else
+        {
+            result = RIG_OK;
+        }
+    }
+
+    if (result == -RIG_ETIMEOUT)
+    {
+        port_stats_timed_out(p, direct);
+
+        if (s)
+        {
+            rtt_timed_out(s->rtt);
+        }
     }
+
+    return result;
 }
 
-static int port_select(hamlib_port_t *p,
-                       int n,
-                       fd_set *readfds,
-                       fd_set *writefds,
-                       fd_set *exceptfds,
-                       struct timeval *timeout,
-                       int direct)
+int HAMLIB_API write_block_sync(hamlib_port_t *p, const unsigned char *txbuffer,
+                                size_t count)
 {
-#if 1
+    struct port_sync_chan *c;
+    struct port_rxbuf *rx;
+    int wake;
 
-    /* select does not work very well with writefds/exceptfds
-     * So let's pretend there's none of them
-     */
-    if (exceptfds)
+    if (!p->asyncio)
     {
-        FD_ZERO(exceptfds);
+        int retval = write(p->fd, txbuffer, count);
+
+        if (retval != count)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: write failed: %s\n", __func__, strerror(errno));
+            retval = -RIG_EIO;
+        }
+
+        return retval;
     }
 
-    if (writefds)
+    c = port_sync_chan_get(p);
+
+    if (c == NULL)
     {
-        FD_ZERO(writefds);
+        return -RIG_ENOMEM;
     }
 
-    writefds = NULL;
-    exceptfds = NULL;
-#endif
+    pthread_mutex_lock(&c->lock);
 
-    /*
-     * Since WIN32 does its special serial select, we have
-     * to catch the microHam case to do just "select".
-     * Note that we always have RIG_PORT_SERIAL in the
-     * microHam case.
-     */
-    if (direct && is_uh_radio_fd(p->fd))
+    rx = &c->buf;
+
+    if (rx->end + count > sizeof(rx->data))
     {
-        return select(n, readfds, writefds, exceptfds, timeout);
+        memmove(rx->data, rx->data + rx->start, rx->end - rx->start);
+        rx->end -= rx->start;
+        rx->start = 0;
     }
 
-    if (direct && p->type.rig == RIG_PORT_SERIAL)
+    if (rx->end + count > sizeof(rx->data))
     {
-        return win32_serial_select(n, readfds, writefds, exceptfds, timeout);
+        pthread_mutex_unlock(&c->lock);
+        rig_debug(RIG_DEBUG_ERR, "%s: channel full, dropping %d bytes\n", __func__,
+                  (int)count);
+        return -RIG_EIO;
     }
-    else
+
+    memcpy(rx->data + rx->end, txbuffer, count);
+    rx->end += count;
+    wake = c->waiting;
+    c->waiting = 0;
+
+    pthread_mutex_unlock(&c->lock);
+
+    if (wake)
     {
-        return select(n, readfds, writefds, exceptfds, timeout);
+        port_sync_wake(p->fd_sync_write);
     }
+
+    return (int) count;
 }
 
-static int port_wait_for_data_direct(hamlib_port_t *p)
+int HAMLIB_API write_block_sync_error(hamlib_port_t *p,
+                                      const unsigned char *txbuffer, size_t count)
 {
-    fd_set rfds, efds;
-    int fd = p->fd;
-    struct timeval tv, tv_timeout;
-    int result;
-    tv_timeout.tv_sec = p->timeout / 1000;
-    tv_timeout.tv_usec = (p->timeout % 1000) * 1000;
-    //rig_debug(RIG_DEBUG_CACHE, "%s(%d): timeout=%ld,%ld\n", __func__, __LINE__, tv_timeout.tv_sec, tv_timeout.tv_usec);
-
-    tv = tv_timeout;    /* select may have updated it */
-
-    FD_ZERO(&rfds);
-    FD_SET(fd, &rfds);
-    efds = rfds;
-
-    result = port_select(p, fd + 1, &rfds, NULL, &efds, &tv, 1);
-    //rig_debug(RIG_DEBUG_CACHE, "%s(%d): timeout=%ld,%ld\n", __func__, __LINE__, tv_timeout.tv_sec, tv_timeout.tv_usec);
+    struct port_sync_chan *c;
+    int wake;
 
-    if (result == 0)
+    if (!p->asyncio || count == 0)
     {
-        return -RIG_ETIMEOUT;
+        return -RIG_EINTERNAL;
     }
-    else if (result < 0)
+
+    c = port_sync_chan_get(p);
+
+    if (c == NULL)
     {
-        rig_debug(RIG_DEBUG_ERR,
-                  "%s(): select() error: %s\n",
-                  __func__,
-                  strerror(errno));
-        return -RIG_EIO;
+        return -RIG_ENOMEM;
     }
 
-    if (FD_ISSET(fd, &efds))
+    pthread_mutex_lock(&c->lock);
+
+    /* only the latest error code is of interest */
+    c->error = (signed char) txbuffer[count - 1];
+    c->error_pending = 1;
+    wake = c->waiting;
+    c->waiting = 0;
+
+    pthread_mutex_unlock(&c->lock);
+
+    if (wake)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s(): fd error\n", __func__);
-        return -RIG_EIO;
+        port_sync_wake(p->fd_sync_write);
     }
 
-    return RIG_OK;
+    return (int) count;
 }
 
-static int port_wait_for_data(hamlib_port_t *p, int direct)
+int HAMLIB_API port_flush_sync_pipes(hamlib_port_t *p)
 {
-    if (direct)
+    struct port_sync_chan *c;
+    int nbytes;
+
+    if (!p->asyncio)
     {
-        return port_wait_for_data_direct(p);
+        return RIG_OK;
     }
 
-    return port_wait_for_data_sync_pipe(p);
-}
+    rig_debug(RIG_DEBUG_TRACE, "%s: flushing sync pipes\n", __func__);
 
-int HAMLIB_API write_block_sync(hamlib_port_t *p, const unsigned char *txbuffer,
-                                size_t count)
-{
-    return async_pipe_write(p->sync_data_pipe, txbuffer, count, p->timeout);
-}
+    nbytes = port_rx_discard(p, 0);
 
-int HAMLIB_API write_block_sync_error(hamlib_port_t *p,
-                                      const unsigned char *txbuffer, size_t count)
-{
-    return async_pipe_write(p->sync_data_error_pipe, txbuffer, count, p->timeout);
-}
+    c = port_sync_chan_get(p);
+
+    if (c != NULL)
+    {
+        pthread_mutex_lock(&c->lock);
+        nbytes += (int)(c->buf.end - c->buf.start);
+        c->buf.start = c->buf.end = 0;
+        c->error_pending = 0;
+        pthread_mutex_unlock(&c->lock);
+    }
+
+    port_sync_wake_clear(p->fd_sync_read);
+
+    rig_debug(RIG_DEBUG_TRACE, "read flushed %d bytes from sync channel\n",
+              nbytes);
 
-int HAMLIB_API port_flush_sync_pipes(hamlib_port_t *p)
-{
-    // TODO: To be implemented for Windows
     return RIG_OK;
 }
 
-#else
+#endif
 
-/* POSIX */
+/*
+ * Transmit queue.
+ *
+ * With write_delay set every byte is followed by a sleep, so a 20 byte
+ * command paced at 5ms keeps the caller in write_block() for 100ms.
+ * When the queue is enabled with port_set_write_queue() write_block()
+ * only appends the command here and returns, and a writer thread per
+ * port sends it out with the same byte pacing and post_write_delay.
+ *
+ * Commands are never split: port_tx_abort() drops the ones not yet
+ * started but lets the one on the wire finish.  Every command carries
+ * the class port_tx_class() set for the thread that wrote it, so urgent
+ * writes of one thread go ahead without taking the writes of the others
+ * along, and aborting CW leaves other queued commands alone.
+ */
 
-static ssize_t port_read_generic(hamlib_port_t *p, void *buf, size_t count,
-                                 int direct)
+/* write_block() waits for room above this many queued bytes */
+#define PORT_TXQ_MAX 4096
+
+struct port_tx_block
 {
-    int fd = direct ? p->fd : p->fd_sync_read;
+    struct port_tx_block *next;
+    int tx_class;               /* PORT_TX_* of the writing thread */
+    size_t len;
+    unsigned char data[];
+};
 
-    if (p->type.rig == RIG_PORT_SERIAL && p->parm.serial.data_bits == 7)
-    {
-        unsigned char *pbuf = buf;
+struct port_tx_list
+{
+    struct port_tx_block *head;
+    struct port_tx_block **tail;
+};
 
-        ssize_t ret = read(fd, buf, count);
+struct port_txq
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        /* broadcast on every state change */
+    pthread_t thread;
+    hamlib_port_t *port;
+    int started;                /* thread created, not yet joined */
+    int running;                /* thread still serving the queue */
+    int stop;
+    int busy;                   /* a command is on the wire */
+    int error;                  /* first write error, reported once */
+    size_t queued;              /* bytes waiting, not counting busy */
+    size_t sending;             /* size of the command on the wire */
+    double next_write;          /* monotonic time of the next command */
+    struct port_tx_list list[2];    /* [0] urgent, [1] normal */
+};
+
+static int port_write_paced(hamlib_port_t *p, const unsigned char *txbuffer,
+                            size_t count);
+
+static void port_tx_list_init(struct port_tx_list *l)
+{
+    l->head = NULL;
+    l->tail = &l->head;
+}
 
-        /* clear MSB */
-        ssize_t i;
+/* free the blocks of a list of tx_class, or all with PORT_TX_ANY,
+ * returns the bytes dropped */
+static size_t port_tx_list_clear(struct port_tx_list *l, int tx_class)
+{
+    struct port_tx_block **pb = &l->head;
+    size_t n = 0;
 
-        for (i = 0; i < ret; i++)
+    while (*pb != NULL)
+    {
+        struct port_tx_block *b = *pb;
+
+        if (tx_class != PORT_TX_ANY && b->tx_class != tx_class)
         {
-            pbuf[i] &= ~0x80;
+            pb = &b->next;
+            continue;
         }
 
-        return ret;
+        *pb = b->next;
+        n += b->len;
+        free(b);
     }
-    else
+
+    l->tail = pb;
+
+    return n;
+}
+
+static pthread_once_t port_tx_once = PTHREAD_ONCE_INIT;
+static pthread_key_t port_tx_key;
+
+static void port_tx_key_init(void)
+{
+    pthread_key_create(&port_tx_key, NULL);
+}
+
+/* class of the writes of the calling thread, stored as class + 1 */
+static int port_tx_thread_class(void)
+{
+    intptr_t v;
+
+    pthread_once(&port_tx_once, port_tx_key_init);
+    v = (intptr_t)pthread_getspecific(port_tx_key);
+
+    return v > 0 ? (int)(v - 1) : PORT_TX_NORMAL;
+}
+
+static struct port_txq *port_txq_new(void)
+{
+    struct port_txq *q = calloc(1, sizeof(struct port_txq));
+
+    if (q == NULL)
     {
-        return read(fd, buf, count);
+        return NULL;
     }
+
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+    port_tx_list_init(&q->list[0]);
+    port_tx_list_init(&q->list[1]);
+
+    return q;
 }
 
-//! @cond Doxygen_Suppress
-#define port_write(p,b,c) write((p)->fd,(b),(c))
-#define port_select(p,n,r,w,e,t,d) select((n),(r),(w),(e),(t))
-//! @endcond
+static void port_txq_free(struct port_txq *q)
+{
+    port_tx_list_clear(&q->list[0], PORT_TX_ANY);
+    port_tx_list_clear(&q->list[1], PORT_TX_ANY);
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+    free(q);
+}
 
-static int port_read_sync_data_error_code(hamlib_port_t *p, int fd, int direct)
+static void *port_txq_thread(void *arg)
 {
-    fd_set rfds, efds;
-    ssize_t total_bytes_read = 0;
-    ssize_t bytes_read;
-    struct timeval tv_timeout;
-    signed char data;
+    struct port_txq *q = arg;
 
-    do
+    pthread_mutex_lock(&q->lock);
+
+    for (;;)
     {
-        int result;
-        tv_timeout.tv_sec = 0;
-        tv_timeout.tv_usec = 0;
+        struct port_tx_block *b;
+        struct port_tx_list *l;
+        hamlib_port_t *p = q->port;
+        double wait;
+        int ret;
 
-        FD_ZERO(&rfds);
-        FD_SET(fd, &rfds);
-        efds = rfds;
+        while (q->list[0].head == NULL && q->list[1].head == NULL && !q->stop)
+        {
+            pthread_cond_wait(&q->cond, &q->lock);
+        }
 
-        result = port_select(p, fd + 1, &rfds, NULL, &efds, &tv_timeout, direct);
+        l = q->list[0].head ? &q->list[0] : &q->list[1];
+        b = l->head;
 
-        if (result < 0)
+        /* on stop, whatever is queued still goes out first */
+        if (b == NULL)
         {
-            rig_debug(RIG_DEBUG_VERBOSE, "%s(): select() timeout, direct=%d\n", __func__,
-                      direct);
-            return -RIG_ETIMEOUT;
+            break;
         }
 
-        if (result == 0)
+        if ((l->head = b->next) == NULL)
         {
-            if (total_bytes_read > 0)
-            {
-                rig_debug(RIG_DEBUG_VERBOSE, "%s(): returning error code %d, direct=%d\n",
-                          __func__, (int) data, direct);
-                return data;
-            }
+            l->tail = &l->head;
+        }
 
-            rig_debug(RIG_DEBUG_ERR, "%s(): no error code available\n", __func__);
-            return -RIG_EIO;
+        q->queued -= b->len;
+        q->sending = b->len;
+        q->busy = 1;
+        wait = q->next_write - monotonic_seconds();
+        pthread_mutex_unlock(&q->lock);
+
+        if (wait > 0)
+        {
+            hl_usleep(wait * 1e6);
         }
 
-        if (FD_ISSET(fd, &efds))
+        ret = port_write_paced(p, b->data, b->len);
+
+        rig_debug(RIG_DEBUG_TRACE, "%s(): TX %d bytes\n", __func__, (int)b->len);
+        dump_hex(b->data, b->len);
+        free(b);
+
+        pthread_mutex_lock(&q->lock);
+
+        q->next_write = p->post_write_delay > 0 ?
+                        monotonic_seconds() + p->post_write_delay / 1000.0 : 0;
+        q->busy = 0;
+        q->sending = 0;
+
+        if (ret != RIG_OK && q->error == RIG_OK)
         {
-            rig_debug(RIG_DEBUG_ERR, "%s(): select() indicated error\n", __func__);
-            return -RIG_EIO;
+            q->error = ret;
         }
 
-        bytes_read = read(fd, &data, 1);
-        total_bytes_read += bytes_read;
+        pthread_cond_broadcast(&q->cond);
     }
-    while (bytes_read > 0);
 
-    rig_debug(RIG_DEBUG_VERBOSE, "%s(): returning error code %d\n", __func__, data);
+    q->running = 0;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
 
-    return data;
+    return NULL;
 }
 
-static int port_wait_for_data(hamlib_port_t *p, int direct)
+/* drain the queue and stop the writer thread, caller must not hold q->lock */
+static void port_txq_stop(struct port_txq *q)
 {
-    fd_set rfds, efds;
-    int fd, errorfd, maxfd;
-    struct timeval tv, tv_timeout;
-    int result;
+    pthread_t thread;
 
-    fd = direct ? p->fd : p->fd_sync_read;
-    errorfd = direct ? -1 : p->fd_sync_error_read;
-    maxfd = (fd > errorfd) ? fd : errorfd;
+    pthread_mutex_lock(&q->lock);
 
-    tv_timeout.tv_sec = p->timeout / 1000;
-    tv_timeout.tv_usec = (p->timeout % 1000) * 1000;
+    if (!q->started)
+    {
+        pthread_mutex_unlock(&q->lock);
+        return;
+    }
 
-    tv = tv_timeout;    /* select may have updated it */
+    thread = q->thread;
+    q->stop = 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
 
-    FD_ZERO(&rfds);
-    FD_SET(fd, &rfds);
+    pthread_join(thread, NULL);
 
-    if (!direct)
+    pthread_mutex_lock(&q->lock);
+    q->started = 0;
+    q->stop = 0;
+    q->next_write = 0;
+    pthread_mutex_unlock(&q->lock);
+}
+
+static struct port_txq *port_txq_get(hamlib_port_t *p)
+{
+    struct port_io_state *s = port_io_state_find(p);
+
+    return s ? s->txq : NULL;
+}
+
+static int port_txq_write(hamlib_port_t *p, struct port_txq *q,
+                          const unsigned char *txbuffer, size_t count)
+{
+    struct port_tx_block *b;
+    struct port_tx_list *l;
+    int urgent;
+    int ret;
+
+    b = malloc(sizeof(struct port_tx_block) + count);
+
+    if (b == NULL)
     {
-        FD_SET(errorfd, &rfds);
+        return -RIG_ENOMEM;
     }
 
-    efds = rfds;
+    b->next = NULL;
+    b->tx_class = port_tx_thread_class();
+    b->len = count;
+    memcpy(b->data, txbuffer, count);
 
-    result = port_select(p, maxfd + 1, &rfds, NULL, &efds, &tv, direct);
+    pthread_mutex_lock(&q->lock);
 
-    if (result == 0)
+    if (!q->started)
     {
-        return -RIG_ETIMEOUT;
+        int err;
+
+        q->port = p;
+        q->running = 1;
+        err = pthread_create(&q->thread, NULL, port_txq_thread, q);
+
+        if (err)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: pthread_create error: %s\n", __func__,
+                      strerror(err));
+            q->running = 0;
+            pthread_mutex_unlock(&q->lock);
+            free(b);
+            return -RIG_EINTERNAL;
+        }
+
+        q->started = 1;
     }
-    else if (result < 0)
+
+    while (q->queued > 0 && q->queued + count > PORT_TXQ_MAX && q->running)
     {
-        rig_debug(RIG_DEBUG_ERR,
-                  "%s(): select() error, direct=%d: %s\n",
-                  __func__,
-                  direct,
-                  strerror(errno));
-        return -RIG_EIO;
+        pthread_cond_wait(&q->cond, &q->lock);
     }
 
-    if (FD_ISSET(fd, &efds))
+    /* a previous command failed, tell the caller now */
+    ret = q->error;
+    q->error = RIG_OK;
+
+    urgent = b->tx_class == PORT_TX_URGENT;
+    l = &q->list[urgent ? 0 : 1];
+    *l->tail = b;
+    l->tail = &b->next;
+    q->queued += count;
+    pthread_cond_broadcast(&q->cond);
+
+    pthread_mutex_unlock(&q->lock);
+
+    rig_debug(RIG_DEBUG_TRACE, "%s(): queued %d bytes%s\n", __func__, (int)count,
+              urgent ? " ahead of the queue" : "");
+
+    return ret;
+}
+
+/**
+ * \brief Send paced writes through a transmit queue
+ * \param p rig port descriptor
+ * \param on 1 to queue writes, 0 to write from the calling thread
+ * \return RIG_OK or < 0
+ *
+ * Only ports with a write_delay use the queue.  write_block() then
+ * returns as soon as the command is queued and a writer thread sends it
+ * with the usual pacing.  Turning the queue off drains it first.
+ */
+int HAMLIB_API port_set_write_queue(hamlib_port_t *p, int on)
+{
+    struct port_io_state *s = port_io_state_get(p);
+
+    if (s == NULL)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s(): fd error, direct=%d\n", __func__, direct);
-        return -RIG_EIO;
+        return -RIG_ENOMEM;
     }
 
-    if (!direct)
+    if (on && s->txq == NULL)
     {
-        if (FD_ISSET(errorfd, &efds))
-        {
-            rig_debug(RIG_DEBUG_ERR, "%s(): fd error from sync error pipe, direct=%d\n",
-                      __func__, direct);
-            return -RIG_EIO;
-        }
+        s->txq = port_txq_new();
 
-        if (FD_ISSET(errorfd, &rfds))
+        if (s->txq == NULL)
         {
-            rig_debug(RIG_DEBUG_VERBOSE, "%s(): attempting to read error code, direct=%d\n",
-                      __func__, direct);
-            return port_read_sync_data_error_code(p, errorfd, 0);
+            return -RIG_ENOMEM;
         }
     }
 
+    if (!on && s->txq)
+    {
+        port_txq_stop(s->txq);
+    }
+
+    s->write_queue = on ? 1 : 0;
+
     return RIG_OK;
 }
 
-int HAMLIB_API write_block_sync(hamlib_port_t *p, const unsigned char *txbuffer,
-                                size_t count)
+/**
+ * \brief Tell if paced writes go through a transmit queue
+ * \param p rig port descriptor
+ * \return 1 if queued, 0 otherwise
+ */
+int HAMLIB_API port_get_write_queue(hamlib_port_t *p)
 {
-    int retval = RIG_OK;
+    const struct port_io_state *s = port_io_state_get(p);
 
-    if (p->asyncio)
+    return s ? s->write_queue : 0;
+}
+
+/**
+ * \brief Number of bytes queued for transmission
+ * \param p rig port descriptor
+ * \return bytes not yet fully sent, including the command on the wire
+ */
+int HAMLIB_API port_tx_pending(hamlib_port_t *p)
+{
+    struct port_txq *q = port_txq_get(p);
+    int n;
+
+    if (q == NULL)
     {
-        retval = write(p->fd_sync_write, txbuffer, count);
+        return 0;
     }
-    else
+
+    pthread_mutex_lock(&q->lock);
+    n = (int)(q->queued + q->sending);
+    pthread_mutex_unlock(&q->lock);
+
+    return n;
+}
+
+/**
+ * \brief Wait until everything queued has been sent
+ * \param p rig port descriptor
+ * \return RIG_OK, or the error of a failed queued write
+ */
+int HAMLIB_API port_tx_drain(hamlib_port_t *p)
+{
+    struct port_txq *q = port_txq_get(p);
+    int ret;
+
+    if (q == NULL)
     {
-        retval = write(p->fd, txbuffer, count);
+        return RIG_OK;
     }
 
-    if (retval != count)
+    pthread_mutex_lock(&q->lock);
+
+    while ((q->busy || q->queued > 0) && q->running)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s: write failed: %s\n", __func__, strerror(errno));
-        retval = -RIG_EIO;
+        pthread_cond_wait(&q->cond, &q->lock);
     }
 
-    return retval;
+    ret = q->error;
+    q->error = RIG_OK;
+    pthread_mutex_unlock(&q->lock);
+
+    return ret;
 }
 
-int HAMLIB_API write_block_sync_error(hamlib_port_t *p,
-                                      const unsigned char *txbuffer, size_t count)
+/**
+ * \brief Drop queued commands not yet started
+ * \param p rig port descriptor
+ * \param tx_class PORT_TX_* of the commands to drop, PORT_TX_ANY for all
+ * \return number of bytes dropped
+ *
+ * A command already on the wire is finished first, so the rig never sees
+ * half of one.  Commands of other classes stay queued.
+ */
+int HAMLIB_API port_tx_abort(hamlib_port_t *p, int tx_class)
 {
-    if (!p->asyncio)
+    struct port_txq *q = port_txq_get(p);
+    size_t n;
+
+    if (q == NULL)
     {
-        return -RIG_EINTERNAL;
+        return 0;
     }
 
-    return (int) write(p->fd_sync_error_write, txbuffer, count);
-}
+    pthread_mutex_lock(&q->lock);
 
-int HAMLIB_API port_flush_sync_pipes(hamlib_port_t *p)
-{
-    unsigned char buf[1024];
-    int n;
-    int nbytes;
+    n = port_tx_list_clear(&q->list[0], tx_class)
+        + port_tx_list_clear(&q->list[1], tx_class);
+    q->queued -= n;
+    pthread_cond_broadcast(&q->cond);
 
-    if (!p->asyncio)
+    while (q->busy)
     {
-        return RIG_OK;
+        pthread_cond_wait(&q->cond, &q->lock);
     }
 
-    rig_debug(RIG_DEBUG_TRACE, "%s: flushing sync pipes\n", __func__);
-
-    nbytes = 0;
+    pthread_mutex_unlock(&q->lock);
 
-    while ((n = read(p->fd_sync_read, buf, sizeof(buf))) > 0)
+    if (n > 0)
     {
-        nbytes += n;
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: dropped %d queued bytes\n", __func__,
+                  (int)n);
     }
 
-    rig_debug(RIG_DEBUG_TRACE, "read flushed %d bytes from sync read pipe\n",
-              nbytes);
+    return (int)n;
+}
+
+/**
+ * \brief Set the class of the writes the calling thread queues
+ * \param tx_class PORT_TX_NORMAL, PORT_TX_URGENT or PORT_TX_CW
+ * \return the class the thread had before, to put back afterwards
+ *
+ * PORT_TX_URGENT writes jump ahead of other queued commands, for commands
+ * that must not wait behind a long queue, like PTT off.  Urgent commands
+ * keep their order among themselves.  PORT_TX_CW writes can be dropped
+ * with port_tx_abort(p, PORT_TX_CW).  Only writes of this thread are
+ * affected.
+ */
+int HAMLIB_API port_tx_class(int tx_class)
+{
+    int old = port_tx_thread_class();
+
+    pthread_setspecific(port_tx_key, (void *)(intptr_t)(tx_class + 1));
 
-    nbytes = 0;
+    return old;
+}
+
+/*
+ * Wait until queued writes are on the wire, so a read timeout starts
+ * counting when the rig can actually answer.
+ */
+static void port_tx_wait_idle(hamlib_port_t *p)
+{
+    struct port_txq *q;
 
-    while ((n = read(p->fd_sync_error_read, buf, sizeof(buf))) > 0)
+    if (p->write_delay <= 0 || (q = port_txq_get(p)) == NULL)
     {
-        nbytes += n;
+        return;
     }
 
-    rig_debug(RIG_DEBUG_TRACE, "read flushed %d bytes from sync error read pipe\n",
-              nbytes);
+    pthread_mutex_lock(&q->lock);
 
-    return RIG_OK;
-}
+    while ((q->busy || q->queued > 0) && q->running)
+    {
+        pthread_cond_wait(&q->cond, &q->lock);
+    }
 
-#endif
+    pthread_mutex_unlock(&q->lock);
+}
 
 /**
  * \brief Write a block of characters to an fd.
@@ -1045,9 +2665,15 @@ int HAMLIB_API port_flush_sync_pipes(hamlib_port_t *p)
  *
  * The write_delay is for Yaesu type rigs..require 5 character
  * sequence to be sent with 50-200msec between each char.
+ * With port_set_write_queue() (conf "write_queue") such paced writes
+ * are handed to a writer thread and this returns once queued.
  *
  * Also, post_write_delay is for some Yaesu rigs (eg: FT747) that
  * get confused with sequential fast writes between cmd sequences.
+ * Normally we sleep post_write_delay after the write.  With
+ * port_set_post_write_deferred() (conf "post_write_deferred") the
+ * delay is only enforced as a minimum gap before the next write, so
+ * time spent reading the reply counts towards it.
  *
  * input:
  *
@@ -1056,7 +2682,6 @@ int HAMLIB_API port_flush_sync_pipes(hamlib_port_t *p)
  * count - count of byte to send from the txbuffer
  * write_delay - write delay in ms between 2 chars
  * post_write_delay - minimum delay between two writes
- * post_write_date - timeval of last write
  *
  * Actually, this function has nothing specific to serial comm,
  * it could work very well also with any file handle, like a socket.
@@ -1065,6 +2690,7 @@ int HAMLIB_API port_flush_sync_pipes(hamlib_port_t *p)
 int HAMLIB_API write_block(hamlib_port_t *p, const unsigned char *txbuffer,
                            size_t count)
 {
+    struct port_io_state *s = NULL;
     int ret;
 
     if (p->fd < 0)
@@ -1073,31 +2699,78 @@ int HAMLIB_API write_block(hamlib_port_t *p, const unsigned char *txbuffer,
         return (-RIG_EIO);
     }
 
-#ifdef WANT_NON_ACTIVE_POST_WRITE_DELAY
+    if (p->type.rig == RIG_PORT_REPLAY)
+    {
+        /* the capture has the delays in it already */
+        rig_debug(RIG_DEBUG_TRACE, "%s(): TX %d bytes (replay)\n", __func__,
+                  (int)count);
+        dump_hex((unsigned char *) txbuffer, count);
+        ret = wirereplay_write(port_replay_get(p), txbuffer, count);
+        port_rtt_sent(p, txbuffer, count);
+        return ret;
+    }
 
-    if (p->post_write_date.tv_sec != 0)
+    if (p->write_delay > 0 || p->post_write_delay > 0)
     {
-        signed int date_delay;    /* in us */
-        struct timeval tv;
+        s = port_io_state_get(p);
 
-        /* FIXME in Y2038 ... */
-        gettimeofday(&tv, NULL);
-        date_delay = p->post_write_delay * 1000 -
-                     ((tv.tv_sec - p->post_write_date.tv_sec) * 1000000 +
-                      (tv.tv_usec - p->post_write_date.tv_usec));
+        if (s && s->write_queue && s->txq && p->write_delay > 0)
+        {
+            return port_txq_write(p, s->txq, txbuffer, count);
+        }
+    }
 
-        if (date_delay > 0)
+    if (p->post_write_delay > 0)
+    {
+        if (s && s->post_write_deferred && s->next_write > 0)
         {
-            /*
-             * optional delay after last write
-             */
-            hl_sleep(date_delay);
+            double wait = s->next_write - monotonic_seconds();
+
+            if (wait > 0)
+            {
+                rig_debug(RIG_DEBUG_TRACE, "%s: post_write_delay %dms, waiting %.1fms\n",
+                          __func__, p->post_write_delay, wait * 1000);
+                hl_usleep(wait * 1e6);
+            }
         }
+    }
 
-        p->post_write_date.tv_sec = 0;
+    ret = port_write_paced(p, txbuffer, count);
+
+    if (ret != RIG_OK)
+    {
+        return ret;
     }
 
-#endif
+    rig_debug(RIG_DEBUG_TRACE, "%s(): TX %d bytes\n", __func__,
+              (int)count);
+    dump_hex((unsigned char *) txbuffer, count);
+
+    if (p->post_write_delay > 0)
+    {
+        if (s && s->post_write_deferred)
+        {
+            s->next_write = monotonic_seconds() + p->post_write_delay / 1000.0;
+        }
+        else
+        {
+            hl_usleep(p->post_write_delay * 1000); /* optional delay after last write */
+        }
+
+        /* otherwise some yaesu rigs get confused */
+        /* with sequential fast writes*/
+    }
+
+    return RIG_OK;
+}
+
+/*
+ * Write count bytes, one at a time with write_delay ms after each if set.
+ */
+static int port_write_paced(hamlib_port_t *p, const unsigned char *txbuffer,
+                            size_t count)
+{
+    int ret;
 
     if (p->write_delay > 0)
     {
@@ -1119,7 +2792,7 @@ int HAMLIB_API write_block(hamlib_port_t *p, const unsigned char *txbuffer,
                 return -RIG_EIO;
             }
 
-            if (p->write_delay > 0) { hl_usleep(p->write_delay * 1000); }
+            hl_usleep(p->write_delay * 1000);
         }
     }
     else
@@ -1139,39 +2812,91 @@ int HAMLIB_API write_block(hamlib_port_t *p, const unsigned char *txbuffer,
         }
     }
 
-    rig_debug(RIG_DEBUG_TRACE, "%s(): TX %d bytes\n", __func__,
-              (int)count);
-    dump_hex((unsigned char *) txbuffer, count);
+    port_capture(p, WIRECAP_TX, txbuffer, count);
+    port_rtt_sent(p, txbuffer, count);
+    port_stats_sent(p, txbuffer, count);
 
-    if (p->post_write_delay > 0)
+    return RIG_OK;
+}
+
+/*
+ * Pull whatever the port has ready into the receive buffer with a single
+ * read.  Returns the byte count from the read, <0 on error.
+ */
+static ssize_t port_rxbuf_fill(hamlib_port_t *p, struct port_rxbuf *rx,
+                               int direct)
+{
+    ssize_t rd_count;
+
+    if (rx->start == rx->end)
+    {
+        rx->start = rx->end = 0;
+    }
+    else if (rx->end == sizeof(rx->data))
+    {
+        memmove(rx->data, rx->data + rx->start, rx->end - rx->start);
+        rx->end -= rx->start;
+        rx->start = 0;
+    }
+
+    if (direct && p->type.rig == RIG_PORT_REPLAY)
+    {
+        rd_count = wirereplay_read(port_replay_get(p), rx->data + rx->end,
+                                   sizeof(rx->data) - rx->end);
+    }
+    else
     {
-#if 0
-#ifdef WANT_NON_ACTIVE_POST_WRITE_DELAY
-#define POST_WRITE_DELAY_TRSHLD 10
+        rd_count = port_read_generic(p, rx->data + rx->end,
+                                     sizeof(rx->data) - rx->end, direct);
+    }
 
-        if (p->post_write_delay > POST_WRITE_DELAY_TRSHLD)
+    if (rd_count > 0)
+    {
+        if (direct)
         {
-            struct timeval tv;
-            gettimeofday(&tv, NULL);
-            p->post_write_date.tv_sec = tv.tv_sec;
-            p->post_write_date.tv_usec = tv.tv_usec;
+            port_capture(p, WIRECAP_RX, rx->data + rx->end, rd_count);
+            port_stats_received(p, rd_count);
         }
-        else
-#endif
-#endif
-            hl_usleep(p->post_write_delay * 1000); /* optional delay after last write */
 
-        /* otherwise some yaesu rigs get confused */
-        /* with sequential fast writes*/
+        rx->end += rd_count;
     }
 
-    return RIG_OK;
+    return rd_count;
+}
+
+/*
+ * Offset of the first byte of buf[0..len) found in stopset, or len if none.
+ */
+static size_t port_rxbuf_scan(const unsigned char *buf, size_t len,
+                              const char *stopset, int stopset_len)
+{
+    const unsigned char *hit;
+    int i;
+
+    if (stopset_len == 1)
+    {
+        hit = memchr(buf, stopset[0], len);
+        return hit ? (size_t)(hit - buf) : len;
+    }
+
+    for (i = 0; i < stopset_len; i++)
+    {
+        hit = memchr(buf, stopset[i], len);
+
+        if (hit)
+        {
+            len = hit - buf;
+        }
+    }
+
+    return len;
 }
 
 static int read_block_generic(hamlib_port_t *p, unsigned char *rxbuffer,
                               size_t count, int direct)
 {
     struct timeval start_time, end_time, elapsed_time;
+    struct port_rxbuf *rx;
     int total_count = 0;
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called, direct=%d\n", __func__, direct);
@@ -1181,6 +2906,13 @@ static int read_block_generic(hamlib_port_t *p, unsigned char *rxbuffer,
         return -RIG_EINTERNAL;
     }
 
+    rx = port_rxbuf_get(p, direct);
+
+    if (rx == NULL)
+    {
+        return -RIG_ENOMEM;
+    }
+
     /* Store the time of the read loop start */
     gettimeofday(&start_time, NULL);
 
@@ -1189,7 +2921,19 @@ static int read_block_generic(hamlib_port_t *p, unsigned char *rxbuffer,
     while (count > 0)
     {
         int result;
-        int rd_count;
+        ssize_t rd_count;
+        size_t avail = rx->end - rx->start;
+
+        if (avail > 0)
+        {
+            if (avail > count) { avail = count; }
+
+            memcpy(rxbuffer + total_count, rx->data + rx->start, avail);
+            rx->start += avail;
+            total_count += (int) avail;
+            count -= avail;
+            continue;
+        }
 
         result = port_wait_for_data(p, direct);
 
@@ -1238,10 +2982,15 @@ static int read_block_generic(hamlib_port_t *p, unsigned char *rxbuffer,
         }
 
         /*
-         * grab bytes from the rig
+         * grab everything the rig has sent so far
          * The file descriptor must have been set up non blocking.
          */
-        rd_count = (int) port_read_generic(p, rxbuffer + total_count, count, direct);
+        rd_count = port_rxbuf_fill(p, rx, direct);
+
+        if (rd_count < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            continue;
+        }
 
         if (rd_count < 0)
         {
@@ -1249,9 +2998,6 @@ static int read_block_generic(hamlib_port_t *p, unsigned char *rxbuffer,
                       direct, strerror(errno));
             return -RIG_EIO;
         }
-
-        total_count += rd_count;
-        count -= rd_count;
     }
 
     if (direct)
@@ -1261,6 +3007,8 @@ static int read_block_generic(hamlib_port_t *p, unsigned char *rxbuffer,
         dump_hex((unsigned char *) rxbuffer, total_count);
     }
 
+    port_rtt_received(p, rxbuffer, total_count, direct);
+
     return total_count;           /* return bytes count read */
 }
 
@@ -1323,9 +3071,9 @@ static int read_string_generic(hamlib_port_t *p,
                                int direct)
 {
     struct timeval start_time, end_time, elapsed_time;
+    struct port_rxbuf *rx;
     int total_count = 0;
-    int i = 0;
-    static int minlen = 1; // dynamic minimum length of rig response data
+    size_t stopstr_len = 0;
 
     if (p != NULL && !p->asyncio && !direct)
     {
@@ -1349,17 +3097,82 @@ static int read_string_generic(hamlib_port_t *p,
         return 0;
     }
 
+    rx = port_rxbuf_get(p, direct);
+
+    if (rx == NULL)
+    {
+        return -RIG_ENOMEM;
+    }
+
+    // special read for FLRig, the whole string terminates the reply
+    if (stopset != NULL && strcmp(stopset, "</methodResponse>") == 0)
+    {
+        stopstr_len = strlen(stopset);
+    }
+
     /* Store the time of the read loop start */
     gettimeofday(&start_time, NULL);
 
-    memset(rxbuffer, 0, rxmax);
-
     short timeout_retries = p->timeout_retry;
 
     while (total_count < rxmax - 1) // allow 1 byte for end-of-string
     {
-        ssize_t rd_count = 0;
+        ssize_t rd_count;
+        size_t avail = rx->end - rx->start;
         int result;
+
+        if (avail > 0)
+        {
+            const unsigned char *src = rx->data + rx->start;
+            size_t used;
+            int found = 0;
+
+            // check to see if our string starts with \...if so we need more chars
+            if (total_count == 0 && src[0] == '\\') { rxmax = (rxmax - 1) * 5; }
+
+            if (avail > rxmax - 1 - total_count) { avail = rxmax - 1 - total_count; }
+
+            used = avail;
+
+            if (stopstr_len > 0)
+            {
+                const char *hit;
+                int from = total_count - (int) stopstr_len + 1;
+
+                memcpy(&rxbuffer[total_count], src, avail);
+                rxbuffer[total_count + avail] = '\0';
+                hit = strstr((char *) &rxbuffer[from > 0 ? from : 0], stopset);
+
+                if (hit)
+                {
+                    used = (hit + stopstr_len) - (char *) &rxbuffer[total_count];
+                    found = 1;
+                }
+            }
+            else
+            {
+                if (stopset && stopset_len > 0)
+                {
+                    used = port_rxbuf_scan(src, avail, stopset, stopset_len);
+
+                    if (used < avail)
+                    {
+                        used++;
+                        found = 1;
+                    }
+                }
+
+                memcpy(&rxbuffer[total_count], src, used);
+            }
+
+            rx->start += used;
+            total_count += (int) used;
+
+            if (found) { break; }
+
+            continue;
+        }
+
         result = port_wait_for_data(p, direct);
 
         if (result == -RIG_ETIMEOUT)
@@ -1375,32 +3188,27 @@ static int read_string_generic(hamlib_port_t *p,
             }
 
             // a timeout is a timeout no matter how many bytes
-            //if (0 == total_count)
-            {
-                /* Record timeout time and calculate elapsed time */
-                gettimeofday(&end_time, NULL);
-                timersub(&end_time, &start_time, &elapsed_time);
-
-                if (direct)
-                {
-                    dump_hex((unsigned char *) rxbuffer, total_count);
-                }
+            /* Record timeout time and calculate elapsed time */
+            gettimeofday(&end_time, NULL);
+            timersub(&end_time, &start_time, &elapsed_time);
 
-                if (!flush_flag)
-                {
-                    rig_debug(RIG_DEBUG_CACHE,
-                              "%s(): Timed out %d.%03d seconds after %d chars, direct=%d\n",
-                              __func__,
-                              (int)elapsed_time.tv_sec,
-                              (int)elapsed_time.tv_usec / 1000,
-                              total_count,
-                              direct);
-                }
+            if (direct)
+            {
+                dump_hex((unsigned char *) rxbuffer, total_count);
+            }
 
-                return -RIG_ETIMEOUT;
+            if (!flush_flag)
+            {
+                rig_debug(RIG_DEBUG_CACHE,
+                          "%s(): Timed out %d.%03d seconds after %d chars, direct=%d\n",
+                          __func__,
+                          (int)elapsed_time.tv_sec,
+                          (int)elapsed_time.tv_usec / 1000,
+                          total_count,
+                          direct);
             }
 
-            break; /* return what we have read */
+            return -RIG_ETIMEOUT;
         }
 
         if (result < 0)
@@ -1416,51 +3224,17 @@ static int read_string_generic(hamlib_port_t *p,
         }
 
         /*
-         * read 1 character from the rig, (check if in stop set)
+         * grab everything the rig has sent so far, the stopset is
+         * checked on the buffered bytes above.
          * The file descriptor must have been set up non blocking.
          */
-        do
-        {
-#if 0
-#ifndef __MINGW32__
-            // The ioctl works on Linux but not mingw
-            int avail = 0;
-            ioctl(p->fd, FIONREAD, &avail);
-            //rig_debug(RIG_DEBUG_ERR, "xs: avail=%d expected_len=%d, minlen=%d, direct=%d\n", __func__, avail, expected_len, minlen, direct);
-#endif
-#endif
-shortcut:
-            rd_count = port_read_generic(p, &rxbuffer[total_count],
-                                         expected_len == 1 ? 1 : minlen, direct);
-//            rig_debug(RIG_DEBUG_VERBOSE, "%s: read %d bytes tot=%d\n", __func__, (int)rd_count, total_count);
-            minlen -= rd_count;
-
-            if (errno == EAGAIN)
-            {
-                hl_usleep(5 * 1000);
-//                rig_debug(RIG_DEBUG_WARN, "%s: port_read is busy? direct=%d\n", __func__,
-//                          direct);
-            }
-
-            // special read for FLRig
-            if (stopset != NULL && strcmp(stopset, "</methodResponse>") == 0)
-            {
-                if (strstr((char *)rxbuffer, stopset))
-                {
-                    HAMLIB_TRACE2;
-                }
-
-                else
-                {
-                    HAMLIB_TRACE2;
-                    goto shortcut;
-                }
-            }
+        rd_count = port_rxbuf_fill(p, rx, direct);
 
+        if (rd_count < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            continue;
         }
 
-        while (++i < 10 && errno == EBUSY);   // 50ms should be enough
-
         /* if we get 0 bytes or an error something is wrong */
         if (rd_count <= 0)
         {
@@ -1474,36 +3248,20 @@ shortcut:
 
             return -RIG_EIO;
         }
-
-        // check to see if our string startis with \...if so we need more chars
-        if (total_count == 0 && rxbuffer[total_count] == '\\') { rxmax = (rxmax - 1) * 5; }
-
-        total_count += (int) rd_count;
-
-        if (total_count == rxmax) { break; }
-
-        if (stopset && memchr(stopset, rxbuffer[total_count - 1], stopset_len))
-        {
-            if (minlen == 1) { minlen = total_count; }
-
-            if (minlen < total_count)
-            {
-                minlen = total_count;
-                //rig_debug(RIG_DEBUG_VERBOSE, "%s: minlen now %d\n", __func__, minlen);
-            }
-
-            break;
-        }
     }
 
     if (total_count > 1 && rxbuffer[0] == ';')
     {
-        while (rxbuffer[0] == ';' && total_count >  1)
+        int skip = 0;
+
+        while (rxbuffer[skip] == ';' && total_count - skip > 1)
         {
-            memmove(rxbuffer, &rxbuffer[1], strlen((char *)rxbuffer) - 1);
-            --total_count;
+            ++skip;
         }
 
+        memmove(rxbuffer, &rxbuffer[skip], total_count - skip);
+        total_count -= skip;
+
         rig_debug(RIG_DEBUG_VERBOSE,
                   "%s: skipping single ';' chars at beginning of reply\n", __func__);
     }
@@ -1524,6 +3282,8 @@ shortcut:
         dump_hex((unsigned char *) rxbuffer, total_count);
     }
 
+    port_rtt_received(p, rxbuffer, total_count, direct);
+
     return total_count;           /* return bytes count read */
 }
 
@@ -50,6 +50,71 @@ extern HAMLIB_EXPORT(int) write_block_sync_error(hamlib_port_t *p,
 
 extern HAMLIB_EXPORT(int) port_flush_sync_pipes(hamlib_port_t *p);
 
+extern HAMLIB_EXPORT(int) port_rx_pending(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(int) port_rx_discard(hamlib_port_t *p, int direct);
+
+extern HAMLIB_EXPORT(void) port_io_state_reset(const hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(void) port_io_state_release(const hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(int) port_set_post_write_deferred(hamlib_port_t *p,
+                                                       int deferred);
+
+extern HAMLIB_EXPORT(int) port_get_post_write_deferred(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(int) port_set_write_queue(hamlib_port_t *p, int on);
+
+extern HAMLIB_EXPORT(int) port_get_write_queue(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(int) port_tx_pending(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(int) port_tx_drain(hamlib_port_t *p);
+
+/* class of a queued write, see port_tx_class() */
+#define PORT_TX_ANY     -1
+#define PORT_TX_NORMAL  0
+#define PORT_TX_URGENT  1
+#define PORT_TX_CW      2
+
+extern HAMLIB_EXPORT(int) port_tx_abort(hamlib_port_t *p, int tx_class);
+
+extern HAMLIB_EXPORT(int) port_tx_class(int tx_class);
+
+extern HAMLIB_EXPORT(int) port_set_capture_file(hamlib_port_t *p,
+                                                const char *path);
+
+extern HAMLIB_EXPORT(const char *) port_get_capture_file(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(int) port_set_replay_file(hamlib_port_t *p,
+                                               const char *path);
+
+extern HAMLIB_EXPORT(const char *) port_get_replay_file(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(int) port_set_replay_speed(hamlib_port_t *p,
+                                                double speed);
+
+extern HAMLIB_EXPORT(double) port_get_replay_speed(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(int) port_set_adaptive_timeout(hamlib_port_t *p,
+                                                    int factor);
+
+extern HAMLIB_EXPORT(int) port_get_adaptive_timeout(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(int) port_get_timeout_learned(hamlib_port_t *p,
+                                                   char *buf,
+                                                   int len);
+
+extern HAMLIB_EXPORT(int) port_reset_timeout_learned(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(int) port_get_stats(hamlib_port_t *p, char *buf, int len);
+
+extern HAMLIB_EXPORT(int) port_reset_stats(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(unsigned long) port_get_traffic(hamlib_port_t *p);
+
+extern HAMLIB_EXPORT(void) port_count_async_frame(const hamlib_port_t *p);
+
 extern HAMLIB_EXPORT(int) read_string(hamlib_port_t *p,
                                       unsigned char *rxbuffer,
                                       size_t rxmax,
@@ -2264,6 +2264,13 @@ int HAMLIB_API rig_flush_force(hamlib_port_t *port, int flush_async_data)
         port_flush_sync_pipes(port);
     }
 
+    if (port->type.rig == RIG_PORT_REPLAY)
+    {
+        // unread replies are skipped by the next write
+        port_rx_discard(port, 1);
+        return RIG_OK;
+    }
+
 #ifndef RIG_FLUSH_REMOVE
 //    rig_debug(RIG_DEBUG_TRACE, "%s: called for %s device\n", __func__,
 //              port->type.rig == RIG_PORT_SERIAL ? "serial" : "network");
@@ -76,7 +76,7 @@ static int multicast_status_changed(RIG *rig)
     struct rig_cache *cachep = CACHE(rig);
     struct rig_state *rs = STATE(rig);
 #if 0
-    freq_t freq, freqsave = cachep->freqMainA;
+    freq_t freq, freqsave = cachep->slot[CACHE_SLOT_MAIN_A].freq;
 
     if ((retval = rig_get_freq(rig, RIG_VFO_A, &freq)) != RIG_OK)
     {
@@ -87,10 +87,10 @@ static int multicast_status_changed(RIG *rig)
 
 #endif
 
-    rmode_t modeA, modeAsave = cachep->modeMainA;
-    rmode_t modeB, modeBsave = cachep->modeMainB;
-    pbwidth_t widthA, widthAsave = cachep->widthMainA;
-    pbwidth_t widthB, widthBsave = cachep->widthMainB;
+    rmode_t modeA, modeAsave = cachep->slot[CACHE_SLOT_MAIN_A].mode;
+    rmode_t modeB, modeBsave = cachep->slot[CACHE_SLOT_MAIN_B].mode;
+    pbwidth_t widthA, widthAsave = cachep->slot[CACHE_SLOT_MAIN_A].width;
+    pbwidth_t widthB, widthBsave = cachep->slot[CACHE_SLOT_MAIN_B].width;
 
 #if  0
 
@@ -227,18 +227,18 @@ void json_add_vfoA(RIG *rig, char *msg)
 
     strcat(msg, "{\n");
     json_add_string(msg, "Name", "VFOA", 1);
-    json_add_int(msg, "Freq", cachep->freqMainA, 1);
+    json_add_int(msg, "Freq", cachep->slot[CACHE_SLOT_MAIN_A].freq, 1);
 
-    if (strlen(rig_strrmode(cachep->modeMainA)) > 0)
+    if (strlen(rig_strrmode(cachep->slot[CACHE_SLOT_MAIN_A].mode)) > 0)
     {
-        json_add_string(msg, "Mode", rig_strrmode(cachep->modeMainA), 1);
+        json_add_string(msg, "Mode", rig_strrmode(cachep->slot[CACHE_SLOT_MAIN_A].mode), 1);
     }
     else
     {
         json_add_string(msg, "Mode", "None", 1);
     }
 
-    json_add_int(msg, "Width", cachep->widthMainA, 0);
+    json_add_int(msg, "Width", cachep->slot[CACHE_SLOT_MAIN_A].width, 0);
 
 #if 0 // not working quite yet
     // what about full duplex? rx_vfo would be in rx all the time?
@@ -284,18 +284,18 @@ void json_add_vfoB(RIG *rig, char *msg)
 
     strcat(msg, ",\n{\n");
     json_add_string(msg, "Name", "VFOB", 1);
-    json_add_int(msg, "Freq", cachep->freqMainB, 1);
+    json_add_int(msg, "Freq", cachep->slot[CACHE_SLOT_MAIN_B].freq, 1);
 
-    if (strlen(rig_strrmode(cachep->modeMainB)) > 0)
+    if (strlen(rig_strrmode(cachep->slot[CACHE_SLOT_MAIN_B].mode)) > 0)
     {
-        json_add_string(msg, "Mode", rig_strrmode(cachep->modeMainB), 1);
+        json_add_string(msg, "Mode", rig_strrmode(cachep->slot[CACHE_SLOT_MAIN_B].mode), 1);
     }
     else
     {
         json_add_string(msg, "Mode", "None", 1);
     }
 
-    json_add_int(msg, "Width", cachep->widthMainB, 0);
+    json_add_int(msg, "Width", cachep->slot[CACHE_SLOT_MAIN_B].width, 0);
 
 #if 0 // not working yet
 
@@ -438,14 +438,14 @@ void *multicast_thread(void *vrig)
         }
         else
         {
-            freqB = cachep->freqMainB;
+            freqB = cachep->slot[CACHE_SLOT_MAIN_B].freq;
         }
 
 #else
-        freqA = cachep->freqMainA;
-        freqB = cachep->freqMainB;
-        modeA = cachep->modeMainA;
-        modeB = cachep->modeMainB;
+        freqA = cachep->slot[CACHE_SLOT_MAIN_A].freq;
+        freqB = cachep->slot[CACHE_SLOT_MAIN_B].freq;
+        modeA = cachep->slot[CACHE_SLOT_MAIN_A].mode;
+        modeB = cachep->slot[CACHE_SLOT_MAIN_B].mode;
         ptt = cachep->ptt;
 #endif
 
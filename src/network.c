@@ -441,6 +441,9 @@ int network_flush2(hamlib_port_t *rp, unsigned char *stopset, char *buf,
         return 0;
     }
 
+    // include what read_string already pulled off the socket
+    len += port_rx_pending(rp);
+
     if (len > 0)
     {
         buf[0] = 0;
@@ -469,6 +472,11 @@ void network_flush(hamlib_port_t *rp)
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
+    if (!rp->asyncio)
+    {
+        port_rx_discard(rp, 1);
+    }
+
     for (;;)
     {
         int ret;
@@ -520,6 +528,8 @@ int network_close(hamlib_port_t *rp)
 {
     int ret = 0;
 
+    port_io_state_reset(rp);
+
     if (rp->fd > 0)
     {
         ret = closesocket(rp->fd);
@@ -591,10 +591,16 @@ static void vaporize(RIG *rig)
 {
     if (CACHE(rig))
     {
+        pthread_mutex_destroy(&CACHE(rig)->write_lock);
+        pthread_cond_destroy(&CACHE(rig)->changed);
         free(CACHE(rig));
         CACHE(rig) = NULL;
     }
 
+    port_io_state_release(RIGPORT(rig));
+    port_io_state_release(PTTPORT(rig));
+    port_io_state_release(DCDPORT(rig));
+
     /* Other buffers go here, as they are converted
      *  to pointers/calloc - WIP
      */
@@ -714,6 +720,7 @@ RIG *HAMLIB_API rig_init(rig_model_t rig_model)
         return NULL;
     }
     cachep = CACHE(rig);
+    rig_cache_init(rig);
 
     rs->rig_model = caps->rig_model;
     rs->priv = NULL;
@@ -811,6 +818,9 @@ RIG *HAMLIB_API rig_init(rig_model_t rig_model)
     rs->rx_vfo = RIG_VFO_CURR;  /* we don't know yet! */
     rs->tx_vfo = RIG_VFO_CURR;  /* we don't know yet! */
     rs->poll_interval = 1000; // enable polling by default
+    rs->event_queue_size = 0;
+    rs->event_overflow = RIG_EVENT_OVERFLOW_COALESCE;
+    rs->poll_budget = 50;
 #if 0
     rs->multicast_data_addr =
         "224.0.0.1"; // do not enable multicast data publishing by default
@@ -1146,7 +1156,7 @@ int HAMLIB_API rig_open(RIG *rig)
     rs->async_data_enabled = rs->async_data_enabled && caps->async_data_supported;
     rp->asyncio = rs->async_data_enabled;
 
-    if (strlen(rp->pathname) > 0)
+    if (strlen(rp->pathname) > 0 && rp->type.rig != RIG_PORT_REPLAY)
     {
         char hoststr[256], portstr[6];
         status = parse_hoststr(rp->pathname, sizeof(rp->pathname),
@@ -1512,6 +1522,26 @@ int HAMLIB_API rig_open(RIG *rig)
               1000); // wait a bit after opening to give some serial ports time
 
 
+    /*
+     * With async data the replies come through the async data handler,
+     * so it has to run before the backend talks to the rig
+     */
+    if (!skip_init)
+    {
+        // without it the callbacks are just called inline
+        rig_event_dispatch_start(rig);
+
+        status = async_data_handler_start(rig);
+
+        if (status < 0)
+        {
+            rig_event_dispatch_stop(rig);
+            port_close(rp, rp->type.rig);
+            rs->comm_status = RIG_COMM_STATUS_ERROR;
+            RETURNFUNC2(status);
+        }
+    }
+
     /*
      * Maybe the backend has something to initialize
      * In case of failure, just close down and report error code.
@@ -1553,6 +1583,8 @@ int HAMLIB_API rig_open(RIG *rig)
 
         if (status != RIG_OK)
         {
+            async_data_handler_stop(rig);
+            rig_event_dispatch_stop(rig);
             remove_opened_rig(rig);
             port_close(rp, rp->type.rig);
             memcpy(&rs->rigport_deprecated, rp, sizeof(hamlib_port_t_deprecated));
@@ -1601,15 +1633,6 @@ int HAMLIB_API rig_open(RIG *rig)
         RETURNFUNC2(RIG_OK);
     }
 
-    status = async_data_handler_start(rig);
-
-    if (status < 0)
-    {
-        port_close(rp, rp->type.rig);
-        rs->comm_status = RIG_COMM_STATUS_ERROR;
-        RETURNFUNC2(status);
-    }
-
     // Some models don't support CW so don't need morse handler
     if (rig->caps->send_morse)
     {
@@ -1782,7 +1805,6 @@ int HAMLIB_API rig_close(RIG *rig)
     if (!skip_init)
     {
         morse_data_handler_stop(rig);
-        async_data_handler_stop(rig);
         rig_poll_routine_stop(rig);
         network_multicast_receiver_stop(rig);
         network_multicast_publisher_stop(rig);
@@ -1795,6 +1817,12 @@ int HAMLIB_API rig_close(RIG *rig)
         caps->rig_close(rig);
     }
 
+    // the backend replies above still come through the async data handler
+    if (!skip_init)
+    {
+        async_data_handler_stop(rig);
+        rig_event_dispatch_stop(rig);
+    }
 
     /*
      * FIXME: what happens if PTT and rig ports are the same?
@@ -2207,13 +2235,13 @@ int rig_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
         if (vfo == RIG_VFO_A || vfo == RIG_VFO_MAIN || (vfo == RIG_VFO_CURR
                 && rs->current_vfo == RIG_VFO_A))
         {
-            if (cachep->freqMainA != freq && (((int)freq % 10) != 0)
+            if (cachep->slot[CACHE_SLOT_MAIN_A].freq != freq && (((int)freq % 10) != 0)
                     && (((int)freq % 100) != 55))
             {
                 rs->doppler = 1;
                 rig_debug(RIG_DEBUG_VERBOSE,
                           "%s(%d): potential doppler detected because old freq %f != new && new freq has 1Hz or such values\n",
-                          __func__, __LINE__, cachep->freqMainA);
+                          __func__, __LINE__, cachep->slot[CACHE_SLOT_MAIN_A].freq);
             }
 
             freq += rs->offset_vfoa;
@@ -2221,13 +2249,13 @@ int rig_set_freq(RIG *rig, vfo_t vfo, freq_t freq)
         else if (vfo == RIG_VFO_B || vfo == RIG_VFO_SUB || (vfo == RIG_VFO_CURR
                  && rs->current_vfo == RIG_VFO_B))
         {
-            if (cachep->freqMainB != freq && ((int)freq % 10) != 0
+            if (cachep->slot[CACHE_SLOT_MAIN_B].freq != freq && ((int)freq % 10) != 0
                     && (((int)freq % 100) != 55))
             {
                 rs->doppler = 1;
                 rig_debug(RIG_DEBUG_VERBOSE,
                           "%s(%d): potential doppler detected because old freq %f != new && new freq has 1Hz or such values\n",
-                          __func__, __LINE__, cachep->freqMainB);
+                          __func__, __LINE__, cachep->slot[CACHE_SLOT_MAIN_B].freq);
             }
 
             freq += rs->offset_vfob;
@@ -2605,7 +2633,7 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
             rig_debug(RIG_DEBUG_TRACE,
                       "%s: split is on so returning VFOA last known freq\n",
                       __func__);
-            *freq = cachep->freqMainA;
+            *freq = cachep->slot[CACHE_SLOT_MAIN_A].freq;
             ELAPSED2;
             LOCK(0);
             RETURNFUNC(RIG_OK);
@@ -2631,6 +2659,7 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
         rig_debug(RIG_DEBUG_TRACE,
                   "%s: %s cache hit age=%dms, freq=%.0f, use_cached_freq=%d\n", __func__,
                   rig_strvfo(vfo), cache_ms_freq, *freq, rs->use_cached_freq);
+        rig_cache_count(cachep, CACHE_ITEM_FREQ, 1);
         ELAPSED2;
         LOCK(0);
         RETURNFUNC(RIG_OK);
@@ -2642,6 +2671,7 @@ int HAMLIB_API rig_get_freq(RIG *rig, vfo_t vfo, freq_t *freq)
                   __func__,
                   cache_ms_freq,
                   rig_strvfo(vfo), rig_strvfo(vfo), rs->use_cached_freq);
+        rig_cache_count(cachep, CACHE_ITEM_FREQ, 0);
     }
 
     caps = rig->caps;
@@ -3101,6 +3131,7 @@ int HAMLIB_API rig_get_mode(RIG *rig,
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age mode=%dms, width=%dms\n",
                   __func__, cache_ms_mode, cache_ms_width);
+        rig_cache_count(cachep, CACHE_ITEM_MODE, 1);
 
         ELAPSED2;
         RETURNFUNC(RIG_OK);
@@ -3111,6 +3142,7 @@ int HAMLIB_API rig_get_mode(RIG *rig,
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age mode=%dms, width=%dms\n",
                   __func__, cache_ms_mode, cache_ms_width);
+        rig_cache_count(cachep, CACHE_ITEM_MODE, 1);
 
         ELAPSED2;
         RETURNFUNC(RIG_OK);
@@ -3119,6 +3151,7 @@ int HAMLIB_API rig_get_mode(RIG *rig,
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age mode=%dms, width=%dms\n",
                   __func__, cache_ms_mode, cache_ms_width);
+        rig_cache_count(cachep, CACHE_ITEM_MODE, 0);
     }
 
     LOCK(1); // we let the caching work before we lock things
@@ -3455,8 +3488,7 @@ int HAMLIB_API rig_set_vfo(RIG *rig, vfo_t vfo)
     if (retcode == RIG_OK)
     {
         vfo = rs->current_vfo; // vfo may change in the rig backend
-        cachep->vfo = vfo;
-        elapsed_ms(&cachep->time_vfo, HAMLIB_ELAPSED_SET);
+        rig_set_cache_vfo(rig, vfo);
         rig_debug(RIG_DEBUG_TRACE, "%s: rs->current_vfo=%s\n", __func__,
                   rig_strvfo(vfo));
     }
@@ -3559,12 +3591,14 @@ int HAMLIB_API rig_get_vfo(RIG *rig, vfo_t *vfo)
         *vfo = cachep->vfo;
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms, vfo=%s\n", __func__,
                   cache_ms, rig_strvfo(*vfo));
+        rig_cache_count(cachep, CACHE_ITEM_VFO, 1);
         ELAPSED2;
         RETURNFUNC(RIG_OK);
     }
     else
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
+        rig_cache_count(cachep, CACHE_ITEM_VFO, 0);
     }
 
     HAMLIB_TRACE;
@@ -3577,7 +3611,9 @@ int HAMLIB_API rig_get_vfo(RIG *rig, vfo_t *vfo)
         if (retcode == RIG_OK)
         {
             rs->current_vfo = *vfo;
+            rig_cache_write_begin(cachep);
             cachep->vfo = *vfo;
+            rig_cache_write_end(cachep);
             //cache_ms = elapsed_ms(&cachep->time_vfo, HAMLIB_ELAPSED_SET);
         }
         else
@@ -3625,8 +3661,8 @@ int HAMLIB_API rig_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
     const struct rig_caps *caps;
     struct rig_state *rs;
     hamlib_port_t *rp, *pttp;
-    struct rig_cache *cachep;
     int retcode = RIG_OK;
+    int tx_class;
 
     if (CHECK_RIG_ARG(rig))
     {
@@ -3639,7 +3675,6 @@ int HAMLIB_API rig_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
 
     caps = rig->caps;
     rs = STATE(rig);
-    cachep = CACHE(rig);
     rp = RIGPORT(rig);
     pttp = PTTPORT(rig);
 
@@ -3672,7 +3707,12 @@ int HAMLIB_API rig_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
             do
             {
                 HAMLIB_TRACE;
+
+                /* PTT off must not wait behind queued commands */
+                tx_class = port_tx_class(ptt == RIG_PTT_OFF ? PORT_TX_URGENT :
+                                         PORT_TX_NORMAL);
                 retcode = caps->set_ptt(rig, vfo, ptt);
+                port_tx_class(tx_class);
 
                 if (retcode != RIG_OK)
                 {
@@ -3685,7 +3725,7 @@ int HAMLIB_API rig_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
                 hl_usleep(50 * 1000); // give PTT a chance to do its thing
 
                 // don't use the cached value and check to see if it worked
-                elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_INVALIDATE);
+                elapsed_ms(&CACHE(rig)->time_ptt, HAMLIB_ELAPSED_INVALIDATE);
 
                 tptt = -1;
                 // IC-9700 is failing on get_ptt right after set_ptt in split mode
@@ -3747,7 +3787,10 @@ int HAMLIB_API rig_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
                 do
                 {
                     HAMLIB_TRACE;
+                    tx_class = port_tx_class(ptt == RIG_PTT_OFF ? PORT_TX_URGENT :
+                                             PORT_TX_NORMAL);
                     retcode = caps->set_ptt(rig, vfo, ptt);
+                    port_tx_class(tx_class);
 
                     if (retcode != RIG_OK)
                     {
@@ -3926,8 +3969,7 @@ int HAMLIB_API rig_set_ptt(RIG *rig, vfo_t vfo, ptt_t ptt)
     // is requested on a rig that can't change freq on a transmitting VFO
     if (ptt != RIG_PTT_ON) { hl_usleep(50 * 1000); }
 
-    cachep->ptt = ptt;
-    elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
+    rig_set_cache_ptt(rig, ptt);
 
     if (retcode != RIG_OK) { rig_debug(RIG_DEBUG_ERR, "%s: Return code=%d\n", __func__, retcode); }
 
@@ -3995,6 +4037,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
     if (cache_ms < cachep->timeout_ms)
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms\n", __func__, cache_ms);
+        rig_cache_count(cachep, CACHE_ITEM_PTT, 1);
         *ptt = cachep->ptt;
         ELAPSED2;
         RETURNFUNC(RIG_OK);
@@ -4002,6 +4045,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
     else
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
+        rig_cache_count(cachep, CACHE_ITEM_PTT, 0);
     }
 
     caps = rig->caps;
@@ -4029,8 +4073,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                cachep->ptt = *ptt;
-                elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
+                rig_set_cache_ptt(rig, *ptt);
             }
 
             ELAPSED2;
@@ -4083,8 +4126,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             {
                 /* Return the first error code */
                 retcode = rc2;
-                cachep->ptt = *ptt;
-                elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
+                rig_set_cache_ptt(rig, *ptt);
             }
         }
 
@@ -4101,8 +4143,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
-                cachep->ptt = *ptt;
+                rig_set_cache_ptt(rig, *ptt);
             }
 
             LOCK(0);
@@ -4124,8 +4165,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             *ptt = status ? RIG_PTT_ON : RIG_PTT_OFF;
         }
 
-        cachep->ptt = *ptt;
-        elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
+        rig_set_cache_ptt(rig, *ptt);
         ELAPSED2;
         LOCK(0);
         RETURNFUNC(retcode);
@@ -4139,8 +4179,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
-                cachep->ptt = *ptt;
+                rig_set_cache_ptt(rig, *ptt);
             }
 
             ELAPSED2;
@@ -4162,8 +4201,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
             *ptt = status ? RIG_PTT_ON : RIG_PTT_OFF;
         }
 
-        cachep->ptt = *ptt;
-        elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
+        rig_set_cache_ptt(rig, *ptt);
         ELAPSED2;
         LOCK(0);
         RETURNFUNC(retcode);
@@ -4176,8 +4214,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
-                cachep->ptt = *ptt;
+                rig_set_cache_ptt(rig, *ptt);
             }
 
             ELAPSED2;
@@ -4189,8 +4226,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
         if (retcode == RIG_OK)
         {
-            elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
-            cachep->ptt = *ptt;
+            rig_set_cache_ptt(rig, *ptt);
         }
 
         ELAPSED2;
@@ -4205,8 +4241,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
-                cachep->ptt = *ptt;
+                rig_set_cache_ptt(rig, *ptt);
             }
 
             ELAPSED2;
@@ -4218,8 +4253,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
         if (retcode == RIG_OK)
         {
-            elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
-            cachep->ptt = *ptt;
+            rig_set_cache_ptt(rig, *ptt);
         }
 
         ELAPSED2;
@@ -4235,8 +4269,7 @@ int HAMLIB_API rig_get_ptt(RIG *rig, vfo_t vfo, ptt_t *ptt)
 
             if (retcode == RIG_OK)
             {
-                elapsed_ms(&cachep->time_ptt, HAMLIB_ELAPSED_SET);
-                cachep->ptt = *ptt;
+                rig_set_cache_ptt(rig, *ptt);
             }
 
             ELAPSED2;
@@ -5893,21 +5926,16 @@ int HAMLIB_API rig_set_split_vfo(RIG *rig,
         {
             // Only update cache on success
             rs->rx_vfo = rs->current_vfo;
+            rs->tx_vfo = split == RIG_SPLIT_OFF ? rs->current_vfo : tx_vfo;
+            rig_cache_write_begin(cachep);
             cachep->split = split;
-
-            if (split == RIG_SPLIT_OFF)
-            {
-                rs->tx_vfo = rs->current_vfo;
-                cachep->split_vfo = rs->current_vfo;
-            }
-            else
-            {
-                rs->tx_vfo = tx_vfo;
-                cachep->split_vfo = tx_vfo;
-            }
+            cachep->split_vfo = rs->tx_vfo;
+            rig_cache_write_end(cachep);
         }
 
+        rig_cache_write_begin(cachep);
         elapsed_ms(&cachep->time_split, HAMLIB_ELAPSED_SET);
+        rig_cache_write_end(cachep);
         ELAPSED2;
         RETURNFUNC(retcode);
     }
@@ -5952,32 +5980,34 @@ int HAMLIB_API rig_set_split_vfo(RIG *rig,
     if (retcode == RIG_OK)
     {
         // Only update cache on success
-        cachep->split = split;
-
         if (split == RIG_SPLIT_OFF)
         {
             if (caps->targetable_vfo & RIG_TARGETABLE_FREQ)
             {
                 rs->rx_vfo = rx_vfo;
                 rs->tx_vfo = rx_vfo;
-                cachep->split_vfo = rx_vfo;
             }
             else
             {
                 rs->rx_vfo = rs->current_vfo;
                 rs->tx_vfo = rs->current_vfo;
-                cachep->split_vfo = rs->current_vfo;
             }
         }
         else
         {
             rs->rx_vfo = rx_vfo;
             rs->tx_vfo = tx_vfo;
-            cachep->split_vfo = tx_vfo;
         }
+
+        rig_cache_write_begin(cachep);
+        cachep->split = split;
+        cachep->split_vfo = rs->tx_vfo;
+        rig_cache_write_end(cachep);
     }
 
+    rig_cache_write_begin(cachep);
     elapsed_ms(&cachep->time_split, HAMLIB_ELAPSED_SET);
+    rig_cache_write_end(cachep);
     ELAPSED2;
     RETURNFUNC(retcode);
 }
@@ -6009,6 +6039,7 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
     int retcode;
     int cache_ms;
     int use_cache = 0;
+    unsigned int seq;
 
     if (CHECK_RIG_ARG(rig))
     {
@@ -6041,8 +6072,14 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
         rig_debug(RIG_DEBUG_TRACE, "%s: ?get_split_vfo=%d use_cache=%d\n", __func__,
                   caps->get_split_vfo != NULL, use_cache);
         // if we can't get the vfo we will return whatever we have cached
-        *split = cachep->split;
-        *tx_vfo = cachep->split_vfo;
+        do
+        {
+            seq = rig_cache_read_begin(cachep);
+            *split = cachep->split;
+            *tx_vfo = cachep->split_vfo;
+        }
+        while (rig_cache_read_retry(cachep, seq));
+
         ELAPSED2;
         RETURNFUNC(RIG_OK);
     }
@@ -6052,16 +6089,24 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
 
     if (cache_ms < cachep->timeout_ms)
     {
-        *split = cachep->split;
-        *tx_vfo = cachep->split_vfo;
+        do
+        {
+            seq = rig_cache_read_begin(cachep);
+            *split = cachep->split;
+            *tx_vfo = cachep->split_vfo;
+        }
+        while (rig_cache_read_retry(cachep, seq));
+
         rig_debug(RIG_DEBUG_TRACE, "%s: cache hit age=%dms, split=%d, tx_vfo=%s\n",
                   __func__, cache_ms, *split, rig_strvfo(*tx_vfo));
+        rig_cache_count(cachep, CACHE_ITEM_SPLIT, 1);
         ELAPSED2;
         RETURNFUNC(RIG_OK);
     }
     else
     {
         rig_debug(RIG_DEBUG_TRACE, "%s: cache miss age=%dms\n", __func__, cache_ms);
+        rig_cache_count(cachep, CACHE_ITEM_SPLIT, 0);
     }
 
     HAMLIB_TRACE;
@@ -6071,9 +6116,11 @@ int HAMLIB_API rig_get_split_vfo(RIG *rig,
     {
         // Only update cache on success
         rs->tx_vfo = *tx_vfo;
+        rig_cache_write_begin(cachep);
         cachep->split = *split;
         cachep->split_vfo = *tx_vfo;
         elapsed_ms(&cachep->time_split, HAMLIB_ELAPSED_SET);
+        rig_cache_write_end(cachep);
         rig_debug(RIG_DEBUG_TRACE, "%s(%d): cache.split=%d\n", __func__, __LINE__,
                   cachep->split);
     }
@@ -7489,6 +7536,7 @@ int HAMLIB_API rig_send_morse(RIG *rig, vfo_t vfo, const char *msg)
     const struct rig_caps *caps;
     struct rig_state *rs;
     int retcode = -RIG_EINTERNAL, rc2;
+    int tx_class;
     vfo_t curr_vfo;
 
     if (CHECK_RIG_ARG(rig))
@@ -7556,7 +7604,9 @@ int HAMLIB_API rig_send_morse(RIG *rig, vfo_t vfo, const char *msg)
     }
 
     HAMLIB_TRACE;
+    tx_class = port_tx_class(PORT_TX_CW);
     retcode = caps->send_morse(rig, vfo, msg);
+    port_tx_class(tx_class);
     /* try and revert even if we had an error above */
     rc2 = caps->set_vfo(rig, curr_vfo);
 
@@ -7605,6 +7655,7 @@ int HAMLIB_API rig_stop_morse(RIG *rig, vfo_t vfo)
     }
 
     resetFIFO(rs->fifo_morse); // clear out the CW queue
+    port_tx_abort(RIGPORT(rig), PORT_TX_CW); // and CW already queued for the port
 
     LOCK(1);
     if (vfo == RIG_VFO_CURR
@@ -8145,6 +8196,10 @@ int HAMLIB_API rig_get_vfo_info(RIG *rig, vfo_t vfo, freq_t *freq,
     //if (vfo == RIG_VFO_CURR) { vfo = STATE(rig)->current_vfo; }
 
     vfo = vfo_fixup(rig, vfo, cachep->split);
+
+    // one get_status_bulk may answer all three getters below
+    if (vfo == STATE(rig)->current_vfo) { rig_cache_refresh_status(rig); }
+
     // we can't use the cached values as some clients may only call this function
     // like Log4OM which mostly does polling
     HAMLIB_TRACE;
@@ -8158,7 +8213,7 @@ int HAMLIB_API rig_get_vfo_info(RIG *rig, vfo_t vfo, freq_t *freq,
     int allTheTimeB = (vfo & (RIG_VFO_B | RIG_VFO_SUB))
                       && (rig->caps->targetable_vfo & RIG_TARGETABLE_MODE);
     int justOnceB = (vfo & (RIG_VFO_B | RIG_VFO_SUB))
-                    && (cachep->modeMainB == RIG_MODE_NONE);
+                    && (cachep->slot[CACHE_SLOT_MAIN_B].mode == RIG_MODE_NONE);
 
     if (allTheTimeA || allTheTimeB || justOnceB)
     {
@@ -8173,8 +8228,8 @@ int HAMLIB_API rig_get_vfo_info(RIG *rig, vfo_t vfo, freq_t *freq,
     }
     else // we'll just us VFOA so we don't swap vfos -- freq is what's important
     {
-        *mode = cachep->modeMainA;
-        *width = cachep->widthMainA;
+        *mode = cachep->slot[CACHE_SLOT_MAIN_A].mode;
+        *width = cachep->slot[CACHE_SLOT_MAIN_A].width;
     }
 
     *satmode = cachep->satmode;
@@ -8193,6 +8248,74 @@ int HAMLIB_API rig_get_vfo_info(RIG *rig, vfo_t vfo, freq_t *freq,
     RETURNFUNC(RIG_OK);
 }
 
+/**
+ * \brief get the state of several VFOs with as few commands as possible
+ * \param rig   The rig handle
+ * \param status   VFOs to read, with vfo set
+ * \param n   Number of entries in status
+ *
+ * Reads freq, mode, PTT, split, RIT and XIT, as far as the rig tells them,
+ * with the backend's get_status_bulk, e.g. one Kenwood IF for the current
+ * VFO.  The valid bits of each entry tell what was read, an entry the
+ * backend cannot answer keeps valid at 0.  Freq, mode, PTT and split go to
+ * the cache, so the rig_get_*() that follow need not ask the rig again.
+ *
+ * \return RIG_OK if the operation has been successful, otherwise
+ * a negative value if an error occurred (in which case, cause is
+ * set appropriately), -RIG_ENAVAIL when the backend has no get_status_bulk.
+ */
+int HAMLIB_API rig_get_status_bulk(RIG *rig, struct rig_status_bulk *status,
+                                   int n)
+{
+    const struct rig_caps *caps;
+    struct rig_cache *cachep;
+    int retcode, i;
+
+    if (CHECK_RIG_ARG(rig))
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: rig or rig->caps is null\n", __func__);
+        return -RIG_EINVAL;
+    }
+
+    ENTERFUNC;
+
+    if (!status || n < 1)
+    {
+        RETURNFUNC(-RIG_EINVAL);
+    }
+
+    caps = rig->caps;
+    cachep = CACHE(rig);
+
+    if (caps->get_status_bulk == NULL)
+    {
+        RETURNFUNC(-RIG_ENAVAIL);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        status[i].vfo = vfo_fixup(rig, status[i].vfo, cachep->split);
+        status[i].valid = 0;
+    }
+
+    LOCK(1);
+
+    HAMLIB_TRACE;
+    retcode = caps->get_status_bulk(rig, status, n);
+
+    if (retcode == RIG_OK)
+    {
+        for (i = 0; i < n; i++)
+        {
+            rig_set_cache_status(rig, &status[i]);
+        }
+    }
+
+    LOCK(0);
+
+    RETURNFUNC(retcode);
+}
+
 /**
  * \brief get list of available vfos
  * \param rig   The rig handle
@@ -8472,6 +8595,7 @@ void rig_lock(RIG *rig, int lock)
     {
         rig_debug(RIG_DEBUG_VERBOSE, "%s: client lock disengaged\n", __func__);
         pthread_mutex_unlock(&rs->api_mutex);
+        rig_poll_wake(rig);
     }
 
 }
@@ -8667,10 +8791,6 @@ static void *async_data_handler(void *arg)
     rig_debug(RIG_DEBUG_VERBOSE, "%s: Starting async data handler thread\n",
               __func__);
 
-    // TODO: check how to enable "transceive" on recent Kenwood/Yaesu rigs
-    // TODO: add initial support for async in Kenwood kenwood_transaction (+one) functions -> add transaction_active flag usage
-    // TODO: add initial support for async in Yaesu newcat_get_cmd/set_cmd (+validate) functions -> add transaction_active flag usage
-
     while (rs->async_data_handler_thread_run)
     {
         int frame_length;
@@ -8711,6 +8831,7 @@ static void *async_data_handler(void *arg)
         if (async_frame)
         {
             result = rig->caps->process_async_frame(rig, frame_length, frame);
+            port_count_async_frame(RIGPORT(rig));
 
             if (result < 0)
             {
@@ -8815,7 +8936,12 @@ static void *morse_data_handler(void *arg)
                 char spdchg = *p;
                 *p = 0;
 
-                if (strlen(c) > 0) { rig->caps->send_morse(rig, RIG_VFO_CURR, c); }
+                if (strlen(c) > 0)
+                {
+                    int tx_class = port_tx_class(PORT_TX_CW);
+                    rig->caps->send_morse(rig, RIG_VFO_CURR, c);
+                    port_tx_class(tx_class);
+                }
 
                 rig_debug(RIG_DEBUG_VERBOSE, "%s(%d): keyspd=%d\n", __func__, __LINE__,
                           keyspd.i);
@@ -8850,7 +8976,10 @@ static void *morse_data_handler(void *arg)
 		        rig_lock(rig, 1);
                 do
                 {
+                    // so rig_stop_morse() can drop it from the port queue
+                    int tx_class = port_tx_class(PORT_TX_CW);
                     result = rig->caps->send_morse(rig, RIG_VFO_CURR, c);
+                    port_tx_class(tx_class);
 
                     if (result != RIG_OK)
                     {
@@ -718,6 +718,8 @@ int HAMLIB_API rot_cleanup(ROT *rot)
     }
 
     //TODO Release any allocated port structures
+    port_io_state_release(ROTPORT(rot));
+    port_io_state_release(ROTPORT2(rot));
 
     free(rot);
 
@@ -0,0 +1,409 @@
+/*
+ *  Hamlib Interface - reply time statistics
+ *  Copyright (c) 2025 by the Hamlib group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/*
+ * Time from the end of a command to the end of its reply, kept
+ * per command class in log scale histograms.  A class is the leading
+ * letters of a text command ("FA", "EX", ...) or the first bytes of a
+ * binary one, which for CI-V covers preamble, addresses and command.
+ *
+ * Counts are halved every RTT_DECAY samples so the figures follow a
+ * link that changes.  A class only gets a shorter timeout once it has
+ * RTT_MIN_SAMPLES replies of its own and few timeouts, so a command
+ * that is slow to answer never starves on the timeout of a quick one.
+ *
+ * A frame that repeats the command, the echo of a CI-V bus, is not the
+ * reply, so the time keeps running until the next frame.
+ */
+
+#include "hamlib/config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hamlib/rig.h"
+#include "rtt.h"
+
+extern double monotonic_seconds();
+
+#define RTT_BUCKETS 32          /* sqrt(2) apart from 0.25ms, up to 11.6s */
+#define RTT_BUCKET0 0.25
+#define RTT_CLASSES 16
+#define RTT_KEY_LEN 6
+#define RTT_MIN_SAMPLES 16
+#define RTT_DECAY 256
+#define RTT_ECHO_LEN 64         /* bytes of the command kept to spot its echo */
+
+struct rtt_hist
+{
+    unsigned int count[RTT_BUCKETS];
+    unsigned int total;
+    unsigned int timeouts;
+};
+
+struct rtt_class
+{
+    unsigned char key[RTT_KEY_LEN];
+    size_t key_len;
+    struct rtt_hist hist;
+};
+
+struct rtt_stats
+{
+    pthread_mutex_t lock;       /* writer, async data handler and reader */
+    struct rtt_hist all;
+    struct rtt_class cls[RTT_CLASSES];
+    int n_cls;
+    struct rtt_class *pending;  /* class of the command awaiting a reply */
+    double sent;                /* when it went out */
+    unsigned char cmd[RTT_ECHO_LEN];    /* its first bytes */
+    size_t cmd_len;
+};
+
+static int rtt_bucket(double ms)
+{
+    double ub = RTT_BUCKET0;
+    int i = 0;
+
+    while (ms > ub && i < RTT_BUCKETS - 1)
+    {
+        ub *= 1.41421356;
+        i++;
+    }
+
+    return i;
+}
+
+static double rtt_bucket_ms(int i)
+{
+    double ub = RTT_BUCKET0;
+
+    while (i-- > 0)
+    {
+        ub *= 1.41421356;
+    }
+
+    return ub;
+}
+
+static void rtt_hist_decay(struct rtt_hist *h)
+{
+    int i;
+
+    h->total = 0;
+
+    for (i = 0; i < RTT_BUCKETS; i++)
+    {
+        h->count[i] /= 2;
+        h->total += h->count[i];
+    }
+
+    h->timeouts /= 2;
+}
+
+static void rtt_hist_add(struct rtt_hist *h, double ms)
+{
+    h->count[rtt_bucket(ms)]++;
+
+    if (++h->total >= RTT_DECAY)
+    {
+        rtt_hist_decay(h);
+    }
+}
+
+/* upper bound in ms of the bucket holding the given fraction of replies */
+static double rtt_hist_quantile(const struct rtt_hist *h, double q)
+{
+    unsigned int want = (unsigned int)(h->total * q + 0.999);
+    unsigned int sum = 0;
+    int i;
+
+    for (i = 0; i < RTT_BUCKETS; i++)
+    {
+        sum += h->count[i];
+
+        if (sum >= want && sum > 0)
+        {
+            return rtt_bucket_ms(i);
+        }
+    }
+
+    return rtt_bucket_ms(RTT_BUCKETS - 1);
+}
+
+static int rtt_is_letter(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+static size_t rtt_key_len(const unsigned char *cmd, size_t len)
+{
+    size_t n = 0;
+
+    while (n < len && n < RTT_KEY_LEN && rtt_is_letter(cmd[n]))
+    {
+        n++;
+    }
+
+    if (n > 0)
+    {
+        return n;
+    }
+
+    return len < RTT_KEY_LEN ? len : RTT_KEY_LEN;
+}
+
+static struct rtt_class *rtt_class_get(struct rtt_stats *st,
+                                       const unsigned char *cmd, size_t len)
+{
+    struct rtt_class *c, *victim = NULL;
+    size_t key_len = rtt_key_len(cmd, len);
+    int i;
+
+    for (i = 0; i < st->n_cls; i++)
+    {
+        c = &st->cls[i];
+
+        if (c->key_len == key_len && memcmp(c->key, cmd, key_len) == 0)
+        {
+            return c;
+        }
+
+        if (victim == NULL || c->hist.total < victim->hist.total)
+        {
+            victim = c;
+        }
+    }
+
+    if (st->n_cls < RTT_CLASSES)
+    {
+        victim = &st->cls[st->n_cls++];
+    }
+
+    memset(victim, 0, sizeof(*victim));
+    memcpy(victim->key, cmd, key_len);
+    victim->key_len = key_len;
+
+    return victim;
+}
+
+struct rtt_stats *rtt_stats_new(void)
+{
+    struct rtt_stats *st = calloc(1, sizeof(struct rtt_stats));
+
+    if (st != NULL)
+    {
+        pthread_mutex_init(&st->lock, NULL);
+    }
+
+    return st;
+}
+
+void rtt_stats_free(struct rtt_stats *st)
+{
+    if (st == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_destroy(&st->lock);
+    free(st);
+}
+
+void rtt_stats_reset(struct rtt_stats *st)
+{
+    pthread_mutex_lock(&st->lock);
+    memset(&st->all, 0, sizeof(st->all));
+    memset(st->cls, 0, sizeof(st->cls));
+    st->n_cls = 0;
+    st->pending = NULL;
+    pthread_mutex_unlock(&st->lock);
+}
+
+/* a command is on the wire, the next frame received that is not its
+ * echo is taken as its reply */
+void rtt_sent(struct rtt_stats *st, const unsigned char *cmd, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&st->lock);
+    st->pending = rtt_class_get(st, cmd, len);
+    st->sent = monotonic_seconds();
+    st->cmd_len = len < RTT_ECHO_LEN ? len : RTT_ECHO_LEN;
+    memcpy(st->cmd, cmd, st->cmd_len);
+    pthread_mutex_unlock(&st->lock);
+}
+
+/* a whole frame came in */
+void rtt_received(struct rtt_stats *st, const unsigned char *frame,
+                  size_t len)
+{
+    int echo;
+
+    pthread_mutex_lock(&st->lock);
+
+    // the echo of the command, keep waiting for the reply
+    echo = len >= st->cmd_len && memcmp(frame, st->cmd, st->cmd_len) == 0;
+
+    if (st->pending && !echo)
+    {
+        double ms = (monotonic_seconds() - st->sent) * 1000;
+
+        rtt_hist_add(&st->pending->hist, ms);
+        rtt_hist_add(&st->all, ms);
+        st->pending = NULL;
+    }
+
+    pthread_mutex_unlock(&st->lock);
+}
+
+/*
+ * The reply is still pending, so should it come in late after all its
+ * time is counted and the class timeout moves up.
+ */
+void rtt_timed_out(struct rtt_stats *st)
+{
+    pthread_mutex_lock(&st->lock);
+
+    if (st->pending)
+    {
+        st->pending->hist.timeouts++;
+        st->all.timeouts++;
+    }
+
+    pthread_mutex_unlock(&st->lock);
+}
+
+static int rtt_class_timeout(const struct rtt_class *c, int configured,
+                             int factor)
+{
+    const struct rtt_hist *h = &c->hist;
+    double ms;
+
+    /* too little to go by, or this class keeps timing out anyway */
+    if (h->total < RTT_MIN_SAMPLES || h->timeouts * 8 > h->total)
+    {
+        return configured;
+    }
+
+    ms = rtt_hist_quantile(h, 0.99) * factor;
+
+    if (ms < RTT_MIN_TIMEOUT) { ms = RTT_MIN_TIMEOUT; }
+
+    return ms < configured ? (int)(ms + 0.5) : configured;
+}
+
+/* timeout for the reply to the last command sent */
+int rtt_timeout(struct rtt_stats *st, int configured, int factor)
+{
+    int timeout = configured;
+
+    pthread_mutex_lock(&st->lock);
+
+    if (st->pending && factor > 0)
+    {
+        timeout = rtt_class_timeout(st->pending, configured, factor);
+    }
+
+    pthread_mutex_unlock(&st->lock);
+
+    return timeout;
+}
+
+static int rtt_format_key(const struct rtt_class *c, char *buf, size_t len)
+{
+    int n = 0;
+    size_t i;
+
+    for (i = 0; i < c->key_len && rtt_is_letter(c->key[i]); i++) {}
+
+    if (i == c->key_len)
+    {
+        return snprintf(buf, len, "%.*s", (int) c->key_len, (const char *) c->key);
+    }
+
+    for (i = 0; i < c->key_len && n >= 0 && n < (int) len; i++)
+    {
+        n += snprintf(buf + n, len - n, "%02X", c->key[i]);
+    }
+
+    return n;
+}
+
+/*
+ * One entry per class, the whole port first:
+ *   "* n=812 to=3 p50=1.41 p99=5.66 FA n=301 to=0 p50=... timeout=17 ..."
+ * n and to are recent replies and timeouts, p50/p99 in ms and timeout
+ * what the class waits now, also in ms.
+ */
+int rtt_format(struct rtt_stats *st, char *buf, size_t len, int configured,
+               int factor)
+{
+    int n, i;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    buf[0] = '\0';
+
+    pthread_mutex_lock(&st->lock);
+
+    n = snprintf(buf, len, "* n=%u to=%u p50=%.2f p99=%.2f", st->all.total,
+                 st->all.timeouts,
+                 st->all.total ? rtt_hist_quantile(&st->all, 0.5) : 0,
+                 st->all.total ? rtt_hist_quantile(&st->all, 0.99) : 0);
+
+    for (i = 0; i < st->n_cls && n >= 0 && n < (int) len; i++)
+    {
+        const struct rtt_class *c = &st->cls[i];
+
+        if (c->hist.total == 0 && c->hist.timeouts == 0)
+        {
+            continue;
+        }
+
+        n += snprintf(buf + n, len - n, " ");
+
+        if (n >= (int) len) { break; }
+
+        n += rtt_format_key(c, buf + n, len - n);
+
+        if (n >= (int) len) { break; }
+
+        n += snprintf(buf + n, len - n, " n=%u to=%u p50=%.2f p99=%.2f timeout=%d",
+                      c->hist.total, c->hist.timeouts,
+                      c->hist.total ? rtt_hist_quantile(&c->hist, 0.5) : 0,
+                      c->hist.total ? rtt_hist_quantile(&c->hist, 0.99) : 0,
+                      factor > 0 ? rtt_class_timeout(c, configured, factor) : configured);
+    }
+
+    pthread_mutex_unlock(&st->lock);
+
+    return n;
+}
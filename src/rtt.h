@@ -0,0 +1,52 @@
+/*
+ *  Hamlib Interface - reply time statistics
+ *  Copyright (c) 2025 by the Hamlib group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#ifndef _RTT_H
+#define _RTT_H
+
+#include <stddef.h>
+
+#include "hamlib/rig.h"
+
+__BEGIN_DECLS
+
+/* smallest timeout an adaptive port will use, in ms */
+#define RTT_MIN_TIMEOUT 10
+
+struct rtt_stats;
+
+struct rtt_stats *rtt_stats_new(void);
+void rtt_stats_free(struct rtt_stats *st);
+void rtt_stats_reset(struct rtt_stats *st);
+
+void rtt_sent(struct rtt_stats *st, const unsigned char *cmd, size_t len);
+void rtt_received(struct rtt_stats *st, const unsigned char *frame,
+                  size_t len);
+void rtt_timed_out(struct rtt_stats *st);
+
+int rtt_timeout(struct rtt_stats *st, int configured, int factor);
+int rtt_format(struct rtt_stats *st, char *buf, size_t len, int configured,
+               int factor);
+
+__END_DECLS
+
+#endif /* _RTT_H */
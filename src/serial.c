@@ -824,6 +824,12 @@ int HAMLIB_API serial_flush(hamlib_port_t *p)
     short timeout_retry_save;
     unsigned char buf[4096];
 
+    // bytes already pulled into the receive buffer are stale as well
+    if (!p->asyncio)
+    {
+        port_rx_discard(p, 1);
+    }
+
 #ifdef __WIN32__
     struct termios_list *index;
     index = win32_serial_find_port(p->fd);
@@ -991,6 +997,8 @@ int ser_close(hamlib_port_t *p)
 
     //rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
+    port_io_state_reset(p);
+
     /*
      * For microHam devices, do not close the
      * socket via close but call a service routine
@@ -45,6 +45,7 @@
 #include "hamlib/rig_state.h"
 #include "cal.h"
 #include "misc.h"
+#include "cache.h"
 
 
 #ifndef DOC_HIDDEN
@@ -103,7 +104,9 @@ int HAMLIB_API rig_set_level(RIG *rig, vfo_t vfo, setting_t level, value_t val)
             morse_data_handler_set_keyspd(rig, val.i);
         }
 
+        rig_cache_invalidate_setting(rig, CACHE_KIND_LEVEL, level);
         retcode = caps->set_level(rig, vfo, level, val);
+        rig_cache_invalidate_setting(rig, CACHE_KIND_LEVEL, level);
         rig_lock(rig, 0);
         return retcode;
     }
@@ -123,8 +126,10 @@ int HAMLIB_API rig_set_level(RIG *rig, vfo_t vfo, setting_t level, value_t val)
         return retcode;
     }
 
+    rig_cache_invalidate_setting(rig, CACHE_KIND_LEVEL, level);
     retcode = caps->set_level(rig, vfo, level, val);
     caps->set_vfo(rig, curr_vfo);
+    rig_cache_invalidate_setting(rig, CACHE_KIND_LEVEL, level);
     rig_lock(rig, 0);
     return retcode;
 }
@@ -160,6 +165,7 @@ int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
     struct rig_state *rs = STATE(rig);
     int retcode;
     vfo_t curr_vfo;
+    unsigned int epoch;
 
     // too verbose
     //rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -176,6 +182,13 @@ int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
         return -RIG_ENAVAIL;
     }
 
+    if (rig_get_cache_setting(rig, CACHE_KIND_LEVEL, vfo, level, val) == RIG_OK)
+    {
+        return RIG_OK;
+    }
+
+    epoch = rig_cache_settings_epoch(rig);
+
     rig_lock(rig, 1); // Keep Out!
     /*
      * Special case(frontend emulation): calibrated S-meter reading
@@ -197,6 +210,7 @@ int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
         }
 
         val->i = (int)rig_raw2val(rawstr.i, &rs->str_cal);
+        rig_set_cache_setting(rig, CACHE_KIND_LEVEL, vfo, level, *val, epoch);
         rig_lock(rig, 0);
         return RIG_OK;
     }
@@ -207,6 +221,12 @@ int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
             || vfo == rs->current_vfo)
     {
         retcode = caps->get_level(rig, vfo, level, val);
+
+        if (retcode == RIG_OK)
+        {
+            rig_set_cache_setting(rig, CACHE_KIND_LEVEL, vfo, level, *val, epoch);
+        }
+
         rig_lock(rig, 0);
         return retcode;
     }
@@ -228,6 +248,12 @@ int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
 
     retcode = caps->get_level(rig, vfo, level, val);
     caps->set_vfo(rig, curr_vfo);
+
+    if (retcode == RIG_OK)
+    {
+        rig_set_cache_setting(rig, CACHE_KIND_LEVEL, vfo, level, *val, epoch);
+    }
+
     rig_lock(rig, 0);
     return retcode;
 }
@@ -251,6 +277,8 @@ int HAMLIB_API rig_get_level(RIG *rig, vfo_t vfo, setting_t level, value_t *val)
  */
 int HAMLIB_API rig_set_parm(RIG *rig, setting_t parm, value_t val)
 {
+    int retcode;
+
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
     if (CHECK_RIG_ARG(rig))
@@ -263,7 +291,11 @@ int HAMLIB_API rig_set_parm(RIG *rig, setting_t parm, value_t val)
         return -RIG_ENAVAIL;
     }
 
-    return rig->caps->set_parm(rig, parm, val);
+    rig_cache_invalidate_setting(rig, CACHE_KIND_PARM, parm);
+    retcode = rig->caps->set_parm(rig, parm, val);
+    rig_cache_invalidate_setting(rig, CACHE_KIND_PARM, parm);
+
+    return retcode;
 }
 
 
@@ -285,6 +317,9 @@ int HAMLIB_API rig_set_parm(RIG *rig, setting_t parm, value_t val)
  */
 int HAMLIB_API rig_get_parm(RIG *rig, setting_t parm, value_t *val)
 {
+    int retcode;
+    unsigned int epoch;
+
     rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
 
     if (CHECK_RIG_ARG(rig) || !val)
@@ -297,7 +332,21 @@ int HAMLIB_API rig_get_parm(RIG *rig, setting_t parm, value_t *val)
         return -RIG_ENAVAIL;
     }
 
-    return rig->caps->get_parm(rig, parm, val);
+    if (rig_get_cache_setting(rig, CACHE_KIND_PARM, RIG_VFO_NONE, parm,
+                              val) == RIG_OK)
+    {
+        return RIG_OK;
+    }
+
+    epoch = rig_cache_settings_epoch(rig);
+    retcode = rig->caps->get_parm(rig, parm, val);
+
+    if (retcode == RIG_OK)
+    {
+        rig_set_cache_setting(rig, CACHE_KIND_PARM, RIG_VFO_NONE, parm, *val, epoch);
+    }
+
+    return retcode;
 }
 
 
@@ -544,8 +593,10 @@ int HAMLIB_API rig_set_func(RIG *rig, vfo_t vfo, setting_t func, int status)
             || vfo == RIG_VFO_CURR
             || vfo == rs->current_vfo)
     {
-
-        return caps->set_func(rig, vfo, func, status);
+        rig_cache_invalidate_setting(rig, CACHE_KIND_FUNC, func);
+        retcode = caps->set_func(rig, vfo, func, status);
+        rig_cache_invalidate_setting(rig, CACHE_KIND_FUNC, func);
+        return retcode;
     }
     else
     {
@@ -567,13 +618,29 @@ int HAMLIB_API rig_set_func(RIG *rig, vfo_t vfo, setting_t func, int status)
         return retcode;
     }
 
+    rig_cache_invalidate_setting(rig, CACHE_KIND_FUNC, func);
     retcode = caps->set_func(rig, vfo, func, status);
     caps->set_vfo(rig, curr_vfo);
+    rig_cache_invalidate_setting(rig, CACHE_KIND_FUNC, func);
 
     return retcode;
 }
 
 
+/* funcs are cached as value_t like levels */
+static void rig_cache_func(RIG *rig, vfo_t vfo, setting_t func, int status,
+                           int retcode, unsigned int epoch)
+{
+    value_t val;
+
+    if (retcode == RIG_OK)
+    {
+        val.i = status;
+        rig_set_cache_setting(rig, CACHE_KIND_FUNC, vfo, func, val, epoch);
+    }
+}
+
+
 /**
  * \brief get the status of functions of the radio
  * \param rig   The rig handle
@@ -599,6 +666,8 @@ int HAMLIB_API rig_get_func(RIG *rig, vfo_t vfo, setting_t func, int *status)
     struct rig_state *rs = STATE(rig);
     int retcode;
     vfo_t curr_vfo;
+    value_t cached;
+    unsigned int epoch;
 
     // too verbose
     //rig_debug(RIG_DEBUG_VERBOSE, "%s called\n", __func__);
@@ -615,12 +684,21 @@ int HAMLIB_API rig_get_func(RIG *rig, vfo_t vfo, setting_t func, int *status)
         return -RIG_ENAVAIL;
     }
 
+    if (rig_get_cache_setting(rig, CACHE_KIND_FUNC, vfo, func, &cached) == RIG_OK)
+    {
+        *status = cached.i;
+        return RIG_OK;
+    }
+
+    epoch = rig_cache_settings_epoch(rig);
+
     if ((caps->targetable_vfo & RIG_TARGETABLE_FUNC)
             || vfo == RIG_VFO_CURR
             || vfo == rs->current_vfo)
     {
-
-        return caps->get_func(rig, vfo, func, status);
+        retcode = caps->get_func(rig, vfo, func, status);
+        rig_cache_func(rig, vfo, func, *status, retcode, epoch);
+        return retcode;
     }
 
     if (!caps->set_vfo)
@@ -638,6 +716,7 @@ int HAMLIB_API rig_get_func(RIG *rig, vfo_t vfo, setting_t func, int *status)
 
     retcode = caps->get_func(rig, vfo, func, status);
     caps->set_vfo(rig, curr_vfo);
+    rig_cache_func(rig, vfo, func, *status, retcode, epoch);
 
     return retcode;
 }
@@ -112,6 +112,7 @@ static int snapshot_serialize_vfo(cJSON *vfo_node, RIG *rig, vfo_t vfo)
     ptt_t ptt;
     split_t split;
     vfo_t split_vfo;
+    unsigned int seq;
     int result;
     int is_rx, is_tx;
     cJSON *node;
@@ -154,8 +155,13 @@ static int snapshot_serialize_vfo(cJSON *vfo_node, RIG *rig, vfo_t vfo)
         }
     }
 
-    split = cachep->split;
-    split_vfo = cachep->split_vfo;
+    do
+    {
+        seq = rig_cache_read_begin(cachep);
+        split = cachep->split;
+        split_vfo = cachep->split_vfo;
+    }
+    while (rig_cache_read_retry(cachep, seq));
 
     is_rx = (split == RIG_SPLIT_OFF && vfo == rs->current_vfo)
             || (split == RIG_SPLIT_ON && vfo != split_vfo);
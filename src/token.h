@@ -99,6 +99,22 @@
 #define TOK_TIMEOUT_RETRY       TOKEN_FRONTEND(39)
 #define TOK_POST_PTT_DELAY       TOKEN_FRONTEND(40)
 #define TOK_DEVICE_ID            TOKEN_FRONTEND(41)
+/** \brief Apply post write delay before the next write instead of after each one */
+#define TOK_POST_WRITE_DEFERRED  TOKEN_FRONTEND(42)
+/** \brief Queue write_delay paced writes to a writer thread */
+#define TOK_WRITE_QUEUE          TOKEN_FRONTEND(43)
+/** \brief Record port traffic to a capture file */
+#define TOK_CAPTURE_FILE         TOKEN_FRONTEND(44)
+/** \brief Replay a capture file instead of talking to a rig */
+#define TOK_REPLAY_FILE          TOKEN_FRONTEND(45)
+/** \brief Replay speed, 1 is as recorded, 0 does not wait at all */
+#define TOK_REPLAY_SPEED         TOKEN_FRONTEND(46)
+/** \brief Reply timeout learned from observed reply times */
+#define TOK_ADAPTIVE_TIMEOUT     TOKEN_FRONTEND(47)
+/** \brief Reply times and timeouts learned so far */
+#define TOK_TIMEOUT_LEARNED      TOKEN_FRONTEND(48)
+/** \brief Bytes, timeouts, retries and async frames counted on the port */
+#define TOK_PORT_STATS           TOKEN_FRONTEND(49)
 
 /*
  * rig specific tokens
@@ -145,6 +161,28 @@
 #define TOK_FREQ_SKIP  TOKEN_FRONTEND(136)
 /** \brief rig: Client ID of WSJTX or GPREDICT */
 #define TOK_CLIENT  TOKEN_FRONTEND(137)
+/** \brief rig: Cache timeout of levels other than meters in milliseconds */
+#define TOK_CACHE_TIMEOUT_LEVEL  TOKEN_FRONTEND(138)
+/** \brief rig: Cache timeout of meter levels in milliseconds */
+#define TOK_CACHE_TIMEOUT_METER  TOKEN_FRONTEND(139)
+/** \brief rig: Cache timeout of funcs in milliseconds */
+#define TOK_CACHE_TIMEOUT_FUNC  TOKEN_FRONTEND(140)
+/** \brief rig: Cache timeout of parms in milliseconds */
+#define TOK_CACHE_TIMEOUT_PARM  TOKEN_FRONTEND(141)
+/** \brief rig: Cache hits and misses of settings, freq, mode, vfo, ptt and split */
+#define TOK_CACHE_STATS  TOKEN_FRONTEND(142)
+/** \brief rig: Length of the queue of the callback dispatch thread */
+#define TOK_EVENT_QUEUE  TOKEN_FRONTEND(143)
+/** \brief rig: What a full callback queue does with a new event */
+#define TOK_EVENT_OVERFLOW  TOKEN_FRONTEND(144)
+/** \brief rig: Queued, coalesced and dropped events */
+#define TOK_EVENT_STATS  TOKEN_FRONTEND(145)
+/** \brief rig: Poll routine refreshes freq, mode, ptt, split and levels itself */
+#define TOK_POLL_REFRESH  TOKEN_FRONTEND(146)
+/** \brief rig: Percent of the serial port capacity the poll refreshes may use */
+#define TOK_POLL_BUDGET  TOKEN_FRONTEND(147)
+/** \brief rig: Poll refreshes done, their bytes and how much the schedule was stretched */
+#define TOK_POLL_STATS  TOKEN_FRONTEND(148)
 
 /*
  * rotator specific tokens
@@ -0,0 +1,477 @@
+/*
+ *  Hamlib Interface - wire capture and replay
+ *  Copyright (c) 2025 by the Hamlib group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+/*
+ * Capture file format, all integers little endian:
+ *
+ *   header  "HLWIRE" version(1) 0
+ *   record  dir('T' or 'R') delta(u32) length(u16) data[length]
+ *
+ * delta is the time in microseconds since the previous record (since the
+ * capture was opened for the first one), taken from the monotonic clock.
+ * A TX record is one write_block(), an RX record is one read from the
+ * device, so a replay hands the backend the same chunks it saw live.
+ */
+
+#include "hamlib/config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "hamlib/rig.h"
+#include "misc.h"
+#include "wirecap.h"
+
+extern double monotonic_seconds();
+
+#define WIRECAP_MAGIC "HLWIRE"
+#define WIRECAP_VERSION 1
+#define WIRECAP_HDR_LEN 8
+#define WIRECAP_REC_LEN 7
+#define WIRECAP_MAX_CHUNK 0xffff
+/* how many records to look ahead for a write that went missing */
+#define WIRECAP_RESYNC_RECORDS 64
+
+struct wirecap
+{
+    FILE *fp;
+    pthread_mutex_t lock;       /* TX and RX may come from different threads */
+    double last;                /* monotonic time of the previous record */
+};
+
+struct wirereplay
+{
+    pthread_mutex_t lock;       /* the async data handler reads, others write */
+    unsigned char *data;
+    size_t len;
+    size_t pos;                 /* offset of the current record */
+    size_t off;                 /* bytes of the current record used up */
+    double t;                   /* capture time of the current record */
+    double speed;               /* 1 = as recorded, 0 = no waiting at all */
+    double anchor_real;         /* when the last TX record was replayed */
+    double anchor_cap;          /* and its capture time */
+    int mismatches;
+};
+
+struct wirecap *wirecap_open(const char *path)
+{
+    struct wirecap *cap;
+    unsigned char hdr[WIRECAP_HDR_LEN] = WIRECAP_MAGIC;
+
+    cap = calloc(1, sizeof(struct wirecap));
+
+    if (cap == NULL)
+    {
+        return NULL;
+    }
+
+    cap->fp = fopen(path, "wb");
+
+    if (cap->fp == NULL)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: cannot create %s: %s\n", __func__, path,
+                  strerror(errno));
+        free(cap);
+        return NULL;
+    }
+
+    hdr[6] = WIRECAP_VERSION;
+    fwrite(hdr, 1, sizeof(hdr), cap->fp);
+
+    pthread_mutex_init(&cap->lock, NULL);
+    cap->last = monotonic_seconds();
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: capturing to %s\n", __func__, path);
+
+    return cap;
+}
+
+void wirecap_record(struct wirecap *cap, int dir, const unsigned char *data,
+                    size_t len)
+{
+    pthread_mutex_lock(&cap->lock);
+
+    do
+    {
+        unsigned char rec[WIRECAP_REC_LEN];
+        size_t n = len > WIRECAP_MAX_CHUNK ? WIRECAP_MAX_CHUNK : len;
+        double now = monotonic_seconds();
+        double delta = (now - cap->last) * 1e6;
+        unsigned long us = delta < 0 ? 0 : delta > 0xffffffff ? 0xffffffff :
+                           (unsigned long) delta;
+
+        cap->last = now;
+
+        rec[0] = (unsigned char) dir;
+        rec[1] = us & 0xff;
+        rec[2] = (us >> 8) & 0xff;
+        rec[3] = (us >> 16) & 0xff;
+        rec[4] = (us >> 24) & 0xff;
+        rec[5] = n & 0xff;
+        rec[6] = (n >> 8) & 0xff;
+
+        fwrite(rec, 1, sizeof(rec), cap->fp);
+        fwrite(data, 1, n, cap->fp);
+
+        data += n;
+        len -= n;
+    }
+    while (len > 0);
+
+    pthread_mutex_unlock(&cap->lock);
+}
+
+void wirecap_close(struct wirecap *cap)
+{
+    if (cap == NULL)
+    {
+        return;
+    }
+
+    fclose(cap->fp);
+    pthread_mutex_destroy(&cap->lock);
+    free(cap);
+}
+
+static int replay_at_end(const struct wirereplay *rp)
+{
+    return rp->pos >= rp->len;
+}
+
+static int replay_dir(const struct wirereplay *rp)
+{
+    return rp->data[rp->pos];
+}
+
+static size_t replay_rec_len(const struct wirereplay *rp, size_t pos)
+{
+    return rp->data[pos + 5] | (rp->data[pos + 6] << 8);
+}
+
+static double replay_rec_delta(const struct wirereplay *rp, size_t pos)
+{
+    const unsigned char *p = rp->data + pos + 1;
+
+    return (p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long) p[3] << 24)) /
+           1e6;
+}
+
+static const unsigned char *replay_payload(const struct wirereplay *rp)
+{
+    return rp->data + rp->pos + WIRECAP_REC_LEN;
+}
+
+static void replay_next(struct wirereplay *rp)
+{
+    rp->pos += WIRECAP_REC_LEN + replay_rec_len(rp, rp->pos);
+    rp->off = 0;
+
+    if (!replay_at_end(rp))
+    {
+        rp->t += replay_rec_delta(rp, rp->pos);
+    }
+}
+
+struct wirereplay *wirereplay_open(const char *path, double speed)
+{
+    struct wirereplay *rp;
+    FILE *fp;
+    long size;
+    size_t pos;
+
+    fp = fopen(path, "rb");
+
+    if (fp == NULL)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: cannot open %s: %s\n", __func__, path,
+                  strerror(errno));
+        return NULL;
+    }
+
+    rp = calloc(1, sizeof(struct wirereplay));
+
+    if (rp == NULL || fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0)
+    {
+        free(rp);
+        fclose(fp);
+        return NULL;
+    }
+
+    rewind(fp);
+    rp->data = malloc(size > 0 ? size : 1);
+
+    if (rp->data == NULL || fread(rp->data, 1, size, fp) != (size_t) size
+            || size < WIRECAP_HDR_LEN
+            || memcmp(rp->data, WIRECAP_MAGIC, 6) != 0
+            || rp->data[6] != WIRECAP_VERSION)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: %s is not a capture file\n", __func__, path);
+        free(rp->data);
+        free(rp);
+        fclose(fp);
+        return NULL;
+    }
+
+    fclose(fp);
+
+    /* drop a record cut short by a crash during capture */
+    for (pos = WIRECAP_HDR_LEN; pos + WIRECAP_REC_LEN <= (size_t) size;)
+    {
+        size_t next = pos + WIRECAP_REC_LEN + replay_rec_len(rp, pos);
+
+        if (next > (size_t) size) { break; }
+
+        pos = next;
+    }
+
+    pthread_mutex_init(&rp->lock, NULL);
+    rp->len = pos;
+    rp->pos = WIRECAP_HDR_LEN;
+    rp->speed = speed;
+    rp->anchor_real = monotonic_seconds();
+
+    if (!replay_at_end(rp))
+    {
+        rp->t = replay_rec_delta(rp, rp->pos);
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE, "%s: replaying %s, %d bytes, speed %g\n",
+              __func__, path, (int) rp->len, speed);
+
+    return rp;
+}
+
+/*
+ * Wait for the next RX record to be due.  Returns RIG_OK when there is
+ * something to read, -RIG_ETIMEOUT when the capture has none at this
+ * point (the rig did not answer, or the backend went another way).
+ */
+int wirereplay_wait(struct wirereplay *rp, int timeout)
+{
+    double wait = 0;
+    int have_rx;
+
+    pthread_mutex_lock(&rp->lock);
+
+    have_rx = !replay_at_end(rp) && replay_dir(rp) == WIRECAP_RX;
+
+    if (have_rx && rp->speed > 0)
+    {
+        wait = rp->anchor_real + (rp->t - rp->anchor_cap) / rp->speed
+               - monotonic_seconds();
+    }
+
+    pthread_mutex_unlock(&rp->lock);
+
+    if (!have_rx)
+    {
+        if (rp->speed > 0)
+        {
+            hl_usleep(timeout * 1000 / rp->speed);
+        }
+
+        return -RIG_ETIMEOUT;
+    }
+
+    if (wait * 1000 > timeout)
+    {
+        hl_usleep(timeout * 1000);
+        return -RIG_ETIMEOUT;
+    }
+
+    if (wait > 0)
+    {
+        hl_usleep(wait * 1e6);
+    }
+
+    return RIG_OK;
+}
+
+/* hand out what is left of the current RX record */
+ssize_t wirereplay_read(struct wirereplay *rp, unsigned char *buf,
+                        size_t count)
+{
+    size_t n;
+
+    pthread_mutex_lock(&rp->lock);
+
+    if (replay_at_end(rp) || replay_dir(rp) != WIRECAP_RX)
+    {
+        pthread_mutex_unlock(&rp->lock);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    n = replay_rec_len(rp, rp->pos) - rp->off;
+
+    if (n > count) { n = count; }
+
+    memcpy(buf, replay_payload(rp) + rp->off, n);
+    rp->off += n;
+
+    if (rp->off == replay_rec_len(rp, rp->pos))
+    {
+        replay_next(rp);
+    }
+
+    pthread_mutex_unlock(&rp->lock);
+
+    return (ssize_t) n;
+}
+
+static int replay_tx_matches(const struct wirereplay *rp,
+                             const unsigned char *buf, size_t count)
+{
+    size_t n = replay_rec_len(rp, rp->pos);
+
+    return memcmp(replay_payload(rp), buf, n < count ? n : count) == 0;
+}
+
+/*
+ * Backends retry and poll depending on timing, so the live session may
+ * have commands the replay does not send.  Look a little ahead for the
+ * write and continue from there if found.
+ */
+static int replay_resync(struct wirereplay *rp, const unsigned char *buf,
+                         size_t count)
+{
+    size_t pos = rp->pos;
+    double t = rp->t;
+    int i;
+
+    for (i = 0; i < WIRECAP_RESYNC_RECORDS; i++)
+    {
+        replay_next(rp);
+
+        if (replay_at_end(rp))
+        {
+            break;
+        }
+
+        if (replay_dir(rp) == WIRECAP_TX && replay_tx_matches(rp, buf, count))
+        {
+            rig_debug(RIG_DEBUG_TRACE, "%s: skipped %d records\n", __func__, i + 1);
+            return 1;
+        }
+    }
+
+    rp->pos = pos;
+    rp->off = 0;
+    rp->t = t;
+
+    return 0;
+}
+
+/*
+ * Match a write against the TX records of the capture.  RX the backend
+ * never read (flushed, or the reply it gave up on) is skipped, and so
+ * are commands it does not send this time.  A write not found in the
+ * capture is reported and gets no reply, as from a rig that did not
+ * understand it; the capture stays where it was for the next write.
+ */
+int wirereplay_write(struct wirereplay *rp, const unsigned char *buf,
+                     size_t count)
+{
+    int mismatch = 0;
+
+    pthread_mutex_lock(&rp->lock);
+
+    while (count > 0)
+    {
+        size_t n;
+
+        if (replay_at_end(rp))
+        {
+            rig_debug(RIG_DEBUG_WARN, "%s: capture exhausted, %d bytes not matched\n",
+                      __func__, (int) count);
+            break;
+        }
+
+        if (replay_dir(rp) != WIRECAP_TX)
+        {
+            rig_debug(RIG_DEBUG_TRACE, "%s: skipping %d unread RX bytes\n", __func__,
+                      (int)(replay_rec_len(rp, rp->pos) - rp->off));
+            replay_next(rp);
+            continue;
+        }
+
+        if (rp->off == 0 && !replay_tx_matches(rp, buf, count)
+                && !replay_resync(rp, buf, count))
+        {
+            mismatch = 1;
+            break;
+        }
+
+        n = replay_rec_len(rp, rp->pos) - rp->off;
+
+        if (n > count) { n = count; }
+
+        if (memcmp(replay_payload(rp) + rp->off, buf, n) != 0)
+        {
+            mismatch = 1;
+        }
+
+        rp->off += n;
+        buf += n;
+        count -= n;
+
+        if (rp->off == replay_rec_len(rp, rp->pos))
+        {
+            /* replies are timed from the end of the command */
+            rp->anchor_cap = rp->t;
+            rp->anchor_real = monotonic_seconds();
+            replay_next(rp);
+        }
+    }
+
+    if (mismatch)
+    {
+        rp->mismatches++;
+        rig_debug(RIG_DEBUG_WARN, "%s: TX not in capture (%d so far)\n",
+                  __func__, rp->mismatches);
+    }
+
+    pthread_mutex_unlock(&rp->lock);
+
+    return RIG_OK;
+}
+
+void wirereplay_close(struct wirereplay *rp)
+{
+    if (rp == NULL)
+    {
+        return;
+    }
+
+    if (rp->mismatches)
+    {
+        rig_debug(RIG_DEBUG_WARN, "%s: %d writes differed from the capture\n",
+                  __func__, rp->mismatches);
+    }
+
+    pthread_mutex_destroy(&rp->lock);
+    free(rp->data);
+    free(rp);
+}
@@ -0,0 +1,54 @@
+/*
+ *  Hamlib Interface - wire capture and replay
+ *  Copyright (c) 2025 by the Hamlib group
+ *
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#ifndef _WIRECAP_H
+#define _WIRECAP_H
+
+#include <sys/types.h>
+
+#include "hamlib/rig.h"
+
+__BEGIN_DECLS
+
+/* record directions */
+#define WIRECAP_TX 'T'
+#define WIRECAP_RX 'R'
+
+struct wirecap;         /* capture file being written */
+struct wirereplay;      /* capture file being played back */
+
+struct wirecap *wirecap_open(const char *path);
+void wirecap_record(struct wirecap *cap, int dir, const unsigned char *data,
+                    size_t len);
+void wirecap_close(struct wirecap *cap);
+
+struct wirereplay *wirereplay_open(const char *path, double speed);
+int wirereplay_wait(struct wirereplay *rp, int timeout);
+ssize_t wirereplay_read(struct wirereplay *rp, unsigned char *buf,
+                        size_t count);
+int wirereplay_write(struct wirereplay *rp, const unsigned char *buf,
+                     size_t count);
+void wirereplay_close(struct wirereplay *rp);
+
+__END_DECLS
+
+#endif /* _WIRECAP_H */
@@ -2,7 +2,7 @@ LOCAL_PATH:= $(call my-dir)
 
 include $(CLEAR_VARS)
 
-LOCAL_SRC_FILES := rotctld.c rotctl_parse.c dumpcaps_rot.c ../src/rot_settings.c
+LOCAL_SRC_FILES := rotctld.c rotctl_parse.c metrics.c dumpcaps_rot.c ../src/rot_settings.c
 LOCAL_MODULE := rotctld
 
 LOCAL_CFLAGS := 
@@ -13,7 +13,7 @@ include $(BUILD_EXECUTABLE)
 
 include $(CLEAR_VARS)
 
-LOCAL_SRC_FILES := rotctl.c rotctl_parse.c dumpcaps_rot.c ../src/rot_settings.c
+LOCAL_SRC_FILES := rotctl.c rotctl_parse.c metrics.c dumpcaps_rot.c ../src/rot_settings.c
 LOCAL_MODULE := rotctl
 
 LOCAL_CFLAGS :=
@@ -68,6 +68,7 @@ extern int read_history();
 #include "sprintflst.h"
 
 #include "ampctl_parse.h"
+#include "metrics.h"
 
 /* Hash table implementation See:  http://uthash.sourceforge.net/ */
 #include "uthash.h"
@@ -160,6 +161,7 @@ declare_proto_amp(set_level);
 declare_proto_amp(get_level);
 declare_proto_amp(set_powerstat);
 declare_proto_amp(get_powerstat);
+declare_proto_amp(dump_metrics);
 //declare_proto_amp(dump_caps);
 
 /*
@@ -180,6 +182,7 @@ struct test_table test_list[] =
     { 'R', "reset",         ACTION(reset),          ARG_IN, "Reset" },
     { 0x87, "set_powerstat",    ACTION(set_powerstat),  ARG_IN, "Power Status" },
     { 0x88, "get_powerstat",    ACTION(get_powerstat),  ARG_OUT, "Power Status" },
+    { 0xb1, "dump_metrics", ACTION(dump_metrics), ARG_OUT },
     { 0x00, "", NULL },
 };
 
@@ -457,6 +460,7 @@ unsigned char resp_sep = '\n';      /* Default response separator */
 int ampctl_parse(AMP *my_amp, FILE *fin, FILE *fout, char *argv[], int argc)
 {
     int retcode;            /* generic return code from functions */
+    double start;
     unsigned char cmd;
     struct test_table *cmd_entry;
 
@@ -1329,6 +1333,7 @@ int ampctl_parse(AMP *my_amp, FILE *fin, FILE *fout, char *argv[], int argc)
      * mutex locking needed because ampctld is multithreaded
      * and hamlib is not MT-safe
      */
+    start = metrics_now();
     pthread_mutex_lock(&amp_mutex);
 
     if (!prompt)
@@ -1379,6 +1384,8 @@ int ampctl_parse(AMP *my_amp, FILE *fin, FILE *fout, char *argv[], int argc)
 
     pthread_mutex_unlock(&amp_mutex);
 
+    metrics_command((unsigned char) cmd_entry->cmd, start, retcode);
+
     if (retcode == -RIG_EIO) { return retcode; }
 
     if (retcode != RIG_OK)
@@ -1915,6 +1922,31 @@ declare_proto_amp(dump_caps)
 }
 
 
+static const char *ampctl_cmd_name(int cmd)
+{
+    const struct test_table *cmd_entry = find_cmd_entry(cmd);
+
+    return cmd_entry ? cmd_entry->name : NULL;
+}
+
+/*
+ * '\dump_metrics' counts and latencies of the commands run so far and
+ * the traffic of the amplifier port, in the Prometheus text format
+ */
+declare_proto_amp(dump_metrics)
+{
+    char buf[256];
+
+    metrics_dump(fout, ampctl_cmd_name);
+
+    port_get_stats(HAMLIB_AMPPORT(amp), buf, sizeof(buf));
+    metrics_text(fout, "port", NULL, buf);
+
+    fprintf(fout, "# EOF\n");
+
+    return RIG_OK;
+}
+
 /* For ampctld internal use
  * '0x8f'
  */
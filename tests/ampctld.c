@@ -59,6 +59,7 @@
 #include "hamlib/amplifier.h"
 
 #include "ampctl_parse.h"
+#include "metrics.h"
 #include "amplist.h"
 #include "rig.h"
 
@@ -597,6 +598,8 @@ void *handle_socket(void *arg)
     char host[NI_MAXHOST];
     char serv[NI_MAXSERV];
 
+    metrics_clients(1);
+
 #ifdef __MINGW32__
     int sock_osfhandle = _open_osfhandle(handle_data_arg->sock, _O_RDONLY);
 
@@ -672,6 +675,7 @@ handle_exit:
 #else
     close(handle_data_arg->sock);
 #endif
+    metrics_clients(-1);
     free(arg);
 
     pthread_exit(NULL);
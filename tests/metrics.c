@@ -0,0 +1,336 @@
+/*
+ * metrics.c - (C) The Hamlib Group 2025
+ *
+ * Command counters of rigctld, rotctld and ampctld, see \dump_metrics.
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Every thread counts its commands into a block of its own, under a lock
+ * of that block which only metrics_dump() contends for, so the counters
+ * can stay on all the time.  The block of a thread that ends is kept for
+ * its totals and taken over by the next new thread.  The client count
+ * and the gauges callback are kept under metrics_lock.
+ *
+ * The dump is in the Prometheus text format, ended by "# EOF".
+ */
+
+#include "hamlib/config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "metrics.h"
+
+extern double monotonic_seconds();
+
+struct metrics_cmd
+{
+    unsigned long count;
+    unsigned long errors;           /* returned something else than RIG_OK */
+    double seconds;
+    unsigned long bucket[METRICS_BUCKETS];
+};
+
+struct metrics_block
+{
+    pthread_mutex_t lock;           /* of cmd */
+    struct metrics_cmd cmd[METRICS_CMDS];
+    int in_use;                     /* a running thread owns it */
+    struct metrics_block *next;
+};
+
+/* upper bounds of the latency buckets in seconds, the last one is +Inf */
+static const double metrics_bound[METRICS_BUCKETS - 1] =
+{
+    0.0005, 0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1
+};
+
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t metrics_once = PTHREAD_ONCE_INIT;
+static pthread_key_t metrics_key;
+static struct metrics_block *metrics_head;
+static int metrics_n_clients;
+static metrics_gauges_t metrics_gauges;
+static void *metrics_gauges_arg;
+
+static void metrics_release(void *arg)
+{
+    struct metrics_block *b = arg;
+
+    pthread_mutex_lock(&metrics_lock);
+    b->in_use = 0;
+    pthread_mutex_unlock(&metrics_lock);
+}
+
+static void metrics_init(void)
+{
+    pthread_key_create(&metrics_key, metrics_release);
+}
+
+static struct metrics_block *metrics_block_get(void)
+{
+    struct metrics_block *b;
+
+    pthread_once(&metrics_once, metrics_init);
+
+    b = pthread_getspecific(metrics_key);
+
+    if (b) { return b; }
+
+    pthread_mutex_lock(&metrics_lock);
+
+    for (b = metrics_head; b && b->in_use; b = b->next) {}
+
+    if (b == NULL && (b = calloc(1, sizeof(*b))) != NULL)
+    {
+        pthread_mutex_init(&b->lock, NULL);
+        b->next = metrics_head;
+        metrics_head = b;
+    }
+
+    if (b) { b->in_use = 1; }
+
+    pthread_mutex_unlock(&metrics_lock);
+
+    if (b) { pthread_setspecific(metrics_key, b); }
+
+    return b;
+}
+
+double metrics_now(void)
+{
+    return monotonic_seconds();
+}
+
+/* Count command cmd that started at metrics_now() start */
+void metrics_command(int cmd, double start, int retcode)
+{
+    struct metrics_block *b = metrics_block_get();
+    struct metrics_cmd *c;
+    double seconds = metrics_now() - start;
+    int i;
+
+    if (b == NULL || cmd < 0 || cmd >= METRICS_CMDS) { return; }
+
+    c = &b->cmd[cmd];
+
+    for (i = 0; i < METRICS_BUCKETS - 1 && seconds > metrics_bound[i]; i++) {}
+
+    pthread_mutex_lock(&b->lock);
+    c->count++;
+    c->errors += retcode != 0;
+    c->seconds += seconds;
+    c->bucket[i]++;
+    pthread_mutex_unlock(&b->lock);
+}
+
+/* A client connected, +1, or went away, -1 */
+void metrics_clients(int delta)
+{
+    pthread_mutex_lock(&metrics_lock);
+    metrics_n_clients += delta;
+    pthread_mutex_unlock(&metrics_lock);
+}
+
+void metrics_set_gauges(metrics_gauges_t cb, void *arg)
+{
+    pthread_mutex_lock(&metrics_lock);
+    metrics_gauges_arg = arg;
+    metrics_gauges = cb;
+    pthread_mutex_unlock(&metrics_lock);
+}
+
+void metrics_type(FILE *fout, const char *name, const char *type)
+{
+    fprintf(fout, "# TYPE %s %s\n", name, type);
+}
+
+/*
+ * Counters from a text like "freq hits=3 misses=1 mode hits=5 misses=0",
+ * as hamlib_<family>_<key>_total{<label>="<word>"} for every key=value,
+ * where word is the last word without '=' before it.
+ */
+void metrics_text(FILE *fout, const char *family, const char *label,
+                  const char *text)
+{
+    char keys[8][64];
+    int n_keys = 0, k, len;
+    const char *p;
+    char tok[64];
+
+    for (p = text; sscanf(p, " %63s%n", tok, &len) == 1; p += len)
+    {
+        char *eq = strchr(tok, '=');
+
+        if (eq == NULL) { continue; }
+
+        *eq = '\0';
+
+        for (k = 0; k < n_keys && strcmp(keys[k], tok) != 0; k++) {}
+
+        if (k == n_keys && n_keys < 8)
+        {
+            snprintf(keys[n_keys++], sizeof(keys[0]), "%s", tok);
+        }
+    }
+
+    for (k = 0; k < n_keys; k++)
+    {
+        char name[128], word[64] = "";
+
+        snprintf(name, sizeof(name), "hamlib_%.31s_%.63s_total", family, keys[k]);
+        metrics_type(fout, name, "counter");
+
+        for (p = text; sscanf(p, " %63s%n", tok, &len) == 1; p += len)
+        {
+            char *eq = strchr(tok, '=');
+
+            if (eq == NULL)
+            {
+                snprintf(word, sizeof(word), "%s", tok);
+                continue;
+            }
+
+            *eq = '\0';
+
+            if (strcmp(tok, keys[k]) != 0) { continue; }
+
+            if (word[0] && label)
+            {
+                fprintf(fout, "%s{%s=\"%s\"} %s\n", name, label, word, eq + 1);
+            }
+            else
+            {
+                fprintf(fout, "%s %s\n", name, eq + 1);
+            }
+        }
+    }
+}
+
+static void metrics_cmd_label(char *buf, size_t len, int cmd,
+                              const char *(*cmd_name)(int cmd))
+{
+    const char *name = cmd_name ? cmd_name(cmd) : NULL;
+
+    if (name && *name) { snprintf(buf, len, "%s", name); }
+    else { snprintf(buf, len, "0x%02x", cmd); }
+}
+
+/*
+ * Command counts, errors and latency histograms summed over all threads,
+ * the connected clients and the gauges of the daemon.  cmd_name gives
+ * the long name of a command code.
+ */
+int metrics_dump(FILE *fout, const char *(*cmd_name)(int cmd))
+{
+    struct metrics_cmd *total = calloc(METRICS_CMDS, sizeof(*total));
+    struct metrics_block *b;
+    metrics_gauges_t gauges;
+    void *gauges_arg;
+    char name[64];
+    int cmd, i, n_clients;
+
+    if (total == NULL) { return -1; }
+
+    pthread_mutex_lock(&metrics_lock);
+
+    for (b = metrics_head; b; b = b->next)
+    {
+        pthread_mutex_lock(&b->lock);
+
+        for (cmd = 0; cmd < METRICS_CMDS; cmd++)
+        {
+            const struct metrics_cmd *c = &b->cmd[cmd];
+
+            total[cmd].count += c->count;
+            total[cmd].errors += c->errors;
+            total[cmd].seconds += c->seconds;
+
+            for (i = 0; i < METRICS_BUCKETS; i++)
+            {
+                total[cmd].bucket[i] += c->bucket[i];
+            }
+        }
+
+        pthread_mutex_unlock(&b->lock);
+    }
+
+    n_clients = metrics_n_clients;
+    gauges = metrics_gauges;
+    gauges_arg = metrics_gauges_arg;
+    pthread_mutex_unlock(&metrics_lock);
+
+    metrics_type(fout, "hamlib_commands_total", "counter");
+
+    for (cmd = 0; cmd < METRICS_CMDS; cmd++)
+    {
+        if (total[cmd].count == 0) { continue; }
+
+        metrics_cmd_label(name, sizeof(name), cmd, cmd_name);
+        fprintf(fout, "hamlib_commands_total{cmd=\"%s\"} %lu\n", name,
+                total[cmd].count);
+    }
+
+    metrics_type(fout, "hamlib_command_errors_total", "counter");
+
+    for (cmd = 0; cmd < METRICS_CMDS; cmd++)
+    {
+        if (total[cmd].count == 0) { continue; }
+
+        metrics_cmd_label(name, sizeof(name), cmd, cmd_name);
+        fprintf(fout, "hamlib_command_errors_total{cmd=\"%s\"} %lu\n", name,
+                total[cmd].errors);
+    }
+
+    metrics_type(fout, "hamlib_command_seconds", "histogram");
+
+    for (cmd = 0; cmd < METRICS_CMDS; cmd++)
+    {
+        unsigned long sum = 0;
+
+        if (total[cmd].count == 0) { continue; }
+
+        metrics_cmd_label(name, sizeof(name), cmd, cmd_name);
+
+        for (i = 0; i < METRICS_BUCKETS - 1; i++)
+        {
+            sum += total[cmd].bucket[i];
+            fprintf(fout, "hamlib_command_seconds_bucket{cmd=\"%s\",le=\"%g\"} %lu\n",
+                    name, metrics_bound[i], sum);
+        }
+
+        fprintf(fout, "hamlib_command_seconds_bucket{cmd=\"%s\",le=\"+Inf\"} %lu\n",
+                name, total[cmd].count);
+        fprintf(fout, "hamlib_command_seconds_sum{cmd=\"%s\"} %.6f\n", name,
+                total[cmd].seconds);
+        fprintf(fout, "hamlib_command_seconds_count{cmd=\"%s\"} %lu\n", name,
+                total[cmd].count);
+    }
+
+    free(total);
+
+    metrics_type(fout, "hamlib_clients", "gauge");
+    fprintf(fout, "hamlib_clients %d\n", n_clients);
+
+    if (gauges) { gauges(fout, gauges_arg); }
+
+    return 0;
+}
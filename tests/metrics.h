@@ -0,0 +1,45 @@
+/*
+ * metrics.h - (C) The Hamlib Group 2025
+ *
+ * Command counters of rigctld, rotctld and ampctld, see \dump_metrics.
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+
+#define METRICS_CMDS 256            /* command codes, one byte */
+#define METRICS_BUCKETS 12          /* latency histogram buckets, last +Inf */
+
+/* extra samples of a daemon, like its queue depths, see metrics_set_gauges() */
+typedef void (*metrics_gauges_t)(FILE *fout, void *arg);
+
+double metrics_now(void);
+void metrics_command(int cmd, double start, int retcode);
+void metrics_clients(int delta);
+void metrics_set_gauges(metrics_gauges_t cb, void *arg);
+
+void metrics_type(FILE *fout, const char *name, const char *type);
+void metrics_text(FILE *fout, const char *family, const char *label,
+                  const char *text);
+int metrics_dump(FILE *fout, const char *(*cmd_name)(int cmd));
+
+#endif  /* METRICS_H */
@@ -166,6 +166,12 @@ static void signal_handler(int sig)
 }
 #endif
 
+/* hold the rig for a command, so reads of poll_refresh come in between */
+static void rigctl_sync(int lock)
+{
+    rig_lock(my_rig, lock != 0);
+}
+
 static void handle_error(enum rig_debug_level_e lvl, const char *msg)
 {
     int e;
@@ -800,9 +806,9 @@ int main(int argc, char *argv[])
             rig_debug(RIG_DEBUG_WARN, "%s: rig_open again retcode=%d\n", __func__, retcode);
         }
 
-        retcode = rigctl_parse(my_rig, stdin, stdout, argv, argc, NULL,
+        retcode = rigctl_parse(my_rig, stdin, stdout, argv, argc, rigctl_sync,
                                interactive, prompt, &vfo_opt, send_cmd_term,
-                               &ext_resp, &rig_resp_sep, 0);
+                               &ext_resp, &rig_resp_sep, 0, NULL);
 
         // If we get a timeout, the rig might be powered off
         // Update our power status in case power gets turned off
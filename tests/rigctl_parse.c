@@ -29,6 +29,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
@@ -72,20 +73,26 @@ extern int read_history();
 #include "hamlib/rig.h"
 #include "misc.h"
 #include "iofunc.h"
+#include "cache.h"
+#include "event.h"
 #include "riglist.h"
 #include "sprintflst.h"
 
 #include "rigctl_parse.h"
+#include "metrics.h"
 
 /* Hash table implementation See:  http://uthash.sourceforge.net/ */
 #include "uthash.h"
 
+extern double monotonic_seconds();
+
 #define STR1(S) #S
 #define STR(S) STR1(S)
 
 #define MAXNAMSIZ 32
 #define MAXNBOPT 100    /* max number of different options */
 #define MAXARGSZ 511
+#define RIGCTL_BATCH_MAX 64     /* commands of a \batch line run under one lock */
 
 #define ARG_IN1  0x01
 #define ARG_OUT1 0x02
@@ -266,6 +273,12 @@ declare_proto_rig(send_raw);
 declare_proto_rig(client_version);
 declare_proto_rig(hamlib_version);
 declare_proto_rig(test);
+declare_proto_rig(subscribe);
+declare_proto_rig(unsubscribe);
+declare_proto_rig(batch);
+declare_proto_rig(set_cache_resp);
+declare_proto_rig(dump_metrics);
+declare_proto_rig(dump_state_hash);
 declare_proto_rig(cm108_get_bit);
 declare_proto_rig(cm108_set_bit);
 declare_proto_rig(set_conf);
@@ -387,6 +400,12 @@ static struct test_table test_list[] =
     { 0xac, "set_conf",    ACTION(set_conf), ARG_NOVFO | ARG_IN, "Token", "Token Value" },
     { 0xad, "get_conf",    ACTION(get_conf), ARG_NOVFO | ARG_IN1 | ARG_OUT2, "Token", "Value"},
     { 0xa7, "test",    ACTION(test), ARG_NOVFO | ARG_IN, "routine" },
+    { 0xae, "subscribe",   ACTION(subscribe), ARG_NOVFO | ARG_IN1 | ARG_IN_LINE, "Items [Interval ms]" },
+    { 0xaf, "unsubscribe", ACTION(unsubscribe), ARG_NOVFO },
+    { 0xb0, "batch",       ACTION(batch), ARG_NOVFO },
+    { 0xb1, "dump_metrics", ACTION(dump_metrics), ARG_NOVFO | ARG_OUT },
+    { 0xb2, "dump_state_hash", ACTION(dump_state_hash), ARG_NOVFO | ARG_OUT },
+    { 0xb3, "set_cache_resp", ACTION(set_cache_resp), ARG_NOVFO | ARG_IN, "Status" },
     { 0x00, "", NULL },
 };
 
@@ -555,6 +574,103 @@ static char parse_arg(const char *arg)
 }
 
 
+/*
+ * Rig access priority of a command: keying, and stopping it, goes before
+ * everything else, sets before reads, so a PTT never waits for the meter
+ * reads of another client.
+ */
+int rigctl_priority(int cmd)
+{
+    const struct test_table *cmd_entry;
+
+    switch (cmd)
+    {
+    case 'T':   // set_ptt
+    case 'b':   // send_morse
+    case 0xbb:  // stop_morse
+    case 0x94:  // send_voice_mem
+    case 0xab:  // stop_voice_mem
+        return RIGCTL_PRIO_PTT;
+    }
+
+    cmd_entry = find_cmd_entry(cmd);
+
+    if (cmd_entry && (cmd_entry->flags & ARG_IN) && !(cmd_entry->flags & ARG_OUT))
+    {
+        return RIGCTL_PRIO_SET;
+    }
+
+    return RIGCTL_PRIO_READ;
+}
+
+/*
+ * The priority whose turn it is among those with waiting[] commands, -1
+ * for none.  Keying always goes first, otherwise the highest one does,
+ * unless a lower one has lost RIGCTL_PRIO_SKIP_MAX turns in a row, so the
+ * reads of one client still get through the set stream of another.
+ */
+int rigctl_priority_next(const int waiting[RIGCTL_PRIOS],
+                         int skipped[RIGCTL_PRIOS])
+{
+    int next = -1, prio;
+
+    for (prio = RIGCTL_PRIOS - 1; prio >= 0; prio--)
+    {
+        if (!waiting[prio]) { continue; }
+
+        if (next < 0) { next = prio; }
+        else if (next != RIGCTL_PRIO_PTT && skipped[prio] >= RIGCTL_PRIO_SKIP_MAX)
+        {
+            next = prio;
+        }
+    }
+
+    for (prio = 0; prio < RIGCTL_PRIOS; prio++)
+    {
+        if (prio == next || !waiting[prio]) { skipped[prio] = 0; }
+        else { skipped[prio]++; }
+    }
+
+    return next;
+}
+
+const char *rigctl_priority_name(int prio)
+{
+    static const char *names[RIGCTL_PRIOS] = { "read", "set", "ptt" };
+
+    return prio >= 0 && prio < RIGCTL_PRIOS ? names[prio] : "";
+}
+
+/* rigctl_priority() of the first command of a rigctld command line */
+int rigctl_line_priority(const char *line, size_t len)
+{
+    char name[MAXNAMSIZ];
+    size_t i = 0, n = 0;
+
+    while (i < len && isspace((unsigned char) line[i])) { i++; }
+
+    // same prefixes as rigctl_parse(): + or a separator for extended replies
+    if (i < len && (line[i] == '+' || (ispunct((unsigned char) line[i])
+                                       && !strchr("\\_#()", line[i]))))
+    {
+        i++;
+    }
+
+    if (i >= len) { return RIGCTL_PRIO_READ; }
+
+    if (line[i] != '\\') { return rigctl_priority((unsigned char) line[i]); }
+
+    for (i++; i < len && n < sizeof(name) - 1 && !isspace((unsigned char) line[i]);)
+    {
+        name[n++] = line[i++];
+    }
+
+    name[n] = '\0';
+
+    return rigctl_priority((unsigned char) parse_arg(name));
+}
+
+
 /*
  * This scanf works even in presence of signals (timer, SIGIO, ..)
  */
@@ -689,10 +805,458 @@ static int next_word(char *buffer, int argc, char *argv[], int newline)
 }
 
 
+/*
+ * Whether the cache can answer get_freq or get_mode of the current VFO
+ * the way rig_get_freq() and rig_get_mode() would, by the same rules.
+ * The rigs those treat specially, see RIG_CACHE_FLAG_NO_FASTPATH, always
+ * go the long way.
+ */
+static int rigctl_cache_fresh(RIG *my_rig, int cmd, freq_t *freq,
+                              rmode_t *mode, pbwidth_t *width)
+{
+    const struct rig_state *rs = STATE(my_rig);
+    int timeout = rig_get_cache_timeout_ms(my_rig, HAMLIB_CACHE_ALL);
+    int always = timeout == HAMLIB_CACHE_ALWAYS;
+    int ms_freq, ms_mode, ms_width;
+
+    if (my_rig->caps->cache_flags & RIG_CACHE_FLAG_NO_FASTPATH)
+    {
+        return 0;
+    }
+
+    if (rig_get_cache(my_rig, RIG_VFO_CURR, freq, &ms_freq, mode, &ms_mode, width,
+                      &ms_width) != RIG_OK)
+    {
+        return 0;
+    }
+
+    if (cmd == 'f')
+    {
+        // WSJT-X senses rig precision with 55 and 56 Hz values
+        long hz = (long) * freq % 100;
+
+        return *freq != 0 && hz != 55 && hz != 56
+               && (ms_freq < timeout || always || rs->use_cached_freq);
+    }
+
+    return my_rig->caps->get_mode != NULL
+           && (always || rs->use_cached_mode
+               || (*mode != RIG_MODE_NONE && ms_mode < timeout && ms_width < timeout));
+}
+
+
+/*
+ * rigctld fast path: answer get_freq or get_mode of the current VFO from
+ * a fresh cache entry without taking the rig lock, so clients polling
+ * them never wait behind a slow command of another client.  The reply
+ * is the one rigctl_parse() gives.  With cache_resp, set by
+ * \set_cache_resp, an extended reply ends with a "Cache: hit" record,
+ * rigctl_parse() adds "Cache: miss" when the command went to the rig.
+ * Returns 1 when the reply was written to fout, unflushed, 0 when the
+ * command must be parsed and run as usual.
+ */
+int rigctl_cache_reply(RIG *my_rig, FILE *fout, int cmd, vfo_t vfo,
+                       int vfo_opt, int *ext_resp_ptr, char *resp_sep_ptr,
+                       int use_password, int cache_resp)
+{
+    const struct rig_state *rs = STATE(my_rig);
+    const struct test_table *cmd_entry;
+    char sep = *resp_sep_ptr;
+    double start = metrics_now();
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+
+    if ((cmd != 'f' && cmd != 'm') || vfo != RIG_VFO_CURR
+            || rs->comm_state == 0 || rs->powerstat == RIG_POWER_OFF
+            || (use_password && !is_passwordOK)
+            || !rigctl_cache_fresh(my_rig, cmd, &freq, &mode, &width))
+    {
+        return 0;
+    }
+
+    cmd_entry = find_cmd_entry(cmd);
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: %s from cache\n", __func__, cmd_entry->name);
+
+    if (*ext_resp_ptr)
+    {
+        if (vfo_opt)
+        {
+            fprintf(fout, "%s: %s%c", cmd_entry->name, rig_strvfo(vfo), sep);
+        }
+        else
+        {
+            fprintf(fout, "%s:%c", cmd_entry->name, sep);
+        }
+
+        fprintf(fout, "%s: ", cmd_entry->arg1);
+    }
+
+    if (cmd == 'f')
+    {
+        fprintf(fout, "%"PRIll"%c", (int64_t)freq, sep);
+    }
+    else
+    {
+        fprintf(fout, "%s%c", rig_strrmode(mode), sep);
+
+        if (*ext_resp_ptr) { fprintf(fout, "%s: ", cmd_entry->arg2); }
+
+        fprintf(fout, "%ld%c", width, sep);
+    }
+
+    if (*ext_resp_ptr)
+    {
+        if (cache_resp) { fprintf(fout, "Cache: hit%c", sep); }
+
+        fprintf(fout, NETRIGCTL_RET "0\n");
+        *ext_resp_ptr = 0;
+        *resp_sep_ptr = '\n';
+    }
+
+    rig_cache_count(CACHE(my_rig), cmd == 'f' ? CACHE_ITEM_FREQ : CACHE_ITEM_MODE, 1);
+    metrics_command(cmd, start, RIG_OK);
+
+    return 1;
+}
+
+
+/*
+ * Push subscriptions.  "\subscribe freq,mode,RFPOWER 200" asks for a line
+ * "EVENT freq 14074000", "EVENT mode USB 2400", "EVENT level RFPOWER 0.5"
+ * whenever the cached value changes, at most one per item every 200ms.
+ * Items are freq, mode, ptt, split, vfo, all of those, or level names.
+ * Values come from the cache only, so they move with whatever updates it:
+ * commands of any client, the poll routine and transceive events.
+ */
+static const char *rigctl_sub_names[RIGCTL_SUB_ITEMS] =
+{
+    "freq", "mode", "ptt", "split", "vfo"
+};
+
+#define RIGCTL_SUB_RETRY_MS 10  /* a reply was going out, try again */
+
+void rigctl_subscription_init(struct rigctl_subscription *sub)
+{
+    memset(sub, 0, sizeof(*sub));
+    pthread_mutex_init(&sub->lock, NULL);
+}
+
+void rigctl_subscription_cleanup(struct rigctl_subscription *sub)
+{
+    pthread_mutex_destroy(&sub->lock);
+}
+
+static void rigctl_sub_item_on(struct rigctl_sub_item *it, int interval_ms)
+{
+    it->on = 1;
+    it->interval_ms = interval_ms;
+    it->sent[0] = '\0';     // have the current value go out first
+}
+
+/* "\subscribe items [interval]", NULL args for "\unsubscribe" */
+static int rigctl_sub_apply(RIG *my_rig, struct rigctl_subscription *sub,
+                            const char *args)
+{
+    char items[MAXARGSZ + 1], *item, *next;
+    int on[RIGCTL_SUB_ITEMS] = { 0 };
+    int level_on[RIGCTL_SUB_LEVELS] = { 0 };
+    setting_t levels[RIGCTL_SUB_LEVELS];
+    int n_levels = sub->n_levels;
+    int interval_ms = 0;
+    int i, j;
+
+    if (args == NULL)
+    {
+        memset(sub->item, 0, sizeof(sub->item));
+        memset(sub->level_item, 0, sizeof(sub->level_item));
+        sub->n_levels = 0;
+        sub->active = 0;
+        return RIG_OK;
+    }
+
+    if (sscanf(args, "%" STR(MAXARGSZ) "s %d", items, &interval_ms) < 1
+            || interval_ms < 0)
+    {
+        return -RIG_EINVAL;
+    }
+
+    memcpy(levels, sub->level, sizeof(levels));
+
+    for (item = items; item; item = next)
+    {
+        setting_t level;
+
+        next = strchr(item, ',');
+
+        if (next) { *next++ = '\0'; }
+
+        if (strcasecmp(item, "all") == 0)
+        {
+            for (i = 0; i < RIGCTL_SUB_ITEMS; i++) { on[i] = 1; }
+
+            continue;
+        }
+
+        for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+        {
+            if (strcasecmp(item, rigctl_sub_names[i]) == 0) { break; }
+        }
+
+        if (i < RIGCTL_SUB_ITEMS)
+        {
+            on[i] = 1;
+            continue;
+        }
+
+        level = rig_parse_level(item);
+
+        if (level == RIG_LEVEL_NONE || !rig_has_get_level(my_rig, level))
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: cannot subscribe to '%s'\n", __func__, item);
+            return -RIG_EINVAL;
+        }
+
+        for (j = 0; j < n_levels && levels[j] != level; j++) {}
+
+        if (j == n_levels)
+        {
+            if (n_levels == RIGCTL_SUB_LEVELS) { return -RIG_ELIMIT; }
+
+            levels[n_levels++] = level;
+        }
+
+        level_on[j] = 1;
+    }
+
+    for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+    {
+        if (on[i]) { rigctl_sub_item_on(&sub->item[i], interval_ms); }
+    }
+
+    for (j = 0; j < n_levels; j++)
+    {
+        sub->level[j] = levels[j];
+
+        if (level_on[j]) { rigctl_sub_item_on(&sub->level_item[j], interval_ms); }
+    }
+
+    sub->n_levels = n_levels;
+    sub->active = 1;
+
+    // the pushers go through the subscriptions when the cache wakes them
+    rig_cache_notify(my_rig);
+
+    return RIG_OK;
+}
+
+/* write one update if its value changed and its interval is up */
+static void rigctl_sub_item_push(FILE *fout, struct rigctl_sub_item *it,
+                                 const char *name, const char *value, double now,
+                                 int *due_ms)
+{
+    double wait;
+
+    if (!it->on || value[0] == '\0' || strcmp(value, it->sent) == 0)
+    {
+        return;
+    }
+
+    wait = it->sent_time + it->interval_ms / 1000.0 - now;
+
+    if (it->sent[0] && wait > 0)
+    {
+        int ms = (int)(wait * 1000) + 1;
+
+        if (*due_ms < 0 || ms < *due_ms) { *due_ms = ms; }
+
+        return;
+    }
+
+    fprintf(fout, "EVENT %s %s\n", name, value);
+    SNPRINTF(it->sent, sizeof(it->sent), "%s", value);
+    it->sent_time = now;
+}
+
+/*
+ * Write the updates due for a subscription to fout.  Returns the ms until
+ * a rate limited one is due, -1 if none is waiting.
+ */
+int rigctl_subscription_push(RIG *my_rig, struct rigctl_subscription *sub,
+                             FILE *fout)
+{
+    const struct rig_cache *cachep = CACHE(my_rig);
+    char value[RIGCTL_SUB_ITEMS][RIGCTL_SUB_VALUE_MAX];
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    ptt_t ptt;
+    split_t split;
+    vfo_t vfo, tx_vfo;
+    int ms_freq, ms_mode, ms_width;
+    int due_ms = -1;
+    unsigned int seq;
+    double now;
+    int i;
+
+    if (!sub->active)
+    {
+        return -1;
+    }
+
+    if (pthread_mutex_trylock(&sub->lock) != 0)
+    {
+        return RIGCTL_SUB_RETRY_MS;
+    }
+
+    memset(value, 0, sizeof(value));
+
+    if (rig_get_cache(my_rig, RIG_VFO_CURR, &freq, &ms_freq, &mode, &ms_mode,
+                      &width, &ms_width) == RIG_OK)
+    {
+        if (freq != 0)
+        {
+            SNPRINTF(value[RIGCTL_SUB_FREQ], RIGCTL_SUB_VALUE_MAX, "%"PRIll,
+                     (int64_t)freq);
+        }
+
+        if (mode != RIG_MODE_NONE)
+        {
+            SNPRINTF(value[RIGCTL_SUB_MODE], RIGCTL_SUB_VALUE_MAX, "%s %ld",
+                     rig_strrmode(mode), width);
+        }
+    }
+
+    do
+    {
+        seq = rig_cache_read_begin(cachep);
+        ptt = cachep->ptt;
+        split = cachep->split;
+        tx_vfo = cachep->split_vfo;
+        vfo = cachep->vfo;
+    }
+    while (rig_cache_read_retry(cachep, seq));
+
+    if (vfo == RIG_VFO_NONE) { vfo = STATE(my_rig)->current_vfo; }
+
+    SNPRINTF(value[RIGCTL_SUB_PTT], RIGCTL_SUB_VALUE_MAX, "%d", ptt);
+    SNPRINTF(value[RIGCTL_SUB_SPLIT], RIGCTL_SUB_VALUE_MAX, "%d %s", split,
+             rig_strvfo(tx_vfo));
+    SNPRINTF(value[RIGCTL_SUB_VFO], RIGCTL_SUB_VALUE_MAX, "%s", rig_strvfo(vfo));
+
+    now = monotonic_seconds();
+
+    for (i = 0; i < RIGCTL_SUB_ITEMS; i++)
+    {
+        rigctl_sub_item_push(fout, &sub->item[i], rigctl_sub_names[i], value[i],
+                             now, &due_ms);
+    }
+
+    for (i = 0; i < sub->n_levels; i++)
+    {
+        char name[RIGCTL_SUB_VALUE_MAX], val[RIGCTL_SUB_VALUE_MAX] = "";
+        setting_t level = sub->level[i];
+        value_t v;
+
+        if (rig_cache_peek_setting(my_rig, CACHE_KIND_LEVEL, RIG_VFO_CURR, level,
+                                   &v) == RIG_OK)
+        {
+            if (RIG_LEVEL_IS_FLOAT(level))
+            {
+                SNPRINTF(val, sizeof(val), "%g", v.f);
+            }
+            else
+            {
+                SNPRINTF(val, sizeof(val), "%d", v.i);
+            }
+        }
+
+        SNPRINTF(name, sizeof(name), "level %s", rig_strlevel(level));
+        rigctl_sub_item_push(fout, &sub->level_item[i], name, val, now, &due_ms);
+    }
+
+    fflush(fout);
+    pthread_mutex_unlock(&sub->lock);
+
+    return due_ms;
+}
+
+
+static int rigctl_parse_cmd(RIG *my_rig, FILE *fin, FILE *fout, char *argv[],
+                            int argc, sync_cb_t sync_cb, int interactive, int prompt,
+                            int *vfo_opt, char send_cmd_term, int *ext_resp_ptr,
+                            char *resp_sep_ptr, int use_password,
+                            struct rigctl_subscription *sub, int batched);
+
 int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
                  sync_cb_t sync_cb,
                  int interactive, int prompt, int *vfo_opt, char send_cmd_term,
-                 int *ext_resp_ptr, char *resp_sep_ptr, int use_password)
+                 int *ext_resp_ptr, char *resp_sep_ptr, int use_password,
+                 struct rigctl_subscription *sub)
+{
+    return rigctl_parse_cmd(my_rig, fin, fout, argv, argc, sync_cb, interactive,
+                            prompt, vfo_opt, send_cmd_term, ext_resp_ptr,
+                            resp_sep_ptr, use_password, sub, 0);
+}
+
+/*
+ * '\batch f m t' runs the commands that follow on its line back to back,
+ * with the rig lock taken once and all replies sent in one write.  Each
+ * reply is the one the command gets on its own; "+\batch" or a separator
+ * makes that the extended, framed form for every command of the line
+ * that has no prefix of its own.
+ * A line longer than RIGCTL_BATCH_MAX commands goes on as single commands.
+ */
+static int rigctl_run_batch(RIG *my_rig, FILE *fin, FILE *fout, int *vfo_opt,
+                            char send_cmd_term, int *ext_resp_ptr, char *resp_sep_ptr,
+                            int use_password, struct rigctl_subscription *sub)
+{
+    int ext_resp = *ext_resp_ptr;
+    char resp_sep = *resp_sep_ptr;
+    int retcode = RIG_OK;
+    int i, ch;
+
+    for (i = 0; i < RIGCTL_BATCH_MAX; i++)
+    {
+        while ((ch = getc(fin)) == ' ' || ch == '\t') {}
+
+        if (ch == EOF) { break; }
+
+        ungetc(ch, fin);
+
+        if (ch == '\n' || ch == '\r') { break; }
+
+        // same prefixes as for a command on its own line
+        if (ch == '+' || (ispunct(ch) && !strchr("\\_#()", ch)))
+        {
+            *ext_resp_ptr = 0;
+            *resp_sep_ptr = '\n';
+        }
+        else
+        {
+            *ext_resp_ptr = ext_resp;
+            *resp_sep_ptr = resp_sep;
+        }
+
+        retcode = rigctl_parse_cmd(my_rig, fin, fout, NULL, 0, NULL, 1, 0, vfo_opt,
+                                   send_cmd_term, ext_resp_ptr, resp_sep_ptr,
+                                   use_password, sub, 1);
+
+        if (retcode != RIG_OK && !RIG_IS_SOFT_ERRCODE(retcode)) { break; }
+    }
+
+    *ext_resp_ptr = 0;
+    *resp_sep_ptr = '\n';
+
+    return retcode;
+}
+
+static int rigctl_parse_cmd(RIG *my_rig, FILE *fin, FILE *fout, char *argv[],
+                            int argc, sync_cb_t sync_cb, int interactive, int prompt,
+                            int *vfo_opt, char send_cmd_term, int *ext_resp_ptr,
+                            char *resp_sep_ptr, int use_password,
+                            struct rigctl_subscription *sub, int batched)
 {
     int retcode = -RIG_EINTERNAL;        /* generic return code from functions */
     unsigned char cmd;
@@ -705,6 +1269,7 @@ int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc,
     char arg3[MAXARGSZ + 1], *p3 = NULL;
     vfo_t vfo = RIG_VFO_CURR;
     char client_version[32];
+    double start;
 
     rig_debug(RIG_DEBUG_TRACE, "%s: called, interactive=%d\n", __func__,
               interactive);
@@ -1724,7 +2289,41 @@ readline_repeat:
 
 #endif // HAVE_LIBREADLINE
 
-    if (sync_cb) { sync_cb(1); }    /* lock if necessary */
+    start = metrics_now();
+
+    // no subscription update goes out in the middle of the reply
+    if (sub && !batched) { pthread_mutex_lock(&sub->lock); }
+
+    if (interactive && !prompt && p1 == NULL
+            && rigctl_cache_reply(my_rig, fout, cmd, vfo, *vfo_opt, ext_resp_ptr,
+                                  resp_sep_ptr, use_password, sub && sub->cache_resp))
+    {
+        if (!batched)
+        {
+            fflush(fout);
+
+            if (sub) { pthread_mutex_unlock(&sub->lock); }
+        }
+
+        return RIG_OK;
+    }
+
+    if (sync_cb) { sync_cb(1 + rigctl_priority(cmd)); }    /* lock if necessary */
+
+    if (cmd == 0xb0 && interactive && !prompt && !batched)
+    {
+        retcode = rigctl_run_batch(my_rig, fin, fout, vfo_opt, send_cmd_term,
+                                   ext_resp_ptr, resp_sep_ptr, use_password, sub);
+        fflush(fout);
+
+        if (sub) { pthread_mutex_unlock(&sub->lock); }
+
+        if (sync_cb) { sync_cb(0); }    /* unlock if necessary */
+
+        metrics_command(cmd, start, retcode);
+
+        return retcode;
+    }
 
     if (!prompt)
     {
@@ -1821,6 +2420,9 @@ readline_repeat:
                 && cmd_entry->cmd != 0x88 // get_powerstat
                 && cmd_entry->cmd != 0xa5 // client_version
                 && cmd_entry->cmd != 0xf2 // set_vfo_opt
+                && cmd_entry->cmd != 0xb1 // dump_metrics
+                && cmd_entry->cmd != 0xb2 // dump_state_hash
+                && cmd_entry->cmd != 0xb3 // set_cache_resp
                 && my_rig->caps->rig_model !=
                 RIG_MODEL_POWERSDR) // some rigs can do stuff when powered off
         {
@@ -1829,8 +2431,33 @@ readline_repeat:
                       cmd_entry->name);
             retcode = -RIG_EPOWER;
         }
+        else if (sub && (cmd == 0xae || cmd == 0xaf))
+        {
+            retcode = rigctl_sub_apply(my_rig, sub, cmd == 0xae ? p1 : NULL);
+        }
+        else if (sub && cmd == 0xb3)
+        {
+            int status;
+
+            if (sscanf(p1, "%d", &status) == 1)
+            {
+                sub->cache_resp = status != 0;
+                retcode = RIG_OK;
+            }
+            else
+            {
+                retcode = -RIG_EINVAL;
+            }
+        }
         else
         {
+            // one get_status_bulk may answer this and the next few getters
+            if ((cmd == 'f' || cmd == 'm' || cmd == 't' || cmd == 's')
+                    && (vfo == RIG_VFO_CURR || vfo == rs->current_vfo))
+            {
+                rig_cache_refresh_status(my_rig);
+            }
+
             retcode = (*cmd_entry->rig_routine)(my_rig,
                                                 fout,
                                                 fin,
@@ -1857,8 +2484,12 @@ readline_repeat:
     {
         rig_debug(RIG_DEBUG_ERR, "%s: RIG_EIO?\n", __func__);
 
+        if (sub && !batched) { pthread_mutex_unlock(&sub->lock); }
+
         if (sync_cb) { sync_cb(0); }    /* unlock if necessary */
 
+        metrics_command(cmd, start, retcode);
+
         return (retcode);
     }
 
@@ -1899,6 +2530,13 @@ readline_repeat:
             else if (*ext_resp_ptr && cmd != 0xf0)
             {
                 rig_debug(RIG_DEBUG_TRACE, "%s: return#3 "NETRIGCTL_RET "0\n", __func__);
+
+                // see rigctl_cache_reply()
+                if (sub && sub->cache_resp && (cmd == 'f' || cmd == 'm'))
+                {
+                    fprintf(fout, "Cache: miss%c", *resp_sep_ptr);
+                }
+
                 fprintf(fout, NETRIGCTL_RET "0\n");
                 *ext_resp_ptr = 0;
                 *resp_sep_ptr = '\n';
@@ -1908,7 +2546,15 @@ readline_repeat:
 
     if (*resp_sep_ptr != '\n') { fprintf(fout, "\n"); }
 
-    fflush(fout);
+    // a batch is sent as a whole once its last command is done
+    if (!batched)
+    {
+        fflush(fout);
+
+        if (sub) { pthread_mutex_unlock(&sub->lock); }
+    }
+
+    metrics_command(cmd, start, retcode);
 
 #ifdef HAVE_LIBREADLINE
 
@@ -2539,6 +3185,61 @@ declare_proto_rig(test)
     RETURNFUNC2(RIG_OK);
 }
 
+/* '\subscribe' and '\unsubscribe' need a connection, see rigctl_sub_apply() */
+declare_proto_rig(subscribe)
+{
+    return -RIG_ENIMPL;
+}
+
+declare_proto_rig(unsubscribe)
+{
+    return -RIG_ENIMPL;
+}
+
+/* '\set_cache_resp' is only for rigctld, see rigctl_cache_reply() */
+declare_proto_rig(set_cache_resp)
+{
+    return -RIG_ENIMPL;
+}
+
+/* '\batch' is only for rigctld, see rigctl_run_batch() */
+declare_proto_rig(batch)
+{
+    return -RIG_ENIMPL;
+}
+
+static const char *rigctl_cmd_name(int cmd)
+{
+    const struct test_table *cmd_entry = find_cmd_entry(cmd);
+
+    return cmd_entry ? cmd_entry->name : NULL;
+}
+
+/*
+ * '\dump_metrics' counts and latencies of the commands run so far, cache
+ * hits, queued events and the traffic of the rig port, in the Prometheus
+ * text format
+ */
+declare_proto_rig(dump_metrics)
+{
+    char buf[1024];
+
+    metrics_dump(fout, rigctl_cmd_name);
+
+    rig_cache_stats(rig, buf, sizeof(buf));
+    metrics_text(fout, "cache", "item", buf);
+
+    rig_event_stats(rig, buf, sizeof(buf));
+    metrics_text(fout, "event", "type", buf);
+
+    port_get_stats(HAMLIB_RIGPORT(rig), buf, sizeof(buf));
+    metrics_text(fout, "port", NULL, buf);
+
+    fprintf(fout, "# EOF\n");
+
+    return RIG_OK;
+}
+
 /* '\get_modes' */
 declare_proto_rig(get_modes)
 {
@@ -4655,8 +5356,62 @@ declare_proto_rig(dump_caps)
 }
 
 
-/* For rigctld internal use */
-declare_proto_rig(dump_state)
+/*
+ * Where the '\dump_state' text goes, a stream or, with fout NULL, a
+ * buffer growing in memory, so '\dump_state_hash' needs no temp file
+ */
+struct dump_text
+{
+    FILE *fout;
+    char *buf;
+    size_t len, size;
+    int err;
+};
+
+static void dump_out(struct dump_text *out, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+
+    if (out->fout)
+    {
+        vfprintf(out->fout, fmt, ap);
+        va_end(ap);
+        return;
+    }
+
+    n = vsnprintf(out->buf ? out->buf + out->len : NULL,
+                  out->buf ? out->size - out->len : 0, fmt, ap);
+    va_end(ap);
+
+    if (n < 0) { out->err = 1; return; }
+
+    if (out->len + n >= out->size)
+    {
+        size_t size = out->size ? out->size : 4096;
+        char *buf;
+
+        while (out->len + n >= size) { size *= 2; }
+
+        buf = realloc(out->buf, size);
+
+        if (buf == NULL) { out->err = 1; return; }
+
+        out->buf = buf;
+        out->size = size;
+
+        va_start(ap, fmt);
+        vsnprintf(out->buf + out->len, out->size - out->len, fmt, ap);
+        va_end(ap);
+    }
+
+    out->len += n;
+}
+
+
+static int rigctl_dump_state_text(RIG *rig, struct dump_text *out)
 {
     int i;
     struct rig_state *rs = STATE(rig);
@@ -4668,18 +5423,18 @@ declare_proto_rig(dump_state)
      * - Protocol version
      */
 #define RIGCTLD_PROT_VER 1
-    fprintf(fout, "%d\n", RIGCTLD_PROT_VER);
-    fprintf(fout, "%d\n", rig->caps->rig_model);
+    dump_out(out, "%d\n", RIGCTLD_PROT_VER);
+    dump_out(out, "%d\n", rig->caps->rig_model);
 #if 0 // deprecated -- not one rig uses this
-    fprintf(fout, "%d\n", rs->itu_region);
+    dump_out(out, "%d\n", rs->itu_region);
 #else  // need to print something to maintain backward compatibility
-    fprintf(fout, "%d\n", 0);
+    dump_out(out, "%d\n", 0);
 #endif
 
     for (i = 0; i < HAMLIB_FRQRANGESIZ
             && !RIG_IS_FRNG_END(rs->rx_range_list[i]); i++)
     {
-        fprintf(fout,
+        dump_out(out,
                 "%"FREQFMT" %"FREQFMT" 0x%"PRXll" %d %d 0x%x 0x%x\n",
                 rs->rx_range_list[i].startf,
                 rs->rx_range_list[i].endf,
@@ -4690,12 +5445,12 @@ declare_proto_rig(dump_state)
                 rs->rx_range_list[i].ant);
     }
 
-    fprintf(fout, "0 0 0 0 0 0 0\n");
+    dump_out(out, "0 0 0 0 0 0 0\n");
 
     for (i = 0; i < HAMLIB_FRQRANGESIZ
             && !RIG_IS_FRNG_END(rs->tx_range_list[i]); i++)
     {
-        fprintf(fout,
+        dump_out(out,
                 "%"FREQFMT" %"FREQFMT" 0x%"PRXll" %d %d 0x%x 0x%x\n",
                 rs->tx_range_list[i].startf,
                 rs->tx_range_list[i].endf,
@@ -4706,57 +5461,57 @@ declare_proto_rig(dump_state)
                 rs->tx_range_list[i].ant);
     }
 
-    fprintf(fout, "0 0 0 0 0 0 0\n");
+    dump_out(out, "0 0 0 0 0 0 0\n");
 
     for (i = 0; i < HAMLIB_TSLSTSIZ && !RIG_IS_TS_END(rs->tuning_steps[i]); i++)
     {
-        fprintf(fout,
+        dump_out(out,
                 "0x%"PRXll" %ld\n",
                 rs->tuning_steps[i].modes,
                 rs->tuning_steps[i].ts);
     }
 
-    fprintf(fout, "0 0\n");
+    dump_out(out, "0 0\n");
 
     for (i = 0; i < HAMLIB_FLTLSTSIZ && !RIG_IS_FLT_END(rs->filters[i]); i++)
     {
-        fprintf(fout,
+        dump_out(out,
                 "0x%"PRXll" %ld\n",
                 rs->filters[i].modes,
                 rs->filters[i].width);
     }
 
-    fprintf(fout, "0 0\n");
+    dump_out(out, "0 0\n");
 
 #if 0
     chan_t chan_list[HAMLIB_CHANLSTSIZ]; /*!< Channel list, zero ended */
 #endif
 
-    fprintf(fout, "%ld\n", rs->max_rit);
-    fprintf(fout, "%ld\n", rs->max_xit);
-    fprintf(fout, "%ld\n", rs->max_ifshift);
-    fprintf(fout, "%d\n", rs->announces);
+    dump_out(out, "%ld\n", rs->max_rit);
+    dump_out(out, "%ld\n", rs->max_xit);
+    dump_out(out, "%ld\n", rs->max_ifshift);
+    dump_out(out, "%d\n", rs->announces);
 
     for (i = 0; i < HAMLIB_MAXDBLSTSIZ && rs->preamp[i]; i++)
     {
-        fprintf(fout, "%d ", rs->preamp[i]);
+        dump_out(out, "%d ", rs->preamp[i]);
     }
 
-    fprintf(fout, "\n");
+    dump_out(out, "\n");
 
     for (i = 0; i < HAMLIB_MAXDBLSTSIZ && rs->attenuator[i]; i++)
     {
-        fprintf(fout, "%d ", rs->attenuator[i]);
+        dump_out(out, "%d ", rs->attenuator[i]);
     }
 
-    fprintf(fout, "\n");
+    dump_out(out, "\n");
 
-    fprintf(fout, "0x%"PRXll"\n", rs->has_get_func);
-    fprintf(fout, "0x%"PRXll"\n", rs->has_set_func);
-    fprintf(fout, "0x%"PRXll"\n", rs->has_get_level);
-    fprintf(fout, "0x%"PRXll"\n", rs->has_set_level);
-    fprintf(fout, "0x%"PRXll"\n", rs->has_get_parm);
-    fprintf(fout, "0x%"PRXll"\n", rs->has_set_parm);
+    dump_out(out, "0x%"PRXll"\n", rs->has_get_func);
+    dump_out(out, "0x%"PRXll"\n", rs->has_set_func);
+    dump_out(out, "0x%"PRXll"\n", rs->has_get_level);
+    dump_out(out, "0x%"PRXll"\n", rs->has_set_level);
+    dump_out(out, "0x%"PRXll"\n", rs->has_get_parm);
+    dump_out(out, "0x%"PRXll"\n", rs->has_set_parm);
 
     // protocol 1 fields are "setting=value"
     // protocol 1 allows fields can be listed/processed in any order
@@ -4767,65 +5522,65 @@ declare_proto_rig(dump_state)
 
     if (chk_vfo_executed) // for 3.3 compatibility
     {
-        fprintf(fout, "vfo_ops=0x%x\n", rig->caps->vfo_ops);
-        fprintf(fout, "ptt_type=0x%x\n",
+        dump_out(out, "vfo_ops=0x%x\n", rig->caps->vfo_ops);
+        dump_out(out, "ptt_type=0x%x\n",
                 PTTPORT(rig)->type.ptt);
-        fprintf(fout, "targetable_vfo=0x%x\n", rig->caps->targetable_vfo);
-        fprintf(fout, "has_set_vfo=%d\n", rig->caps->set_vfo != NULL);
-        fprintf(fout, "has_get_vfo=%d\n", rig->caps->get_vfo != NULL);
-        fprintf(fout, "has_set_freq=%d\n", rig->caps->set_freq != NULL);
-        fprintf(fout, "has_get_freq=%d\n", rig->caps->get_freq != NULL);
-        fprintf(fout, "has_set_conf=%d\n", rig->caps->set_conf != NULL);
-        fprintf(fout, "has_get_conf=%d\n", rig->caps->get_conf != NULL);
+        dump_out(out, "targetable_vfo=0x%x\n", rig->caps->targetable_vfo);
+        dump_out(out, "has_set_vfo=%d\n", rig->caps->set_vfo != NULL);
+        dump_out(out, "has_get_vfo=%d\n", rig->caps->get_vfo != NULL);
+        dump_out(out, "has_set_freq=%d\n", rig->caps->set_freq != NULL);
+        dump_out(out, "has_get_freq=%d\n", rig->caps->get_freq != NULL);
+        dump_out(out, "has_set_conf=%d\n", rig->caps->set_conf != NULL);
+        dump_out(out, "has_get_conf=%d\n", rig->caps->get_conf != NULL);
 #if 0
-        fprintf(fout, "has_set_parm=%d\n", rig->caps->set_parm != NULL);
-        fprintf(fout, "has_get_parm=%d\n", rig->caps->get_parm != NULL);
-        fprintf(fout, "parm_gran=0x%x\n", rig->caps->parm_gran);
+        dump_out(out, "has_set_parm=%d\n", rig->caps->set_parm != NULL);
+        dump_out(out, "has_get_parm=%d\n", rig->caps->get_parm != NULL);
+        dump_out(out, "parm_gran=0x%x\n", rig->caps->parm_gran);
 #endif
         // for the future
-//        fprintf(fout, "has_set_trn=%d\n", rig->caps->set_trn != NULL);
-//        fprintf(fout, "has_get_trn=%d\n", rig->caps->get_trn != NULL);
-        fprintf(fout, "has_power2mW=%d\n", rig->caps->power2mW != NULL);
-        fprintf(fout, "has_mW2power=%d\n", rig->caps->mW2power != NULL);
-        fprintf(fout, "has_get_ant=%d\n", rig->caps->get_ant != NULL);
-        fprintf(fout, "has_set_ant=%d\n", rig->caps->set_ant != NULL);
-        fprintf(fout, "timeout=%d\n", rig->caps->timeout);
-        fprintf(fout, "rig_model=%d\n", rig->caps->rig_model);
-        fprintf(fout, "rigctld_version=%s\n", hamlib_version2);
+//        dump_out(out, "has_set_trn=%d\n", rig->caps->set_trn != NULL);
+//        dump_out(out, "has_get_trn=%d\n", rig->caps->get_trn != NULL);
+        dump_out(out, "has_power2mW=%d\n", rig->caps->power2mW != NULL);
+        dump_out(out, "has_mW2power=%d\n", rig->caps->mW2power != NULL);
+        dump_out(out, "has_get_ant=%d\n", rig->caps->get_ant != NULL);
+        dump_out(out, "has_set_ant=%d\n", rig->caps->set_ant != NULL);
+        dump_out(out, "timeout=%d\n", rig->caps->timeout);
+        dump_out(out, "rig_model=%d\n", rig->caps->rig_model);
+        dump_out(out, "rigctld_version=%s\n", hamlib_version2);
         rig_sprintf_agc_levels(rig, buf, sizeof(buf));
 
-        if (strlen(buf) > 0) { fprintf(fout, "agc_levels=%s\n", buf); }
+        if (strlen(buf) > 0) { dump_out(out, "agc_levels=%s\n", buf); }
 
         if (rig->caps->ctcss_list)
         {
-            fprintf(fout, "ctcss_list=");
+            dump_out(out, "ctcss_list=");
 
             for (i = 0; i < CTCSS_LIST_SIZE && rig->caps->ctcss_list[i] != 0; i++)
             {
-                fprintf(fout,
+                dump_out(out,
                         " %u.%1u",
                         rig->caps->ctcss_list[i] / 10, rig->caps->ctcss_list[i] % 10);
             }
 
-            fprintf(fout, "\n");
+            dump_out(out, "\n");
         }
 
         if (rig->caps->dcs_list)
         {
-            fprintf(fout, "dcs_list=");
+            dump_out(out, "dcs_list=");
 
             for (i = 0; i < DCS_LIST_SIZE && rig->caps->dcs_list[i] != 0; i++)
             {
-                fprintf(fout,
+                dump_out(out,
                         " %u",
                         rig->caps->dcs_list[i]);
             }
 
-            fprintf(fout, "\n");
+            dump_out(out, "\n");
         }
 
 
-        fprintf(fout, "level_gran=");
+        dump_out(out, "level_gran=");
 
         for (i = 0; i < RIG_SETTING_MAX; ++i)
         {
@@ -4833,17 +5588,17 @@ declare_proto_rig(dump_state)
 
             if (RIG_LEVEL_IS_FLOAT(level))
             {
-                fprintf(fout, "%d=%g,%g,%g;", i, rs->level_gran[i].min.f,
+                dump_out(out, "%d=%g,%g,%g;", i, rs->level_gran[i].min.f,
                         rs->level_gran[i].max.f, rs->level_gran[i].step.f);
             }
             else
             {
-                fprintf(fout, "%d=%d,%d,%d;", i, rs->level_gran[i].min.i,
+                dump_out(out, "%d=%d,%d,%d;", i, rs->level_gran[i].min.i,
                         rs->level_gran[i].max.i, rs->level_gran[i].step.i);
             }
         }
 
-        fprintf(fout, "\nparm_gran=");
+        dump_out(out, "\nparm_gran=");
 
         for (i = 0; i < RIG_SETTING_MAX; ++i)
         {
@@ -4851,32 +5606,68 @@ declare_proto_rig(dump_state)
 
             if (RIG_PARM_IS_FLOAT(parm))
             {
-                fprintf(fout, "%d=%g,%g,%g;", i, rs->parm_gran[i].min.f,
+                dump_out(out, "%d=%g,%g,%g;", i, rs->parm_gran[i].min.f,
                         rs->parm_gran[i].max.f, rs->parm_gran[i].step.f);
             }
             else if (RIG_PARM_IS_STRING(parm))
             {
-                fprintf(fout, "%d=%s;", i, rs->parm_gran[i].step.cs);
+                dump_out(out, "%d=%s;", i, rs->parm_gran[i].step.cs);
             }
             else
             {
-                fprintf(fout, "%d=%d,%d,%d;", i, rs->level_gran[i].min.i,
+                dump_out(out, "%d=%d,%d,%d;", i, rs->level_gran[i].min.i,
                         rs->level_gran[i].max.i, rs->level_gran[i].step.i);
             }
         }
 
-        fprintf(fout, "\n");
+        dump_out(out, "\n");
 
         rs->rig_model = rig->caps->rig_model;
-        fprintf(fout, "rig_model=%d\n", rs->rig_model);
-        fprintf(fout, "hamlib_version=%s\n", hamlib_version2);
-        fprintf(fout, "done\n");
+        dump_out(out, "rig_model=%d\n", rs->rig_model);
+        dump_out(out, "hamlib_version=%s\n", hamlib_version2);
+        dump_out(out, "done\n");
     }
 
     RETURNFUNC2(RIG_OK);
 }
 
 
+/* For rigctld internal use */
+declare_proto_rig(dump_state)
+{
+    struct dump_text out = { fout, NULL, 0, 0, 0 };
+
+    return rigctl_dump_state_text(rig, &out);
+}
+
+
+/*
+ * '\dump_state_hash' protocol version, rig model, length and CRC32 of what
+ * '\dump_state' would send, so a client can tell its saved copy is good
+ */
+declare_proto_rig(dump_state_hash)
+{
+    struct dump_text out = { NULL, NULL, 0, 0, 0 };
+    int ret;
+
+    ENTERFUNC2;
+
+    ret = rigctl_dump_state_text(rig, &out);
+
+    if (ret == RIG_OK && out.err) { ret = -RIG_ENOMEM; }
+
+    if (ret == RIG_OK)
+    {
+        fprintf(fout, "%d %d %ld %08x\n", RIGCTLD_PROT_VER, rig->caps->rig_model,
+                (long) out.len, CRC32_function((uint8_t *) out.buf, out.len));
+    }
+
+    free(out.buf);
+
+    RETURNFUNC2(ret);
+}
+
+
 /* '3' */
 declare_proto_rig(dump_conf)
 {
@@ -26,6 +26,7 @@
 #define RIGCTL_PARSE_H
 
 #include <stdio.h>
+#include <pthread.h>
 #include "hamlib/rig.h"
 
 #define RIGCTL_PARSE_END 1
@@ -51,9 +52,75 @@ int print_conf_list(const struct confparams *cfp, rig_ptr_t data);
 int print_conf_list2(const struct confparams *cfp, rig_ptr_t data);
 int set_conf(RIG *my_rig, char *conf_parms);
 
+/* what \subscribe can follow besides levels */
+enum rigctl_sub_item_e
+{
+    RIGCTL_SUB_FREQ,
+    RIGCTL_SUB_MODE,
+    RIGCTL_SUB_PTT,
+    RIGCTL_SUB_SPLIT,
+    RIGCTL_SUB_VFO,
+    RIGCTL_SUB_ITEMS
+};
+
+#define RIGCTL_SUB_LEVELS 8         /* levels one connection can follow */
+#define RIGCTL_SUB_VALUE_MAX 64
+
+struct rigctl_sub_item
+{
+    int on;
+    int interval_ms;                /* least time between two updates */
+    char sent[RIGCTL_SUB_VALUE_MAX];    /* value of the last update, "" none */
+    double sent_time;
+};
+
+/*
+ * Changes a connection asked to have pushed with \subscribe, and whether
+ * it asked for Cache: records with \set_cache_resp.  lock is held while
+ * a reply goes out, so an update never lands inside one.
+ */
+struct rigctl_subscription
+{
+    pthread_mutex_t lock;
+    int active;                     /* anything subscribed at all */
+    struct rigctl_sub_item item[RIGCTL_SUB_ITEMS];
+    setting_t level[RIGCTL_SUB_LEVELS];
+    struct rigctl_sub_item level_item[RIGCTL_SUB_LEVELS];
+    int n_levels;
+    int cache_resp;                 /* Cache: hit/miss in extended replies */
+};
+
+/* rig access priority of a command, see rigctl_priority() */
+enum rigctl_prio_e
+{
+    RIGCTL_PRIO_READ,               /* gets */
+    RIGCTL_PRIO_SET,                /* sets and other commands with arguments */
+    RIGCTL_PRIO_PTT,                /* PTT, CW and voice keying and their aborts */
+    RIGCTL_PRIOS
+};
+
+#define RIGCTL_PRIO_SKIP_MAX 4      /* turns a waiting priority can lose */
+
+/*
+ * sync_cb(0) releases the rig, rigctl_parse() takes it with
+ * sync_cb(1 + RIGCTL_PRIO_*) so a scheduler can serve keying first.
+ */
 typedef void (*sync_cb_t)(int);
 int rigctl_parse(RIG *my_rig, FILE *fin, FILE *fout, char *argv[], int argc, sync_cb_t sync_cb,
                  int interactive, int prompt, int * vfo_mode, char send_cmd_term,
-                 int * ext_resp_ptr, char * resp_sep_ptr, int use_password);
+                 int * ext_resp_ptr, char * resp_sep_ptr, int use_password,
+                 struct rigctl_subscription *sub);
+int rigctl_cache_reply(RIG *my_rig, FILE *fout, int cmd, vfo_t vfo, int vfo_opt,
+                       int *ext_resp_ptr, char *resp_sep_ptr, int use_password,
+                       int cache_resp);
+int rigctl_priority(int cmd);
+int rigctl_line_priority(const char *line, size_t len);
+const char *rigctl_priority_name(int prio);
+int rigctl_priority_next(const int waiting[RIGCTL_PRIOS],
+                         int skipped[RIGCTL_PRIOS]);
+void rigctl_subscription_init(struct rigctl_subscription *sub);
+void rigctl_subscription_cleanup(struct rigctl_subscription *sub);
+int rigctl_subscription_push(RIG *my_rig, struct rigctl_subscription *sub,
+                             FILE *fout);
 
 #endif  /* RIGCTL_PARSE_H */
@@ -69,8 +69,11 @@
 #include "hamlib/rig.h"
 #include "misc.h"
 #include "network.h"
+#include "cache.h"
 
 #include "rigctl_parse.h"
+#include "rigctld_loop.h"
+#include "metrics.h"
 #include "riglist.h"
 #include "token.h"
 
@@ -79,7 +82,8 @@
  *      keep up to date SHORT_OPTIONS, usage()'s output and man page. thanks.
  * TODO: add an option to read from a file
  */
-#define SHORT_OPTIONS "m:r:p:d:P:D:s:S:c:T:t:C:W:w:x:lLuovhVZRA:b"
+#define SHORT_OPTIONS "m:r:p:d:P:D:s:S:c:T:t:C:W:w:x:lLuovhVZRA:bE"
+#define OPT_PRIORITY_PORT 0x100     /* long option only */
 static struct option long_options[] =
 {
     {"model",           1, 0, 'm'},
@@ -108,18 +112,69 @@ static struct option long_options[] =
     {"password",        1, 0, 'A'},
     {"rigctld-idle",    0, 0, 'R'},
     {"bind-all",        0, 0, 'b'},
+    {"event-loop",      0, 0, 'E'},
+    {"priority-port",   1, 0, OPT_PRIORITY_PORT},
     {0, 0, 0, 0}
 };
 
 
+#define MAXCONFLEN 2048
+#define RIGCTLD_RIGS_MAX 16         /* radios one daemon serves, one per -m */
+
+struct handle_data;
+
+/*
+ * A radio of the daemon and what it was given on the command line.
+ * Every rig has its own listeners, its own scheduler and its own push
+ * thread, so clients of one rig never wait for another.
+ */
+struct rigctld_rig
+{
+    RIG *rig;
+    int index;                  /* in rigs[], counting the -m options */
+    rig_model_t model;
+    int model_set;
+    const char *rig_file, *ptt_file, *dcd_file;
+    ptt_type_t ptt_type;
+    dcd_type_t dcd_type;
+    int serial_rate;
+    const char *civaddr;        /* NULL means no need to set conf */
+    char conf_parms[MAXCONFLEN];
+    int skip_open;
+    const char *portno;
+    const char *priority_portno;    /* clients whose commands go first */
+    int sock_listen, sock_priority;
+    volatile int opened;
+    unsigned client_count;
+
+    /* see mutex_rigctld() */
+    pthread_mutex_t sched_lock;
+    pthread_cond_t sched_cond[RIGCTL_PRIOS];
+    unsigned long sched_ticket[RIGCTL_PRIOS];   /* next ticket to hand out */
+    unsigned long sched_serving[RIGCTL_PRIOS];  /* ticket whose turn it is */
+    int sched_skipped[RIGCTL_PRIOS];
+    int sched_busy;
+    int sched_turn;             /* priority picked to go next, -1 anybody */
+
+    /* see push_thread() */
+    struct handle_data *push_list;
+    pthread_mutex_t push_lock;
+    pthread_t push;
+};
+
 struct handle_data
 {
     RIG *rig;
+    struct rigctld_rig *r;      /* rig of the listener it came in on */
     int sock;
     struct sockaddr_storage cli_addr;
     socklen_t clilen;
     int vfo_mode;
     int use_password;
+    int priority;               /* least RIGCTL_PRIO_* of its commands */
+    FILE *fsockout;
+    struct rigctl_subscription sub;
+    struct handle_data *next;   /* in push_list */
 };
 
 
@@ -130,10 +185,8 @@ void *handle_socket(void *arg);
 static void usage(FILE *fout);
 static void short_usage(FILE *fout);
 
-static unsigned client_count;
-
-static RIG *my_rig;             /* handle to rig (instance) */
-static volatile int rig_opened = 0;
+static struct rigctld_rig rigs[RIGCTLD_RIGS_MAX];
+static int n_rigs;
 static int verbose = RIG_DEBUG_NONE;
 
 #ifdef HAVE_SIG_ATOMIC_T
@@ -142,33 +195,215 @@ static sig_atomic_t volatile ctrl_c = 0;
 static int volatile ctrl_c = 0;
 #endif
 
-const char *portno = "4532";
+#define RIGCTLD_PORT "4532"
 const char *src_addr = NULL; /* INADDR_ANY */
 extern char rigctld_password[65];
 char resp_sep = '\n';
 static int rigctld_idle =
     0; // if true then rig will close when no clients are connected
-static int skip_open = 0;
 static int bind_all = 0;
+static int event_loop = 0;
 
-#define MAXCONFLEN 2048
 
+/* a new rig with nothing set yet, exits when there are too many */
+static struct rigctld_rig *rigctld_rig_add(void)
+{
+    struct rigctld_rig *r;
+    int i;
 
-void mutex_rigctld(int lock)
+    if (n_rigs == RIGCTLD_RIGS_MAX)
+    {
+        fprintf(stderr, "At most %d rigs can be served\n", RIGCTLD_RIGS_MAX);
+        exit(1);
+    }
+
+    r = &rigs[n_rigs];
+    r->index = n_rigs++;
+    r->model = RIG_MODEL_DUMMY;
+    r->ptt_type = RIG_PTT_NONE;
+    r->dcd_type = RIG_DCD_NONE;
+    r->portno = r->index == 0 ? RIGCTLD_PORT : NULL;
+    r->sock_listen = r->sock_priority = -1;
+
+    pthread_mutex_init(&r->sched_lock, NULL);
+
+    for (i = 0; i < RIGCTL_PRIOS; i++)
+    {
+        pthread_cond_init(&r->sched_cond[i], NULL);
+    }
+
+    r->sched_turn = -1;
+    pthread_mutex_init(&r->push_lock, NULL);
+
+    return r;
+}
+
+
+/*
+ * A rig goes to the waiting client with the highest priority, first
+ * come first served among equals, so a PTT never queues behind the meter
+ * reads of a busy logger, see rigctl_priority_next().  lock is
+ * 1 + RIGCTL_PRIO_*, raised to client_prio, the priority of the client
+ * thread's listener, see --priority-port.  The client also holds the rig
+ * lock of the library, so reads of poll_refresh come between commands.
+ */
+static void rigctld_sched(struct rigctld_rig *r, int lock, int client_prio)
 {
-    static pthread_mutex_t client_lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_mutex_lock(&r->sched_lock);
 
     if (lock)
     {
-        pthread_mutex_lock(&client_lock);
+        int prio = lock - 1;
+        unsigned long ticket;
+
+        if (client_prio > prio) { prio = client_prio; }
+
+        if (prio < 0) { prio = 0; }
+
+        if (prio >= RIGCTL_PRIOS) { prio = RIGCTL_PRIOS - 1; }
+
+        ticket = r->sched_ticket[prio]++;
+
+        // a free rig nobody else waited for is taken right away
+        while (r->sched_busy || ticket != r->sched_serving[prio]
+                || (r->sched_turn >= 0 && r->sched_turn != prio))
+        {
+            pthread_cond_wait(&r->sched_cond[prio], &r->sched_lock);
+        }
+
+        r->sched_serving[prio]++;
+        r->sched_busy = 1;
+        r->sched_turn = -1;
         rig_debug(RIG_DEBUG_VERBOSE, "%s: client lock engaged\n", __func__);
     }
     else
     {
+        int waiting[RIGCTL_PRIOS];
+        int i;
+
+        rig_lock(r->rig, 0);
+
         rig_debug(RIG_DEBUG_VERBOSE, "%s: client lock disengaged\n", __func__);
-        pthread_mutex_unlock(&client_lock);
+
+        for (i = 0; i < RIGCTL_PRIOS; i++)
+        {
+            waiting[i] = r->sched_ticket[i] != r->sched_serving[i];
+        }
+
+        r->sched_busy = 0;
+        r->sched_turn = rigctl_priority_next(waiting, r->sched_skipped);
+
+        if (r->sched_turn >= 0) { pthread_cond_broadcast(&r->sched_cond[r->sched_turn]); }
+    }
+
+    pthread_mutex_unlock(&r->sched_lock);
+
+    if (lock) { rig_lock(r->rig, 1); }
+}
+
+static pthread_key_t client_key;    /* handle_data of a client thread */
+
+/* take or release the rig of the calling client thread, see rigctld_sched() */
+void mutex_rigctld(int lock)
+{
+    const struct handle_data *h = pthread_getspecific(client_key);
+
+    if (h) { rigctld_sched(h->r, lock, h->priority); }
+    else { rigctld_sched(&rigs[0], lock, RIGCTL_PRIO_READ); }
+}
+
+/* '\dump_metrics' clients waiting for a rig per priority */
+static void sched_gauges(FILE *fout, void *arg)
+{
+    char label[32] = "";
+    int i, j;
+
+    metrics_type(fout, "hamlib_queue_depth", "gauge");
+
+    for (j = 0; j < n_rigs; j++)
+    {
+        struct rigctld_rig *r = &rigs[j];
+
+        if (n_rigs > 1) { SNPRINTF(label, sizeof(label), "rig=\"%d\",", j); }
+
+        pthread_mutex_lock(&r->sched_lock);
+
+        for (i = 0; i < RIGCTL_PRIOS; i++)
+        {
+            fprintf(fout, "hamlib_queue_depth{%sclass=\"%s\"} %lu\n", label,
+                    rigctl_priority_name(i), r->sched_ticket[i] - r->sched_serving[i]);
+        }
+
+        pthread_mutex_unlock(&r->sched_lock);
     }
+}
 
+static int rigctld_quit(void)
+{
+    return ctrl_c;
+}
+
+
+/*
+ * Connections to a rig that may subscribe to changes.  One thread per rig
+ * sends all their updates, woken by the cache; a connection busy with a
+ * reply is tried again shortly instead of waited for.
+ */
+static int push_stop;
+
+static void push_add(struct rigctld_rig *r, struct handle_data *h)
+{
+    pthread_mutex_lock(&r->push_lock);
+    h->next = r->push_list;
+    r->push_list = h;
+    pthread_mutex_unlock(&r->push_lock);
+}
+
+static void push_remove(struct rigctld_rig *r, struct handle_data *h)
+{
+    struct handle_data **pp;
+
+    pthread_mutex_lock(&r->push_lock);
+
+    for (pp = &r->push_list; *pp; pp = &(*pp)->next)
+    {
+        if (*pp == h)
+        {
+            *pp = h->next;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&r->push_lock);
+}
+
+static void *push_thread(void *arg)
+{
+    struct rigctld_rig *r = arg;
+    RIG *rig = r->rig;
+    unsigned int generation = rig_cache_generation(rig);
+    int wait_ms = 0;
+
+    while (!push_stop)
+    {
+        struct handle_data *h;
+
+        rig_cache_wait(rig, &generation, wait_ms);
+        wait_ms = 1000;
+
+        pthread_mutex_lock(&r->push_lock);
+
+        for (h = r->push_list; h; h = h->next)
+        {
+            int due_ms = rigctl_subscription_push(rig, &h->sub, h->fsockout);
+
+            if (due_ms >= 0 && due_ms < wait_ms) { wait_ms = due_ms; }
+        }
+
+        pthread_mutex_unlock(&r->push_lock);
+    }
+
+    return NULL;
 }
 
 #ifdef WIN32
@@ -239,43 +474,258 @@ static void handle_error(enum rig_debug_level_e lvl, const char *msg)
 #endif
 }
 
-int main(int argc, char *argv[])
+/* a socket bound to src_addr and port, listening; exits on failure */
+static int rigctld_listen(const char *port)
+{
+    struct addrinfo hints, *result, *saved_result;
+    int sock_listen;
+    int retcode;
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;    /* Allow IPv4 or IPv6 */
+    hints.ai_socktype = SOCK_STREAM;/* TCP socket */
+    hints.ai_flags = AI_PASSIVE;    /* For wildcard IP address */
+    hints.ai_protocol = 0;          /* Any protocol */
+
+    retcode = getaddrinfo(src_addr, port, &hints, &result);
+
+    if (retcode == 0 && result->ai_family == AF_INET6)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: Using IPV6\n", __func__);
+    }
+    else if (retcode == 0)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: Using IPV4\n", __func__);
+    }
+    else
+    {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(retcode));
+        exit(1);
+    }
+
+    saved_result = result;
+
+    do
+    {
+        sock_listen = socket(result->ai_family,
+                             result->ai_socktype,
+                             result->ai_protocol);
+
+        if (sock_listen < 0)
+        {
+            handle_error(RIG_DEBUG_ERR, "socket");
+            freeaddrinfo(saved_result);     /* No longer needed */
+            exit(1);
+        }
+
+        const int optval = 1;
+        if (setsockopt(sock_listen, SOL_SOCKET, SO_REUSEADDR, SOCKOPT_CAST(&optval),
+                       sizeof(optval)) < 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: error enabling UDP address reuse: %s\n", __func__,
+                      strerror(errno));
+        }
+
+        // Windows does not have SO_REUSEPORT. However, SO_REUSEADDR works in a similar way.
+#if defined(SO_REUSEPORT)
+        if (setsockopt(sock_listen, SOL_SOCKET, SO_REUSEPORT, SOCKOPT_CAST(&optval),
+                       sizeof(optval)) < 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: error enabling UDP port reuse: %s\n", __func__,
+                      strerror(errno));
+        }
+
+#endif
+
+
+#if 0
+        if (setsockopt(sock_listen,
+                       SOL_SOCKET,
+                       SO_REUSEADDR,
+                       SOCKOPT_CAST(&reuseaddr),
+                       sizeof(reuseaddr))
+                < 0)
+        {
+
+            handle_error(RIG_DEBUG_ERR, "setsockopt");
+            freeaddrinfo(saved_result);     /* No longer needed */
+            exit(1);
+        }
+
+#endif
+
+#ifdef IPV6_V6ONLY
+
+        if (AF_INET6 == result->ai_family)
+        {
+            /* allow IPv4 mapped to IPv6 clients Windows and BSD default
+               this to 1 (i.e. disallowed) and we prefer it off */
+            int sockopt = 0;
+
+            if (setsockopt(sock_listen,
+                           IPPROTO_IPV6,
+                           IPV6_V6ONLY,
+                           SOCKOPT_CAST(&sockopt),
+                           sizeof(sockopt))
+                    < 0)
+            {
+
+                handle_error(RIG_DEBUG_ERR, "setsockopt");
+                freeaddrinfo(saved_result);     /* No longer needed */
+                exit(1);
+            }
+        }
+
+#endif
+
+        int retval = bind(sock_listen, result->ai_addr, result->ai_addrlen);
+
+        if (retval == 0)
+        {
+            break;
+        }
+
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: bind: %s\n", __func__, strerror(errno));
+        }
+
+        if (bind_all)
+        {
+            handle_error(RIG_DEBUG_WARN, "binding failed (trying next interface)");
+        }
+        else
+        {
+            handle_error(RIG_DEBUG_WARN, "binding failed");
+        }
+
+#ifdef __MINGW32__
+        closesocket(sock_listen);
+#else
+        close(sock_listen);
+#endif
+    }
+    while (bind_all && ((result = result->ai_next) != NULL));
+
+    freeaddrinfo(saved_result);     /* No longer needed */
+
+    if (NULL == result)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: bind error - no available interface\n", __func__);
+        exit(1);
+    }
+
+    if (listen(sock_listen, 4) < 0)
+    {
+        handle_error(RIG_DEBUG_ERR, "listening");
+        exit(1);
+    }
+
+    return sock_listen;
+}
+
+/*
+ * accept a client of rig r on sock and start its thread, -1 when that
+ * failed and the daemon should stop
+ */
+static int rigctld_accept(struct rigctld_rig *r, int sock, int priority,
+                          int vfo_mode)
 {
-    rig_model_t my_model = RIG_MODEL_DUMMY;
+    struct handle_data *arg;
+    char host[NI_MAXHOST];
+    char serv[NI_MAXSERV];
+    pthread_t thread;
+    pthread_attr_t attr;
+    int retcode;
+
+    arg = calloc(1, sizeof(struct handle_data));
+
+    if (!arg)
+    {
+        rig_debug(RIG_DEBUG_ERR, "calloc: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    if (rigctld_password[0] != 0) { arg->use_password = 1; }
+
+    arg->rig = r->rig;
+    arg->r = r;
+    arg->priority = priority;
+    arg->clilen = sizeof(arg->cli_addr);
+    arg->vfo_mode = vfo_mode;
+    arg->sock = accept(sock,
+                       (struct sockaddr *)&arg->cli_addr,
+                       &arg->clilen);
+
+    if (arg->sock < 0)
+    {
+        handle_error(RIG_DEBUG_ERR, "accept");
+        free(arg);
+        return -1;
+    }
+
+    if ((retcode = getnameinfo((struct sockaddr const *)&arg->cli_addr,
+                               arg->clilen,
+                               host,
+                               sizeof(host),
+                               serv,
+                               sizeof(serv),
+                               NI_NUMERICHOST | NI_NUMERICSERV))
+            < 0)
+    {
+        rig_debug(RIG_DEBUG_WARN,
+                  "Peer lookup error: %s",
+                  gai_strerror(retcode));
+    }
+
+    rig_debug(RIG_DEBUG_VERBOSE,
+              "Connection opened from %s:%s to rig %d\n",
+              host,
+              serv,
+              r->index);
 
-    int retcode;        /* generic return code from functions */
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    retcode = pthread_create(&thread, &attr, handle_socket, arg);
+
+    if (retcode != 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "pthread_create: %s\n", strerror(retcode));
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct rigctld_rig *r;
+    int retcode = RIG_OK;        /* generic return code from functions */
 
     int show_conf = 0;
     int dump_caps_opt = 0;
-    const char *rig_file = NULL, *ptt_file = NULL, *dcd_file = NULL;
-    ptt_type_t ptt_type = RIG_PTT_NONE;
-    dcd_type_t dcd_type = RIG_DCD_NONE;
-    int serial_rate = 0;
-    const char *civaddr = NULL;   /* NULL means no need to set conf */
-    char conf_parms[MAXCONFLEN] = "";
 
-    struct addrinfo hints, *result, *saved_result;
-    int sock_listen;
 //    int reuseaddr = 1;
     int twiddle_timeout = 0;
     int twiddle_rit = 0;
     int uplink = 0;
-    char host[NI_MAXHOST];
-    char serv[NI_MAXSERV];
     char rigstartup[1024];
     char vbuf[1024];
 #if HAVE_SIGACTION
     struct sigaction act;
 #endif
 
-    pthread_t thread;
-    pthread_attr_t attr;
-    struct handle_data *arg;
     int vfo_mode = 0; /* vfo_mode=0 means target VFO is current VFO */
-    int i;
+    const char *ports[2 * RIGCTLD_RIGS_MAX];
+    int n_ports = 0;
+    int i, j;
     extern int is_rigctld;
 
     is_rigctld = 1;
+    pthread_key_create(&client_key, NULL);
+
+    // options before the first -m are for the first rig, every other -m starts a rig
+    r = rigctld_rig_add();
 
     int err = setvbuf(stderr, vbuf, _IOFBF, sizeof(vbuf));
 
@@ -317,6 +767,10 @@ int main(int argc, char *argv[])
             bind_all = 1;
             break;
 
+        case 'E':
+            event_loop = 1;
+            break;
+
         case 'A':
             strncpy(rigctld_password, optarg, sizeof(rigctld_password) - 1);
             //char *md5 = rig_make_m d5(rigctld_password);
@@ -327,58 +781,61 @@ int main(int argc, char *argv[])
             break;
 
         case 'm':
-            my_model = atoi(optarg);
+            if (r->model_set) { r = rigctld_rig_add(); }
+
+            r->model = atoi(optarg);
+            r->model_set = 1;
             break;
 
         case 'r':
-            rig_file = optarg;
+            r->rig_file = optarg;
             break;
 
         case 'p':
-            ptt_file = optarg;
+            r->ptt_file = optarg;
             break;
 
         case 'd':
-            dcd_file = optarg;
+            r->dcd_file = optarg;
             break;
 
         case 'P':
             if (!strcmp(optarg, "RIG"))
             {
-                ptt_type = RIG_PTT_RIG;
+                r->ptt_type = RIG_PTT_RIG;
             }
             else if (!strcmp(optarg, "DTR"))
             {
-                ptt_type = RIG_PTT_SERIAL_DTR;
+                r->ptt_type = RIG_PTT_SERIAL_DTR;
             }
             else if (!strcmp(optarg, "RTS"))
             {
-                ptt_type = RIG_PTT_SERIAL_RTS;
+                r->ptt_type = RIG_PTT_SERIAL_RTS;
             }
             else if (!strcmp(optarg, "PARALLEL"))
             {
-                ptt_type = RIG_PTT_PARALLEL;
+                r->ptt_type = RIG_PTT_PARALLEL;
             }
             else if (!strcmp(optarg, "CM108"))
             {
-                ptt_type = RIG_PTT_CM108;
+                r->ptt_type = RIG_PTT_CM108;
             }
             else if (!strcmp(optarg, "GPIO"))
             {
-                ptt_type = RIG_PTT_GPIO;
+                r->ptt_type = RIG_PTT_GPIO;
             }
             else if (!strcmp(optarg, "GPION"))
             {
-                ptt_type = RIG_PTT_GPION;
+                r->ptt_type = RIG_PTT_GPION;
             }
             else if (!strcmp(optarg, "NONE"))
             {
-                ptt_type = RIG_PTT_NONE;
+                r->ptt_type = RIG_PTT_NONE;
             }
             else
             {
                 puts("Unrecognised PTT type, using NONE");
-                ptt_type = RIG_PTT_NONE;
+                r->ptt_type = RIG_PTT_NONE;
             }
 
             break;
@@ -386,50 +843,50 @@ int main(int argc, char *argv[])
         case 'D':
             if (!strcmp(optarg, "RIG"))
             {
-                dcd_type = RIG_DCD_RIG;
+                r->dcd_type = RIG_DCD_RIG;
             }
             else if (!strcmp(optarg, "DSR"))
             {
-                dcd_type = RIG_DCD_SERIAL_DSR;
+                r->dcd_type = RIG_DCD_SERIAL_DSR;
             }
             else if (!strcmp(optarg, "CTS"))
             {
-                dcd_type = RIG_DCD_SERIAL_CTS;
+                r->dcd_type = RIG_DCD_SERIAL_CTS;
             }
             else if (!strcmp(optarg, "CD"))
             {
-                dcd_type = RIG_DCD_SERIAL_CAR;
+                r->dcd_type = RIG_DCD_SERIAL_CAR;
             }
             else if (!strcmp(optarg, "PARALLEL"))
             {
-                dcd_type = RIG_DCD_PARALLEL;
+                r->dcd_type = RIG_DCD_PARALLEL;
             }
             else if (!strcmp(optarg, "CM108"))
             {
-                dcd_type = RIG_DCD_CM108;
+                r->dcd_type = RIG_DCD_CM108;
             }
             else if (!strcmp(optarg, "GPIO"))
             {
-                dcd_type = RIG_DCD_GPIO;
+                r->dcd_type = RIG_DCD_GPIO;
             }
             else if (!strcmp(optarg, "GPION"))
             {
-                dcd_type = RIG_DCD_GPION;
+                r->dcd_type = RIG_DCD_GPION;
             }
             else if (!strcmp(optarg, "NONE"))
             {
-                dcd_type = RIG_DCD_NONE;
+                r->dcd_type = RIG_DCD_NONE;
             }
             else
             {
                 puts("Unrecognised DCD type, using NONE");
-                dcd_type = RIG_DCD_NONE;
+                r->dcd_type = RIG_DCD_NONE;
             }
 
             break;
 
         case 'c':
-            civaddr = optarg;
+            r->civaddr = optarg;
             break;
 
         case 'S':
@@ -438,7 +895,7 @@ int main(int argc, char *argv[])
             break;
 
         case 's':
-            if (sscanf(optarg, "%d%1s", &serial_rate, dummy) != 1)
+            if (sscanf(optarg, "%d%1s", &r->serial_rate, dummy) != 1)
             {
                 fprintf(stderr, "Invalid baud rate of %s\n", optarg);
                 exit(1);
@@ -450,30 +907,34 @@ int main(int argc, char *argv[])
             if (strcmp(optarg, "auto_power_on=0") == 0)
             {
                 rig_debug(RIG_DEBUG_ERR, "%s: skipping rig_open\n", __func__);
-                skip_open = 1;
+                r->skip_open = 1;
             }
             else
             {
 
-                if (*conf_parms != '\0')
+                if (*r->conf_parms != '\0')
                 {
-                    strcat(conf_parms, ",");
+                    strcat(r->conf_parms, ",");
                 }
 
-                if (strlen(conf_parms) + strlen(optarg) > MAXCONFLEN - 24)
+                if (strlen(r->conf_parms) + strlen(optarg) > MAXCONFLEN - 24)
                 {
                     printf("Length of conf_parms exceeds internal maximum of %d\n",
                            MAXCONFLEN - 24);
                     return 1;
                 }
 
-                strncat(conf_parms, optarg, MAXCONFLEN - strlen(conf_parms) - 1);
+                strncat(r->conf_parms, optarg, MAXCONFLEN - strlen(r->conf_parms) - 1);
             }
 
             break;
 
         case 't':
-            portno = optarg;
+            r->portno = optarg;
+            break;
+
+        case OPT_PRIORITY_PORT:
+            r->priority_portno = optarg;
             break;
 
         case 'T':
@@ -531,369 +992,280 @@ int main(int argc, char *argv[])
         }
     }
 
-#if 0
-
-    if (!vfo_mode)
-    {
-        printf("Recommend using --vfo switch for rigctld if client supports it\n");
-        printf("rigctl and netrigctl will automatically detect vfo mode\n");
-    }
-
-#endif
-
-    SNPRINTF(rigstartup, sizeof(rigstartup), "%s(%d) Startup:", __FILE__, __LINE__);
-
-    for (i = 0; i < argc; ++i) { strcat(rigstartup, " "); strcat(rigstartup, argv[i]); }
-
-    rig_debug(RIG_DEBUG_VERBOSE, "%s\n", rigstartup);
-
-    rig_debug(RIG_DEBUG_VERBOSE, "rigctld %s\n", hamlib_version2);
-    rig_debug(RIG_DEBUG_VERBOSE, "%s",
-              "Report bugs to <hamlib-developer@lists.sourceforge.net>\n\n");
-    rig_debug(RIG_DEBUG_VERBOSE, "Max# of rigctld client services=%d\n",
-              NI_MAXSERV);
-
-    my_rig = rig_init(my_model);
-
-    if (!my_rig)
-    {
-        fprintf(stderr,
-                "Unknown rig num %u, or initialization error.\n",
-                my_model);
-
-        fprintf(stderr, "Please check with --list option.\n");
-        exit(2);
-    }
-
-    my_rig->caps->ptt_type = ptt_type;
-    const char *token = strtok(conf_parms, ",");
-    struct rig_state *rs = HAMLIB_STATE(my_rig);
-
-    while (token)
-    {
-        char mytoken[100], myvalue[100];
-        hamlib_token_t lookup;
-        sscanf(token, "%99[^=]=%99s", mytoken, myvalue);
-        //printf("mytoken=%s,myvalue=%s\n",mytoken, myvalue);
-        lookup = rig_token_lookup(my_rig, mytoken);
-
-        if (lookup == 0)
-        {
-            rig_debug(RIG_DEBUG_ERR, "%s: no such token as '%s'\n", __func__, mytoken);
-            token = strtok(NULL, ",");
-            continue;
-        }
-
-        retcode = rig_set_conf(my_rig, lookup, myvalue);
-
-        if (retcode != RIG_OK)
-        {
-            fprintf(stderr, "Config parameter error: %s\n", rigerror(retcode));
-            exit(2);
-        }
-
-        token = strtok(NULL, ",");
-        ptt_type = my_rig->caps->ptt_type; // in case we set the ptt_type with set_conf
-    }
-
-    if (rig_file)
-    {
-        rig_set_conf(my_rig, TOK_PATHNAME, rig_file);
-    }
-
-    rs->twiddle_timeout = twiddle_timeout;
-    rs->twiddle_rit = twiddle_rit;
-    rs->uplink = uplink;
-    rig_debug(RIG_DEBUG_TRACE, "%s: twiddle=%d, uplink=%d, twiddle_rit=%d\n",
-              __func__,
-              rs->twiddle_timeout, rs->uplink, rs->twiddle_rit);
-
-    /*
-     * ex: RIG_PTT_PARALLEL and /dev/parport0
-     */
-    if (ptt_type != RIG_PTT_NONE)
-    {
-        HAMLIB_PTTPORT(my_rig)->type.ptt = ptt_type;
-        rs->pttport_deprecated.type.ptt = ptt_type;
-        // This causes segfault since backend rig_caps are const
-        // rigctld will use the HAMLIB_STATE(rig) version of this for clients
-        //my_rig->caps->ptt_type = ptt_type;
-    }
-
-    if (dcd_type != RIG_DCD_NONE)
-    {
-        HAMLIB_DCDPORT(my_rig)->type.dcd = dcd_type;
-        rs->dcdport_deprecated.type.dcd = dcd_type;
-    }
-
-    if (ptt_file)
-    {
-        strncpy(HAMLIB_PTTPORT(my_rig)->pathname, ptt_file, HAMLIB_FILPATHLEN - 1);
-        strncpy(rs->pttport_deprecated.pathname, ptt_file,
-                HAMLIB_FILPATHLEN - 1);
-
-        // default to RTS when ptt_type is not specified
-        if (ptt_type == RIG_PTT_NONE)
-        {
-            rig_debug(RIG_DEBUG_VERBOSE, "%s: defaulting to RTS PTT\n", __func__);
-            my_rig->caps->ptt_type = RIG_PTT_SERIAL_RTS;
-        }
-    }
-
-    if (dcd_file)
-    {
-        strncpy(HAMLIB_DCDPORT(my_rig)->pathname, dcd_file, HAMLIB_FILPATHLEN - 1);
-        strncpy(rs->dcdport_deprecated.pathname, dcd_file,
-                HAMLIB_FILPATHLEN - 1);
-    }
-
-    /* FIXME: bound checking and port type == serial */
-    if (serial_rate != 0)
-    {
-        HAMLIB_RIGPORT(my_rig)->parm.serial.rate = serial_rate;
-        rs->rigport_deprecated.parm.serial.rate = serial_rate;
-    }
-
-    if (civaddr)
-    {
-        rig_set_conf(my_rig, rig_token_lookup(my_rig, "civaddr"), civaddr);
-    }
-
-    /*
-     * print out conf parameters
-     */
-    if (show_conf)
-    {
-        rig_token_foreach(my_rig, print_conf_list, (rig_ptr_t)my_rig);
-
-        if (rig_file == NULL)
-        {
-            fflush(stdout);
-            exit(0);
-        }
-    }
-
-    /*
-     * print out conf parameters, and exits immediately
-     * We may be interested only in only caps, and rig_open may fail.
-     */
-    if (dump_caps_opt)
-    {
-        dumpcaps(my_rig, stdout);
-        rig_cleanup(my_rig); /* if you care about memory */
-        exit(0);
-    }
-
-    /* attempt to open rig to check early for issues */
-    if (skip_open)
-    {
-        rig_opened = 0;
-    }
-    else
-    {
-        retcode = rig_open(my_rig);
-        rig_opened = retcode == RIG_OK ? 1 : 0;
-    }
-
-    if (retcode != RIG_OK)
-    {
-        fprintf(stderr, "rig_open: error = %s %s %s \n", rigerror(retcode), rig_file,
-                strerror(errno));
-        // continue even if opening the rig fails, because it may be powered off
-    }
-
-    if (verbose > RIG_DEBUG_ERR)
-    {
-        printf("Opened rig model %u, '%s'\n",
-               my_rig->caps->rig_model,
-               my_rig->caps->model_name);
-    }
-
-    rig_debug(RIG_DEBUG_VERBOSE, "Backend version: %s, Status: %s\n",
-              my_rig->caps->version, rig_strstatus(my_rig->caps->status));
-
-    // Normally we keep the rig open to speed up the 1st client connect
-    // But some rigs like the FT-736 have to lock the rig for CAT control
-    // So they need to release the rig when no clients are connected
-    if (rigctld_idle)
-    {
-        rig_close(my_rig);          /* we will reopen for clients */
-
-        if (verbose > RIG_DEBUG_ERR)
-        {
-            printf("Closed rig model %u, '%s - will reopen for clients'\n",
-                   my_rig->caps->rig_model,
-                   my_rig->caps->model_name);
-        }
-    }
-
-#ifdef __MINGW32__
-#  ifndef SO_OPENTYPE
-#    define SO_OPENTYPE     0x7008
-#  endif
-#  ifndef SO_SYNCHRONOUS_NONALERT
-#    define SO_SYNCHRONOUS_NONALERT 0x20
-#  endif
-#  ifndef INVALID_SOCKET
-#    define INVALID_SOCKET -1
-#  endif
-
-    WSADATA wsadata;
-
-    if (WSAStartup(MAKEWORD(1, 1), &wsadata) == SOCKET_ERROR)
-    {
-        fprintf(stderr, "WSAStartup socket error\n");
-        exit(1);
-    }
-
+#if 0
+
+    if (!vfo_mode)
     {
-        int sockopt = SO_SYNCHRONOUS_NONALERT;
-        setsockopt(INVALID_SOCKET, SOL_SOCKET, SO_OPENTYPE, SOCKOPT_CAST(&sockopt),
-                   sizeof(sockopt));
+        printf("Recommend using --vfo switch for rigctld if client supports it\n");
+        printf("rigctl and netrigctl will automatically detect vfo mode\n");
     }
 
 #endif
 
-    /*
-     * Prepare listening socket
-     */
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_family = AF_UNSPEC;    /* Allow IPv4 or IPv6 */
-    hints.ai_socktype = SOCK_STREAM;/* TCP socket */
-    hints.ai_flags = AI_PASSIVE;    /* For wildcard IP address */
-    hints.ai_protocol = 0;          /* Any protocol */
+    SNPRINTF(rigstartup, sizeof(rigstartup), "%s(%d) Startup:", __FILE__, __LINE__);
 
-    retcode = getaddrinfo(src_addr, portno, &hints, &result);
+    for (i = 0; i < argc; ++i) { strcat(rigstartup, " "); strcat(rigstartup, argv[i]); }
 
-    if (retcode == 0 && result->ai_family == AF_INET6)
+    rig_debug(RIG_DEBUG_VERBOSE, "%s\n", rigstartup);
+
+    rig_debug(RIG_DEBUG_VERBOSE, "rigctld %s\n", hamlib_version2);
+    rig_debug(RIG_DEBUG_VERBOSE, "%s",
+              "Report bugs to <hamlib-developer@lists.sourceforge.net>\n\n");
+    rig_debug(RIG_DEBUG_VERBOSE, "Max# of rigctld client services=%d\n",
+              NI_MAXSERV);
+
+    // the port of every rig but the first has to be given, and no port twice
+    for (i = 0; i < n_rigs; i++)
     {
-        rig_debug(RIG_DEBUG_TRACE, "%s: Using IPV6\n", __func__);
+        if (rigs[i].portno == NULL)
+        {
+            fprintf(stderr, "Rig %d (-m %u) needs its own --port\n", i,
+                    rigs[i].model);
+            exit(1);
+        }
+
+        ports[n_ports++] = rigs[i].portno;
+
+        if (rigs[i].priority_portno) { ports[n_ports++] = rigs[i].priority_portno; }
     }
-    else if (retcode == 0)
+
+    for (i = 0; i < n_ports; i++)
     {
-        rig_debug(RIG_DEBUG_TRACE, "%s: Using IPV4\n", __func__);
+        for (j = 0; j < i; j++)
+        {
+            if (strcmp(ports[i], ports[j]) == 0)
+            {
+                fprintf(stderr, "Port %s is given twice\n", ports[i]);
+                exit(1);
+            }
+        }
     }
-    else
+
+    // all rigs first, the settings below change the caps rigs of a model share
+    for (i = 0; i < n_rigs; i++)
     {
-        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(retcode));
-        exit(1);
-    }
+        rigs[i].rig = rig_init(rigs[i].model);
 
-    saved_result = result;
+        if (!rigs[i].rig)
+        {
+            fprintf(stderr,
+                    "Unknown rig num %u, or initialization error.\n",
+                    rigs[i].model);
 
-    do
+            fprintf(stderr, "Please check with --list option.\n");
+            exit(2);
+        }
+    }
+
+    for (i = 0; i < n_rigs; i++)
     {
-        sock_listen = socket(result->ai_family,
-                             result->ai_socktype,
-                             result->ai_protocol);
+        RIG *my_rig;
+        struct rig_state *rs;
+        ptt_type_t ptt_type;
+        const char *token;
+
+        r = &rigs[i];
+        my_rig = r->rig;
+        ptt_type = r->ptt_type;
+        my_rig->caps->ptt_type = ptt_type;
+        token = strtok(r->conf_parms, ",");
+        rs = HAMLIB_STATE(my_rig);
+
+        while (token)
+        {
+            char mytoken[100], myvalue[100];
+            hamlib_token_t lookup;
+            sscanf(token, "%99[^=]=%99s", mytoken, myvalue);
+            //printf("mytoken=%s,myvalue=%s\n",mytoken, myvalue);
+            lookup = rig_token_lookup(my_rig, mytoken);
 
-        if (sock_listen < 0)
+            if (lookup == 0)
+            {
+                rig_debug(RIG_DEBUG_ERR, "%s: no such token as '%s'\n", __func__, mytoken);
+                token = strtok(NULL, ",");
+                continue;
+            }
+
+            retcode = rig_set_conf(my_rig, lookup, myvalue);
+
+            if (retcode != RIG_OK)
+            {
+                fprintf(stderr, "Config parameter error: %s\n", rigerror(retcode));
+                exit(2);
+            }
+
+            token = strtok(NULL, ",");
+            ptt_type = my_rig->caps->ptt_type; // in case we set the ptt_type with set_conf
+        }
+
+        if (r->rig_file)
         {
-            handle_error(RIG_DEBUG_ERR, "socket");
-            freeaddrinfo(saved_result);     /* No longer needed */
-            exit(1);
+            rig_set_conf(my_rig, TOK_PATHNAME, r->rig_file);
         }
 
-        const int optval = 1;
-        if (setsockopt(sock_listen, SOL_SOCKET, SO_REUSEADDR, SOCKOPT_CAST(&optval),
-                       sizeof(optval)) < 0)
+        rs->twiddle_timeout = twiddle_timeout;
+        rs->twiddle_rit = twiddle_rit;
+        rs->uplink = uplink;
+        rig_debug(RIG_DEBUG_TRACE, "%s: twiddle=%d, uplink=%d, twiddle_rit=%d\n",
+                  __func__,
+                  rs->twiddle_timeout, rs->uplink, rs->twiddle_rit);
+
+        /*
+         * ex: RIG_PTT_PARALLEL and /dev/parport0
+         */
+        if (ptt_type != RIG_PTT_NONE)
         {
-            rig_debug(RIG_DEBUG_ERR, "%s: error enabling UDP address reuse: %s\n", __func__,
-                      strerror(errno));
+            HAMLIB_PTTPORT(my_rig)->type.ptt = ptt_type;
+            rs->pttport_deprecated.type.ptt = ptt_type;
+            // This causes segfault since backend rig_caps are const
+            // rigctld will use the HAMLIB_STATE(rig) version of this for clients
+            //my_rig->caps->ptt_type = ptt_type;
         }
 
-        // Windows does not have SO_REUSEPORT. However, SO_REUSEADDR works in a similar way.
-#if defined(SO_REUSEPORT)
-        if (setsockopt(sock_listen, SOL_SOCKET, SO_REUSEPORT, SOCKOPT_CAST(&optval),
-                       sizeof(optval)) < 0)
+        if (r->dcd_type != RIG_DCD_NONE)
         {
-            rig_debug(RIG_DEBUG_ERR, "%s: error enabling UDP port reuse: %s\n", __func__,
-                      strerror(errno));
+            HAMLIB_DCDPORT(my_rig)->type.dcd = r->dcd_type;
+            rs->dcdport_deprecated.type.dcd = r->dcd_type;
         }
 
-#endif
+        if (r->ptt_file)
+        {
+            strncpy(HAMLIB_PTTPORT(my_rig)->pathname, r->ptt_file, HAMLIB_FILPATHLEN - 1);
+            strncpy(rs->pttport_deprecated.pathname, r->ptt_file,
+                    HAMLIB_FILPATHLEN - 1);
 
+            // default to RTS when ptt_type is not specified
+            if (ptt_type == RIG_PTT_NONE)
+            {
+                rig_debug(RIG_DEBUG_VERBOSE, "%s: defaulting to RTS PTT\n", __func__);
+                my_rig->caps->ptt_type = RIG_PTT_SERIAL_RTS;
+            }
+        }
 
-#if 0
-        if (setsockopt(sock_listen,
-                       SOL_SOCKET,
-                       SO_REUSEADDR,
-                       SOCKOPT_CAST(&reuseaddr),
-                       sizeof(reuseaddr))
-                < 0)
+        if (r->dcd_file)
         {
-
-            handle_error(RIG_DEBUG_ERR, "setsockopt");
-            freeaddrinfo(saved_result);     /* No longer needed */
-            exit(1);
+            strncpy(HAMLIB_DCDPORT(my_rig)->pathname, r->dcd_file, HAMLIB_FILPATHLEN - 1);
+            strncpy(rs->dcdport_deprecated.pathname, r->dcd_file,
+                    HAMLIB_FILPATHLEN - 1);
         }
 
-#endif
+        /* FIXME: bound checking and port type == serial */
+        if (r->serial_rate != 0)
+        {
+            HAMLIB_RIGPORT(my_rig)->parm.serial.rate = r->serial_rate;
+            rs->rigport_deprecated.parm.serial.rate = r->serial_rate;
+        }
 
-#ifdef IPV6_V6ONLY
+        if (r->civaddr)
+        {
+            rig_set_conf(my_rig, rig_token_lookup(my_rig, "civaddr"), r->civaddr);
+        }
 
-        if (AF_INET6 == result->ai_family)
+        /*
+         * print out conf parameters
+         */
+        if (show_conf)
         {
-            /* allow IPv4 mapped to IPv6 clients Windows and BSD default
-               this to 1 (i.e. disallowed) and we prefer it off */
-            int sockopt = 0;
+            rig_token_foreach(my_rig, print_conf_list, (rig_ptr_t)my_rig);
 
-            if (setsockopt(sock_listen,
-                           IPPROTO_IPV6,
-                           IPV6_V6ONLY,
-                           SOCKOPT_CAST(&sockopt),
-                           sizeof(sockopt))
-                    < 0)
+            if (r->rig_file == NULL)
             {
-
-                handle_error(RIG_DEBUG_ERR, "setsockopt");
-                freeaddrinfo(saved_result);     /* No longer needed */
-                exit(1);
+                fflush(stdout);
+                exit(0);
             }
         }
 
-#endif
+        /*
+         * print out conf parameters, and exits immediately
+         * We may be interested only in only caps, and rig_open may fail.
+         */
+        if (dump_caps_opt)
+        {
+            dumpcaps(my_rig, stdout);
+            rig_cleanup(my_rig); /* if you care about memory */
 
-        int retval = bind(sock_listen, result->ai_addr, result->ai_addrlen);
+            if (i == n_rigs - 1) { exit(0); }
 
-        if (retval == 0)
+            continue;
+        }
+
+        /* attempt to open rig to check early for issues */
+        if (r->skip_open)
         {
-            break;
+            r->opened = 0;
+        }
+        else
+        {
+            retcode = rig_open(my_rig);
+            r->opened = retcode == RIG_OK ? 1 : 0;
         }
 
+        if (retcode != RIG_OK)
         {
-            rig_debug(RIG_DEBUG_ERR, "%s: bind: %s\n", __func__, strerror(errno));
+            fprintf(stderr, "rig_open: error = %s %s %s \n", rigerror(retcode),
+                    r->rig_file, strerror(errno));
+            // continue even if opening the rig fails, because it may be powered off
         }
 
-        if (bind_all)
+        if (verbose > RIG_DEBUG_ERR)
         {
-            handle_error(RIG_DEBUG_WARN, "binding failed (trying next interface)");
+            printf("Opened rig model %u, '%s'\n",
+                   my_rig->caps->rig_model,
+                   my_rig->caps->model_name);
         }
-        else
+
+        rig_debug(RIG_DEBUG_VERBOSE, "Backend version: %s, Status: %s\n",
+                  my_rig->caps->version, rig_strstatus(my_rig->caps->status));
+
+        // Normally we keep the rig open to speed up the 1st client connect
+        // But some rigs like the FT-736 have to lock the rig for CAT control
+        // So they need to release the rig when no clients are connected
+        if (rigctld_idle)
         {
-            handle_error(RIG_DEBUG_WARN, "binding failed");
+            rig_close(my_rig);          /* we will reopen for clients */
+
+            if (verbose > RIG_DEBUG_ERR)
+            {
+                printf("Closed rig model %u, '%s - will reopen for clients'\n",
+                       my_rig->caps->rig_model,
+                       my_rig->caps->model_name);
+            }
         }
+    }
 
 #ifdef __MINGW32__
-        closesocket(sock_listen);
-#else
-        close(sock_listen);
-#endif
-    }
-    while (bind_all && ((result = result->ai_next) != NULL));
+#  ifndef SO_OPENTYPE
+#    define SO_OPENTYPE     0x7008
+#  endif
+#  ifndef SO_SYNCHRONOUS_NONALERT
+#    define SO_SYNCHRONOUS_NONALERT 0x20
+#  endif
+#  ifndef INVALID_SOCKET
+#    define INVALID_SOCKET -1
+#  endif
 
-    freeaddrinfo(saved_result);     /* No longer needed */
+    WSADATA wsadata;
 
-    if (NULL == result)
+    if (WSAStartup(MAKEWORD(1, 1), &wsadata) == SOCKET_ERROR)
     {
-        rig_debug(RIG_DEBUG_ERR, "%s: bind error - no available interface\n", __func__);
+        fprintf(stderr, "WSAStartup socket error\n");
         exit(1);
     }
 
-    if (listen(sock_listen, 4) < 0)
     {
-        handle_error(RIG_DEBUG_ERR, "listening");
-        exit(1);
+        int sockopt = SO_SYNCHRONOUS_NONALERT;
+        setsockopt(INVALID_SOCKET, SOL_SOCKET, SO_OPENTYPE, SOCKOPT_CAST(&sockopt),
+                   sizeof(sockopt));
+    }
+
+#endif
+
+    for (i = 0; i < n_rigs; i++)
+    {
+        r = &rigs[i];
+        r->sock_listen = rigctld_listen(r->portno);
+        r->sock_priority = r->priority_portno ? rigctld_listen(r->priority_portno) :
+                           -1;
     }
 
 #if HAVE_SIGACTION
@@ -970,30 +1342,85 @@ int main(int argc, char *argv[])
     /*
      * main loop accepting connections
      */
-    rig_debug(RIG_DEBUG_TRACE, "%s: rigctld listening on port %s\n", __func__,
-              portno);
+    for (i = 0; i < n_rigs; i++)
+    {
+        rig_debug(RIG_DEBUG_TRACE, "%s: rigctld listening on port %s for rig %d\n",
+                  __func__, rigs[i].portno, i);
+    }
 
-    do
+    if (event_loop)
     {
-        fd_set set;
-        struct timeval timeout;
+        struct rigctld_loop_rig loop_rigs[RIGCTLD_RIGS_MAX];
+        struct rigctld_loop_cfg loop_cfg;
 
-        arg = calloc(1, sizeof(struct handle_data));
+        memset(&loop_cfg, 0, sizeof(loop_cfg));
 
-        if (!arg)
+        for (i = 0; i < n_rigs; i++)
         {
-            rig_debug(RIG_DEBUG_ERR, "calloc: %s\n", strerror(errno));
-            exit(1);
+            loop_rigs[i].rig = rigs[i].rig;
+            loop_rigs[i].sock_listen = rigs[i].sock_listen;
+            loop_rigs[i].sock_priority = rigs[i].sock_priority;
+            loop_rigs[i].rig_opened = rigs[i].opened && !rigctld_idle;
+        }
+
+        loop_cfg.rigs = loop_rigs;
+        loop_cfg.n_rigs = n_rigs;
+        loop_cfg.vfo_mode = vfo_mode;
+        loop_cfg.use_password = rigctld_password[0] != 0;
+        loop_cfg.resp_sep = resp_sep;
+        loop_cfg.idle = rigctld_idle;
+        loop_cfg.quit = rigctld_quit;
+
+        if (rigctld_loop(&loop_cfg) == -RIG_ENIMPL)
+        {
+            fprintf(stderr, "Event loop not available, using a thread per client\n");
+            event_loop = 0;
+        }
+    }
+
+    if (!event_loop)
+    {
+        metrics_set_gauges(sched_gauges, NULL);
+
+        for (i = 0; i < n_rigs; i++)
+        {
+            retcode = pthread_create(&rigs[i].push, NULL, push_thread, &rigs[i]);
+
+            if (retcode != 0)
+            {
+                rig_debug(RIG_DEBUG_ERR, "pthread_create push: %s\n", strerror(retcode));
+                exit(1);
+            }
         }
+    }
 
-        if (rigctld_password[0] != 0) { arg->use_password = 1; }
+    while (!event_loop && !ctrl_c)
+    {
+        fd_set set;
+        struct timeval timeout;
+        int maxfd = -1;
 
         /* use select to allow for periodic checks for CTRL+C */
         FD_ZERO(&set);
-        FD_SET(sock_listen, &set);
+
+        for (i = 0; i < n_rigs; i++)
+        {
+            r = &rigs[i];
+            FD_SET(r->sock_listen, &set);
+
+            if (r->sock_listen > maxfd) { maxfd = r->sock_listen; }
+
+            if (r->sock_priority >= 0)
+            {
+                FD_SET(r->sock_priority, &set);
+
+                if (r->sock_priority > maxfd) { maxfd = r->sock_priority; }
+            }
+        }
+
         timeout.tv_sec = 5;
         timeout.tv_usec = 0;
-        retcode = select(sock_listen + 1, &set, NULL, NULL, &timeout);
+        retcode = select(maxfd + 1, &set, NULL, NULL, &timeout);
 
         if (retcode == -1)
         {
@@ -1024,72 +1451,67 @@ int main(int argc, char *argv[])
         }
         else
         {
-            arg->rig = my_rig;
-            arg->clilen = sizeof(arg->cli_addr);
-            arg->vfo_mode = vfo_mode;
-            arg->sock = accept(sock_listen,
-                               (struct sockaddr *)&arg->cli_addr,
-                               &arg->clilen);
-
-            if (arg->sock < 0)
-            {
-                handle_error(RIG_DEBUG_ERR, "accept");
-                break;
-            }
-
-            if ((retcode = getnameinfo((struct sockaddr const *)&arg->cli_addr,
-                                       arg->clilen,
-                                       host,
-                                       sizeof(host),
-                                       serv,
-                                       sizeof(serv),
-                                       NI_NUMERICHOST | NI_NUMERICSERV))
-                    < 0)
+            for (i = 0; i < n_rigs && retcode >= 0; i++)
             {
-                rig_debug(RIG_DEBUG_WARN,
-                          "Peer lookup error: %s",
-                          gai_strerror(retcode));
-            }
-
-            rig_debug(RIG_DEBUG_VERBOSE,
-                      "Connection opened from %s:%s\n",
-                      host,
-                      serv);
+                r = &rigs[i];
 
-            pthread_attr_init(&attr);
-            pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-
-            retcode = pthread_create(&thread, &attr, handle_socket, arg);
+                if (r->sock_priority >= 0 && FD_ISSET(r->sock_priority, &set))
+                {
+                    retcode = rigctld_accept(r, r->sock_priority, RIGCTL_PRIO_PTT, vfo_mode);
+                }
 
-            if (retcode != 0)
-            {
-                rig_debug(RIG_DEBUG_ERR, "pthread_create: %s\n", strerror(retcode));
-                break;
+                if (retcode >= 0 && FD_ISSET(r->sock_listen, &set))
+                {
+                    retcode = rigctld_accept(r, r->sock_listen, RIGCTL_PRIO_READ, vfo_mode);
+                }
             }
 
+            if (retcode < 0) { break; }
         }
     }
-    while (!ctrl_c);
 
     rig_debug(RIG_DEBUG_VERBOSE, "%s: while loop done\n", __func__);
 
-    /* allow threads to finish current action */
-    mutex_rigctld(1);
-
-    if (client_count)
+    if (!event_loop)
     {
-        rig_debug(RIG_DEBUG_WARN, "%u outstanding client(s)\n", client_count);
+        push_stop = 1;
+
+        for (i = 0; i < n_rigs; i++)
+        {
+            rig_cache_notify(rigs[i].rig);
+            pthread_join(rigs[i].push, NULL);
+        }
     }
 
+    for (i = 0; i < n_rigs; i++)
+    {
+        r = &rigs[i];
+
+        /* allow threads to finish current action */
+        rigctld_sched(r, 1, RIGCTL_PRIO_READ);
+
+        if (r->client_count)
+        {
+            rig_debug(RIG_DEBUG_WARN, "%u outstanding client(s) of rig %d\n",
+                      r->client_count, i);
+        }
+
 #ifdef __MINGW__
-    closesocket(sock_listen);
+        closesocket(r->sock_listen);
+
+        if (r->sock_priority >= 0) { closesocket(r->sock_priority); }
+
 #else
-    close(sock_listen);
+        close(r->sock_listen);
+
+        if (r->sock_priority >= 0) { close(r->sock_priority); }
+
 #endif
-    rig_close(my_rig);
-    mutex_rigctld(0);
+        rig_close(r->rig);
+        rigctld_sched(r, 0, RIGCTL_PRIO_READ);
 
-    rig_cleanup(my_rig); /* if you care about memory */
+        rig_cleanup(r->rig); /* if you care about memory */
+    }
 
 #ifdef __MINGW32__
     WSACleanup();
@@ -1131,6 +1553,8 @@ static FILE *get_fsockin(struct handle_data *handle_data_arg)
 void *handle_socket(void *arg)
 {
     struct handle_data *handle_data_arg = (struct handle_data *)arg;
+    struct rigctld_rig *r = handle_data_arg->r;
+    RIG *my_rig = handle_data_arg->rig;
     FILE *fsockin = NULL;
     FILE *fsockout = NULL;
     int retcode = RIG_OK;
@@ -1142,6 +1566,10 @@ void *handle_socket(void *arg)
     rig_powerstat = RIG_POWER_ON; // defaults to power on
     struct timespec powerstat_check_time;
 
+    // mutex_rigctld() serves this thread on its rig at the priority of its listener
+    pthread_setspecific(client_key, handle_data_arg);
+    metrics_clients(1);
+
     fsockin = get_fsockin(handle_data_arg);
 
     if (!fsockin)
@@ -1163,12 +1591,16 @@ void *handle_socket(void *arg)
         goto handle_exit;
     }
 
+    handle_data_arg->fsockout = fsockout;
+    rigctl_subscription_init(&handle_data_arg->sub);
+    push_add(r, handle_data_arg);
+
     mutex_rigctld(1);
 
-    ++client_count;
+    ++r->client_count;
 #if 0
 
-    if (!client_count++)
+    if (!r->client_count++)
     {
         retcode = rig_open(my_rig);
 
@@ -1196,19 +1628,23 @@ void *handle_socket(void *arg)
 
     do
     {
-        mutex_rigctld(1);
-
-        if (!rig_opened)
+        // only lock to reopen, so cache hits never wait for another client
+        if (!r->opened)
         {
-            retcode = rig_open(my_rig);
-            rig_opened = retcode == RIG_OK ? 1 : 0;
-            rig_debug(RIG_DEBUG_ERR, "%s: rig_open reopened retcode=%d\n", __func__,
-                      retcode);
-        }
+            mutex_rigctld(1);
 
-        mutex_rigctld(0);
+            if (!r->opened)
+            {
+                retcode = rig_open(my_rig);
+                r->opened = retcode == RIG_OK ? 1 : 0;
+                rig_debug(RIG_DEBUG_ERR, "%s: rig_open reopened retcode=%d\n", __func__,
+                          retcode);
+            }
 
-        if (rig_opened) // only do this if rig is open
+            mutex_rigctld(0);
+        }
+
+        if (r->opened) // only do this if rig is open
         {
             rig_debug(RIG_DEBUG_TRACE, "%s: doing rigctl_parse vfo_mode=%d, secure=%d\n",
                       __func__,
@@ -1216,7 +1652,7 @@ void *handle_socket(void *arg)
             retcode = rigctl_parse(handle_data_arg->rig, fsockin, fsockout, NULL, 0,
                                    mutex_rigctld, 1, 0, &handle_data_arg->vfo_mode,
                                    send_cmd_term, &ext_resp, &my_resp_sep,
-                                   handle_data_arg->use_password);
+                                   handle_data_arg->use_password, &handle_data_arg->sub);
 
             if (retcode != 0) { rig_debug(RIG_DEBUG_VERBOSE, "%s: rigctl_parse retcode=%d\n", __func__, retcode); }
 
@@ -1255,7 +1691,7 @@ void *handle_socket(void *arg)
             {
                 mutex_rigctld(1);
                 retcode = rig_close(my_rig);
-                rig_opened = 0;
+                r->opened = 0;
                 mutex_rigctld(0);
                 rig_debug(RIG_DEBUG_ERR, "%s: rig_close retcode=%d\n", __func__, retcode);
 
@@ -1263,39 +1699,39 @@ void *handle_socket(void *arg)
 
                 mutex_rigctld(1);
 
-                if (!rig_opened)
+                if (!r->opened)
                 {
                     retcode = rig_open(my_rig);
-                    rig_opened = retcode == RIG_OK ? 1 : 0;
+                    r->opened = retcode == RIG_OK ? 1 : 0;
                     rig_debug(RIG_DEBUG_ERR, "%s: rig_open retcode=%d, opened=%d\n", __func__,
-                              retcode, rig_opened);
+                              retcode, r->opened);
                 }
 
                 mutex_rigctld(0);
             }
-            while (!ctrl_c && !rig_opened && retry-- > 0 && retcode != RIG_OK);
+            while (!ctrl_c && !r->opened && retry-- > 0 && retcode != RIG_OK);
         }
     }
     while (!ctrl_c && (retcode == RIG_OK || RIG_IS_SOFT_ERRCODE(retcode)));
 
     mutex_rigctld(1);
-    if (rigctld_idle && client_count == 1)
+    if (rigctld_idle && r->client_count == 1)
     {
         rig_close(my_rig);
 
         if (verbose > RIG_DEBUG_ERR) { printf("Closed rig model %s.  Will reopen for new clients\n", my_rig->caps->model_name); }
     }
 
-    --client_count;
+    --r->client_count;
     mutex_rigctld(0);
 
-    if (rigctld_idle && client_count > 0) { printf("%u client%s still connected so rig remains open\n", client_count, client_count > 1 ? "s" : ""); }
+    if (rigctld_idle && r->client_count > 0) { printf("%u client%s still connected so rig remains open\n", r->client_count, r->client_count > 1 ? "s" : ""); }
 
 #if 0
     mutex_rigctld(1);
 
     /* Release rig if there are no clients */
-    if (!--client_count)
+    if (!--r->client_count)
     {
         rig_close(my_rig);
 
@@ -1340,7 +1776,12 @@ handle_exit:
 
     if (fsockin) { fclose(fsockin); }
 
-    if (fsockout) { fclose(fsockout); }
+    if (fsockout)
+    {
+        push_remove(r, handle_data_arg);
+        rigctl_subscription_cleanup(&handle_data_arg->sub);
+        fclose(fsockout);
+    }
 
 // for everybody else we close the handle after fclose
 #ifndef __MINGW32__
@@ -1350,6 +1791,8 @@ handle_exit:
 
 #endif
 
+    metrics_clients(-1);
+    pthread_setspecific(client_key, NULL);
     free(arg);
 
     pthread_exit(NULL);
@@ -1388,9 +1831,14 @@ static void usage(FILE *fout)
         "  -A, --password=PASSWORD       set password for rigctld access (NOT IMPLEMENTED)\n"
         "  -R, --rigctld-idle            make rigctld close the rig when no clients are connected\n"
         "  -b, --bind-all                make rigctld bind to first network device available\n"
+        "  -E, --event-loop              serve all clients from one event loop and a rig command queue\n"
+        "      --priority-port=NUM       also listen on port NUM, its clients get the rig first\n"
         "  -h, --help                    display this help and exit\n"
-        "  -V, --version                 output version information and exit\n\n",
-        portno);
+        "  -V, --version                 output version information and exit\n\n"
+        "Every -m after the first adds a rig, with the device, PTT, DCD, serial,\n"
+        "CI-V, --set-conf and port options that follow it; each rig needs its own\n"
+        "--port and its clients connect there.\n\n",
+        RIGCTLD_PORT);
 
     usage_rig(fout);
 }
@@ -1398,7 +1846,7 @@ static void usage(FILE *fout)
 
 static void short_usage(FILE *fout)
 {
-    fprintf(fout, "Usage: rigctld [OPTION]... [-m ID] [-r DEVICE] [-s BAUD]\n");
+    fprintf(fout, "Usage: rigctld [OPTION]... [-m ID] [-r DEVICE] [-s BAUD] [-t PORT]...\n");
     fprintf(fout, "Daemon serving COMMANDs to a connected radio transceiver or receiver.\n\n");
     fprintf(fout, "Type: rigctld --help for extended usage.\n");
 }
@@ -0,0 +1,1608 @@
+/*
+ * rigctld_loop.c - (C) The Hamlib Group 2025
+ *
+ * Event loop mode of rigctld.
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Instead of a thread per client all sockets are served by one epoll
+ * loop.  It reads whole command lines, and hands them one at a time per
+ * client to the command queue of the rig.  A single thread drains that
+ * queue, runs rigctl_parse() on each line against an in-memory stream
+ * and passes the reply back to the loop, which writes it out as the
+ * client socket accepts it.
+ *
+ * A client has at most one command in the queue, so replies go out in
+ * the order of its commands and every client gets its turn at the rig.
+ * The queue is ordered by rigctl_line_priority(), keying first, then
+ * sets, then reads, raised for clients of the priority listener; equal
+ * priorities go in the order they came and a starved lower one is let
+ * through now and then, see rigctl_priority_next().
+ *
+ * Reads that many clients poll, like f, m or t, are shared: a line equal
+ * to one already waiting or running, for a client in the same protocol
+ * state, waits for that one and gets a copy of its reply.  set_freq is
+ * shared the same way, and a repeat within LOOP_SET_WINDOW_MS of an
+ * identical set_freq, with nothing but reads in between and the cached
+ * frequencies where that one left them, is answered without going to
+ * the rig at all.
+ *
+ * get_freq and get_mode of the current VFO are answered by the loop
+ * itself when the cache holds a fresh value, see rigctl_cache_reply(),
+ * so they never queue behind a slow command of another client.
+ *
+ * Clients that \subscribe get their updates from the loop as well.  A
+ * watcher thread pokes it when the cache changes, and the loop writes the
+ * updates between replies, like any other output.
+ *
+ * Several rigs share the loop, each with a command queue and a thread of
+ * its own, so a slow radio never holds up the others.  A client talks to
+ * the rig of the listener it came in on.  The queue thread is the only
+ * client thread of its rig, but the poll routine and the async data
+ * handler drive the rig too, so each command holds rig_lock() while it
+ * runs, like the client threads of the thread mode do.
+ */
+
+#include "hamlib/config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#  include <sys/epoll.h>
+#  include <fcntl.h>
+#  include <sys/socket.h>
+#  include <netdb.h>
+#endif
+
+#include <pthread.h>
+
+#include "hamlib/rig.h"
+#include "misc.h"
+#include "cache.h"
+
+#include "rigctl_parse.h"
+#include "rigctld_loop.h"
+#include "metrics.h"
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#define LOOP_MAX_EVENTS 64
+#define LOOP_IN_MAX 16384       /* longest command line accepted */
+#define LOOP_OUT_MAX 65536      /* unsent reply bytes before a client waits */
+#define LOOP_KEY_MAX 128        /* longest command line that can be shared */
+#define LOOP_SET_WINDOW_MS 200  /* a set_freq repeated this soon is skipped */
+#define LOOP_PUSH_WAIT_MS 100   /* retry of updates held back by a full buffer */
+
+/* how a command line may be shared with other clients */
+#define LOOP_SHARE_NONE 0
+#define LOOP_SHARE_READ 1       /* no side effects */
+#define LOOP_SHARE_SET 2        /* set_freq, same outcome when repeated */
+
+static const struct loop_shared_cmd
+{
+    char cmd;
+    const char *name;
+    int share;
+} loop_shared_cmds[] =
+{
+    { 'f', "get_freq", LOOP_SHARE_READ },
+    { 'm', "get_mode", LOOP_SHARE_READ },
+    { 't', "get_ptt", LOOP_SHARE_READ },
+    { 'v', "get_vfo", LOOP_SHARE_READ },
+    { 's', "get_split_vfo", LOOP_SHARE_READ },
+    { 'i', "get_split_freq", LOOP_SHARE_READ },
+    { 'x', "get_split_mode", LOOP_SHARE_READ },
+    { 'l', "get_level", LOOP_SHARE_READ },
+    { 'u', "get_func", LOOP_SHARE_READ },
+    { 'p', "get_parm", LOOP_SHARE_READ },
+    { 'j', "get_rit", LOOP_SHARE_READ },
+    { 'z', "get_xit", LOOP_SHARE_READ },
+    { 0, "get_vfo_info", LOOP_SHARE_READ },
+    { 0, "get_rig_info", LOOP_SHARE_READ },
+    { 'F', "set_freq", LOOP_SHARE_SET },
+    { 0, NULL, LOOP_SHARE_NONE }
+};
+
+struct loop_client
+{
+    int sock;
+    char peer[NI_MAXHOST + NI_MAXSERV + 2];
+    char *in;                   /* received, not yet queued */
+    size_t in_len;
+    char *out;                  /* replies not yet sent */
+    size_t out_len, out_off, out_size;
+    unsigned int events;        /* what epoll waits for */
+    int busy;                   /* a command is queued or running */
+    int eof;                    /* no more commands, close once answered */
+    int dead;                   /* to be freed as soon as it is not busy */
+    int priority;               /* least RIGCTL_PRIO_* of its commands */
+    struct loop_rig *rig;       /* where its commands go */
+
+    /* rigctl_parse() state, only touched by the rig thread while busy */
+    int vfo_mode;
+    int ext_resp;
+    char resp_sep;
+    int use_password;
+    struct rigctl_subscription sub;
+
+    struct loop_client *next;
+};
+
+struct loop_job
+{
+    struct loop_client *client; /* NULL to release an idle rig */
+    char *cmd;
+    size_t cmd_len;
+    char *reply;
+    size_t reply_len;
+    int retcode;
+    int priority;               /* RIGCTL_PRIO_*, picks its queue */
+    int share;                  /* LOOP_SHARE_*, key is valid unless NONE */
+    char key[LOOP_KEY_MAX + 16];
+    struct loop_job *followers; /* equal jobs of other clients, via next */
+    struct loop_job *next;
+};
+
+struct loop;
+
+/* A rig, its command queue and the thread draining it */
+struct loop_rig
+{
+    RIG *rig;
+    int index;                  /* in rigctld_loop_cfg.rigs */
+    struct loop *loop;
+    int opened;
+    unsigned int client_count;
+    struct timespec powerstat_check_time;
+    pthread_t thread;
+    int thread_started;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct loop_job *head[RIGCTL_PRIOS], *tail[RIGCTL_PRIOS];
+    int skipped[RIGCTL_PRIOS];  /* see rigctl_priority_next() */
+    struct loop_job *running;
+    int stop;
+
+    /* last set_freq done, only the rig thread uses these */
+    char last_set[LOOP_KEY_MAX + 16];
+    char *last_set_reply;
+    size_t last_set_reply_len;
+    struct timespec last_set_time;
+    freq_t last_set_freq[2];    /* cached VFO A and B after it */
+
+    unsigned long shared;       /* jobs answered by an equal job */
+    unsigned long sets_skipped; /* set_freq repeats not sent to the rig */
+
+    /* subscriptions */
+    pthread_t watch_thread;
+    int watch_started;
+    unsigned int push_generation;   /* cache generation last pushed */
+    int push_moved;             /* the cache moved since the last push */
+};
+
+/* a listening socket and where its clients go */
+struct loop_listener
+{
+    int sock;
+    int priority;               /* RIGCTL_PRIO_* its clients get at least */
+    struct loop_rig *rig;
+};
+
+struct loop
+{
+    const struct rigctld_loop_cfg *cfg;
+    int epfd;
+    int wake_fd[2];             /* the rig thread pokes the loop */
+    pthread_mutex_t done_lock;
+    struct loop_job *done, *done_tail;
+    struct loop_client *clients;
+    struct loop_rig *rigs;
+    int n_rigs;
+    struct loop_listener *listeners;
+    int n_listeners;
+    unsigned long cache_hits;   /* lines answered from the cache */
+
+    /* subscriptions */
+    int watch_stop;
+    int watching;               /* some client subscribed, poke on changes */
+    double push_at;             /* a rate limited update is due, 0 none */
+};
+
+/* epoll_event.data.ptr of the wake pipe, listeners point to their entry */
+static char loop_wake_tag;
+
+extern double monotonic_seconds();
+
+
+static int loop_set_nonblock(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+
+static void loop_job_free(struct loop_job *job)
+{
+    while (job->followers)
+    {
+        struct loop_job *f = job->followers;
+
+        job->followers = f->next;
+        loop_job_free(f);
+    }
+
+    free(job->cmd);
+    free(job->reply);
+    free(job);
+}
+
+
+/* work out whether a job can be shared and what it must equal for that */
+static void loop_job_share(struct loop_job *job)
+{
+    const struct loop_client *c = job->client;
+    const char *cmd = job->cmd;
+    size_t len = job->cmd_len, i = 0, n;
+    int k;
+
+    job->share = LOOP_SHARE_NONE;
+
+    while (len > 0 && isspace((unsigned char) cmd[len - 1])) { len--; }
+
+    while (i < len && isspace((unsigned char) cmd[i])) { i++; }
+
+    if (len - i > LOOP_KEY_MAX) { return; }
+
+    // same prefixes as rigctl_parse(): + or a separator for extended replies
+    if (i < len && (cmd[i] == '+' || (ispunct((unsigned char) cmd[i])
+                                      && !strchr("\\_#()", cmd[i]))))
+    {
+        i++;
+    }
+
+    if (i < len && cmd[i] == '\\')
+    {
+        for (n = ++i; n < len && !isspace((unsigned char) cmd[n]); n++) {}
+
+        for (k = 0; loop_shared_cmds[k].name; k++)
+        {
+            if (strlen(loop_shared_cmds[k].name) == n - i
+                    && strncmp(loop_shared_cmds[k].name, cmd + i, n - i) == 0)
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        if (i >= len || (i + 1 < len && !isspace((unsigned char) cmd[i + 1])))
+        {
+            return;
+        }
+
+        for (k = 0; loop_shared_cmds[k].name; k++)
+        {
+            if (loop_shared_cmds[k].cmd == cmd[i]) { break; }
+        }
+    }
+
+    if (!loop_shared_cmds[k].name) { return; }
+
+    // the reply also depends on how the client talks to us
+    SNPRINTF(job->key, sizeof(job->key), "%d %d %d %d %.*s", c->vfo_mode,
+             c->ext_resp, c->resp_sep, c->sub.cache_resp, (int) len, cmd);
+    job->share = loop_shared_cmds[k].share;
+}
+
+
+static int loop_job_same(const struct loop_job *a, const struct loop_job *b)
+{
+    return a && a->share == b->share && strcmp(a->key, b->key) == 0;
+}
+
+
+static int loop_job_copy_reply(struct loop_job *dst, const char *reply,
+                               size_t len)
+{
+    free(dst->reply);
+    dst->reply = malloc(len ? len : 1);
+    dst->reply_len = dst->reply ? len : 0;
+
+    if (!dst->reply) { return -RIG_ENOMEM; }
+
+    memcpy(dst->reply, reply, len);
+
+    return RIG_OK;
+}
+
+
+static void loop_rig_submit(struct loop_rig *lr, struct loop_job *job)
+{
+    int prio = job->priority;
+
+    job->next = NULL;
+
+    pthread_mutex_lock(&lr->lock);
+
+    if (job->share != LOOP_SHARE_NONE)
+    {
+        struct loop_job *lead = lr->running;
+        int i;
+
+        for (i = 0; i < RIGCTL_PRIOS && !loop_job_same(lead, job); i++)
+        {
+            for (lead = lr->head[i]; lead && !loop_job_same(lead, job); lead = lead->next) {}
+        }
+
+        if (lead)
+        {
+            job->next = lead->followers;
+            lead->followers = job;
+            lr->shared++;
+            pthread_mutex_unlock(&lr->lock);
+            return;
+        }
+    }
+
+    if (lr->tail[prio]) { lr->tail[prio]->next = job; }
+    else { lr->head[prio] = job; }
+
+    lr->tail[prio] = job;
+    pthread_cond_signal(&lr->cond);
+    pthread_mutex_unlock(&lr->lock);
+}
+
+
+static void loop_wake(struct loop *loop)
+{
+    char c = 0;
+
+    // a full pipe already has the loop on its way
+    if (write(loop->wake_fd[1], &c, 1) < 0 && errno != EAGAIN)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: write: %s\n", __func__, strerror(errno));
+    }
+}
+
+
+/* hand a finished job back to the event loop */
+static void loop_post(struct loop *loop, struct loop_job *job)
+{
+    job->next = NULL;
+
+    pthread_mutex_lock(&loop->done_lock);
+
+    if (loop->done_tail) { loop->done_tail->next = job; }
+    else { loop->done = job; }
+
+    loop->done_tail = job;
+    pthread_mutex_unlock(&loop->done_lock);
+
+    loop_wake(loop);
+}
+
+
+/* pokes the loop when the cache of a rig changes while anybody subscribed */
+static void *loop_watch_thread(void *arg)
+{
+    struct loop_rig *lr = arg;
+    struct loop *loop = lr->loop;
+    unsigned int generation = rig_cache_generation(lr->rig);
+
+    while (!HL_ATOMIC_LOAD(&loop->watch_stop))
+    {
+        if (rig_cache_wait(lr->rig, &generation, 1000)
+                && HL_ATOMIC_LOAD_RELAXED(&loop->watching))
+        {
+            loop_wake(loop);
+        }
+    }
+
+    return NULL;
+}
+
+
+static int loop_rig_open(struct loop_rig *lr)
+{
+    int retcode;
+
+    retcode = rig_open(lr->rig);
+    lr->opened = retcode == RIG_OK;
+
+    rig_debug(RIG_DEBUG_ERR, "%s: rig_open retcode=%d, opened=%d\n", __func__,
+              retcode, lr->opened);
+
+    return retcode;
+}
+
+
+static void loop_rig_close(struct loop_rig *lr)
+{
+    rig_close(lr->rig);
+    lr->opened = 0;
+}
+
+
+/* same recovery as a rigctld client thread: power check, then reopen */
+static int loop_rig_recover(struct loop_rig *lr, int retcode)
+{
+    RIG *rig = lr->rig;
+    int retry = 3;
+
+    if (rig->caps->get_powerstat && (retcode == -RIG_ETIMEOUT
+                                     || (retcode == -RIG_EPOWER
+                                         && elapsed_ms(&lr->powerstat_check_time, HAMLIB_ELAPSED_GET) >= 1000)))
+    {
+        powerstat_t powerstat;
+
+        rig_get_powerstat(rig, &powerstat);
+        rig_powerstat = powerstat;
+
+        if (powerstat == RIG_POWER_OFF || powerstat == RIG_POWER_STANDBY)
+        {
+            retcode = -RIG_EPOWER;
+        }
+
+        elapsed_ms(&lr->powerstat_check_time, HAMLIB_ELAPSED_SET);
+    }
+
+    if (retcode >= 0 || RIG_IS_SOFT_ERRCODE(retcode))
+    {
+        return retcode;
+    }
+
+    rig_debug(RIG_DEBUG_ERR, "%s: i/o error\n", __func__);
+
+    do
+    {
+        loop_rig_close(lr);
+        hl_usleep(1000 * 1000);
+        retcode = loop_rig_open(lr);
+    }
+    while (!lr->loop->cfg->quit() && !lr->opened && retry-- > 0);
+
+    return retcode;
+}
+
+
+/* run one command line of a client against the rig */
+static void loop_rig_run(struct loop_rig *lr, struct loop_job *job)
+{
+    struct loop_client *c = job->client;
+    FILE *fin, *fout;
+    int retcode = RIG_OK;
+    int ch;
+
+    if (!lr->opened && loop_rig_open(lr) != RIG_OK)
+    {
+        job->retcode = loop_rig_recover(lr, -RIG_EIO);
+        return;
+    }
+
+    fin = fmemopen(job->cmd, job->cmd_len, "r");
+    fout = open_memstream(&job->reply, &job->reply_len);
+
+    if (!fin || !fout)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: stream: %s\n", __func__, strerror(errno));
+
+        if (fin) { fclose(fin); }
+
+        if (fout) { fclose(fout); }
+
+        job->retcode = -RIG_ENOMEM;
+        return;
+    }
+
+    do
+    {
+        // rigctl_parse() takes running out of input for a broken connection
+        while ((ch = fgetc(fin)) != EOF && isspace(ch)) {}
+
+        if (ch == EOF) { break; }
+
+        ungetc(ch, fin);
+
+        retcode = rigctl_parse(lr->rig, fin, fout, NULL, 0, NULL, 1, 0,
+                               &c->vfo_mode, '\r', &c->ext_resp, &c->resp_sep,
+                               c->use_password, &c->sub);
+    }
+    while (retcode == RIG_OK || RIG_IS_SOFT_ERRCODE(retcode));
+
+    fclose(fin);
+    fclose(fout);
+
+    if (retcode == RIGCTL_PARSE_ERROR)
+    {
+        // a command missing arguments, a client thread would wait for more
+        retcode = RIG_OK;
+    }
+
+    job->retcode = loop_rig_recover(lr, retcode);
+}
+
+
+/* the cached frequencies of VFO A and B */
+static void loop_rig_freqs(struct loop_rig *lr, freq_t freqs[2])
+{
+    rmode_t mode;
+    pbwidth_t width;
+    int ms_f, ms_m, ms_w;
+
+    rig_get_cache(lr->rig, RIG_VFO_A, &freqs[0], &ms_f, &mode, &ms_m, &width,
+                  &ms_w);
+    rig_get_cache(lr->rig, RIG_VFO_B, &freqs[1], &ms_f, &mode, &ms_m, &width,
+                  &ms_w);
+}
+
+
+/* run a job, unless it repeats the set_freq just done */
+static void loop_rig_exec(struct loop_rig *lr, struct loop_job *job)
+{
+    int repeat = job->share == LOOP_SHARE_SET && lr->last_set_reply
+                 && strcmp(job->key, lr->last_set) == 0
+                 && elapsed_ms(&lr->last_set_time, HAMLIB_ELAPSED_GET) < LOOP_SET_WINDOW_MS;
+
+    if (repeat)
+    {
+        freq_t freqs[2];
+
+        // the rig may have been tuned since, by its knob or a report
+        loop_rig_freqs(lr, freqs);
+        repeat = freqs[0] == lr->last_set_freq[0]
+                 && freqs[1] == lr->last_set_freq[1];
+    }
+
+    if (repeat)
+    {
+        job->retcode = loop_job_copy_reply(job, lr->last_set_reply,
+                                           lr->last_set_reply_len);
+
+        if (job->retcode == RIG_OK)
+        {
+            lr->sets_skipped++;
+            return;
+        }
+    }
+
+    rig_lock(lr->rig, 1);
+    loop_rig_run(lr, job);
+    rig_lock(lr->rig, 0);
+
+    if (job->share == LOOP_SHARE_READ)
+    {
+        return;
+    }
+
+    // anything else may have moved the rig away from the last set_freq
+    free(lr->last_set_reply);
+    lr->last_set_reply = NULL;
+
+    if (job->share == LOOP_SHARE_SET && job->retcode == RIG_OK)
+    {
+        lr->last_set_reply = malloc(job->reply_len ? job->reply_len : 1);
+
+        if (lr->last_set_reply)
+        {
+            memcpy(lr->last_set_reply, job->reply, job->reply_len);
+            lr->last_set_reply_len = job->reply_len;
+            strcpy(lr->last_set, job->key);
+            elapsed_ms(&lr->last_set_time, HAMLIB_ELAPSED_SET);
+            loop_rig_freqs(lr, lr->last_set_freq);
+        }
+    }
+}
+
+
+/*
+ * '\dump_metrics' commands waiting per priority and what sharing saved,
+ * labelled with the rig when there are several
+ */
+static void loop_gauges(FILE *fout, void *arg)
+{
+    struct loop *loop = arg;
+    unsigned long depth[RIGCTL_PRIOS];
+    unsigned long shared = 0, sets_skipped = 0;
+    const struct loop_job *job;
+    char label[32] = "";
+    int i, prio;
+
+    metrics_type(fout, "hamlib_queue_depth", "gauge");
+
+    for (i = 0; i < loop->n_rigs; i++)
+    {
+        struct loop_rig *lr = &loop->rigs[i];
+
+        memset(depth, 0, sizeof(depth));
+        pthread_mutex_lock(&lr->lock);
+
+        for (prio = 0; prio < RIGCTL_PRIOS; prio++)
+        {
+            for (job = lr->head[prio]; job; job = job->next) { depth[prio]++; }
+        }
+
+        shared += lr->shared;
+        sets_skipped += lr->sets_skipped;
+        pthread_mutex_unlock(&lr->lock);
+
+        if (loop->n_rigs > 1) { SNPRINTF(label, sizeof(label), "rig=\"%d\",", i); }
+
+        for (prio = 0; prio < RIGCTL_PRIOS; prio++)
+        {
+            fprintf(fout, "hamlib_queue_depth{%sclass=\"%s\"} %lu\n", label,
+                    rigctl_priority_name(prio), depth[prio]);
+        }
+    }
+
+    metrics_type(fout, "hamlib_commands_shared_total", "counter");
+    fprintf(fout, "hamlib_commands_shared_total %lu\n", shared);
+    metrics_type(fout, "hamlib_sets_skipped_total", "counter");
+    fprintf(fout, "hamlib_sets_skipped_total %lu\n", sets_skipped);
+}
+
+static void *loop_rig_thread(void *arg)
+{
+    struct loop_rig *lr = arg;
+
+    pthread_mutex_lock(&lr->lock);
+
+    for (;;)
+    {
+        struct loop_job *job = NULL;
+        int waiting[RIGCTL_PRIOS];
+        int prio;
+
+        while (!lr->stop)
+        {
+            for (prio = RIGCTL_PRIOS - 1; prio >= 0 && !lr->head[prio]; prio--) {}
+
+            if (prio >= 0) { break; }
+
+            pthread_cond_wait(&lr->cond, &lr->lock);
+        }
+
+        for (prio = 0; prio < RIGCTL_PRIOS; prio++)
+        {
+            waiting[prio] = lr->head[prio] != NULL;
+        }
+
+        prio = rigctl_priority_next(waiting, lr->skipped);
+
+        if (prio < 0) { break; }
+
+        job = lr->head[prio];
+        lr->head[prio] = job->next;
+
+        if (!lr->head[prio]) { lr->tail[prio] = NULL; }
+
+        lr->running = job;
+        pthread_mutex_unlock(&lr->lock);
+
+        if (job->client)
+        {
+            struct loop_job *followers;
+
+            loop_rig_exec(lr, job);
+
+            pthread_mutex_lock(&lr->lock);
+            followers = job->followers;
+            job->followers = NULL;
+            lr->running = NULL;
+            pthread_mutex_unlock(&lr->lock);
+
+            while (followers)
+            {
+                struct loop_job *f = followers;
+
+                followers = f->next;
+
+                // the same line left the client in the same state
+                f->client->vfo_mode = job->client->vfo_mode;
+                f->client->ext_resp = job->client->ext_resp;
+                f->client->resp_sep = job->client->resp_sep;
+                f->retcode = loop_job_copy_reply(f, job->reply, job->reply_len);
+
+                if (f->retcode == RIG_OK) { f->retcode = job->retcode; }
+
+                loop_post(lr->loop, f);
+            }
+
+            loop_post(lr->loop, job);
+        }
+        else
+        {
+            if (lr->opened)
+            {
+                loop_rig_close(lr);
+
+                if (rig_need_debug(RIG_DEBUG_WARN))
+                {
+                    printf("Closed rig model %s.  Will reopen for new clients\n",
+                           lr->rig->caps->model_name);
+                }
+            }
+
+            loop_job_free(job);
+            pthread_mutex_lock(&lr->lock);
+            lr->running = NULL;
+            pthread_mutex_unlock(&lr->lock);
+        }
+
+        pthread_mutex_lock(&lr->lock);
+    }
+
+    pthread_mutex_unlock(&lr->lock);
+
+    return NULL;
+}
+
+
+static void loop_client_events(struct loop *loop, struct loop_client *c)
+{
+    struct epoll_event ev;
+    unsigned int events = 0;
+
+    if (c->dead) { return; }
+
+    if (!c->eof && c->in_len < LOOP_IN_MAX) { events |= EPOLLIN; }
+
+    if (c->out_off < c->out_len) { events |= EPOLLOUT; }
+
+    if (events == c->events) { return; }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = c;
+
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, c->sock, &ev) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: epoll_ctl: %s\n", __func__, strerror(errno));
+    }
+
+    c->events = events;
+}
+
+
+static void loop_client_kill(struct loop *loop, struct loop_client *c)
+{
+    if (c->dead) { return; }
+
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, c->sock, NULL);
+    c->dead = 1;
+}
+
+
+static void loop_client_flush(struct loop *loop, struct loop_client *c)
+{
+    while (c->out_off < c->out_len)
+    {
+        ssize_t n = send(c->sock, c->out + c->out_off, c->out_len - c->out_off,
+                         MSG_NOSIGNAL);
+
+        if (n > 0)
+        {
+            c->out_off += n;
+        }
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        else if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            rig_debug(RIG_DEBUG_VERBOSE, "%s: %s: %s\n", __func__, c->peer,
+                      strerror(errno));
+            loop_client_kill(loop, c);
+            return;
+        }
+    }
+
+    if (c->out_off == c->out_len)
+    {
+        c->out_off = c->out_len = 0;
+    }
+}
+
+
+/* queue reply bytes for a client, which is killed when that fails */
+static int loop_client_append(struct loop *loop, struct loop_client *c,
+                              const char *buf, size_t len)
+{
+    size_t need = c->out_len + len;
+
+    if (need > c->out_size)
+    {
+        char *out = realloc(c->out, need);
+
+        if (!out)
+        {
+            loop_client_kill(loop, c);
+            return -RIG_ENOMEM;
+        }
+
+        c->out = out;
+        c->out_size = need;
+    }
+
+    memcpy(c->out + c->out_len, buf, len);
+    c->out_len = need;
+
+    return RIG_OK;
+}
+
+
+/*
+ * Answer a get_freq or get_mode line of the current VFO from the cache
+ * right here, 1 when done.  The line is parsed the way rigctl_parse()
+ * would, anything unusual goes to the rig thread instead.
+ */
+static int loop_cache_reply(struct loop *loop, struct loop_client *c,
+                            const struct loop_job *job)
+{
+    const char *cmd = job->cmd;
+    size_t len = job->cmd_len, i = 0, n;
+    int ext_resp = c->ext_resp;
+    char resp_sep = c->resp_sep;
+    vfo_t vfo = RIG_VFO_CURR;
+    char name, vfo_name[32];
+    char *reply = NULL;
+    size_t reply_len = 0;
+    FILE *fout;
+    int hit;
+
+    if (job->share != LOOP_SHARE_READ) { return 0; }
+
+    while (len > 0 && isspace((unsigned char) cmd[len - 1])) { len--; }
+
+    while (i < len && isspace((unsigned char) cmd[i])) { i++; }
+
+    if (i < len && cmd[i] == '+')
+    {
+        ext_resp = 1;
+        i++;
+    }
+    else if (i < len && ispunct((unsigned char) cmd[i])
+             && !strchr("\\_#()", cmd[i]))
+    {
+        ext_resp = 1;
+        resp_sep = cmd[i++];
+    }
+
+    if (i < len && cmd[i] == '\\')
+    {
+        for (n = ++i; n < len && !isspace((unsigned char) cmd[n]); n++) {}
+
+        if (n - i == 8 && strncmp(cmd + i, "get_freq", 8) == 0) { name = 'f'; }
+        else if (n - i == 8 && strncmp(cmd + i, "get_mode", 8) == 0) { name = 'm'; }
+        else { return 0; }
+
+        i = n;
+    }
+    else
+    {
+        name = i < len ? cmd[i++] : 0;
+    }
+
+    if ((name != 'f' && name != 'm') || (i < len && !isspace((unsigned char) cmd[i])))
+    {
+        return 0;
+    }
+
+    while (i < len && isspace((unsigned char) cmd[i])) { i++; }
+
+    if (c->vfo_mode)
+    {
+        for (n = i; n < len && !isspace((unsigned char) cmd[n]); n++) {}
+
+        if (n == i || n - i >= sizeof(vfo_name)) { return 0; }
+
+        memcpy(vfo_name, cmd + i, n - i);
+        vfo_name[n - i] = '\0';
+        vfo = rig_parse_vfo(vfo_name);
+        i = n;
+    }
+
+    if (i != len) { return 0; }
+
+    fout = open_memstream(&reply, &reply_len);
+
+    if (!fout) { return 0; }
+
+    hit = rigctl_cache_reply(c->rig->rig, fout, name, vfo, c->vfo_mode,
+                             &ext_resp, &resp_sep, c->use_password,
+                             c->sub.cache_resp);
+    fclose(fout);
+
+    if (hit && loop_client_append(loop, c, reply, reply_len) == RIG_OK)
+    {
+        c->ext_resp = ext_resp;
+        c->resp_sep = resp_sep;
+        loop->cache_hits++;
+    }
+
+    free(reply);
+
+    return hit;
+}
+
+
+/* queue the next complete command line of a client */
+static void loop_client_dispatch(struct loop *loop, struct loop_client *c)
+{
+    while (!c->busy && !c->dead && c->out_len - c->out_off < LOOP_OUT_MAX)
+    {
+        struct loop_job *job;
+        size_t len, i;
+
+        for (len = 0; len < c->in_len; len++)
+        {
+            if (c->in[len] == '\n' || c->in[len] == '\r') { break; }
+        }
+
+        if (len == c->in_len)
+        {
+            if (len >= LOOP_IN_MAX)
+            {
+                rig_debug(RIG_DEBUG_ERR, "%s: %s: command line too long\n", __func__,
+                          c->peer);
+                loop_client_kill(loop, c);
+                return;
+            }
+
+            // whatever came before the hang up is a command too
+            if (!c->eof || len == 0) { break; }
+        }
+        else
+        {
+            len++;
+        }
+
+        for (i = 0; i < len && isspace((unsigned char) c->in[i]); i++) {}
+
+        if (i == len)
+        {
+            c->in_len -= len;
+            memmove(c->in, c->in + len, c->in_len);
+            continue;
+        }
+
+        job = calloc(1, sizeof(*job));
+
+        if (job)
+        {
+            job->cmd = malloc(len);
+        }
+
+        if (!job || !job->cmd)
+        {
+            free(job);
+            loop_client_kill(loop, c);
+            return;
+        }
+
+        memcpy(job->cmd, c->in, len);
+        job->cmd_len = len;
+        job->client = c;
+        job->priority = rigctl_line_priority(job->cmd, len);
+
+        if (job->priority < c->priority) { job->priority = c->priority; }
+
+        loop_job_share(job);
+        c->in_len -= len;
+        memmove(c->in, c->in + len, c->in_len);
+
+        if (loop_cache_reply(loop, c, job))
+        {
+            loop_job_free(job);
+            continue;
+        }
+
+        c->busy = 1;
+        loop_rig_submit(c->rig, job);
+    }
+}
+
+
+/* push out what can be sent, queue what can be run and close what is done */
+static void loop_client_update(struct loop *loop, struct loop_client *c)
+{
+    loop_client_flush(loop, c);
+    loop_client_dispatch(loop, c);
+
+    if (!c->dead && !c->busy && c->eof && c->out_len == 0)
+    {
+        loop_client_kill(loop, c);
+    }
+
+    loop_client_events(loop, c);
+}
+
+
+static void loop_client_read(struct loop *loop, struct loop_client *c)
+{
+    ssize_t n;
+
+    if (c->in_len >= LOOP_IN_MAX)
+    {
+        // no EPOLLIN while full, so the client hung up or failed
+        c->eof = 1;
+        loop_client_update(loop, c);
+        return;
+    }
+
+    n = recv(c->sock, c->in + c->in_len, LOOP_IN_MAX - c->in_len, 0);
+
+    if (n > 0)
+    {
+        c->in_len += n;
+    }
+    else if (n == 0)
+    {
+        c->eof = 1;
+    }
+    else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        rig_debug(RIG_DEBUG_VERBOSE, "%s: %s: %s\n", __func__, c->peer,
+                  strerror(errno));
+        loop_client_kill(loop, c);
+        return;
+    }
+
+    loop_client_update(loop, c);
+}
+
+
+/* send a client the updates of its subscription that are due */
+static void loop_client_push(struct loop *loop, struct loop_client *c)
+{
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *fout;
+    int due_ms = LOOP_PUSH_WAIT_MS;
+
+    if (c->dead || !c->sub.active) { return; }
+
+    // values that wait for a full buffer are sent once it drains
+    if (c->out_len - c->out_off < LOOP_OUT_MAX
+            && (fout = open_memstream(&buf, &len)) != NULL)
+    {
+        due_ms = rigctl_subscription_push(c->rig->rig, &c->sub, fout);
+        fclose(fout);
+
+        if (len > 0 && loop_client_append(loop, c, buf, len) == RIG_OK)
+        {
+            loop_client_flush(loop, c);
+            loop_client_events(loop, c);
+        }
+
+        free(buf);
+    }
+
+    if (due_ms >= 0)
+    {
+        double at = monotonic_seconds() + due_ms / 1000.0;
+
+        if (loop->push_at == 0 || at < loop->push_at) { loop->push_at = at; }
+    }
+}
+
+
+/* send the updates of all subscriptions, if a cache moved or some are due */
+static void loop_push(struct loop *loop)
+{
+    struct loop_client *c;
+    int due, moved = 0, watching = 0;
+    int i;
+
+    if (!loop->watching) { return; }
+
+    due = loop->push_at > 0 && monotonic_seconds() >= loop->push_at;
+
+    for (i = 0; i < loop->n_rigs; i++)
+    {
+        struct loop_rig *lr = &loop->rigs[i];
+        unsigned int generation = rig_cache_generation(lr->rig);
+
+        lr->push_moved = generation != lr->push_generation;
+        lr->push_generation = generation;
+        moved |= lr->push_moved;
+    }
+
+    if (!due && !moved) { return; }
+
+    loop->push_at = 0;
+
+    for (c = loop->clients; c; c = c->next)
+    {
+        if (!c->dead && c->sub.active)
+        {
+            watching = 1;
+
+            if (due || c->rig->push_moved) { loop_client_push(loop, c); }
+        }
+    }
+
+    HL_ATOMIC_STORE_RELAXED(&loop->watching, watching);
+}
+
+
+static void loop_client_finish(struct loop *loop, struct loop_job *job)
+{
+    struct loop_client *c = job->client;
+
+    c->busy = 0;
+
+    if (c->dead || loop_client_append(loop, c, job->reply, job->reply_len) != RIG_OK)
+    {
+        loop_job_free(job);
+        return;
+    }
+
+    // asked to quit, or the rig is gone: answer and hang up
+    if (job->retcode == RIGCTL_PARSE_END
+            || (job->retcode < 0 && !RIG_IS_SOFT_ERRCODE(job->retcode)))
+    {
+        c->eof = 1;
+        c->in_len = 0;
+    }
+
+    loop_job_free(job);
+
+    // the first values of a new subscription go out right away
+    if (c->sub.active)
+    {
+        HL_ATOMIC_STORE_RELAXED(&loop->watching, 1);
+        loop_client_push(loop, c);
+    }
+
+    loop_client_update(loop, c);
+}
+
+
+static void loop_accept(struct loop *loop, struct loop_listener *l)
+{
+    const struct rigctld_loop_cfg *cfg = loop->cfg;
+
+    for (;;)
+    {
+        struct sockaddr_storage addr;
+        socklen_t addrlen = sizeof(addr);
+        char host[NI_MAXHOST], serv[NI_MAXSERV];
+        struct loop_client *c;
+        struct epoll_event ev;
+        int sock;
+
+        sock = accept(l->sock, (struct sockaddr *)&addr, &addrlen);
+
+        if (sock < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                rig_debug(RIG_DEBUG_ERR, "%s: accept: %s\n", __func__, strerror(errno));
+            }
+
+            return;
+        }
+
+        c = calloc(1, sizeof(*c));
+
+        if (c)
+        {
+            c->in = malloc(LOOP_IN_MAX);
+        }
+
+        if (!c || !c->in || loop_set_nonblock(sock) < 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: cannot take client: %s\n", __func__,
+                      strerror(errno));
+
+            if (c) { free(c->in); }
+
+            free(c);
+            close(sock);
+            continue;
+        }
+
+        if (getnameinfo((struct sockaddr *)&addr, addrlen, host, sizeof(host), serv,
+                        sizeof(serv), NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+        {
+            strcpy(host, "?");
+            strcpy(serv, "?");
+        }
+
+        SNPRINTF(c->peer, sizeof(c->peer), "%s:%s", host, serv);
+        rigctl_subscription_init(&c->sub);
+        c->sock = sock;
+        c->vfo_mode = cfg->vfo_mode;
+        c->resp_sep = cfg->resp_sep;
+        c->use_password = cfg->use_password;
+        c->priority = l->priority;
+        c->rig = l->rig;
+        c->events = EPOLLIN;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = c->events;
+        ev.data.ptr = c;
+
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, sock, &ev) < 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: epoll_ctl: %s\n", __func__, strerror(errno));
+            rigctl_subscription_cleanup(&c->sub);
+            free(c->in);
+            free(c);
+            close(sock);
+            continue;
+        }
+
+        c->next = loop->clients;
+        loop->clients = c;
+        l->rig->client_count++;
+        metrics_clients(1);
+
+        rig_debug(RIG_DEBUG_VERBOSE, "Connection opened from %s to rig %d\n",
+                  c->peer, l->rig->index);
+    }
+}
+
+
+static void loop_collect(struct loop *loop)
+{
+    struct loop_job *job;
+    char buf[64];
+
+    while (read(loop->wake_fd[0], buf, sizeof(buf)) > 0) {}
+
+    pthread_mutex_lock(&loop->done_lock);
+    job = loop->done;
+    loop->done = loop->done_tail = NULL;
+    pthread_mutex_unlock(&loop->done_lock);
+
+    while (job)
+    {
+        struct loop_job *next = job->next;
+
+        loop_client_finish(loop, job);
+        job = next;
+    }
+}
+
+
+/* free the clients that are gone and have nothing left on the rig */
+static void loop_reap(struct loop *loop)
+{
+    struct loop_client **pc = &loop->clients;
+
+    while (*pc)
+    {
+        struct loop_client *c = *pc;
+        struct loop_rig *lr = c->rig;
+
+        if (!c->dead || c->busy)
+        {
+            pc = &c->next;
+            continue;
+        }
+
+        *pc = c->next;
+        rig_debug(RIG_DEBUG_VERBOSE, "Connection closed from %s\n", c->peer);
+        close(c->sock);
+        rigctl_subscription_cleanup(&c->sub);
+        free(c->in);
+        free(c->out);
+        free(c);
+        metrics_clients(-1);
+
+        if (--lr->client_count == 0 && loop->cfg->idle)
+        {
+            struct loop_job *job = calloc(1, sizeof(*job));
+
+            if (job) { loop_rig_submit(lr, job); }
+        }
+    }
+}
+
+
+/* have the loop accept the clients of a listener for rig lr */
+static void loop_listen(struct loop *loop, struct loop_rig *lr, int sock,
+                        int priority)
+{
+    struct loop_listener *l = &loop->listeners[loop->n_listeners++];
+    struct epoll_event ev;
+
+    l->sock = sock;
+    l->priority = priority;
+    l->rig = lr;
+    loop_set_nonblock(sock);
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = l;
+
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, sock, &ev) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: epoll_ctl: %s\n", __func__, strerror(errno));
+    }
+}
+
+
+static struct loop_listener *loop_listener_find(struct loop *loop,
+        const void *ptr)
+{
+    int i;
+
+    for (i = 0; i < loop->n_listeners; i++)
+    {
+        if (ptr == &loop->listeners[i]) { return &loop->listeners[i]; }
+    }
+
+    return NULL;
+}
+
+
+int rigctld_loop(const struct rigctld_loop_cfg *cfg)
+{
+    struct epoll_event events[LOOP_MAX_EVENTS], ev;
+    struct loop loop;
+    struct loop_job *job;
+    int retcode = RIG_OK;
+    int i, prio;
+
+    memset(&loop, 0, sizeof(loop));
+    loop.cfg = cfg;
+    loop.n_rigs = cfg->n_rigs;
+    loop.rigs = calloc(cfg->n_rigs, sizeof(*loop.rigs));
+    loop.listeners = calloc(2 * cfg->n_rigs, sizeof(*loop.listeners));
+
+    if (!loop.rigs || !loop.listeners)
+    {
+        free(loop.rigs);
+        free(loop.listeners);
+        return -RIG_ENOMEM;
+    }
+
+    rig_powerstat = RIG_POWER_ON;
+
+    loop.epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (loop.epfd < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: epoll_create1: %s\n", __func__,
+                  strerror(errno));
+        free(loop.rigs);
+        free(loop.listeners);
+        return -RIG_EINTERNAL;
+    }
+
+    if (pipe(loop.wake_fd) < 0)
+    {
+        rig_debug(RIG_DEBUG_ERR, "%s: pipe: %s\n", __func__, strerror(errno));
+        close(loop.epfd);
+        free(loop.rigs);
+        free(loop.listeners);
+        return -RIG_EINTERNAL;
+    }
+
+    loop_set_nonblock(loop.wake_fd[0]);
+    loop_set_nonblock(loop.wake_fd[1]);
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = &loop_wake_tag;
+    epoll_ctl(loop.epfd, EPOLL_CTL_ADD, loop.wake_fd[0], &ev);
+
+    pthread_mutex_init(&loop.done_lock, NULL);
+
+    for (i = 0; i < loop.n_rigs; i++)
+    {
+        struct loop_rig *lr = &loop.rigs[i];
+
+        lr->rig = cfg->rigs[i].rig;
+        lr->index = i;
+        lr->loop = &loop;
+        lr->opened = cfg->rigs[i].rig_opened;
+        elapsed_ms(&lr->powerstat_check_time, HAMLIB_ELAPSED_SET);
+        pthread_mutex_init(&lr->lock, NULL);
+        pthread_cond_init(&lr->cond, NULL);
+
+        loop_listen(&loop, lr, cfg->rigs[i].sock_listen, RIGCTL_PRIO_READ);
+
+        if (cfg->rigs[i].sock_priority >= 0)
+        {
+            loop_listen(&loop, lr, cfg->rigs[i].sock_priority, RIGCTL_PRIO_PTT);
+        }
+    }
+
+    metrics_set_gauges(loop_gauges, &loop);
+
+    for (i = 0; i < loop.n_rigs && retcode == RIG_OK; i++)
+    {
+        struct loop_rig *lr = &loop.rigs[i];
+
+        if (pthread_create(&lr->thread, NULL, loop_rig_thread, lr) != 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: pthread_create: %s\n", __func__,
+                      strerror(errno));
+            retcode = -RIG_EINTERNAL;
+            break;
+        }
+
+        lr->thread_started = 1;
+
+        if (pthread_create(&lr->watch_thread, NULL, loop_watch_thread, lr) != 0)
+        {
+            rig_debug(RIG_DEBUG_ERR, "%s: pthread_create: %s\n", __func__,
+                      strerror(errno));
+            retcode = -RIG_EINTERNAL;
+            break;
+        }
+
+        lr->watch_started = 1;
+    }
+
+    rig_debug(RIG_DEBUG_TRACE, "%s: serving %d rig(s) from the event loop\n",
+              __func__, loop.n_rigs);
+
+    while (retcode == RIG_OK && !cfg->quit())
+    {
+        int n, timeout = 1000;
+
+        if (loop.push_at > 0)
+        {
+            double ms = (loop.push_at - monotonic_seconds()) * 1000;
+
+            timeout = ms < 0 ? 0 : ms < timeout ? (int) ms + 1 : timeout;
+        }
+
+        n = epoll_wait(loop.epfd, events, LOOP_MAX_EVENTS, timeout);
+
+        if (n < 0)
+        {
+            if (errno == EINTR) { continue; }
+
+            rig_debug(RIG_DEBUG_ERR, "%s: epoll_wait: %s\n", __func__, strerror(errno));
+            retcode = -RIG_EIO;
+            break;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            struct loop_client *c = events[i].data.ptr;
+            struct loop_listener *l;
+
+            if (events[i].data.ptr == &loop_wake_tag)
+            {
+                loop_collect(&loop);
+            }
+            else if ((l = loop_listener_find(&loop, events[i].data.ptr)) != NULL)
+            {
+                loop_accept(&loop, l);
+            }
+            else if (c->dead)
+            {
+                continue;
+            }
+            else if (c->eof && (events[i].events & (EPOLLHUP | EPOLLERR)))
+            {
+                // nobody left to answer to
+                loop_client_kill(&loop, c);
+            }
+            else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                loop_client_read(&loop, c);
+            }
+            else if (events[i].events & EPOLLOUT)
+            {
+                loop_client_update(&loop, c);
+            }
+        }
+
+        loop_push(&loop);
+        loop_reap(&loop);
+    }
+
+    HL_ATOMIC_STORE(&loop.watch_stop, 1);
+
+    for (i = 0; i < loop.n_rigs; i++)
+    {
+        struct loop_rig *lr = &loop.rigs[i];
+
+        if (lr->watch_started)
+        {
+            rig_cache_notify(lr->rig);
+            pthread_join(lr->watch_thread, NULL);
+        }
+
+        if (lr->thread_started)
+        {
+            pthread_mutex_lock(&lr->lock);
+            lr->stop = 1;
+            pthread_cond_signal(&lr->cond);
+            pthread_mutex_unlock(&lr->lock);
+            pthread_join(lr->thread, NULL);
+        }
+    }
+
+    while (loop.clients)
+    {
+        struct loop_client *c = loop.clients;
+
+        loop.clients = c->next;
+        close(c->sock);
+        rigctl_subscription_cleanup(&c->sub);
+        free(c->in);
+        free(c->out);
+        free(c);
+        metrics_clients(-1);
+    }
+
+    metrics_set_gauges(NULL, NULL);
+
+    for (i = 0; i < loop.n_rigs; i++)
+    {
+        struct loop_rig *lr = &loop.rigs[i];
+
+        for (prio = 0; prio < RIGCTL_PRIOS; prio++)
+        {
+            while ((job = lr->head[prio]) != NULL)
+            {
+                lr->head[prio] = job->next;
+                loop_job_free(job);
+            }
+        }
+
+        free(lr->last_set_reply);
+        pthread_cond_destroy(&lr->cond);
+        pthread_mutex_destroy(&lr->lock);
+    }
+
+    while ((job = loop.done) != NULL)
+    {
+        loop.done = job->next;
+        loop_job_free(job);
+    }
+
+    pthread_mutex_destroy(&loop.done_lock);
+    close(loop.wake_fd[0]);
+    close(loop.wake_fd[1]);
+    close(loop.epfd);
+    free(loop.rigs);
+    free(loop.listeners);
+
+    return retcode;
+}
+
+#else
+
+int rigctld_loop(const struct rigctld_loop_cfg *cfg)
+{
+    rig_debug(RIG_DEBUG_ERR, "%s: built without epoll support\n", __func__);
+    return -RIG_ENIMPL;
+}
+
+#endif  /* HAVE_SYS_EPOLL_H */
@@ -0,0 +1,52 @@
+/*
+ * rigctld_loop.h - (C) The Hamlib Group 2025
+ *
+ * Event loop mode of rigctld.
+ *
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License along
+ *   with this program; if not, write to the Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef RIGCTLD_LOOP_H
+#define RIGCTLD_LOOP_H
+
+#include "hamlib/rig.h"
+#include "rigctl_parse.h"
+
+/* a radio of the daemon and the listeners whose clients it serves */
+struct rigctld_loop_rig
+{
+    RIG *rig;
+    int sock_listen;        /* bound and listening */
+    int sock_priority;      /* listening for clients served first, or -1 */
+    int rig_opened;         /* rig_open() succeeded already */
+};
+
+struct rigctld_loop_cfg
+{
+    const struct rigctld_loop_rig *rigs;
+    int n_rigs;
+    int vfo_mode;           /* initial vfo mode of every client */
+    int use_password;
+    char resp_sep;          /* initial response separator of every client */
+    int idle;               /* close a rig when its last client leaves */
+    int (*quit)(void);      /* polled at least once a second */
+};
+
+int rigctld_loop(const struct rigctld_loop_cfg *cfg);
+
+#endif  /* RIGCTLD_LOOP_H */
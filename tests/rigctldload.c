@@ -0,0 +1,301 @@
+/*
+ * Hamlib rigctld load test
+ *
+ * Opens a number of connections to rigctld, and has every one of them
+ * send a command and wait for its reply as fast as it can.  Prints the
+ * requests per second of all of them together and the reply latency.
+ *
+ * Usage: rigctldload host:port clients seconds [command]
+ *
+ * The command is sent with the extended response protocol, so the reply
+ * of any command ends in a RPRT line.  Default is \get_freq.  The cache
+ * of rigctld is turned off while the clients run, so the load goes the
+ * whole way to the rig, and turned back on after.
+ * See rigctldload.sh to run it against the dummy rig.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+struct load_client
+{
+    int sock;
+    const char *cmd;
+    double *lat;        /* reply times in ms */
+    size_t n_lat, size_lat;
+    unsigned long errors;
+    pthread_t thread;
+};
+
+/* the clients start together once all are connected */
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int started;
+static volatile int running = 1;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int load_connect(const char *host, const char *port)
+{
+    struct addrinfo hints, *res, *rp;
+    int sock = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(host, port, &hints, &res) != 0)
+    {
+        return -1;
+    }
+
+    for (rp = res; rp; rp = rp->ai_next)
+    {
+        sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+
+        if (sock < 0) { continue; }
+
+        if (connect(sock, rp->ai_addr, rp->ai_addrlen) == 0) { break; }
+
+        close(sock);
+        sock = -1;
+    }
+
+    freeaddrinfo(res);
+    return sock;
+}
+
+/*
+ * read up to and including the RPRT line, 0 when it says RPRT 0, the
+ * number on the line before it goes to value if that is not NULL
+ */
+static int load_reply(int sock, long *value)
+{
+    char line[256];
+    size_t len = 0;
+
+    for (;;)
+    {
+        char c;
+        ssize_t n = recv(sock, &c, 1, 0);
+
+        if (n <= 0) { return -1; }
+
+        if (c != '\n')
+        {
+            if (len < sizeof(line) - 1) { line[len++] = c; }
+
+            continue;
+        }
+
+        line[len] = '\0';
+
+        if (strncmp(line, "RPRT ", 5) == 0)
+        {
+            return atoi(line + 5) == 0 ? 0 : 1;
+        }
+
+        if (value)
+        {
+            const char *p = strrchr(line, ':');
+
+            *value = atol(p ? p + 1 : line);
+        }
+
+        len = 0;
+    }
+}
+
+/* send a command and read its reply, see load_reply() */
+static int load_command(int sock, const char *cmd, long *value)
+{
+    size_t cmd_len = strlen(cmd);
+
+    if (send(sock, cmd, cmd_len, 0) != (ssize_t) cmd_len) { return -1; }
+
+    return load_reply(sock, value);
+}
+
+static void *load_thread(void *arg)
+{
+    struct load_client *lc = arg;
+    size_t cmd_len = strlen(lc->cmd);
+
+    pthread_mutex_lock(&start_lock);
+
+    while (!started) { pthread_cond_wait(&start_cond, &start_lock); }
+
+    pthread_mutex_unlock(&start_lock);
+
+    while (running)
+    {
+        double t0 = now_ms();
+        int ret;
+
+        if (send(lc->sock, lc->cmd, cmd_len, 0) != (ssize_t) cmd_len)
+        {
+            lc->errors++;
+            break;
+        }
+
+        ret = load_reply(lc->sock, NULL);
+
+        if (ret < 0)
+        {
+            lc->errors++;
+            break;
+        }
+
+        if (ret > 0) { lc->errors++; }
+
+        if (lc->n_lat == lc->size_lat)
+        {
+            size_t size = lc->size_lat ? lc->size_lat * 2 : 4096;
+            double *lat = realloc(lc->lat, size * sizeof(double));
+
+            if (!lat) { break; }
+
+            lc->lat = lat;
+            lc->size_lat = size;
+        }
+
+        lc->lat[lc->n_lat++] = now_ms() - t0;
+    }
+
+    return NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[])
+{
+    struct load_client *clients;
+    char host[256], cmd[256], *port;
+    int n_clients, seconds, i;
+    double *all, t0, elapsed;
+    size_t n_all = 0;
+    unsigned long errors = 0;
+    long cache_ms = 0;
+
+    if (argc < 4)
+    {
+        fprintf(stderr, "Usage: %s host:port clients seconds [command]\n", argv[0]);
+        return 1;
+    }
+
+    strncpy(host, argv[1], sizeof(host) - 1);
+    host[sizeof(host) - 1] = '\0';
+    port = strrchr(host, ':');
+
+    if (!port)
+    {
+        fprintf(stderr, "%s: no port in %s\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    *port++ = '\0';
+    n_clients = atoi(argv[2]);
+    seconds = atoi(argv[3]);
+    snprintf(cmd, sizeof(cmd), "+%s\n", argc > 4 ? argv[4] : "\\get_freq");
+
+    if (n_clients < 1 || seconds < 1)
+    {
+        fprintf(stderr, "%s: need at least one client and one second\n", argv[0]);
+        return 1;
+    }
+
+    clients = calloc(n_clients, sizeof(*clients));
+
+    if (!clients) { return 1; }
+
+    for (i = 0; i < n_clients; i++)
+    {
+        clients[i].sock = load_connect(host, port);
+        clients[i].cmd = cmd;
+
+        if (clients[i].sock < 0)
+        {
+            fprintf(stderr, "%s: connect #%d to %s:%s failed: %s\n", argv[0], i + 1,
+                    host, port, strerror(errno));
+            return 1;
+        }
+    }
+
+    for (i = 0; i < n_clients; i++)
+    {
+        pthread_create(&clients[i].thread, NULL, load_thread, &clients[i]);
+    }
+
+    if (load_command(clients[0].sock, "+\\get_cache\n", &cache_ms) != 0
+            || load_command(clients[0].sock, "+\\set_cache 0\n", NULL) != 0)
+    {
+        fprintf(stderr, "%s: cannot turn off the cache\n", argv[0]);
+        return 1;
+    }
+
+    pthread_mutex_lock(&start_lock);
+    started = 1;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&start_lock);
+
+    t0 = now_ms();
+    sleep(seconds);
+    running = 0;
+
+    for (i = 0; i < n_clients; i++)
+    {
+        pthread_join(clients[i].thread, NULL);
+        n_all += clients[i].n_lat;
+        errors += clients[i].errors;
+    }
+
+    elapsed = (now_ms() - t0) / 1000;
+
+    snprintf(cmd, sizeof(cmd), "+\\set_cache %ld\n", cache_ms);
+    load_command(clients[0].sock, cmd, NULL);
+
+    all = malloc((n_all ? n_all : 1) * sizeof(double));
+
+    if (!all) { return 1; }
+
+    n_all = 0;
+
+    for (i = 0; i < n_clients; i++)
+    {
+        memcpy(all + n_all, clients[i].lat, clients[i].n_lat * sizeof(double));
+        n_all += clients[i].n_lat;
+        close(clients[i].sock);
+        free(clients[i].lat);
+    }
+
+    qsort(all, n_all, sizeof(double), cmp_double);
+
+    printf("clients=%d requests=%lu errors=%lu req/s=%.0f p50=%.3fms p99=%.3fms max=%.3fms\n",
+           n_clients, (unsigned long) n_all, errors, n_all / elapsed,
+           n_all ? all[n_all / 2] : 0,
+           n_all ? all[(size_t)(n_all * 0.99)] : 0,
+           n_all ? all[n_all - 1] : 0);
+
+    free(all);
+    free(clients);
+
+    return errors != 0;
+}
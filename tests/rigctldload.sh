@@ -0,0 +1,31 @@
+#!/bin/sh
+
+# Requests/sec and reply latency of rigctld with the dummy rig, with 1, 16
+# and 256 clients, once with a thread per client and once with the event
+# loop (-E).  Run from the build tests directory.
+# PORT and LOAD_SECONDS may be set in the environment.
+
+port=${PORT:-4540}
+seconds=${LOAD_SECONDS:-5}
+
+for mode in threads -E; do
+    if [ $mode = "threads" ]; then
+        ./rigctld -m 1 -t $port &
+    else
+        ./rigctld -m 1 -t $port $mode &
+    fi
+
+    pid=$!
+    sleep 2
+
+    for clients in 1 16 256; do
+        printf "rigctld %-8s " $mode
+        ./rigctldload 127.0.0.1:$port $clients $seconds
+    done
+
+    kill $pid
+    wait $pid 2>/dev/null
+
+    # Use even port numbers for rigctld.
+    port=$((port + 2))
+done
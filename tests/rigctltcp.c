@@ -1127,7 +1127,7 @@ void *handle_socket(void *arg)
             retcode = rigctl_parse(handle_data_arg->rig, fsockin, fsockout, NULL, 0,
                                    mutex_rigctld,
                                    1, 0, &handle_data_arg->vfo_mode, send_cmd_term, &ext_resp, &resp_sep,
-                                   handle_data_arg->use_password);
+                                   handle_data_arg->use_password, NULL);
 #else
             memset(cmd, 0, sizeof(cmd));
             nbytes = -1;
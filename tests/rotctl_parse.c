@@ -82,6 +82,7 @@ extern int read_history();
 #endif
 
 #include "rotctl_parse.h"
+#include "metrics.h"
 #include "rotlist.h"
 #include "sprintflst.h"
 
@@ -201,6 +202,7 @@ declare_proto_rot(coord2qrb);
 declare_proto_rot(az_sp2az_lp);
 declare_proto_rot(dist_sp2dist_lp);
 declare_proto_rot(pause);
+declare_proto_rot(dump_metrics);
 
 /*
  * convention: upper case cmd is set, lowercase is get
@@ -239,6 +241,7 @@ struct test_table test_list[] =
     { 'A', "a_sp2a_lp",     ACTION(az_sp2az_lp),        ARG_IN1 | ARG_OUT1, "Short Path Deg", "Long Path Deg" },
     { 'a', "d_sp2d_lp",     ACTION(dist_sp2dist_lp),    ARG_IN1 | ARG_OUT1, "Short Path km", "Long Path km" },
     { 0x8c, "pause",        ACTION(pause),              ARG_IN, "Seconds" },
+    { 0xb1, "dump_metrics", ACTION(dump_metrics), ARG_OUT },
     { 0x00, "", NULL },
 
 };
@@ -527,6 +530,7 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, const char *argv[],
                  int interactive, int prompt, char send_cmd_term)
 {
     int retcode;            /* generic return code from functions */
+    double start;
     unsigned char cmd;
     struct test_table *cmd_entry = NULL;
     int ext_resp = 0;
@@ -1403,6 +1407,7 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, const char *argv[],
      * mutex locking needed because rotctld is multithreaded
      * and hamlib is not MT-safe
      */
+    start = metrics_now();
     pthread_mutex_lock(&rot_mutex);
 
     if (!prompt)
@@ -1457,6 +1462,8 @@ int rotctl_parse(ROT *my_rot, FILE *fin, FILE *fout, const char *argv[],
 
     pthread_mutex_unlock(&rot_mutex);
 
+    metrics_command((unsigned char) cmd_entry->cmd, start, retcode);
+
     if (retcode == -RIG_EIO) { return retcode; }
 
     if (retcode != RIG_OK)
@@ -2428,6 +2435,31 @@ declare_proto_rot(dump_conf)
     RETURNFUNC2(RIG_OK);
 }
 
+static const char *rotctl_cmd_name(int cmd)
+{
+    const struct test_table *cmd_entry = find_cmd_entry(cmd);
+
+    return cmd_entry ? cmd_entry->name : NULL;
+}
+
+/*
+ * '\dump_metrics' counts and latencies of the commands run so far and
+ * the traffic of the rotator port, in the Prometheus text format
+ */
+declare_proto_rot(dump_metrics)
+{
+    char buf[256];
+
+    metrics_dump(fout, rotctl_cmd_name);
+
+    port_get_stats(HAMLIB_ROTPORT(rot), buf, sizeof(buf));
+    metrics_text(fout, "port", NULL, buf);
+
+    fprintf(fout, "# EOF\n");
+
+    return RIG_OK;
+}
+
 /* For rotctld internal use
  * '0x8f'
  */
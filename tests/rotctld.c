@@ -57,6 +57,7 @@
 
 #include "rig.h"
 #include "rotctl_parse.h"
+#include "metrics.h"
 #include "rotlist.h"
 
 struct handle_data
@@ -614,6 +615,8 @@ void *handle_socket(void *arg)
     char host[NI_MAXHOST];
     char serv[NI_MAXSERV];
 
+    metrics_clients(1);
+
 #ifdef __MINGW32__
     int sock_osfhandle = _open_osfhandle(handle_data_arg->sock, _O_RDONLY);
 
@@ -696,6 +699,7 @@ handle_exit:
 #else
     close(handle_data_arg->sock);
 #endif
+    metrics_clients(-1);
     free(arg);
 
     pthread_exit(NULL);
@@ -0,0 +1,225 @@
+/*
+ * Hamlib testasync program
+ *
+ * Feeds the async frame parsers of the Kenwood and newcat backends with
+ * replies and reports, without a rig: which frames are taken for the
+ * reply of the running transaction, and what a report does to the cache
+ * and the callbacks.  The parsers need no port, the rig only has to look open to
+ * the cache and the event functions.
+ *
+ * Usage: testasync
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hamlib/rig.h"
+#include "hamlib/riglist.h"
+
+/* not in the public headers, see rigs/kenwood/kenwood.h */
+extern void kenwood_set_async_wait(RIG *rig, const char *reply);
+extern int kenwood_is_async_frame(RIG *rig, size_t frame_length,
+                                  const unsigned char *frame);
+extern int kenwood_process_async_frame(RIG *rig, size_t frame_length,
+                                       const unsigned char *frame);
+/* see rigs/yaesu/newcat.h */
+extern void newcat_set_async_wait(RIG *rig, const char *reply);
+extern int newcat_is_async_frame(RIG *rig, size_t frame_length,
+                                 const unsigned char *frame);
+extern int newcat_process_async_frame(RIG *rig, size_t frame_length,
+                                      const unsigned char *frame);
+
+struct frame_case
+{
+    const char *wait;   /* what the transaction waits for */
+    const char *frame;
+    int async;          /* a report, not the reply */
+};
+
+static vfo_t last_vfo;
+
+static int vfo_event(RIG *rig, vfo_t vfo, rig_ptr_t arg)
+{
+    last_vfo = vfo;
+    return 0;
+}
+
+/* a reply is a frame starting with the whole command waiting for it */
+static int kenwood_frames(RIG *rig)
+{
+    static const struct frame_case cases[] =
+    {
+        { "FA;", "FA00014074000;", 0 },
+        { "FA;", "FB00007074000;", 1 },
+        { "ZZFA;", "ZZFA00014074000;", 0 },
+        { "ZZFA;", "ZZFB00007074000;", 1 },
+        { "ZZFA;", "ZZMD01;", 1 },
+        { "RM1;", "RM10005;", 0 },
+        { "RM1;", "RM20000;", 1 },
+        { "*", "FB00007074000;", 0 },
+        { "", "FA00014074000;", 1 },
+        { "FA;", "?;", 0 },
+    };
+    int i, failed = 0;
+
+    for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++)
+    {
+        int async;
+
+        kenwood_set_async_wait(rig, cases[i].wait);
+        async = kenwood_is_async_frame(rig, strlen(cases[i].frame),
+                                       (const unsigned char *) cases[i].frame);
+
+        if (async != cases[i].async)
+        {
+            printf("kenwood: waiting for %s, %s taken as %s\n", cases[i].wait,
+                   cases[i].frame, async ? "report" : "reply");
+            failed = 1;
+        }
+    }
+
+    kenwood_set_async_wait(rig, "");
+
+    return failed;
+}
+
+/* IF while transmitting split shows the TX VFO, A stays the receive VFO */
+static int kenwood_if_split(RIG *rig)
+{
+    char frame[64];
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    int ms_f, ms_m, ms_w;
+
+    rig_set_vfo_callback(rig, vfo_event, NULL);
+    last_vfo = RIG_VFO_NONE;
+
+    /* freq, step, RIT offset, RIT and XIT, memory, TX, USB, VFO B, scan,
+     * split, tone */
+    snprintf(frame, sizeof(frame), "IF%011d" "0000" "+00000" "00" "000"
+             "1" "2" "1" "0" "1" "0000;", 14080000);
+
+    kenwood_process_async_frame(rig, strlen(frame), (unsigned char *) frame);
+
+    rig_get_cache(rig, RIG_VFO_B, &freq, &ms_f, &mode, &ms_m, &width, &ms_w);
+    printf("kenwood IF split TX: VFO B %.0f %s, receive VFO %s\n", freq,
+           rig_strrmode(mode), rig_strvfo(last_vfo));
+
+    rig_set_vfo_callback(rig, NULL, NULL);
+
+    return freq != 14080000 || mode != RIG_MODE_USB || last_vfo != RIG_VFO_A;
+}
+
+/* a reply starts with the whole query, selector digit included */
+static int newcat_frames(RIG *rig)
+{
+    static const struct frame_case cases[] =
+    {
+        { "FA;", "FA014074000;", 0 },
+        { "FA;", "FB007074000;", 1 },
+        { "MD0;", "MD02;", 0 },
+        { "MD0;", "MD12;", 1 },
+        { "AG0;", "AG0128;", 0 },
+        { "SM0;", "SM1100;", 1 },
+        { "EX030101;", "EX0301011;", 0 },
+        { "EX030101;", "EX0301021;", 1 },
+        { "", "FA014074000;", 1 },
+        { "MD0;", "?;", 0 },
+    };
+    int i, failed = 0;
+
+    for (i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++)
+    {
+        int async;
+
+        newcat_set_async_wait(rig, cases[i].wait);
+        async = newcat_is_async_frame(rig, strlen(cases[i].frame),
+                                      (const unsigned char *) cases[i].frame);
+
+        if (async != cases[i].async)
+        {
+            printf("newcat: waiting for %s, %s taken as %s\n", cases[i].wait,
+                   cases[i].frame, async ? "report" : "reply");
+            failed = 1;
+        }
+    }
+
+    /* one reply per query, a second matching frame is a report */
+    newcat_set_async_wait(rig, "FA;");
+    newcat_is_async_frame(rig, 12, (const unsigned char *) "FA014074000;");
+
+    if (!newcat_is_async_frame(rig, 12, (const unsigned char *) "FA014074100;"))
+    {
+        printf("newcat: second FA taken as reply\n");
+        failed = 1;
+    }
+
+    newcat_set_async_wait(rig, "");
+
+    return failed;
+}
+
+/* an MD1 report changes the mode of VFO B only */
+static int newcat_md_report(RIG *rig)
+{
+    rmode_t mode_a, mode_b;
+    freq_t freq;
+    pbwidth_t width;
+    int ms_f, ms_m, ms_w;
+
+    newcat_process_async_frame(rig, 5, (const unsigned char *) "MD02;");
+    newcat_process_async_frame(rig, 5, (const unsigned char *) "MD13;");
+
+    rig_get_cache(rig, RIG_VFO_A, &freq, &ms_f, &mode_a, &ms_m, &width, &ms_w);
+    rig_get_cache(rig, RIG_VFO_B, &freq, &ms_f, &mode_b, &ms_m, &width, &ms_w);
+    printf("newcat MD reports: VFO A %s, VFO B %s\n", rig_strrmode(mode_a),
+           rig_strrmode(mode_b));
+
+    return mode_a != RIG_MODE_USB || mode_b != RIG_MODE_CW;
+}
+
+int main(int argc, char *argv[])
+{
+    RIG *rig;
+    int failed = 0;
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    rig = rig_init(RIG_MODEL_TS590S);
+
+    if (rig == NULL)
+    {
+        printf("rig_init failed\n");
+        return 1;
+    }
+
+    STATE(rig)->comm_state = 1;
+
+    failed |= kenwood_frames(rig);
+    failed |= kenwood_if_split(rig);
+
+    STATE(rig)->comm_state = 0;
+    rig_cleanup(rig);
+
+    rig = rig_init(RIG_MODEL_FT991);
+
+    if (rig == NULL)
+    {
+        printf("rig_init failed\n");
+        return 1;
+    }
+
+    STATE(rig)->comm_state = 1;
+
+    failed |= newcat_frames(rig);
+    failed |= newcat_md_report(rig);
+
+    STATE(rig)->comm_state = 0;
+    rig_cleanup(rig);
+
+    printf("%s\n", failed ? "FAILED" : "OK");
+
+    return failed;
+}
@@ -10,10 +10,328 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
 #include "hamlib/rig.h"
 #include "hamlib/riglist.h"
 //#include "misc.h"
 
+/* not in the public headers, see src/cache.h */
+extern int rig_set_cache_mode(RIG *rig, vfo_t vfo, rmode_t mode,
+                              pbwidth_t width);
+extern int rig_set_cache_freq(RIG *rig, vfo_t vfo, freq_t freq);
+extern unsigned int rig_cache_generation(RIG *rig);
+extern int rig_cache_wait(RIG *rig, unsigned int *generation, int timeout_ms);
+extern unsigned int rig_cache_settings_epoch(RIG *rig);
+extern void rig_set_cache_setting(RIG *rig, int kind, vfo_t vfo,
+                                  setting_t setting, value_t val,
+                                  unsigned int epoch);
+extern void rig_set_cache_status(RIG *rig,
+                                 const struct rig_status_bulk *status);
+extern int rig_cache_stale(RIG *rig);
+/* see src/event.h */
+extern int rig_fire_mode_event(RIG *rig, vfo_t vfo, rmode_t mode,
+                               pbwidth_t width);
+
+static volatile int writer_done;
+
+/* flip VFOA between two mode/width pairs as fast as possible */
+static void *cache_writer(void *arg)
+{
+    RIG *rig = arg;
+    int i;
+
+    for (i = 0; i < 200000; i++)
+    {
+        if (i & 1)
+        {
+            rig_set_cache_mode(rig, RIG_VFO_A, RIG_MODE_USB, 1000);
+        }
+        else
+        {
+            rig_set_cache_mode(rig, RIG_VFO_A, RIG_MODE_LSB, 2000);
+        }
+    }
+
+    writer_done = 1;
+    return NULL;
+}
+
+/* readers must never see the mode of one update with the width of another */
+static int cache_consistency(RIG *rig)
+{
+    pthread_t writer;
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    int freq_ms, mode_ms, width_ms;
+    int reads = 0, torn = 0;
+
+    rig_set_debug(RIG_DEBUG_NONE);
+    rig_set_cache_mode(rig, RIG_VFO_A, RIG_MODE_LSB, 2000);
+    writer_done = 0;
+
+    if (pthread_create(&writer, NULL, cache_writer, rig) != 0)
+    {
+        printf("pthread_create failed\n");
+        return 1;
+    }
+
+    while (!writer_done)
+    {
+        rig_get_cache(rig, RIG_VFO_A, &freq, &freq_ms, &mode, &mode_ms, &width,
+                      &width_ms);
+        reads++;
+
+        if (!(mode == RIG_MODE_USB && width == 1000)
+                && !(mode == RIG_MODE_LSB && width == 2000))
+        {
+            torn++;
+        }
+    }
+
+    pthread_join(writer, NULL);
+    rig_set_debug(RIG_DEBUG_CACHE);
+    printf("cache consistency: %d reads, %d torn\n", reads, torn);
+
+    return torn != 0;
+}
+
+
+/* a freq cached for the other VFO is read back through either name */
+static int cache_other(RIG *rig)
+{
+    freq_t freq_other, freq_b;
+    rmode_t mode;
+    pbwidth_t width;
+    int freq_ms, mode_ms, width_ms;
+
+    rig_set_cache_freq(rig, RIG_VFO_OTHER, 7074000);
+    rig_get_cache(rig, RIG_VFO_OTHER, &freq_other, &freq_ms, &mode, &mode_ms,
+                  &width, &width_ms);
+    rig_get_cache(rig, RIG_VFO_B, &freq_b, &freq_ms, &mode, &mode_ms, &width,
+                  &width_ms);
+    printf("cache other: other=%.0f B=%.0f\n", freq_other, freq_b);
+
+    return freq_other != 7074000 || freq_b != 7074000;
+}
+
+
+static void *cache_notifier(void *arg)
+{
+    RIG *rig = arg;
+
+    hl_usleep(100 * 1000);
+    rig_set_cache_freq(rig, RIG_VFO_B, 14074000);
+    return NULL;
+}
+
+/* a waiter wakes up on an update, not on its timeout, and times out idle */
+static int cache_wait(RIG *rig)
+{
+    pthread_t notifier;
+    struct timespec start, end;
+    unsigned int generation = rig_cache_generation(rig);
+    int changed;
+    double ms;
+
+    if (rig_cache_wait(rig, &generation, 50))
+    {
+        printf("cache wait: woke up without an update\n");
+        return 1;
+    }
+
+    if (pthread_create(&notifier, NULL, cache_notifier, rig) != 0)
+    {
+        printf("pthread_create failed\n");
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    changed = rig_cache_wait(rig, &generation, 5000);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_join(notifier, NULL);
+
+    ms = (end.tv_sec - start.tv_sec) * 1000.0
+         + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("cache wait: changed=%d after %.0fms\n", changed, ms);
+
+    return !changed || ms > 2000;
+}
+
+/* a second get within the level timeout is a hit, a set forgets the level */
+static int settings_cache(RIG *rig)
+{
+    hamlib_token_t stats_tok = rig_token_lookup(rig, "cache_stats");
+    char stats[256];
+    value_t val;
+    unsigned int epoch;
+
+    rig_set_conf(rig, rig_token_lookup(rig, "cache_timeout_level"), "1000");
+    rig_set_conf(rig, stats_tok, "");
+
+    val.f = 0.25;
+    rig_set_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, val);
+    rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, &val);
+    rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, &val);
+
+    if (val.f != 0.25f) { printf("AF = %g\n", val.f); return 1; }
+
+    val.f = 0.5;
+    rig_set_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, val);
+    rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, &val);
+
+    if (val.f != 0.5f) { printf("AF after set = %g\n", val.f); return 1; }
+
+    rig_get_conf2(rig, stats_tok, stats, sizeof(stats));
+    printf("cache stats: %s\n", stats);
+
+    if (strncmp(stats, "level hits=1 misses=2 ", 22) != 0) { return 1; }
+
+    // a get that read the rig before a set must not cache what it read
+    epoch = rig_cache_settings_epoch(rig);
+    val.f = 0.75;
+    rig_set_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, val);
+    val.f = 0.5;
+    rig_set_cache_setting(rig, 0 /* CACHE_KIND_LEVEL */, RIG_VFO_CURR,
+                          RIG_LEVEL_AF, val, epoch);
+    rig_get_level(rig, RIG_VFO_CURR, RIG_LEVEL_AF, &val);
+    printf("AF after racing get = %g\n", val.f);
+
+    return val.f != 0.75f;
+}
+
+/* once a get_status_bulk told freq and mode only, PTT and split are not
+ * counted as stale, a refresh would not bring them up to date */
+static int status_fields(RIG *rig)
+{
+    struct rig_status_bulk status;
+    int before, after;
+
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_ALL, 20);
+    hl_usleep(50 * 1000);
+    before = rig_cache_stale(rig);
+
+    memset(&status, 0, sizeof(status));
+    status.vfo = RIG_VFO_A;
+    status.valid = RIG_STATUS_FREQ | RIG_STATUS_MODE;
+    status.freq = 14074000;
+    status.mode = RIG_MODE_USB;
+    rig_set_cache_status(rig, &status);
+
+    hl_usleep(50 * 1000);
+    after = rig_cache_stale(rig);
+    rig_set_cache_timeout_ms(rig, HAMLIB_CACHE_ALL, 0);
+
+    printf("stale items: %d before a freq and mode bulk, %d after\n", before,
+           after);
+
+    return before != 4 || after != 2;
+}
+
+static pthread_mutex_t event_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t event_cond = PTHREAD_COND_INITIALIZER;
+static int event_entered, event_released, event_calls;
+
+/* a callback that blocks until the test lets it go */
+static int held_mode_event(RIG *rig, vfo_t vfo, rmode_t mode, pbwidth_t width,
+                           rig_ptr_t arg)
+{
+    pthread_mutex_lock(&event_lock);
+    event_entered = 1;
+    pthread_cond_broadcast(&event_cond);
+
+    while (!event_released) { pthread_cond_wait(&event_cond, &event_lock); }
+
+    event_calls++;
+    pthread_mutex_unlock(&event_lock);
+    return 0;
+}
+
+/* a blocked callback does not hold up the thread firing the events */
+static int event_dispatch(RIG *rig)
+{
+    hamlib_token_t stats_tok = rig_token_lookup(rig, "event_stats");
+    hamlib_token_t queue_tok = rig_token_lookup(rig, "event_queue");
+    char stats[256];
+    unsigned long queued, coalesced, dropped;
+    int i, calls;
+
+    rig_close(rig);
+    rig_set_conf(rig, queue_tok, "8");
+
+    if (rig_open(rig) != RIG_OK) { return 1; }
+
+    rig_set_conf(rig, stats_tok, "");
+    rig_set_mode_callback(rig, held_mode_event, NULL);
+
+    // the dispatch thread takes the first event and blocks in the callback
+    rig_fire_mode_event(rig, RIG_VFO_A, RIG_MODE_LSB, 2400);
+
+    pthread_mutex_lock(&event_lock);
+
+    while (!event_entered) { pthread_cond_wait(&event_cond, &event_lock); }
+
+    pthread_mutex_unlock(&event_lock);
+
+    for (i = 1; i < 200; i++)
+    {
+        rig_fire_mode_event(rig, i & 1 ? RIG_VFO_B : RIG_VFO_A,
+                            i & 2 ? RIG_MODE_USB : RIG_MODE_LSB, 2400);
+    }
+
+    pthread_mutex_lock(&event_lock);
+    calls = event_calls;
+    event_released = 1;
+    pthread_cond_broadcast(&event_cond);
+    pthread_mutex_unlock(&event_lock);
+
+    rig_get_conf2(rig, stats_tok, stats, sizeof(stats));
+    printf("event dispatch: 200 events fired, %d delivered meanwhile, %s\n",
+           calls, stats);
+
+    rig_set_mode_callback(rig, NULL, NULL);
+    rig_set_conf(rig, queue_tok, "0");
+
+    if (sscanf(stats, "freq queued=%*u coalesced=%*u dropped=%*u "
+               "mode queued=%lu coalesced=%lu dropped=%lu",
+               &queued, &coalesced, &dropped) != 3)
+    {
+        return 1;
+    }
+
+    // a full queue of A and B mode events only ever coalesces
+    return calls != 0 || queued != 200 || coalesced == 0 || dropped != 0;
+}
+
+/* with poll_refresh the poll routine keeps the cache fresh by itself */
+static int poll_refresh(RIG *rig)
+{
+    hamlib_token_t stats_tok = rig_token_lookup(rig, "poll_stats");
+    char stats[256];
+    unsigned long reads;
+    freq_t freq;
+    rmode_t mode;
+    pbwidth_t width;
+    int freq_ms, mode_ms, width_ms;
+
+    rig_close(rig);
+    rig_set_conf(rig, rig_token_lookup(rig, "poll_refresh"), "1");
+    rig_set_conf(rig, rig_token_lookup(rig, "poll_interval"), "50");
+
+    if (rig_open(rig) != RIG_OK) { return 1; }
+
+    hl_usleep(500 * 1000);
+
+    rig_get_conf2(rig, stats_tok, stats, sizeof(stats));
+    rig_get_cache(rig, RIG_VFO_A, &freq, &freq_ms, &mode, &mode_ms, &width,
+                  &width_ms);
+    printf("poll refresh: %s, freq age %dms\n", stats, freq_ms);
+
+    if (sscanf(stats, "reads=%lu", &reads) != 1) { return 1; }
+
+    return reads < 5 || freq_ms > 250;
+}
 
 int main(int argc, char *argv[])
 {
@@ -175,6 +493,20 @@ int main(int argc, char *argv[])
 
     if (split != RIG_SPLIT_ON || (tx_vfo != RIG_VFO_B && tx_vfo != RIG_VFO_SUB)) { printf("split#2 failed\n"); exit(1); }
 
+    if (cache_consistency(my_rig)) { printf("cache consistency failed\n"); exit(1); }
+
+    if (settings_cache(my_rig)) { printf("settings cache failed\n"); exit(1); }
+
+    if (cache_other(my_rig)) { printf("cache other failed\n"); exit(1); }
+
+    if (cache_wait(my_rig)) { printf("cache wait failed\n"); exit(1); }
+
+    if (status_fields(my_rig)) { printf("status fields failed\n"); exit(1); }
+
+    if (event_dispatch(my_rig)) { printf("event dispatch failed\n"); exit(1); }
+
+    if (poll_refresh(my_rig)) { printf("poll refresh failed\n"); exit(1); }
+
     printf("All OK\n");
     rig_close(my_rig);
     return 0 ;
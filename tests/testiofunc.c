@@ -0,0 +1,1083 @@
+/*
+ * Hamlib testiofunc program
+ *
+ * Exercises the port I/O layer (write_block/read_string/read_block) over a
+ * pseudo-terminal pair, with a responder thread playing the rig on the
+ * master side.  Checks that buffered replies are split on the stopset and
+ * carried over between calls, that post_write_delay keeps commands
+ * apart on the wire in both the sleeping and the deferred mode and that
+ * the write queue keeps write_delay pacing, order, abort and urgent
+ * semantics, then runs a small benchmark reporting read syscalls and
+ * latency per reply.  A session is then captured to a file and played
+ * back through a RIG_PORT_REPLAY port at several speeds, reporting the
+ * CPU time per replayed transaction.  With adaptive_timeout a lost reply
+ * must time out after a few reply times, while a command not seen before
+ * still waits the configured timeout.  The last part opens 32 ports in asyncio mode, as
+ * with 32 rigs in one process, checks the channel the async data handler
+ * feeds and measures how fast a frame handed over with write_block_sync()
+ * wakes the transaction waiting for it.
+ *
+ * Usage: testiofunc [-b|-w|-W] [count] [chunk]
+ *    -b      benchmark only, skip the functional checks
+ *    -w      wakeup benchmark only, count frames per rig
+ *    -W      same with all rig fds above FD_SETSIZE, as in a process
+ *            that already has many sockets open
+ *    count   number of benchmark transactions (default 2000)
+ *    chunk   bytes per responder write for the reply (default 4)
+ *
+ * Linux only for the syscall counter (/proc/thread-self/io), the rest
+ * works on any system with posix_openpt().
+ */
+
+#include "hamlib/config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <termios.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "hamlib/rig.h"
+#include "iofunc.h"
+#include "misc.h"
+
+#define REPLY "FA00014074000;"
+#define MAX_ARRIVALS 16
+#define WAKEUP_RIGS 32
+
+static int master_fd = -1;
+static int chunk_size = 4;
+static volatile int responder_run = 1;
+static pthread_t responder_thread;
+
+/* when each command was seen by the responder, in ms, and what it was */
+static double arrivals[MAX_ARRIVALS];
+static char commands[MAX_ARRIVALS][32];
+static volatile int n_arrivals;
+/* >= 0: echo each command like a CI-V bus and reply this many ms later */
+static volatile int echo_ms = -1;
+
+static double now_ms(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void put_master(const char *s, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(master_fd, s, len);
+
+        if (n <= 0)
+        {
+            if (errno == EINTR || errno == EAGAIN) { continue; }
+
+            return;
+        }
+
+        s += n;
+        len -= n;
+    }
+}
+
+/* answer every ';' terminated command with REPLY, chunk_size bytes at a time */
+static void *responder(void *arg)
+{
+    char buf[256];
+    char cmd[32];
+    size_t cmdlen = 0;
+
+    (void)arg;
+
+    while (responder_run)
+    {
+        ssize_t i, n = read(master_fd, buf, sizeof(buf));
+
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR) { continue; }
+
+            break;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (cmdlen < sizeof(cmd) - 1)
+            {
+                cmd[cmdlen++] = buf[i];
+            }
+
+            if (buf[i] == ';')
+            {
+                size_t off;
+
+                if (n_arrivals < MAX_ARRIVALS)
+                {
+                    cmd[cmdlen] = '\0';
+                    strcpy(commands[n_arrivals], cmd);
+                    arrivals[n_arrivals++] = now_ms();
+                }
+
+                if (echo_ms >= 0)
+                {
+                    put_master(cmd, cmdlen);
+                    hl_usleep(echo_ms * 1000);
+                }
+
+                cmdlen = 0;
+
+                for (off = 0; off < strlen(REPLY); off += chunk_size)
+                {
+                    size_t len = strlen(REPLY) - off;
+
+                    put_master(REPLY + off, len < chunk_size ? len : chunk_size);
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int start_responder(void)
+{
+    responder_run = 1;
+    return pthread_create(&responder_thread, NULL, responder, NULL);
+}
+
+static void stop_responder(void)
+{
+    responder_run = 0;
+    pthread_cancel(responder_thread);
+    pthread_join(responder_thread, NULL);
+}
+
+static long read_syscalls(void)
+{
+    char line[128];
+    long syscr = -1;
+    FILE *fp = fopen("/proc/thread-self/io", "r");
+
+    if (fp == NULL)
+    {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "syscr: %ld", &syscr) == 1) { break; }
+    }
+
+    fclose(fp);
+    return syscr;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int check(int cond, const char *what)
+{
+    printf("%-50s %s\n", what, cond ? "OK" : "FAILED");
+    return cond ? 0 : 1;
+}
+
+static int functional_tests(hamlib_port_t *port)
+{
+    unsigned char buf[64];
+    int errors = 0;
+    int n;
+
+    /* two replies in a single write must come out one at a time */
+    put_master("FA00014074000;MD2;", 18);
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == 14 && strcmp((char *)buf, "FA00014074000;") == 0,
+                    "first reply of two split on stopset");
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == 4 && strcmp((char *)buf, "MD2;") == 0,
+                    "second reply carried over");
+
+    /* a reply arriving in pieces is reassembled */
+    put_master("IF0001", 6);
+    hl_usleep(20 * 1000);
+    put_master("4074000;", 8);
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == 14 && strcmp((char *)buf, "IF00014074000;") == 0,
+                    "reply split across writes reassembled");
+
+    /* leftover bytes are served to read_block too */
+    put_master("ID;\xfe\xfe\x94\xe0", 7);
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == 3, "string before binary block");
+    n = read_block(port, buf, 4);
+    errors += check(n == 4 && memcmp(buf, "\xfe\xfe\x94\xe0", 4) == 0,
+                    "read_block takes carried over bytes");
+
+    /* several stop characters, the first one seen wins */
+    put_master("AB\rCD\n", 6);
+    n = read_string(port, buf, sizeof(buf), "\n\r", 2, 0, 1);
+    errors += check(n == 3 && strcmp((char *)buf, "AB\r") == 0,
+                    "multi-character stopset");
+    n = read_string(port, buf, sizeof(buf), "\n\r", 2, 0, 1);
+    errors += check(n == 3 && strcmp((char *)buf, "CD\n") == 0,
+                    "multi-character stopset carry over");
+
+    /* rxmax limits a reply without losing the rest */
+    put_master("0123456789;", 11);
+    n = read_string(port, buf, 5, ";", 1, 0, 1);
+    errors += check(n == 4 && strcmp((char *)buf, "0123") == 0,
+                    "rxmax honoured");
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == 7 && strcmp((char *)buf, "456789;") == 0,
+                    "rest of truncated reply kept");
+
+    /* whole-string terminator used by the FLRig backend */
+    put_master("<a>1</a></methodResponse><b>", 28);
+    n = read_string(port, buf, sizeof(buf), "</methodResponse>", 17, 0, 1);
+    errors += check(n == 25, "string terminator");
+    put_master("</methodResponse>", 17);
+    n = read_string(port, buf, sizeof(buf), "</methodResponse>", 17, 0, 1);
+    errors += check(n == 20 && strncmp((char *)buf, "<b>", 3) == 0,
+                    "string terminator carry over");
+
+    /* flush drops whatever is buffered */
+    put_master("FA1;FA2;", 8);
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    rig_flush(port);
+    errors += check(n == 4 && port_rx_pending(port) == 0,
+                    "rig_flush discards buffered bytes");
+
+    /* and with nothing to read we time out */
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == -RIG_ETIMEOUT, "timeout with empty buffer");
+
+    return errors;
+}
+
+/*
+ * Run n FA; transactions with idle_ms of caller work between them.
+ * Returns the smallest gap between commands as seen on the wire and
+ * the average time spent inside write_block().
+ */
+static int paced_transactions(hamlib_port_t *port, int n, int idle_ms,
+                              double *min_gap, double *avg_block)
+{
+    unsigned char buf[64];
+    double blocked = 0;
+    int i;
+
+    n_arrivals = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        double t0 = now_ms();
+
+        write_block(port, (const unsigned char *)"FA;", 3);
+        blocked += now_ms() - t0;
+
+        if (read_string(port, buf, sizeof(buf), ";", 1, 0, 1) != strlen(REPLY))
+        {
+            return 1;
+        }
+
+        if (idle_ms > 0) { hl_usleep(idle_ms * 1000); }
+    }
+
+    *min_gap = 1e9;
+
+    for (i = 1; i < n_arrivals; i++)
+    {
+        if (arrivals[i] - arrivals[i - 1] < *min_gap)
+        {
+            *min_gap = arrivals[i] - arrivals[i - 1];
+        }
+    }
+
+    *avg_block = blocked / n;
+    return n_arrivals == n ? 0 : 1;
+}
+
+static int post_write_tests(hamlib_port_t *port)
+{
+    const int delay = 30;
+    double gap_sleep, gap_deferred, gap_idle;
+    double block_sleep, block_deferred, block_idle;
+    int errors = 0;
+
+    if (start_responder() != 0)
+    {
+        return 1;
+    }
+
+    port->post_write_delay = delay;
+
+    port_set_post_write_deferred(port, 0);
+    errors += paced_transactions(port, 6, 0, &gap_sleep, &block_sleep);
+
+    port_set_post_write_deferred(port, 1);
+    errors += paced_transactions(port, 6, 0, &gap_deferred, &block_deferred);
+    hl_usleep(delay * 1000);
+    errors += paced_transactions(port, 6, delay, &gap_idle, &block_idle);
+
+    port_set_post_write_deferred(port, 0);
+    port->post_write_delay = 0;
+
+    stop_responder();
+
+    printf("post_write_delay %dms: min gap on wire / blocked per write\n", delay);
+    printf("  sleep after write:         %6.1fms / %6.1fms\n", gap_sleep,
+           block_sleep);
+    printf("  deferred, busy caller:     %6.1fms / %6.1fms\n", gap_deferred,
+           block_deferred);
+    printf("  deferred, caller works %dms: %4.1fms / %6.1fms\n", delay, gap_idle,
+           block_idle);
+
+    /* allow a little scheduling slack on the gaps */
+    errors += check(errors == 0, "paced transactions completed");
+    errors += check(gap_sleep >= delay - 2, "sleeping mode keeps the gap");
+    errors += check(gap_deferred >= delay - 2, "deferred mode keeps the gap");
+    errors += check(gap_idle >= delay - 2, "deferred mode with idle caller keeps the gap");
+    errors += check(block_sleep >= delay - 2, "sleeping mode blocks in write_block");
+    errors += check(block_idle < delay / 4.0,
+                    "deferred mode does not block an idle caller");
+
+    return errors;
+}
+
+static int write_queue_tests(hamlib_port_t *port)
+{
+    const char *cmd = "FA00014074000000000;";
+    const size_t len = strlen(cmd);
+    const int delay = 5;
+    unsigned char buf[64];
+    double t0, block_direct, block_queued, wire_queued;
+    int timeout = port->timeout;
+    int errors = 0;
+    int n;
+
+    if (start_responder() != 0)
+    {
+        return 1;
+    }
+
+    port->write_delay = delay;
+
+    /* the caller pays for every byte */
+    t0 = now_ms();
+    write_block(port, (const unsigned char *)cmd, len);
+    block_direct = now_ms() - t0;
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == strlen(REPLY), "paced write without queue");
+
+    /*
+     * with the queue it only pays for the copy, and the reply wait
+     * covers the time still needed to send the command
+     */
+    port_set_write_queue(port, 1);
+    port->timeout = 3 * delay;
+    n_arrivals = 0;
+    t0 = now_ms();
+    write_block(port, (const unsigned char *)cmd, len);
+    block_queued = now_ms() - t0;
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    wire_queued = n_arrivals == 1 ? arrivals[0] - t0 : 0;
+    port->timeout = timeout;
+    errors += check(n == strlen(REPLY) && n_arrivals == 1
+                    && strcmp(commands[0], cmd) == 0,
+                    "queued write answered");
+    errors += check(wire_queued >= (len - 1) * delay, "queued write keeps byte pacing");
+    errors += check(block_queued < delay, "queued write does not block");
+
+    /* abort drops what has not started, the command on the wire completes */
+    n_arrivals = 0;
+    write_block(port, (const unsigned char *)cmd, len);
+    write_block(port, (const unsigned char *)"FB1;", 4);
+    write_block(port, (const unsigned char *)"FB2;", 4);
+    hl_usleep(delay * 1000);
+    n = port_tx_abort(port, PORT_TX_ANY);
+    errors += check(n == 8 && port_tx_pending(port) == 0
+                    && n_arrivals == 1 && strcmp(commands[0], cmd) == 0,
+                    "abort keeps the command on the wire");
+
+    /* aborting CW leaves the other commands queued */
+    n_arrivals = 0;
+    write_block(port, (const unsigned char *)cmd, len);
+    port_tx_class(PORT_TX_CW);
+    write_block(port, (const unsigned char *)"KY A;", 5);
+    port_tx_class(PORT_TX_NORMAL);
+    write_block(port, (const unsigned char *)"TX0;", 4);
+    hl_usleep(delay * 1000);
+    n = port_tx_abort(port, PORT_TX_CW);
+    port_tx_drain(port);
+    hl_usleep(20 * 1000);
+    errors += check(n == 5 && n_arrivals == 2
+                    && strcmp(commands[0], cmd) == 0
+                    && strcmp(commands[1], "TX0;") == 0,
+                    "CW abort keeps other commands");
+
+    /* urgent commands go out right after the one on the wire */
+    n_arrivals = 0;
+    write_block(port, (const unsigned char *)cmd, len);
+    write_block(port, (const unsigned char *)"FB3;", 4);
+    hl_usleep(delay * 1000);
+    port_tx_class(PORT_TX_URGENT);
+    write_block(port, (const unsigned char *)"TX0;", 4);
+    port_tx_class(PORT_TX_NORMAL);
+    n = port_tx_drain(port);
+    hl_usleep(20 * 1000);
+    errors += check(n == RIG_OK && n_arrivals == 3
+                    && strcmp(commands[0], cmd) == 0
+                    && strcmp(commands[1], "TX0;") == 0
+                    && strcmp(commands[2], "FB3;") == 0,
+                    "urgent command jumps the queue");
+
+    port_set_write_queue(port, 0);
+    port->write_delay = 0;
+
+    stop_responder();
+    rig_flush(port);
+
+    printf("write_delay %dms, %d byte command: blocked %.1fms direct, %.1fms queued\n",
+           delay, (int)len, block_direct, block_queued);
+
+    return errors;
+}
+
+static int benchmark(hamlib_port_t *port, int count)
+{
+    unsigned char buf[64];
+    double *lat = calloc(count, sizeof(double));
+    long syscr_start, syscr_end;
+    struct timeval tv1, tv2;
+    double total_ms = 0;
+    int i;
+
+    if (lat == NULL)
+    {
+        return 1;
+    }
+
+    if (start_responder() != 0)
+    {
+        free(lat);
+        return 1;
+    }
+
+    syscr_start = read_syscalls();
+
+    for (i = 0; i < count; i++)
+    {
+        int n;
+
+        gettimeofday(&tv1, NULL);
+        write_block(port, (const unsigned char *)"FA;", 3);
+        n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+        gettimeofday(&tv2, NULL);
+
+        if (n != (int)strlen(REPLY))
+        {
+            fprintf(stderr, "transaction %d: got %d bytes\n", i, n);
+            free(lat);
+            return 1;
+        }
+
+        lat[i] = (tv2.tv_sec - tv1.tv_sec) * 1000.0
+                 + (tv2.tv_usec - tv1.tv_usec) / 1000.0;
+        total_ms += lat[i];
+    }
+
+    syscr_end = read_syscalls();
+
+    stop_responder();
+
+    qsort(lat, count, sizeof(double), cmp_double);
+
+    printf("transactions:      %d (reply %d bytes in %d byte chunks)\n", count,
+           (int)strlen(REPLY), chunk_size);
+
+    if (syscr_start >= 0 && syscr_end >= 0)
+    {
+        printf("read syscalls/reply: %.2f\n",
+               (double)(syscr_end - syscr_start) / count);
+    }
+
+    printf("latency avg:       %.3f ms\n", total_ms / count);
+    printf("latency p50:       %.3f ms\n", lat[count / 2]);
+    printf("latency p99:       %.3f ms\n", lat[(count * 99) / 100]);
+
+    free(lat);
+    return 0;
+}
+
+static double cpu_ms(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0
+           + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+}
+
+/*
+ * The traffic replay_tests() records: IF; answered 50ms later, n FA;
+ * transactions and an ID; the rig does not answer.
+ */
+static int replay_session(hamlib_port_t *port, int n, const char *fa,
+                          double *if_ms, double *total_ms)
+{
+    unsigned char buf[64];
+    double t0 = now_ms();
+    int errors = 0;
+    int i;
+
+    write_block(port, (const unsigned char *)"IF;", 3);
+
+    if (port->type.rig != RIG_PORT_REPLAY)
+    {
+        if (read(master_fd, buf, sizeof(buf)) <= 0) { return 1; }
+
+        hl_usleep(50 * 1000);
+        put_master("IF00014074000;", 14);
+    }
+
+    errors += read_string(port, buf, sizeof(buf), ";", 1, 0, 1) != 14;
+    *if_ms = now_ms() - t0;
+
+    if (port->type.rig != RIG_PORT_REPLAY && start_responder() != 0)
+    {
+        return 1;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        write_block(port, (const unsigned char *)fa, strlen(fa));
+
+        if (read_string(port, buf, sizeof(buf), ";", 1, 0, 1) != strlen(REPLY)
+                || strcmp((char *)buf, REPLY) != 0)
+        {
+            errors++;
+        }
+    }
+
+    if (port->type.rig != RIG_PORT_REPLAY)
+    {
+        stop_responder();
+    }
+
+    write_block(port, (const unsigned char *)"ID", 2);
+    errors += read_string(port, buf, sizeof(buf), ";", 1, 0, 1) != -RIG_ETIMEOUT;
+
+    *total_ms = now_ms() - t0;
+
+    return errors;
+}
+
+static int replay_tests(hamlib_port_t *port, int count)
+{
+    hamlib_port_t *rp = calloc(1, sizeof(hamlib_port_t));
+    unsigned char buf[64];
+    char path[256];
+    double live_ms, if_ms, total_ms, cpu0, cpu1;
+    int errors = 0;
+    int n = count / 10 + 1;
+
+    snprintf(path, sizeof(path), "%s/testiofunc.%d.cap",
+             getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp", (int)getpid());
+
+    /* record a live session */
+    errors += check(port_set_capture_file(port, path) == RIG_OK,
+                    "capture file created");
+    errors += check(replay_session(port, n, "FA;", &if_ms, &live_ms) == 0,
+                    "captured session");
+    port_set_capture_file(port, NULL);
+
+    rp->timeout = port->timeout;
+    port_set_replay_file(rp, path);
+    errors += check(rp->type.rig == RIG_PORT_REPLAY
+                    && strcmp(port_get_replay_file(rp), path) == 0,
+                    "replay_file makes a replay port");
+
+    /* as recorded: the IF; reply comes after the same 50ms */
+    port_open(rp);
+    errors += check(replay_session(rp, n, "FA;", &if_ms, &total_ms) == 0,
+                    "replay at speed 1");
+    errors += check(if_ms > 40 && if_ms < 100, "replay keeps reply timing");
+    port_close(rp, rp->type.rig);
+
+    port_set_replay_speed(rp, 2);
+    port_open(rp);
+    errors += check(replay_session(rp, n, "FA;", &if_ms, &total_ms) == 0
+                    && if_ms > 15 && if_ms < 40, "replay at speed 2");
+    port_close(rp, rp->type.rig);
+
+    /* a command not in the capture is not answered, and does not throw
+     * the replay out of step */
+    port_set_replay_speed(rp, 0);
+    port_open(rp);
+    write_block(rp, (const unsigned char *)"IF;", 3);
+    read_string(rp, buf, sizeof(buf), ";", 1, 0, 1);
+    write_block(rp, (const unsigned char *)"FB;", 3);
+    errors += check(read_string(rp, buf, sizeof(buf), ";", 1, 0, 1)
+                    == -RIG_ETIMEOUT, "unknown command times out");
+    write_block(rp, (const unsigned char *)"FA;", 3);
+    errors += check(read_string(rp, buf, sizeof(buf), ";", 1, 0, 1)
+                    == strlen(REPLY), "replay stays in step");
+    port_close(rp, rp->type.rig);
+
+    port_open(rp);
+    cpu0 = cpu_ms();
+    errors += check(replay_session(rp, n, "FA;", &if_ms, &total_ms) == 0
+                    && total_ms < live_ms / 2, "replay at speed 0 does not wait");
+    cpu1 = cpu_ms();
+    port_close(rp, rp->type.rig);
+
+    printf("replay of %d transactions: %.1f ms live, %.1f ms at speed 0, "
+           "%.2f us cpu each\n", n + 2, live_ms, total_ms,
+           (cpu1 - cpu0) * 1000.0 / (n + 2));
+
+    port_io_state_release(rp);
+    free(rp);
+    unlink(path);
+
+    return errors;
+}
+
+static int adaptive_timeout_tests(hamlib_port_t *port)
+{
+    unsigned char buf[64];
+    char learned[512];
+    const char *p;
+    double t0, lost_ms, new_ms, p50;
+    int errors = 0;
+    int i;
+
+    if (start_responder() != 0)
+    {
+        return 1;
+    }
+
+    port_set_adaptive_timeout(port, 3);
+
+    for (i = 0; i < 40; i++)
+    {
+        write_block(port, (const unsigned char *)"FA;", 3);
+        errors += read_string(port, buf, sizeof(buf), ";", 1, 0, 1) != strlen(REPLY);
+    }
+
+    port_get_timeout_learned(port, learned, sizeof(learned));
+    errors += check(strstr(learned, "FA n=40 to=0") != NULL,
+                    "reply times learned per command");
+
+    /* a lost FA reply only costs a few times the usual reply time */
+    t0 = now_ms();
+    write_block(port, (const unsigned char *)"FA", 2);
+    errors += read_string(port, buf, sizeof(buf), ";", 1, 0, 1) != -RIG_ETIMEOUT;
+    lost_ms = now_ms() - t0;
+
+    /* a command never seen before waits the full timeout */
+    t0 = now_ms();
+    write_block(port, (const unsigned char *)"ID", 2);
+    errors += read_string(port, buf, sizeof(buf), ";", 1, 0, 1) != -RIG_ETIMEOUT;
+    new_ms = now_ms() - t0;
+
+    /* an echo is not the reply, the time runs on until the reply */
+    echo_ms = 20;
+
+    for (i = 0; i < 20; i++)
+    {
+        write_block(port, (const unsigned char *)"IF;", 3);
+        read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+        errors += read_string(port, buf, sizeof(buf), ";", 1, 0, 1) != strlen(REPLY);
+    }
+
+    echo_ms = -1;
+    port_get_timeout_learned(port, learned, sizeof(learned));
+    p = strstr(learned, "IF n=");
+    errors += check(p && sscanf(p, "IF n=%*d to=%*d p50=%lf", &p50) == 1
+                    && p50 >= 15, "echo is not taken as the reply");
+
+    stop_responder();
+
+    errors += check(lost_ms < port->timeout / 2, "lost reply times out early");
+    errors += check(new_ms >= port->timeout - 5, "unknown command waits timeout");
+
+    port_get_timeout_learned(port, learned, sizeof(learned));
+    printf("timeout %dms, lost reply after %.1fms: %s\n", port->timeout,
+           lost_ms, learned);
+
+    port_set_adaptive_timeout(port, 0);
+    port_reset_timeout_learned(port);
+    rig_flush(port);
+
+    return errors;
+}
+
+static int port_stats_tests(hamlib_port_t *port)
+{
+    unsigned char buf[64];
+    char stats[256], expect[256];
+    int errors = 0;
+    int i;
+
+    if (start_responder() != 0)
+    {
+        return 1;
+    }
+
+    port_reset_stats(port);
+
+    for (i = 0; i < 3; i++)
+    {
+        write_block(port, (const unsigned char *)"FA;", 3);
+        errors += read_string(port, buf, sizeof(buf), ";", 1, 0, 1) != strlen(REPLY);
+    }
+
+    /* no reply to an unterminated command, sending it again is a retry */
+    for (i = 0; i < 2; i++)
+    {
+        write_block(port, (const unsigned char *)"FA", 2);
+        errors += read_string(port, buf, sizeof(buf), ";", 1, 0, 1) != -RIG_ETIMEOUT;
+    }
+
+    stop_responder();
+
+    port_get_stats(port, stats, sizeof(stats));
+    snprintf(expect, sizeof(expect),
+             "tx_bytes=13 rx_bytes=%d timeouts=2 retries=1 async_frames=0",
+             (int)(3 * strlen(REPLY)));
+    printf("port stats: %s\n", stats);
+    errors += check(strcmp(stats, expect) == 0, "bytes, timeouts and retries counted");
+
+    port_reset_stats(port);
+    port_get_stats(port, stats, sizeof(stats));
+    errors += check(strncmp(stats, "tx_bytes=0 rx_bytes=0 ", 22) == 0,
+                    "port stats reset");
+    rig_flush(port);
+
+    return errors;
+}
+
+/* open a pty pair, returning the master fd, and port on its slave side */
+static int open_pty_port(hamlib_port_t *port, int asyncio)
+{
+    struct termios tio;
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        printf("no pseudo-terminal available, skipping\n");
+        return -1;
+    }
+
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+
+    port->type.rig = RIG_PORT_SERIAL;
+    strncpy(port->pathname, ptsname(master), HAMLIB_FILPATHLEN - 1);
+    port->parm.serial.rate = 115200;
+    port->parm.serial.data_bits = 8;
+    port->parm.serial.stop_bits = 1;
+    port->parm.serial.parity = RIG_PARITY_NONE;
+    port->parm.serial.handshake = RIG_HANDSHAKE_NONE;
+    port->timeout = 200;
+    port->asyncio = asyncio;
+
+    if (port_open(port) != RIG_OK)
+    {
+        printf("cannot open %s, skipping\n", port->pathname);
+        close(master);
+        return -1;
+    }
+
+    return master;
+}
+
+struct wakeup_rig
+{
+    hamlib_port_t port;
+    int master;
+    int count;
+    int received;
+    double *lat;
+    pthread_t producer;
+    pthread_t consumer;
+};
+
+/* plays the async data handler: hands over timestamped frames */
+static void *wakeup_producer(void *arg)
+{
+    struct wakeup_rig *r = arg;
+    char frame[32];
+    int i;
+
+    for (i = 0; i < r->count; i++)
+    {
+        /* spread the rigs out instead of firing all in lockstep */
+        hl_usleep(500 + (i * 7919 + r->master * 104729) % 1000);
+        snprintf(frame, sizeof(frame), "T%.3f;", now_ms());
+        write_block_sync(&r->port, (unsigned char *)frame, strlen(frame));
+    }
+
+    return NULL;
+}
+
+/* plays the transaction waiting for the reply */
+static void *wakeup_consumer(void *arg)
+{
+    struct wakeup_rig *r = arg;
+    unsigned char buf[64];
+
+    while (r->received < r->count)
+    {
+        int n = read_string(&r->port, buf, sizeof(buf), ";", 1, 0, 1);
+
+        if (n <= 0)
+        {
+            break;
+        }
+
+        r->lat[r->received++] = now_ms() - atof((char *)buf + 1);
+    }
+
+    return NULL;
+}
+
+static int sync_channel_tests(hamlib_port_t *port)
+{
+    unsigned char buf[64];
+    unsigned char err = (unsigned char) -RIG_EPROTO;
+    int errors = 0;
+    int n;
+
+    write_block_sync(port, (const unsigned char *)"FA1;MD2;", 8);
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == 4 && strcmp((char *)buf, "FA1;") == 0,
+                    "sync channel delivers frame");
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == 4 && strcmp((char *)buf, "MD2;") == 0,
+                    "sync channel carries over");
+
+    write_block_sync_error(port, &err, 1);
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == -RIG_EPROTO, "sync channel delivers error code");
+
+    write_block_sync(port, (const unsigned char *)"FA3;", 4);
+    port_flush_sync_pipes(port);
+    n = read_string(port, buf, sizeof(buf), ";", 1, 0, 1);
+    errors += check(n == -RIG_ETIMEOUT, "sync channel flushed");
+
+    return errors;
+}
+
+static int wakeup_benchmark(int count, int check_only, int high_fds)
+{
+    struct wakeup_rig *rigs = calloc(WAKEUP_RIGS, sizeof(struct wakeup_rig));
+    struct timeval tv1, tv2;
+    struct rusage ru1, ru2;
+    double *all, cpu_ms, wall_ms;
+    int i, total = 0, errors = 0;
+    int filler = -1;
+
+    all = calloc((size_t)WAKEUP_RIGS * count, sizeof(double));
+
+    if (rigs == NULL || all == NULL)
+    {
+        return 1;
+    }
+
+    if (high_fds)
+    {
+        struct rlimit rl;
+
+        getrlimit(RLIMIT_NOFILE, &rl);
+
+        if (rl.rlim_cur < FD_SETSIZE + 8 * WAKEUP_RIGS)
+        {
+            rl.rlim_cur = rl.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &rl);
+        }
+
+        /* occupy every fd below FD_SETSIZE */
+        filler = open("/dev/null", O_RDONLY);
+
+        while (filler >= 0 && filler < FD_SETSIZE - 1)
+        {
+            if (dup(filler) < 0) { break; }
+
+            filler++;
+        }
+
+        printf("rig fds start above %d\n", filler);
+    }
+
+    for (i = 0; i < WAKEUP_RIGS; i++)
+    {
+        rigs[i].master = open_pty_port(&rigs[i].port, 1);
+
+        if (rigs[i].master < 0)
+        {
+            return 1;
+        }
+
+        rigs[i].count = count;
+        rigs[i].lat = all + (size_t)i * count;
+    }
+
+    if (check_only)
+    {
+        errors = sync_channel_tests(&rigs[WAKEUP_RIGS - 1].port);
+    }
+
+    getrusage(RUSAGE_SELF, &ru1);
+    gettimeofday(&tv1, NULL);
+
+    for (i = 0; i < WAKEUP_RIGS; i++)
+    {
+        pthread_create(&rigs[i].consumer, NULL, wakeup_consumer, &rigs[i]);
+        pthread_create(&rigs[i].producer, NULL, wakeup_producer, &rigs[i]);
+    }
+
+    for (i = 0; i < WAKEUP_RIGS; i++)
+    {
+        pthread_join(rigs[i].producer, NULL);
+        pthread_join(rigs[i].consumer, NULL);
+    }
+
+    gettimeofday(&tv2, NULL);
+    getrusage(RUSAGE_SELF, &ru2);
+
+    for (i = 0; i < WAKEUP_RIGS; i++)
+    {
+        /* pack the latencies of all rigs together for the percentiles */
+        memmove(all + total, rigs[i].lat, rigs[i].received * sizeof(double));
+        total += rigs[i].received;
+        port_close(&rigs[i].port, RIG_PORT_SERIAL);
+        close(rigs[i].master);
+    }
+
+    qsort(all, total, sizeof(double), cmp_double);
+
+    wall_ms = (tv2.tv_sec - tv1.tv_sec) * 1000.0
+              + (tv2.tv_usec - tv1.tv_usec) / 1000.0;
+    cpu_ms = (ru2.ru_utime.tv_sec - ru1.ru_utime.tv_sec
+              + ru2.ru_stime.tv_sec - ru1.ru_stime.tv_sec) * 1000.0
+             + (ru2.ru_utime.tv_usec - ru1.ru_utime.tv_usec
+                + ru2.ru_stime.tv_usec - ru1.ru_stime.tv_usec) / 1000.0;
+
+    errors += check(total == WAKEUP_RIGS * count, "all async frames received");
+
+    if (total > 0)
+    {
+        printf("async wakeup, %d rigs:  %d frames in %.0f ms\n", WAKEUP_RIGS, total,
+               wall_ms);
+        printf("wakeup latency p50:  %.3f ms\n", all[total / 2]);
+        printf("wakeup latency p99:  %.3f ms\n", all[(int)(total * 0.99)]);
+        printf("wakeup latency max:  %.3f ms\n", all[total - 1]);
+        printf("cpu per frame:       %.1f us\n", cpu_ms * 1000.0 / total);
+    }
+
+    free(all);
+    free(rigs);
+
+    if (filler >= 0)
+    {
+        for (i = 3; i <= filler; i++) { close(i); }
+    }
+
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    hamlib_port_t *port;
+    int bench_only = 0;
+    int wakeup_only = 0;
+    int count = 2000;
+    int errors = 0;
+    int argi = 1;
+
+    rig_set_debug(RIG_DEBUG_NONE);
+
+    if (argi < argc && strcmp(argv[argi], "-b") == 0)
+    {
+        bench_only = 1;
+        argi++;
+    }
+    else if (argi < argc && (strcmp(argv[argi], "-w") == 0
+                             || strcmp(argv[argi], "-W") == 0))
+    {
+        wakeup_only = argv[argi][1] == 'W' ? 2 : 1;
+        argi++;
+    }
+
+    if (argi < argc) { count = atoi(argv[argi++]); }
+
+    if (argi < argc) { chunk_size = atoi(argv[argi++]); }
+
+    if (count < 1) { count = 1; }
+
+    if (chunk_size < 1) { chunk_size = 1; }
+
+    if (wakeup_only)
+    {
+        return wakeup_benchmark(count, 0, wakeup_only == 2) ? 1 : 0;
+    }
+
+    port = calloc(1, sizeof(hamlib_port_t));
+    master_fd = open_pty_port(port, 0);
+
+    if (master_fd < 0)
+    {
+        free(port);
+        return 77;
+    }
+
+    if (!bench_only)
+    {
+        errors = functional_tests(port);
+        errors += post_write_tests(port);
+        errors += write_queue_tests(port);
+    }
+
+    if (errors == 0)
+    {
+        errors = benchmark(port, count);
+    }
+
+    if (errors == 0 && !bench_only)
+    {
+        errors = replay_tests(port, count);
+    }
+
+    if (errors == 0 && !bench_only)
+    {
+        errors = adaptive_timeout_tests(port);
+    }
+
+    if (errors == 0 && !bench_only)
+    {
+        errors = port_stats_tests(port);
+    }
+
+    port_close(port, RIG_PORT_SERIAL);
+    free(port);
+    close(master_fd);
+
+    if (errors == 0 && !bench_only)
+    {
+        errors = wakeup_benchmark(count / 10 + 1, 1, 0);
+    }
+
+    return errors ? 1 : 0;
+}